@@ -0,0 +1,90 @@
+#include "arena.h"
+#include "bench.h"
+#include "renderer.h"
+
+#include <thread>
+
+/** @brief The benchmark frame; every pixel makes SCRATCH_OBJECTS objects. */
+static const std::size_t FRAME_SIZE = 256;
+static const std::size_t SCRATCH_OBJECTS = 16;
+
+/** @brief A hit record, as a shader keeps a few per pixel. */
+struct scratch_hit {
+    float t;
+    vec3f normal;
+    std::uint32_t primitive;
+};
+
+/** @returns A color computed from a list of scratch hits. */
+template <typename List>
+static colorf shade(List& hits, std::size_t x, std::size_t y) {
+    hits.reserve(SCRATCH_OBJECTS);
+
+    for (std::size_t i = 0; i < SCRATCH_OBJECTS; i++)
+        hits.push_back(scratch_hit{float(x + i), vec3f(0, 1, 0),
+                                   static_cast<std::uint32_t>(y)});
+
+    float sum = 0;
+
+    for (const scratch_hit& hit : hits)
+        sum += hit.t;
+
+    return colorf(sum, 0, 0);
+}
+
+/** @brief Renders a frame whose shader allocates from the heap or arenas. */
+static std::vector<bench_result> measure(unsigned threads) {
+    scheduler pool(threads);
+    framebuffer frame(FRAME_SIZE, FRAME_SIZE);
+    thread_arenas scratch(pool);
+    const std::string mode = std::to_string(pool.size()) + "_threads";
+    const std::size_t pixels = FRAME_SIZE * FRAME_SIZE;
+
+    std::vector<bench_result> results;
+
+    results.push_back(bench_measure("scratch_alloc", "heap", mode, pixels,
+                                    [&] {
+        render(pool, frame, render_settings(),
+               [](std::size_t x, std::size_t y) {
+            std::vector<scratch_hit> hits;
+
+            return shade(hits, x, y);
+        });
+    }));
+
+    arena_stats stats;
+
+    results.push_back(bench_measure("scratch_alloc", "arena", mode, pixels,
+                                    [&] {
+        render(pool, frame, render_settings(), scratch,
+               [](std::size_t x, std::size_t y, arena& memory) {
+            arena_vector<scratch_hit> hits{
+                arena_allocator<scratch_hit>(memory)};
+
+            return shade(hits, x, y);
+        });
+
+        stats = scratch.reset();
+    }));
+
+    results.back().counters.push_back({"high_water_kb",
+                                       stats.high_water / 1024.0});
+    results.back().counters.push_back({"capacity_kb",
+                                       stats.capacity / 1024.0});
+
+    return results;
+}
+
+int main(int argc, char** argv) {
+    std::vector<bench_result> results = measure(1);
+
+    if (std::thread::hardware_concurrency() > 1) {
+        const std::vector<bench_result> parallel = measure(0);
+
+        results.insert(results.end(), parallel.begin(), parallel.end());
+    }
+
+    bench_write(argc, argv, results);
+
+    return 0;
+}
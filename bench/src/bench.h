@@ -0,0 +1,134 @@
+/** @file bench.h */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define RAYSTALKER_BENCH_TSC 1
+#endif
+
+/**
+ * @brief One measurement: cost of an operation on a component type.
+ *
+ * ops_per_cycle is measured against the time stamp counter, i.e. at the
+ * nominal (not turbo) frequency. It is 0 where no TSC is available.
+ * counters holds optional per-op metrics of a benchmark (e.g. nodes
+ * visited per ray).
+ */
+struct bench_result {
+    std::string operation;
+    std::string type;
+    std::string mode;
+    double ns_per_op;
+    double ops_per_cycle;
+    std::vector<std::pair<std::string, double>> counters = {};
+};
+
+/**
+ * @brief Keeps the compiler from optimizing value away.
+ *
+ * Same technique as benchmark::DoNotOptimize: value is considered read
+ * and memory clobbered.
+ */
+template <typename Type>
+inline void bench_keep(const Type& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/** @returns The current value of the time stamp counter (or 0). */
+inline std::uint64_t bench_cycles() {
+#ifdef RAYSTALKER_BENCH_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Times body(), which performs ops operations.
+ *
+ * @returns The result with ns_per_op and ops_per_cycle filled in.
+ */
+template <typename Body>
+bench_result bench_measure(const std::string& operation,
+                           const std::string& type,
+                           const std::string& mode,
+                           std::size_t ops, Body body) {
+    body();  // warm-up
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::uint64_t start_cycles = bench_cycles();
+
+    body();
+
+    const std::uint64_t cycles = bench_cycles() - start_cycles;
+    const double ns = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count();
+
+    return bench_result{operation, type, mode, ns / ops,
+                        cycles ? double(ops) / cycles : 0.0};
+}
+
+/** @brief Writes the results as CSV, one row per result. */
+inline void bench_write_csv(std::ostream& out,
+                            const std::vector<bench_result>& results) {
+    out << "operation,type,mode,ns_per_op,ops_per_cycle,counters\n";
+
+    for (const bench_result& result : results) {
+        out << result.operation << ',' << result.type << ','
+            << result.mode << ',' << result.ns_per_op << ','
+            << result.ops_per_cycle << ',';
+
+        for (std::size_t i = 0; i < result.counters.size(); i++)
+            out << (i ? ";" : "") << result.counters[i].first << '='
+                << result.counters[i].second;
+
+        out << '\n';
+    }
+}
+
+/** @brief Writes the results as a JSON array of objects. */
+inline void bench_write_json(std::ostream& out,
+                             const std::vector<bench_result>& results) {
+    out << "[\n";
+
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const bench_result& result = results[i];
+
+        out << "  {\"operation\": \"" << result.operation
+            << "\", \"type\": \"" << result.type
+            << "\", \"mode\": \"" << result.mode
+            << "\", \"ns_per_op\": " << result.ns_per_op
+            << ", \"ops_per_cycle\": " << result.ops_per_cycle
+            << ", \"counters\": {";
+
+        for (std::size_t c = 0; c < result.counters.size(); c++)
+            out << (c ? ", " : "") << '"' << result.counters[c].first
+                << "\": " << result.counters[c].second;
+
+        out << "}}" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+
+    out << "]\n";
+}
+
+/**
+ * @brief Writes the results to stdout: JSON if the first program
+ *        argument is --json, CSV otherwise.
+ */
+inline void bench_write(int argc, char** argv,
+                        const std::vector<bench_result>& results) {
+    if (argc > 1 && std::strcmp(argv[1], "--json") == 0)
+        bench_write_json(std::cout, results);
+    else
+        bench_write_csv(std::cout, results);
+}
@@ -0,0 +1,284 @@
+#include "bench.h"
+#include "camera.h"
+#include "compressed_bvh.h"
+#include "lbvh.h"
+#include "random.h"
+#include "sbvh.h"
+
+#include <cmath>
+#include <limits>
+
+/** @brief Number of spheres of the benchmark scene. */
+static const std::size_t SPHERE_COUNT = 200000;
+
+/** @brief Number of triangles of the sliver scene. */
+static const std::size_t SLIVER_COUNT = 100000;
+
+/** @brief Primary rays are traced on a RAYS_X x RAYS_Y grid. */
+static const std::size_t RAYS_X = 512;
+static const std::size_t RAYS_Y = 512;
+
+/** @returns A deterministic field of small spheres. */
+static std::vector<sphere> make_spheres() {
+    std::vector<sphere> spheres;
+    pcg32 random(1);
+
+    for (std::size_t i = 0; i < SPHERE_COUNT; i++) {
+        const float radius = 0.02f + 0.06f * random.next_float();
+        const float x = random.next_float() * 16 - 8;
+        const float y = random.next_float() * 4;
+        const float z = random.next_float() * 16 - 12;
+
+        spheres.push_back(sphere(vec3f(x, y, z), radius));
+    }
+
+    return spheres;
+}
+
+/**
+ * @returns Long thin triangles lying diagonally across the sphere field:
+ *          the worst case of object split hierarchies.
+ */
+static std::vector<triangle> make_slivers() {
+    std::vector<triangle> triangles;
+    pcg32 random(5);
+
+    for (std::size_t i = 0; i < SLIVER_COUNT; i++) {
+        const vec3f center(random.next_float() * 16 - 8,
+                           random.next_float() * 4,
+                           random.next_float() * 16 - 12);
+        const vec3f along = vec3f(random.next_float() - 0.5f,
+                                  random.next_float() - 0.5f,
+                                  random.next_float() - 0.5f) * 2.0f;
+        const vec3f across(0.05f, 0.05f, 0);
+
+        triangles.push_back(triangle(center - along, center + along,
+                                     center + across));
+    }
+
+    return triangles;
+}
+
+/** @returns The bounds of spheres at frame of a wobbling animation. */
+static std::vector<aabb> animate(const std::vector<sphere>& spheres,
+                                 int frame) {
+    std::vector<aabb> bounds;
+    bounds.reserve(spheres.size());
+
+    for (std::size_t i = 0; i < spheres.size(); i++) {
+        const float phase = 0.3f * frame + 0.001f * i;
+        const vec3f offset(std::sin(phase), 0, std::cos(phase));
+
+        bounds.push_back(::bounds(sphere(spheres[i].center() + offset * 0.1f,
+                                         spheres[i].radius())));
+    }
+
+    return bounds;
+}
+
+static std::vector<ray> make_rays() {
+    const camera view(vec3f(0, 1.5f, 6), vec3f(0, 0.8f, 0), vec3f(0, 1, 0),
+                      40, float(RAYS_X) / RAYS_Y);
+    std::vector<ray> rays;
+
+    for (std::size_t y = 0; y < RAYS_Y; y++)
+        for (std::size_t x = 0; x < RAYS_X; x++)
+            rays.push_back(view.get_ray((x + 0.5f) / RAYS_X,
+                                        (y + 0.5f) / RAYS_Y));
+
+    return rays;
+}
+
+/**
+ * @returns Rays from random points of the field in random directions:
+ *          every ray touches different nodes, so traversal is bound by
+ *          memory rather than by the slab tests.
+ */
+static std::vector<ray> make_incoherent_rays() {
+    std::vector<ray> rays;
+    pcg32 random(11);
+
+    for (std::size_t i = 0; i < RAYS_X * RAYS_Y; i++) {
+        const vec3f origin(random.next_float() * 16 - 8,
+                           random.next_float() * 4,
+                           random.next_float() * 16 - 12);
+
+        rays.push_back(ray(origin, sample_sphere(random)));
+    }
+
+    return rays;
+}
+
+/** @brief Times closest-hit queries of every ray against tree. */
+template <typename Tree, typename Primitives>
+static bench_result trace(const std::string& layout, const Tree& tree,
+                          const Primitives& primitives,
+                          const std::vector<ray>& rays,
+                          const std::string& mode = "primary") {
+    bvh_traversal_stats stats;
+
+    bench_result result = bench_measure("closest_hit", layout, mode,
+                                        rays.size(), [&] {
+        stats = bvh_traversal_stats();
+
+        for (const ray& r : rays) {
+            float t = std::numeric_limits<float>::infinity();
+            std::size_t hit = 0;
+
+            intersect(r, tree, primitives, 1e-4f, t, hit, &stats);
+            bench_keep(t);
+        }
+    });
+
+    result.counters.push_back({"nodes_per_ray",
+                               double(stats.nodes) / stats.rays});
+    result.counters.push_back({"primitives_per_ray",
+                               double(stats.primitives) / stats.rays});
+
+    return result;
+}
+
+int main(int argc, char** argv) {
+    const std::vector<sphere> spheres = make_spheres();
+    const std::vector<ray> rays = make_rays();
+    const std::vector<aabb> bounds = primitive_bounds(spheres);
+
+    std::vector<bench_result> results;
+    bvh binary;
+
+    results.push_back(bench_measure("build", "binary", "sah",
+                                    spheres.size(), [&] {
+        binary = bvh(bounds);
+    }));
+    results.back().counters.push_back({"nodes",
+                                       double(binary.stats().node_count)});
+    results.back().counters.push_back({"sah_cost", binary.stats().sah_cost});
+
+    // Interactive rebuilds: Morton order, without and with treelet
+    // reoptimization.
+    scheduler pool;
+    lbvh_build_settings morton;
+    bvh linear;
+    bvh optimized;
+
+    results.push_back(bench_measure("build", "lbvh", "morton",
+                                    spheres.size(), [&] {
+        linear = build_lbvh(bounds, &pool, morton);
+    }));
+    results.back().counters.push_back({"sah_cost", linear.stats().sah_cost});
+
+    morton.treelet_passes = 2;
+
+    results.push_back(bench_measure("build", "lbvh", "treelets",
+                                    spheres.size(), [&] {
+        optimized = build_lbvh(bounds, &pool, morton);
+    }));
+    results.back().counters.push_back({"sah_cost",
+                                       optimized.stats().sah_cost});
+
+    // An animation step: full rebuild, refit, and refit with partial
+    // rebuilds of the degraded subtrees.
+    const std::vector<aabb> frames[2] = { animate(spheres, 1),
+                                          animate(spheres, 2) };
+    dynamic_bvh animated(bounds);
+    bvh_update_stats update;
+    int frame = 0;
+
+    results.push_back(bench_measure("build", "binary", "animated",
+                                    spheres.size(), [&] {
+        bench_keep(bvh(frames[0]).stats().sah_cost);
+    }));
+    results.push_back(bench_measure("refit", "binary", "animated",
+                                    spheres.size(), [&] {
+        bench_keep(refit(binary, frames[0]).stats().sah_cost);
+    }));
+    results.push_back(bench_measure("update", "dynamic", "animated",
+                                    spheres.size(), [&] {
+        update = animated.update(frames[frame++ % 2]);
+    }));
+    results.back().counters.push_back({"sah_cost", update.sah_cost});
+    results.back().counters.push_back({"rebuilt_primitives",
+                                       double(update.rebuilt_primitives)});
+
+    wide_bvh<4> wide4;
+    wide_bvh<8> wide8;
+
+    results.push_back(bench_measure("collapse", "bvh4", "from_binary",
+                                    spheres.size(), [&] {
+        wide4 = wide_bvh<4>(binary);
+    }));
+    results.push_back(bench_measure("collapse", "bvh8", "from_binary",
+                                    spheres.size(), [&] {
+        wide8 = wide_bvh<8>(binary);
+    }));
+
+    compressed_bvh<4> compressed4;
+    compressed_bvh<8> compressed8;
+
+    results.push_back(bench_measure("compress", "cbvh4", "from_wide",
+                                    spheres.size(), [&] {
+        compressed4 = compressed_bvh<4>(wide4);
+    }));
+    results.push_back(bench_measure("compress", "cbvh8", "from_wide",
+                                    spheres.size(), [&] {
+        compressed8 = compressed_bvh<8>(wide8);
+    }));
+
+    results.push_back(trace("binary", binary, spheres, rays));
+    results.back().counters.push_back({"node_mb",
+        binary.nodes().size() * sizeof(bvh_node) / 1e6});
+
+    results.push_back(trace("lbvh", linear, spheres, rays));
+    results.push_back(trace("lbvh_treelets", optimized, spheres, rays));
+
+    results.push_back(trace("bvh4", wide4, spheres, rays));
+    results.back().counters.push_back({"node_mb",
+        wide4.nodes().size() * sizeof(wide_bvh_node<4>) / 1e6});
+
+    results.push_back(trace("bvh8", wide8, spheres, rays));
+    results.back().counters.push_back({"node_mb",
+        wide8.nodes().size() * sizeof(wide_bvh_node<8>) / 1e6});
+
+    results.push_back(trace("cbvh4", compressed4, spheres, rays));
+    results.back().counters.push_back({"node_mb",
+        compressed4.nodes().size() * sizeof(compressed_bvh_node<4>) / 1e6});
+
+    results.push_back(trace("cbvh8", compressed8, spheres, rays));
+    results.back().counters.push_back({"node_mb",
+        compressed8.nodes().size() * sizeof(compressed_bvh_node<8>) / 1e6});
+
+    const std::vector<ray> incoherent = make_incoherent_rays();
+
+    results.push_back(trace("binary", binary, spheres, incoherent,
+                            "incoherent"));
+    results.push_back(trace("bvh8", wide8, spheres, incoherent,
+                            "incoherent"));
+    results.push_back(trace("cbvh8", compressed8, spheres, incoherent,
+                            "incoherent"));
+
+    // Build quality presets on long thin triangles.
+    const std::vector<triangle> slivers = make_slivers();
+    bvh fast;
+    bvh high;
+
+    results.push_back(bench_measure("build", "binary", "slivers",
+                                    slivers.size(), [&] {
+        fast = bvh(primitive_bounds(slivers));
+    }));
+    results.back().counters.push_back({"sah_cost", fast.stats().sah_cost});
+
+    results.push_back(bench_measure("build", "sbvh", "slivers",
+                                    slivers.size(), [&] {
+        high = build_sbvh(slivers);
+    }));
+    results.back().counters.push_back({"sah_cost", high.stats().sah_cost});
+    results.back().counters.push_back({"references",
+        double(high.indices().size()) / slivers.size()});
+
+    results.push_back(trace("binary", fast, slivers, rays, "slivers"));
+    results.push_back(trace("sbvh", high, slivers, rays, "slivers"));
+
+    bench_write(argc, argv, results);
+
+    return 0;
+}
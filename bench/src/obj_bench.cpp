@@ -0,0 +1,101 @@
+#include "bench.h"
+#include "obj_loader.h"
+#include "scene_cache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+/** @brief The generated OBJ is a GRID_SIZE x GRID_SIZE quad grid. */
+static const std::size_t GRID_SIZE = 400;
+
+/**
+ * @brief Writes a grid with positions, uvs and normals, as exporters
+ *        write them: one uv and normal per position, quads as faces.
+ */
+static void write_grid(const std::string& path) {
+    std::ofstream file(path, std::ios::binary);
+    const std::size_t row = GRID_SIZE + 1;
+
+    for (std::size_t y = 0; y < row; y++)
+        for (std::size_t x = 0; x < row; x++)
+            file << "v " << x * 0.01f << ' ' << y * 0.01f << ' '
+                 << (x * y % 7) * 0.001f << '\n';
+
+    for (std::size_t y = 0; y < row; y++)
+        for (std::size_t x = 0; x < row; x++)
+            file << "vt " << float(x) / GRID_SIZE << ' '
+                 << float(y) / GRID_SIZE << '\n';
+
+    for (std::size_t i = 0; i < row * row; i++)
+        file << "vn 0 0 1\n";
+
+    for (std::size_t y = 0; y < GRID_SIZE; y++)
+        for (std::size_t x = 0; x < GRID_SIZE; x++) {
+            const std::size_t i = y * row + x + 1;
+            const std::size_t corners[4] = { i, i + 1, i + row + 1, i + row };
+
+            file << 'f';
+
+            for (std::size_t c : corners)
+                file << ' ' << c << '/' << c << '/' << c;
+
+            file << '\n';
+        }
+}
+
+/** @brief Times load_obj on a scheduler of threads threads. */
+static bench_result measure_load(const std::string& path, unsigned threads) {
+    scheduler pool(threads);
+    obj_scene scene;
+
+    bench_result result = bench_measure(
+        "load_obj", std::to_string(pool.size()) + "_threads", "parse",
+        2 * GRID_SIZE * GRID_SIZE, [&] {
+        scene = load_obj(path, pool);
+    });
+
+    result.counters.push_back({"megabytes_per_second",
+                               scene.stats.megabytes_per_second});
+    result.counters.push_back({"peak_memory_mb",
+                               scene.stats.peak_memory_bytes / 1e6});
+
+    return result;
+}
+
+int main(int argc, char** argv) {
+    const std::filesystem::path directory =
+        std::filesystem::temp_directory_path();
+    const std::string path = (directory / "raystalker_bench.obj").string();
+    const std::string cache = (directory / "raystalker_bench.cache").string();
+
+    write_grid(path);
+
+    std::vector<bench_result> results;
+
+    results.push_back(measure_load(path, 1));
+
+    if (std::thread::hardware_concurrency() > 1)
+        results.push_back(measure_load(path, 0));
+
+    // Startup from a scene cache of the same mesh and its BVH.
+    scheduler pool;
+    cached_scene scene;
+    scene.geometry = load_obj(path, pool).geometry;
+    scene.tree = bvh(primitive_bounds(scene.geometry), &pool);
+
+    write_scene_cache(cache, scene);
+
+    results.push_back(bench_measure("load_cache", "mmap", "zero_copy",
+                                    2 * GRID_SIZE * GRID_SIZE, [&] {
+        scene = load_scene_cache(cache);
+    }));
+
+    std::remove(path.c_str());
+    std::remove(cache.c_str());
+
+    bench_write(argc, argv, results);
+
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include "bench.h"
+#include "random.h"
+#include "triangle.h"
+
+#include <limits>
+
+/** @brief Number of triangles; every ray is tested against all. */
+static const std::size_t TRIANGLE_COUNT = 1 << 12;
+static const std::size_t RAY_COUNT = 1 << 10;
+
+static std::vector<triangle> make_triangles() {
+    std::vector<triangle> triangles;
+    pcg32 random(3);
+
+    for (std::size_t i = 0; i < TRIANGLE_COUNT; i++) {
+        const vec3f center(random.next_float() * 2 - 1,
+                           random.next_float() * 2 - 1,
+                           random.next_float() * 4 + 2);
+        const vec3f a(random.next_float() - 0.5f, random.next_float() - 0.5f,
+                      random.next_float() - 0.5f);
+        const vec3f b(random.next_float() - 0.5f, random.next_float() - 0.5f,
+                      random.next_float() - 0.5f);
+
+        triangles.push_back(triangle(center, center + a, center + b));
+    }
+
+    return triangles;
+}
+
+static std::vector<ray> make_rays() {
+    std::vector<ray> rays;
+    pcg32 random(5);
+
+    for (std::size_t i = 0; i < RAY_COUNT; i++)
+        rays.push_back(ray(vec3f(0, 0, 0),
+                           vec3f(random.next_float() - 0.5f,
+                                 random.next_float() - 0.5f, 1)));
+
+    return rays;
+}
+
+/**
+ * @brief Times test(ray, primitive, t) over every ray / primitive pair.
+ *
+ * Reports the hit rate, which must match between kernels.
+ */
+template <typename Primitive, typename Test>
+static bench_result measure_kernel(const std::string& kernel,
+                                   const std::string& layout,
+                                   const std::vector<Primitive>& primitives,
+                                   const std::vector<ray>& rays, Test test) {
+    std::size_t hits = 0;
+
+    bench_result result = bench_measure(
+        kernel, layout, "closest_hit", primitives.size() * rays.size(), [&] {
+        hits = 0;
+
+        for (const ray& r : rays) {
+            float t = std::numeric_limits<float>::infinity();
+
+            for (const Primitive& primitive : primitives)
+                hits += test(r, primitive, t);
+
+            bench_keep(t);
+        }
+    });
+
+    result.counters.push_back({"hit_rate",
+                               double(hits) / (primitives.size() *
+                                               rays.size())});
+    result.counters.push_back({"bytes_per_triangle",
+                               double(sizeof(Primitive))});
+
+    return result;
+}
+
+int main(int argc, char** argv) {
+    const std::vector<triangle> triangles = make_triangles();
+    const std::vector<ray> rays = make_rays();
+
+    std::vector<triangle_precomputed> precomputed;
+
+    for (const triangle& tri : triangles)
+        precomputed.push_back(triangle_precomputed(tri));
+
+    std::vector<bench_result> results;
+
+    results.push_back(measure_kernel("moller_trumbore", "compact",
+                                     triangles, rays,
+                                     [](const ray& r, const triangle& tri,
+                                        float& t) {
+        return intersect(r, tri, 0.0f, t);
+    }));
+
+    results.push_back(measure_kernel("watertight", "compact", triangles,
+                                     rays,
+                                     [](const ray& r, const triangle& tri,
+                                        float& t) {
+        return intersect_watertight(r, tri, 0.0f, t);
+    }));
+
+    // The watertight setup amortized over all triangles, as in a BVH leaf
+    // loop that prepares the ray once.
+    results.push_back(bench_measure("watertight", "compact",
+                                    "closest_hit_prepared",
+                                    triangles.size() * rays.size(), [&] {
+        for (const ray& r : rays) {
+            const watertight_ray prepared(r);
+            float t = std::numeric_limits<float>::infinity();
+
+            for (const triangle& tri : triangles)
+                intersect_watertight(prepared, tri, 0.0f, t);
+
+            bench_keep(t);
+        }
+    }));
+
+    results.push_back(measure_kernel("moller_trumbore", "precomputed",
+                                     precomputed, rays,
+                                     [](const ray& r,
+                                        const triangle_precomputed& tri,
+                                        float& t) {
+        return intersect(r, tri, 0.0f, t);
+    }));
+
+    bench_write(argc, argv, results);
+
+    return 0;
+}
@@ -0,0 +1,200 @@
+#include "bench.h"
+#include "vec3.h"
+
+#include <type_traits>
+
+/** @brief Number of dependent operations timed in latency mode. */
+static const std::size_t LATENCY_STEPS = 1 << 22;
+
+/** @brief Array size and repetitions used in throughput mode. */
+static const std::size_t THROUGHPUT_SIZE = 1 << 16;
+static const std::size_t THROUGHPUT_REPEAT = 64;
+
+template <typename Type> struct bench_type_name;
+
+template <> struct bench_type_name<float> {
+    static const char* get() { return "float"; }
+};
+
+template <> struct bench_type_name<double> {
+    static const char* get() { return "double"; }
+};
+
+template <> struct bench_type_name<unsigned char> {
+    static const char* get() { return "unsigned char"; }
+};
+
+/** @brief Target type of the vec3_convert benchmark. */
+template <typename Type> struct bench_convert_target { typedef float type; };
+template <> struct bench_convert_target<float> { typedef double type; };
+
+/** @returns count deterministic, non-degenerate vectors. */
+template <typename Type>
+static std::vector<vec3_<Type>> make_inputs(std::size_t count, int seed) {
+    std::vector<vec3_<Type>> vecs;
+    vecs.reserve(count);
+
+    for (std::size_t i = 0; i < count; i++) {
+        const int base = static_cast<int>((i * 7 + seed * 13) % 5) + 1;
+
+        vecs.push_back(vec3_<Type>(static_cast<Type>(base),
+                                   static_cast<Type>(base + 1),
+                                   static_cast<Type>(base + 2)));
+    }
+
+    return vecs;
+}
+
+/** @returns value, hidden from the optimizer so that it is not folded. */
+template <typename Type>
+static Type bench_opaque(Type value) {
+    asm volatile("" : "+m"(value) : : "memory");
+    return value;
+}
+
+/**
+ * @brief Latency: each operation consumes the result of the previous one.
+ *
+ * step maps the current vector to the next one.
+ */
+template <typename Type, typename Step>
+static bench_result latency(const std::string& operation,
+                            const vec3_<Type>& start, Step step) {
+    return bench_measure(operation, bench_type_name<Type>::get(), "latency",
+                         LATENCY_STEPS, [&] {
+        vec3_<Type> vec = start;
+
+        for (std::size_t i = 0; i < LATENCY_STEPS; i++) {
+            vec = step(vec);
+            bench_keep(vec);
+        }
+    });
+}
+
+/**
+ * @brief Throughput: independent operations over large arrays.
+ *
+ * op maps two input vectors to a result stored in an output array.
+ */
+template <typename Type, typename Op>
+static bench_result throughput(const std::string& operation,
+                               const std::vector<vec3_<Type>>& a,
+                               const std::vector<vec3_<Type>>& b, Op op) {
+    typedef decltype(op(a[0], b[0])) result_type;
+    std::vector<result_type> out(a.size());
+
+    return bench_measure(operation, bench_type_name<Type>::get(),
+                         "throughput", a.size() * THROUGHPUT_REPEAT, [&] {
+        for (std::size_t r = 0; r < THROUGHPUT_REPEAT; r++) {
+            for (std::size_t i = 0; i < a.size(); i++)
+                out[i] = op(a[i], b[i]);
+
+            bench_keep(out.data());
+        }
+    });
+}
+
+template <typename Type>
+static void bench_type(std::vector<bench_result>& results) {
+    typedef vec3_<Type> vec;
+    typedef typename bench_convert_target<Type>::type target;
+
+    const std::vector<vec> a = make_inputs<Type>(THROUGHPUT_SIZE, 1);
+    const std::vector<vec> b = make_inputs<Type>(THROUGHPUT_SIZE, 2);
+    const vec start = a[0];
+    const vec other = b[1];
+
+    // The mul, dot and cross chains use a unit operand so that they stay
+    // bounded: growing chains overflow to inf and NaN, which times the
+    // slow paths rather than the operations.
+    const vec ones = bench_opaque(vec(1, 1, 1));
+    const vec axis = bench_opaque(vec(0, 0, 1));
+
+    results.push_back(latency("construct", start, [](const vec& v) {
+        return vec(v.y(), v.z(), v.x());
+    }));
+    results.push_back(throughput("construct", a, b, [](const vec& v,
+                                                       const vec&) {
+        return vec(v.y(), v.z(), v.x());
+    }));
+
+    results.push_back(latency("copy", start, [](const vec& v) {
+        vec copy(v);
+        return copy;
+    }));
+    results.push_back(throughput("copy", a, b, [](const vec& v, const vec&) {
+        vec copy(v);
+        return copy;
+    }));
+
+    results.push_back(latency("add", start, [&](const vec& v) {
+        return v + other;
+    }));
+    results.push_back(throughput("add", a, b, [](const vec& v1,
+                                                 const vec& v2) {
+        return v1 + v2;
+    }));
+
+    results.push_back(latency("mul", start, [&](const vec& v) {
+        return v * ones;
+    }));
+    results.push_back(throughput("mul", a, b, [](const vec& v1,
+                                                 const vec& v2) {
+        return v1 * v2;
+    }));
+
+    results.push_back(latency("dot", start, [&](const vec& v) {
+        return vec(static_cast<Type>(dot(v, axis)), v.y(), v.z());
+    }));
+    results.push_back(throughput("dot", a, b, [](const vec& v1,
+                                                 const vec& v2) {
+        return dot(v1, v2);
+    }));
+
+    results.push_back(latency("cross", start, [&](const vec& v) {
+        return cross(v, axis);
+    }));
+    results.push_back(throughput("cross", a, b, [](const vec& v1,
+                                                   const vec& v2) {
+        return cross(v1, v2);
+    }));
+
+    results.push_back(latency("length", start, [](const vec& v) {
+        return vec(static_cast<Type>(v.length()), v.y(), v.z());
+    }));
+    results.push_back(throughput("length", a, b, [](const vec& v,
+                                                    const vec&) {
+        return v.length();
+    }));
+
+    // Integer vectors truncate to zero, whose normalization is NaN.
+    if (std::is_floating_point<Type>::value)
+        results.push_back(latency("normalize", start, [](const vec& v) {
+            return v.getNormalized();
+        }));
+
+    results.push_back(throughput("normalize", a, b, [](const vec& v,
+                                                       const vec&) {
+        return v.getNormalized();
+    }));
+
+    results.push_back(latency("vec3_convert", start, [](const vec& v) {
+        return vec3_convert<target, Type>(vec3_convert<Type, target>(v));
+    }));
+    results.push_back(throughput("vec3_convert", a, b, [](const vec& v,
+                                                          const vec&) {
+        return vec3_convert<Type, target>(v);
+    }));
+}
+
+int main(int argc, char** argv) {
+    std::vector<bench_result> results;
+
+    bench_type<float>(results);
+    bench_type<double>(results);
+    bench_type<unsigned char>(results);
+
+    bench_write(argc, argv, results);
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+/** @file aabb.h */
+
+#pragma once
+
+#include "ray.h"
+#include "sphere.h"
+#include "triangle.h"
+
+#include <limits>
+
+/**
+ * @class aabb
+ * @brief Axis-aligned bounding box given by its min and max corners.
+ *
+ * A default constructed box is empty (min = +inf, max = -inf), so that
+ * extending it by a point or box yields that point or box.
+ */
+class aabb {
+    private:
+        vec3f lo;
+        vec3f hi;
+
+    public:
+        /** @brief Constructs an empty box. */
+        aabb() {
+            const float inf = std::numeric_limits<float>::infinity();
+
+            lo = vec3f(inf, inf, inf);
+            hi = vec3f(-inf, -inf, -inf);
+        }
+
+        /**
+         * @brief Constructs the box.
+         *
+         * @param min -> The min corner
+         * @param max -> The max corner
+         */
+        aabb(const vec3f& min, const vec3f& max) : lo(min), hi(max) {}
+
+        /** @brief Returns the min corner. */
+        inline const vec3f& min() const {
+            return lo;
+        }
+
+        /** @brief Returns the max corner. */
+        inline const vec3f& max() const {
+            return hi;
+        }
+
+        /** @returns true if the box contains no point. */
+        inline bool empty() const {
+            return !(lo.x() <= hi.x() && lo.y() <= hi.y() && lo.z() <= hi.z());
+        }
+
+        /** @brief Grows the box to contain point. */
+        inline void extend(const vec3f& point) {
+            lo = vec3_min(lo, point);
+            hi = vec3_max(hi, point);
+        }
+
+        /** @brief Grows the box to contain box. */
+        inline void extend(const aabb& box) {
+            lo = vec3_min(lo, box.lo);
+            hi = vec3_max(hi, box.hi);
+        }
+
+        /** @returns The center of the box. */
+        inline vec3f centroid() const {
+            return (lo + hi) * 0.5f;
+        }
+
+        /** @returns The size of the box along each axis. */
+        inline vec3f extent() const {
+            return hi - lo;
+        }
+
+        /** @returns The surface area of the box, 0 if it is empty. */
+        inline float surface_area() const {
+            if (empty())
+                return 0;
+
+            const vec3f size = extent();
+
+            return 2 * (size.x() * size.y() + size.y() * size.z() +
+                        size.z() * size.x());
+        }
+
+        /** @returns The axis (0, 1, 2) along which the box is largest. */
+        inline int largest_axis() const {
+            const vec3f size = extent();
+
+            if (size.x() >= size.y() && size.x() >= size.z())
+                return 0;
+
+            return size.y() >= size.z() ? 1 : 2;
+        }
+};
+
+/** @returns The smallest box containing both boxes. */
+inline aabb merge(const aabb& a, const aabb& b) {
+    return aabb(vec3_min(a.min(), b.min()), vec3_max(a.max(), b.max()));
+}
+
+/** @returns The bounding box of a sphere. */
+inline aabb bounds(const sphere& s) {
+    const vec3f radius(s.radius(), s.radius(), s.radius());
+
+    return aabb(s.center() - radius, s.center() + radius);
+}
+
+/** @returns The bounding box of a triangle. */
+inline aabb bounds(const triangle& tri) {
+    return aabb(vec3_min(vec3_min(tri.v0(), tri.v1()), tri.v2()),
+                vec3_max(vec3_max(tri.v0(), tri.v1()), tri.v2()));
+}
+
+/** @returns The bounding box of a precomputed triangle. */
+inline aabb bounds(const triangle_precomputed& tri) {
+    const vec3f v1 = tri.v0() + tri.edge_1();
+    const vec3f v2 = tri.v0() + tri.edge_2();
+
+    return aabb(vec3_min(vec3_min(tri.v0(), v1), v2),
+                vec3_max(vec3_max(tri.v0(), v1), v2));
+}
+
+/**
+ * @brief Intersects a ray with a box (slab test).
+ *
+ * @param r -> The ray
+ * @param inverse_direction -> 1 / r.direction(), component-wise. Zero
+ *                             components yield infinities, which the
+ *                             test handles.
+ * @param box -> The box
+ * @param t_min -> The smallest accepted distance
+ * @param t_max -> The largest accepted distance
+ * @param t_entry -> Set to the distance at which the ray enters the box
+ *                   (clamped to t_min) on a hit.
+ *
+ * @returns true if the ray overlaps the box within [t_min, t_max].
+ */
+inline bool intersect(const ray& r, const vec3f& inverse_direction,
+                      const aabb& box, float t_min, float t_max,
+                      float& t_entry) {
+    const vec3f t0 = (box.min() - r.origin()) * inverse_direction;
+    const vec3f t1 = (box.max() - r.origin()) * inverse_direction;
+
+    const vec3f near = vec3_min(t0, t1);
+    const vec3f far = vec3_max(t0, t1);
+
+    float enter = near.x() > t_min ? near.x() : t_min;
+    enter = near.y() > enter ? near.y() : enter;
+    enter = near.z() > enter ? near.z() : enter;
+
+    float exit = far.x() < t_max ? far.x() : t_max;
+    exit = far.y() < exit ? far.y() : exit;
+    exit = far.z() < exit ? far.z() : exit;
+
+    t_entry = enter;
+
+    return enter <= exit;
+}
@@ -0,0 +1,72 @@
+#include "arena.h"
+
+#include <stdexcept>
+
+arena::arena(std::size_t block_size) : block_size(block_size) {
+    if (block_size == 0)
+        throw std::invalid_argument("arena: block_size must be > 0");
+}
+
+void* arena::allocate_slow(std::size_t bytes, std::size_t alignment) {
+    // Worst case padding, so that any block start can be aligned.
+    const std::size_t needed = bytes + alignment - 1;
+
+    if (needed < bytes)
+        throw std::bad_alloc();
+
+    const std::size_t next = cursor ? current + 1 : 0;
+
+    // The rest of the current block is wasted, but still counted as used
+    // until the arena is rewound.
+    if (cursor)
+        used += limit - cursor;
+
+    if (next == blocks.size() || blocks[next].size < needed) {
+        const std::size_t size = needed > block_size ? needed : block_size;
+
+        blocks.insert(blocks.begin() + next,
+                      block{std::unique_ptr<char[]>(new char[size]), size});
+        counters.capacity += size;
+    }
+
+    current = next;
+    cursor = blocks[current].memory.get();
+    limit = cursor + blocks[current].size;
+
+    return allocate(bytes, alignment);
+}
+
+arena_stats arena::reset() {
+    const arena_stats finished = counters;
+
+    current = 0;
+    cursor = nullptr;
+    limit = nullptr;
+    used = 0;
+
+    counters = arena_stats();
+    counters.capacity = finished.capacity;
+
+    return finished;
+}
+
+thread_arenas::thread_arenas(const scheduler& pool, std::size_t block_size)
+    : pool(pool) {
+    // One arena per worker, plus one for threads outside the pool.
+    for (unsigned i = 0; i < pool.size(); i++)
+        slots.push_back(std::unique_ptr<slot>(new slot(block_size)));
+}
+
+arena_stats thread_arenas::reset() {
+    arena_stats total;
+
+    for (const std::unique_ptr<slot>& s : slots) {
+        const arena_stats finished = s->scratch.reset();
+
+        total.high_water += finished.high_water;
+        total.capacity += finished.capacity;
+        total.allocations += finished.allocations;
+    }
+
+    return total;
+}
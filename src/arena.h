@@ -0,0 +1,287 @@
+/** @file arena.h */
+
+#pragma once
+
+#include "scheduler.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/** @brief Usage counters of an @ref arena. */
+struct arena_stats {
+    /** @brief Largest number of bytes in use, padding included. */
+    std::size_t high_water = 0;
+
+    /** @brief Bytes of the blocks owned by the arena. */
+    std::size_t capacity = 0;
+
+    /** @brief Number of allocations. */
+    std::size_t allocations = 0;
+};
+
+/** @brief Position of an @ref arena, to rewind to. */
+struct arena_mark {
+    std::size_t block;
+    char* cursor;
+    std::size_t used;
+};
+
+/**
+ * @class arena
+ * @brief Bump allocator for short-lived scratch objects.
+ *
+ * Allocations advance a cursor through large blocks, which costs a few
+ * instructions and no lock; individual objects are never freed. Instead
+ * the whole arena is rewound (to a @ref mark, or by @ref reset) once its
+ * objects are dead. The blocks are kept, so a warmed up arena does not
+ * call the heap at all.
+ *
+ * Not thread safe: every thread uses its own arena, see
+ * @ref thread_arenas.
+ */
+class arena {
+    private:
+        struct block {
+            std::unique_ptr<char[]> memory;
+            std::size_t size;
+        };
+
+        std::vector<block> blocks;
+        std::size_t block_size;
+
+        std::size_t current = 0;
+        char* cursor = nullptr;
+        char* limit = nullptr;
+
+        std::size_t used = 0;
+        arena_stats counters;
+
+        void* allocate_slow(std::size_t bytes, std::size_t alignment);
+
+    public:
+        /** @brief Default size of the blocks, in bytes. */
+        static constexpr std::size_t default_block_size = 64 * 1024;
+
+        /**
+         * @brief Constructs an empty arena. No memory is allocated until
+         *        the first allocation.
+         *
+         * @param block_size -> The size of the blocks. Larger allocations
+         *                      get a block of their own.
+         *
+         * @throws std::invalid_argument if block_size is 0.
+         */
+        explicit arena(std::size_t block_size = default_block_size);
+
+        arena(const arena&) = delete;
+        arena& operator=(const arena&) = delete;
+
+        /**
+         * @brief Allocates uninitialized memory.
+         *
+         * @param bytes -> The size of the allocation
+         * @param alignment -> The alignment. Must be a power of 2.
+         *
+         * @returns The memory, valid until the arena is rewound past it.
+         */
+        inline void* allocate(std::size_t bytes,
+                              std::size_t alignment =
+                                  alignof(std::max_align_t)) {
+            const std::uintptr_t address =
+                reinterpret_cast<std::uintptr_t>(cursor);
+            const std::uintptr_t aligned =
+                (address + alignment - 1) & ~std::uintptr_t(alignment - 1);
+
+            if (cursor && bytes <= std::uintptr_t(limit - cursor) &&
+                aligned - address <= std::uintptr_t(limit - cursor) - bytes) {
+                char* result = cursor + (aligned - address);
+
+                used += (aligned - address) + bytes;
+                counters.allocations++;
+
+                if (used > counters.high_water)
+                    counters.high_water = used;
+
+                cursor = result + bytes;
+
+                return result;
+            }
+
+            return allocate_slow(bytes, alignment);
+        }
+
+        /**
+         * @brief Constructs an object in the arena.
+         *
+         * The destructor is never run, hence the type must be trivially
+         * destructible.
+         */
+        template <typename Type, typename... Args>
+        Type* create(Args&&... args) {
+            static_assert(std::is_trivially_destructible<Type>::value,
+                          "ERROR: arena objects are never destroyed.");
+
+            return new (allocate(sizeof(Type), alignof(Type)))
+                Type(std::forward<Args>(args)...);
+        }
+
+        /** @brief Allocates an uninitialized array of count objects. */
+        template <typename Type>
+        Type* allocate_array(std::size_t count) {
+            static_assert(std::is_trivially_destructible<Type>::value,
+                          "ERROR: arena objects are never destroyed.");
+
+            if (count > std::size_t(-1) / sizeof(Type))
+                throw std::bad_array_new_length();
+
+            return static_cast<Type*>(allocate(count * sizeof(Type),
+                                               alignof(Type)));
+        }
+
+        /** @brief Returns the current position. */
+        inline arena_mark mark() const {
+            return arena_mark{current, cursor, used};
+        }
+
+        /**
+         * @brief Frees everything allocated since position was marked.
+         *
+         * @warning Marks taken after position are invalidated.
+         */
+        inline void rewind(const arena_mark& position) {
+            current = position.block;
+            cursor = position.cursor;
+            limit = blocks.empty() ? nullptr
+                  : blocks[current].memory.get() + blocks[current].size;
+            used = position.used;
+        }
+
+        /**
+         * @brief Frees everything and starts a new period (e.g. frame).
+         *
+         * @returns The counters of the period that ended.
+         */
+        arena_stats reset();
+
+        /** @brief Returns the number of bytes in use, padding included. */
+        inline std::size_t size() const {
+            return used;
+        }
+
+        /** @brief Returns the counters of the current period. */
+        inline const arena_stats& stats() const {
+            return counters;
+        }
+};
+
+/**
+ * @class arena_allocator
+ * @brief Standard allocator drawing from an @ref arena.
+ *
+ * deallocate is a no-op: the memory of a container is reclaimed when the
+ * arena is rewound, which must not happen while the container is alive.
+ *
+ * @tparam Type The allocated type.
+ */
+template <typename Type>
+class arena_allocator {
+    private:
+        arena* owner;
+
+    public:
+        typedef Type value_type;
+
+        /** @brief Allocates from source. */
+        explicit arena_allocator(arena& source) noexcept : owner(&source) {}
+
+        template <typename Other>
+        arena_allocator(const arena_allocator<Other>& other) noexcept
+            : owner(&other.source()) {}
+
+        Type* allocate(std::size_t count) {
+            return owner->allocate_array<Type>(count);
+        }
+
+        void deallocate(Type*, std::size_t) noexcept {}
+
+        /** @brief Returns the arena allocated from. */
+        inline arena& source() const {
+            return *owner;
+        }
+
+        template <typename Other>
+        bool operator==(const arena_allocator<Other>& other) const {
+            return owner == &other.source();
+        }
+
+        template <typename Other>
+        bool operator!=(const arena_allocator<Other>& other) const {
+            return owner != &other.source();
+        }
+};
+
+/** @brief std::vector allocating from an @ref arena. */
+template <typename Type>
+using arena_vector = std::vector<Type, arena_allocator<Type>>;
+
+/**
+ * @class thread_arenas
+ * @brief One @ref arena per thread of a @ref scheduler.
+ *
+ * Tasks allocate from @ref local without any synchronization. Between
+ * frames, when no task runs, @ref reset frees all arenas at once and
+ * reports the frame's usage.
+ */
+class thread_arenas {
+    private:
+        // alignas keeps the hot cursors of two threads off one cache line.
+        struct alignas(64) slot {
+            arena scratch;
+
+            explicit slot(std::size_t block_size) : scratch(block_size) {}
+        };
+
+        const scheduler& pool;
+        std::vector<std::unique_ptr<slot>> slots;
+
+    public:
+        /**
+         * @brief Creates the arenas of pool's threads.
+         *
+         * @param pool -> The scheduler
+         * @param block_size -> The block size of every arena
+         */
+        explicit thread_arenas(const scheduler& pool,
+                               std::size_t block_size =
+                                   arena::default_block_size);
+
+        /**
+         * @brief Returns the arena of the calling thread.
+         *
+         * Threads outside pool share one arena: only one of them (e.g.
+         * the thread waiting for the frame) may use it at a time.
+         */
+        inline arena& local() {
+            const int worker = pool.current_worker();
+
+            return slots[worker >= 0 ? worker : slots.size() - 1]->scratch;
+        }
+
+        /** @brief Returns the number of arenas. */
+        inline std::size_t size() const {
+            return slots.size();
+        }
+
+        /**
+         * @brief Resets every arena. Must not be called while tasks run.
+         *
+         * @returns The summed counters of the period that ended: the
+         *          high-water mark is the sum of the arenas' marks.
+         */
+        arena_stats reset();
+};
@@ -0,0 +1,691 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+/** @brief Depth from which the builder only makes median splits. */
+static const std::size_t MEDIAN_SPLIT_DEPTH = bvh::max_depth - 32;
+
+/** @brief Node of the temporary pointer tree built before flattening. */
+struct build_node {
+    aabb box;
+    std::unique_ptr<build_node> left;
+    std::unique_ptr<build_node> right;
+    std::uint32_t begin = 0;
+    std::uint32_t count = 0;
+    int axis = 0;
+};
+
+/** @brief Binned SAH builder over a range of primitive indices. */
+class sah_builder {
+    private:
+        struct bin {
+            aabb box;
+            std::size_t count = 0;
+        };
+
+        const std::vector<aabb>& bounds;
+        std::vector<vec3f> centroids;
+        std::vector<std::uint32_t>& indices;
+        const bvh_build_settings& settings;
+        scheduler* pool;
+
+        std::unique_ptr<build_node> make_leaf(const aabb& box,
+                                              std::size_t begin,
+                                              std::size_t end) const {
+            std::unique_ptr<build_node> node(new build_node);
+
+            node->box = box;
+            node->begin = static_cast<std::uint32_t>(begin);
+            node->count = static_cast<std::uint32_t>(end - begin);
+
+            return node;
+        }
+
+        /** @returns The bin of centroid c along axis. */
+        inline std::size_t bin_of(const vec3f& c, int axis, float origin,
+                                  float scale) const {
+            const float offset = (c.component(axis) - origin) * scale;
+            const std::size_t index = offset > 0
+                                    ? static_cast<std::size_t>(offset) : 0;
+
+            return index < settings.bins ? index : settings.bins - 1;
+        }
+
+        /**
+         * @brief Finds the cheapest binned split of [begin, end).
+         *
+         * @returns The split cost, or infinity if no axis can be split.
+         */
+        float find_split(std::size_t begin, std::size_t end,
+                         const aabb& box, const aabb& centroid_box,
+                         int& best_axis, std::size_t& best_bin) const {
+            const float parent_area = box.surface_area();
+            const vec3f extent = centroid_box.extent();
+
+            float best_cost = std::numeric_limits<float>::infinity();
+
+            std::vector<bin> bins(settings.bins);
+            std::vector<float> right_area(settings.bins);
+            std::vector<std::size_t> right_count(settings.bins);
+
+            for (int axis = 0; axis < 3; axis++) {
+                if (!(extent.component(axis) > 0))
+                    continue;
+
+                const float origin = centroid_box.min().component(axis);
+                const float scale = settings.bins / extent.component(axis);
+
+                std::fill(bins.begin(), bins.end(), bin());
+
+                for (std::size_t i = begin; i < end; i++) {
+                    bin& b = bins[bin_of(centroids[indices[i]], axis,
+                                         origin, scale)];
+
+                    b.box.extend(bounds[indices[i]]);
+                    b.count++;
+                }
+
+                // right_*[i] describe the bins i..bins-1.
+                aabb right;
+                std::size_t count = 0;
+
+                for (std::size_t i = settings.bins - 1; i > 0; i--) {
+                    right.extend(bins[i].box);
+                    count += bins[i].count;
+
+                    right_area[i] = right.surface_area();
+                    right_count[i] = count;
+                }
+
+                aabb left;
+                count = 0;
+
+                for (std::size_t i = 0; i + 1 < settings.bins; i++) {
+                    left.extend(bins[i].box);
+                    count += bins[i].count;
+
+                    if (count == 0 || right_count[i + 1] == 0)
+                        continue;
+
+                    const float cost = settings.traversal_cost +
+                        settings.intersection_cost *
+                        (left.surface_area() * count +
+                         right_area[i + 1] * right_count[i + 1]) /
+                        (parent_area > 0 ? parent_area : 1);
+
+                    if (cost < best_cost) {
+                        best_cost = cost;
+                        best_axis = axis;
+                        best_bin = i;
+                    }
+                }
+            }
+
+            return best_cost;
+        }
+
+        /** @returns The middle of [begin, end) after a median split. */
+        std::size_t median_split(std::size_t begin, std::size_t end,
+                                 int axis) {
+            const std::size_t middle = begin + (end - begin) / 2;
+
+            std::nth_element(indices.begin() + begin,
+                             indices.begin() + middle,
+                             indices.begin() + end,
+                             [&](std::uint32_t a, std::uint32_t b) {
+                return centroids[a].component(axis) <
+                       centroids[b].component(axis);
+            });
+
+            return middle;
+        }
+
+    public:
+        sah_builder(const std::vector<aabb>& bounds,
+                    std::vector<std::uint32_t>& indices,
+                    const bvh_build_settings& settings, scheduler* pool)
+            : bounds(bounds), indices(indices), settings(settings),
+              pool(pool) {
+            centroids.reserve(bounds.size());
+
+            for (const aabb& box : bounds)
+                centroids.push_back(box.centroid());
+        }
+
+        std::unique_ptr<build_node> build(std::size_t begin, std::size_t end,
+                                          std::size_t depth) {
+            aabb box;
+            aabb centroid_box;
+
+            for (std::size_t i = begin; i < end; i++) {
+                box.extend(bounds[indices[i]]);
+                centroid_box.extend(centroids[indices[i]]);
+            }
+
+            const std::size_t count = end - begin;
+
+            if (count == 1)
+                return make_leaf(box, begin, end);
+
+            int axis = centroid_box.largest_axis();
+            std::size_t middle = end;
+
+            if (depth < MEDIAN_SPLIT_DEPTH &&
+                centroid_box.extent().component(axis) > 0) {
+                std::size_t split_bin = 0;
+                const float split_cost = find_split(begin, end, box,
+                                                    centroid_box, axis,
+                                                    split_bin);
+                const float leaf_cost = settings.intersection_cost * count;
+
+                if (count <= settings.max_leaf_size && leaf_cost <= split_cost)
+                    return make_leaf(box, begin, end);
+
+                if (split_cost < std::numeric_limits<float>::infinity()) {
+                    const float origin = centroid_box.min().component(axis);
+                    const float scale = settings.bins /
+                                        centroid_box.extent().component(axis);
+
+                    middle = std::partition(indices.begin() + begin,
+                                            indices.begin() + end,
+                                            [&](std::uint32_t i) {
+                        return bin_of(centroids[i], axis, origin, scale) <=
+                               split_bin;
+                    }) - indices.begin();
+                }
+            } else if (count <= settings.max_leaf_size) {
+                return make_leaf(box, begin, end);
+            }
+
+            if (middle == begin || middle == end)
+                middle = median_split(begin, end, axis);
+
+            std::unique_ptr<build_node> node(new build_node);
+            node->box = box;
+            node->axis = axis;
+
+            if (pool && count >= settings.parallel_threshold) {
+                task_group group;
+
+                pool->submit(group, [&] {
+                    node->left = build(begin, middle, depth + 1);
+                });
+
+                node->right = build(middle, end, depth + 1);
+                pool->wait(group);
+            } else {
+                node->left = build(begin, middle, depth + 1);
+                node->right = build(middle, end, depth + 1);
+            }
+
+            return node;
+        }
+};
+
+/** @brief Sets the bounds of a flat node. */
+static void set_bounds(bvh_node& node, const aabb& box) {
+    node.lo[0] = box.min().x();
+    node.lo[1] = box.min().y();
+    node.lo[2] = box.min().z();
+    node.hi[0] = box.max().x();
+    node.hi[1] = box.max().y();
+    node.hi[2] = box.max().z();
+}
+
+/** @brief Appends node and its subtree to nodes, depth-first. */
+static void flatten(const build_node& node, std::size_t depth,
+                    float root_area, const bvh_build_settings& settings,
+                    std::vector<bvh_node>& nodes, bvh_build_stats& stats) {
+    const std::size_t index = nodes.size();
+    nodes.push_back(bvh_node());
+
+    bvh_node& flat = nodes[index];
+    const aabb& box = node.box;
+
+    set_bounds(flat, box);
+
+    const double relative_area = root_area > 0
+                               ? box.surface_area() / root_area : 1;
+
+    stats.max_depth = depth > stats.max_depth ? depth : stats.max_depth;
+
+    if (!node.left) {
+        flat.offset = node.begin;
+        flat.count = static_cast<std::uint16_t>(node.count);
+        flat.axis = 0;
+
+        stats.leaf_count++;
+        stats.sah_cost += settings.intersection_cost * node.count *
+                          relative_area;
+        return;
+    }
+
+    flat.count = 0;
+    flat.axis = static_cast<std::uint16_t>(node.axis);
+
+    stats.sah_cost += settings.traversal_cost * relative_area;
+
+    flatten(*node.left, depth + 1, root_area, settings, nodes, stats);
+
+    // nodes may have been reallocated, so flat is no longer valid.
+    nodes[index].offset = static_cast<std::uint32_t>(nodes.size());
+
+    flatten(*node.right, depth + 1, root_area, settings, nodes, stats);
+}
+
+bvh::bvh(const std::vector<aabb>& bounds, scheduler* pool,
+         const bvh_build_settings& settings) {
+    if (settings.bins < 2)
+        throw std::invalid_argument("bvh: at least 2 bins are required");
+
+    if (settings.max_leaf_size < 1 || settings.max_leaf_size > 65535)
+        throw std::invalid_argument("bvh: max_leaf_size must be in "
+                                    "[1, 65535]");
+
+    if (bounds.size() >= std::numeric_limits<std::uint32_t>::max())
+        throw std::invalid_argument("bvh: too many primitives");
+
+    const auto start = std::chrono::steady_clock::now();
+
+    if (!bounds.empty()) {
+        std::vector<std::uint32_t> indices(bounds.size());
+        std::vector<bvh_node> nodes;
+
+        for (std::size_t i = 0; i < bounds.size(); i++)
+            indices[i] = static_cast<std::uint32_t>(i);
+
+        sah_builder builder(bounds, indices, settings, pool);
+        const std::unique_ptr<build_node> root =
+            builder.build(0, bounds.size(), 0);
+
+        nodes.reserve(2 * bounds.size());
+        flatten(*root, 0, root->box.surface_area(), settings, nodes,
+                build_stats);
+        nodes.shrink_to_fit();
+
+        node_array = shared_buffer<bvh_node>(std::move(nodes));
+        index_array = shared_buffer<std::uint32_t>(std::move(indices));
+    }
+
+    build_stats.node_count = node_array.size();
+    build_stats.build_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+/** @returns An SAH subtree cost relative to the area of its root. */
+static float relative_cost(float cost, const bvh_node& node) {
+    const float area = node.bounds().surface_area();
+
+    return area > 0 ? cost / area : 0;
+}
+
+/**
+ * @brief Computes the SAH cost of the subtree of node index, which spans
+ *        the nodes [index, end), into costs (not relative to any area).
+ *
+ * With mutable nodes, the subtree is first refitted to bounds, bottom-up.
+ */
+template <typename Node>
+static void update_subtree(Node* nodes, const std::uint32_t* indices,
+                           std::size_t index, std::size_t end,
+                           const std::vector<aabb>& bounds,
+                           const bvh_build_settings& settings,
+                           scheduler* pool, float* costs) {
+    Node& node = nodes[index];
+
+    if (node.leaf()) {
+        if constexpr (!std::is_const<Node>::value) {
+            aabb box;
+
+            for (std::uint32_t i = node.offset; i < node.offset + node.count;
+                 i++)
+                box.extend(bounds[indices[i]]);
+
+            set_bounds(node, box);
+        }
+
+        costs[index] = settings.intersection_cost * node.count *
+                       node.bounds().surface_area();
+        return;
+    }
+
+    const std::size_t left = index + 1;
+    const std::size_t right = node.offset;
+
+    if (pool && end - index >= settings.parallel_threshold) {
+        task_group group;
+
+        pool->submit(group, [&] {
+            update_subtree(nodes, indices, left, right, bounds, settings,
+                           pool, costs);
+        });
+
+        update_subtree(nodes, indices, right, end, bounds, settings, pool,
+                       costs);
+        pool->wait(group);
+    } else {
+        update_subtree(nodes, indices, left, right, bounds, settings, pool,
+                       costs);
+        update_subtree(nodes, indices, right, end, bounds, settings, pool,
+                       costs);
+    }
+
+    if constexpr (!std::is_const<Node>::value) {
+        aabb box = nodes[left].bounds();
+        box.extend(nodes[right].bounds());
+
+        set_bounds(node, box);
+    }
+
+    costs[index] = settings.traversal_cost * node.bounds().surface_area() +
+                   costs[left] + costs[right];
+}
+
+/** @brief Adds the node, leaf and depth statistics of a subtree. */
+static void measure_subtree(const bvh_node* nodes, std::size_t index,
+                            std::size_t depth, bvh_build_stats& stats) {
+    stats.node_count++;
+    stats.max_depth = depth > stats.max_depth ? depth : stats.max_depth;
+
+    if (nodes[index].leaf()) {
+        stats.leaf_count++;
+        return;
+    }
+
+    measure_subtree(nodes, index + 1, depth + 1, stats);
+    measure_subtree(nodes, nodes[index].offset, depth + 1, stats);
+}
+
+/** @returns The statistics of nodes, whose subtree costs are costs. */
+static bvh_build_stats measure(const std::vector<bvh_node>& nodes,
+                               const std::vector<float>& costs,
+                               std::chrono::steady_clock::time_point start) {
+    bvh_build_stats stats;
+
+    if (!nodes.empty()) {
+        measure_subtree(nodes.data(), 0, 0, stats);
+        stats.sah_cost = relative_cost(costs[0], nodes[0]);
+    }
+
+    stats.build_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    return stats;
+}
+
+static void check_refit_bounds(const bvh& tree,
+                               const std::vector<aabb>& bounds) {
+    if (bounds.size() != tree.indices().size())
+        throw std::invalid_argument("bvh: refit needs one box per "
+                                    "primitive");
+}
+
+bvh refit(const bvh& tree, const std::vector<aabb>& bounds, scheduler* pool,
+          const bvh_build_settings& settings) {
+    check_refit_bounds(tree, bounds);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<bvh_node> nodes(tree.nodes().begin(), tree.nodes().end());
+    std::vector<float> costs(nodes.size());
+
+    if (!nodes.empty())
+        update_subtree(nodes.data(), tree.indices().data(), 0, nodes.size(),
+                       bounds, settings, pool, costs.data());
+
+    const bvh_build_stats stats = measure(nodes, costs, start);
+
+    return bvh(shared_buffer<bvh_node>(std::move(nodes)), tree.indices(),
+               stats);
+}
+
+/** @brief A degraded subtree, and the tree built to replace it. */
+struct rebuilt_subtree {
+    std::size_t node;
+    std::size_t depth;
+    std::size_t begin;
+    std::size_t end;
+    std::unique_ptr<build_node> root;
+};
+
+/**
+ * @brief Finds the degraded subtrees to rebuild below node index: the
+ *        highest ones with at most max_primitives primitives.
+ */
+static void find_degraded(const std::vector<bvh_node>& nodes,
+                          const std::vector<float>& costs,
+                          const std::vector<float>& reference,
+                          float threshold, std::size_t max_primitives,
+                          std::size_t index, std::size_t depth,
+                          std::vector<rebuilt_subtree>& degraded) {
+    const bvh_node& node = nodes[index];
+
+    if (node.leaf() ||
+        !(relative_cost(costs[index], node) > threshold * reference[index]))
+        return;
+
+    // The primitives of a subtree are contiguous in the indices: from its
+    // leftmost to its rightmost leaf.
+    std::size_t first = index;
+    std::size_t last = index;
+
+    while (!nodes[first].leaf())
+        first++;
+
+    while (!nodes[last].leaf())
+        last = nodes[last].offset;
+
+    const std::size_t begin = nodes[first].offset;
+    const std::size_t end = nodes[last].offset + nodes[last].count;
+
+    if (end - begin <= max_primitives) {
+        degraded.push_back(rebuilt_subtree{index, depth, begin, end,
+                                           nullptr});
+        return;
+    }
+
+    find_degraded(nodes, costs, reference, threshold, max_primitives,
+                  index + 1, depth + 1, degraded);
+    find_degraded(nodes, costs, reference, threshold, max_primitives,
+                  node.offset, depth + 1, degraded);
+}
+
+/** @brief Origin of the spliced nodes that come from a rebuilt subtree. */
+static const std::size_t REBUILT_NODE = std::numeric_limits<std::size_t>::max();
+
+/**
+ * @brief Appends the subtree of node index of source to nodes, replacing
+ *        the degraded subtrees by their rebuilt trees.
+ *
+ * @param origin -> Set, per appended node, to its index in source, or
+ *                  REBUILT_NODE.
+ */
+static void splice(const std::vector<bvh_node>& source, std::size_t index,
+                   std::size_t depth,
+                   const std::vector<rebuilt_subtree>& degraded,
+                   std::size_t& next_degraded,
+                   const bvh_build_settings& settings,
+                   std::vector<bvh_node>& nodes,
+                   std::vector<std::size_t>& origin) {
+    // degraded is in depth-first order, like this traversal.
+    if (next_degraded < degraded.size() &&
+        degraded[next_degraded].node == index) {
+        const build_node& root = *degraded[next_degraded++].root;
+        bvh_build_stats unused;
+
+        flatten(root, depth, root.box.surface_area(), settings, nodes,
+                unused);
+        origin.resize(nodes.size(), REBUILT_NODE);
+
+        return;
+    }
+
+    const std::size_t position = nodes.size();
+
+    nodes.push_back(source[index]);
+    origin.push_back(index);
+
+    if (source[index].leaf())
+        return;
+
+    splice(source, index + 1, depth + 1, degraded, next_degraded, settings,
+           nodes, origin);
+
+    nodes[position].offset = static_cast<std::uint32_t>(nodes.size());
+
+    splice(source, source[index].offset, depth + 1, degraded, next_degraded,
+           settings, nodes, origin);
+}
+
+dynamic_bvh::dynamic_bvh(const std::vector<aabb>& bounds, scheduler* pool,
+                         const bvh_build_settings& settings,
+                         const bvh_update_settings& update)
+    : build_settings(settings), update_settings(update) {
+    if (!(update.rebuild_threshold >= 1))
+        throw std::invalid_argument("dynamic_bvh: rebuild_threshold must "
+                                    "be at least 1");
+
+    if (!(update.max_rebuild_fraction > 0 &&
+          update.max_rebuild_fraction <= 1))
+        throw std::invalid_argument("dynamic_bvh: max_rebuild_fraction "
+                                    "must be in (0, 1]");
+
+    build(bounds, pool);
+}
+
+void dynamic_bvh::build(const std::vector<aabb>& bounds, scheduler* pool) {
+    current = bvh(bounds, pool, build_settings);
+    full_build_cost = current.stats().sah_cost;
+
+    const bvh_node* nodes = current.nodes().data();
+    std::vector<float> costs(current.nodes().size());
+
+    if (!current.empty())
+        update_subtree(nodes, current.indices().data(), 0, costs.size(),
+                       bounds, build_settings, pool, costs.data());
+
+    reference.resize(costs.size());
+
+    for (std::size_t i = 0; i < costs.size(); i++)
+        reference[i] = relative_cost(costs[i], nodes[i]);
+}
+
+bvh_update_stats dynamic_bvh::update(const std::vector<aabb>& bounds,
+                                     scheduler* pool) {
+    check_refit_bounds(current, bounds);
+
+    const auto start = std::chrono::steady_clock::now();
+    const float threshold = update_settings.rebuild_threshold;
+
+    bvh_update_stats stats;
+
+    std::vector<bvh_node> nodes(current.nodes().begin(),
+                                current.nodes().end());
+    std::vector<float> costs(nodes.size());
+
+    if (nodes.empty())
+        return stats;
+
+    update_subtree(nodes.data(), current.indices().data(), 0, nodes.size(),
+                   bounds, build_settings, pool, costs.data());
+
+    stats.refit_sah_cost = relative_cost(costs[0], nodes[0]);
+    stats.sah_cost = stats.refit_sah_cost;
+
+    if (!(stats.refit_sah_cost > threshold * full_build_cost)) {
+        const bvh_build_stats refitted = measure(nodes, costs, start);
+
+        current = bvh(shared_buffer<bvh_node>(std::move(nodes)),
+                      current.indices(), refitted);
+        stats.seconds = refitted.build_seconds;
+
+        return stats;
+    }
+
+    std::vector<rebuilt_subtree> degraded;
+    const std::size_t max_primitives = static_cast<std::size_t>(
+        update_settings.max_rebuild_fraction * bounds.size());
+
+    find_degraded(nodes, costs, reference, threshold, max_primitives, 0, 0,
+                  degraded);
+
+    if (!degraded.empty()) {
+        std::vector<std::uint32_t> indices(current.indices().begin(),
+                                           current.indices().end());
+        sah_builder builder(bounds, indices, build_settings, pool);
+
+        // Disjoint ranges of indices: the subtrees build concurrently.
+        if (pool) {
+            task_group group;
+
+            for (rebuilt_subtree& subtree : degraded)
+                pool->submit(group, [&builder, &subtree] {
+                    subtree.root = builder.build(subtree.begin, subtree.end,
+                                                 subtree.depth);
+                });
+
+            pool->wait(group);
+        } else {
+            for (rebuilt_subtree& subtree : degraded)
+                subtree.root = builder.build(subtree.begin, subtree.end,
+                                             subtree.depth);
+        }
+
+        std::vector<bvh_node> spliced;
+        std::vector<std::size_t> origin;
+        std::size_t next_degraded = 0;
+
+        spliced.reserve(nodes.size() + nodes.size() / 4);
+        splice(nodes, 0, 0, degraded, next_degraded, build_settings,
+               spliced, origin);
+
+        std::vector<float> spliced_costs(spliced.size());
+        std::vector<float> spliced_reference(spliced.size());
+
+        update_subtree(static_cast<const bvh_node*>(spliced.data()),
+                       indices.data(), 0, spliced.size(), bounds,
+                       build_settings, pool, spliced_costs.data());
+
+        // The rebuilt subtrees are the new reference; the other nodes
+        // keep theirs, so that their drift keeps being tracked.
+        for (std::size_t i = 0; i < spliced.size(); i++)
+            spliced_reference[i] = origin[i] == REBUILT_NODE
+                                 ? relative_cost(spliced_costs[i],
+                                                 spliced[i])
+                                 : reference[origin[i]];
+
+        for (const rebuilt_subtree& subtree : degraded)
+            stats.rebuilt_primitives += subtree.end - subtree.begin;
+
+        stats.rebuilt_subtrees = degraded.size();
+        stats.sah_cost = relative_cost(spliced_costs[0], spliced[0]);
+
+        if (!(stats.sah_cost > threshold * full_build_cost)) {
+            const bvh_build_stats built = measure(spliced, spliced_costs,
+                                                  start);
+
+            current = bvh(shared_buffer<bvh_node>(std::move(spliced)),
+                          shared_buffer<std::uint32_t>(std::move(indices)),
+                          built);
+            reference = std::move(spliced_reference);
+            stats.seconds = built.build_seconds;
+
+            return stats;
+        }
+    }
+
+    build(bounds, pool);
+
+    stats.full_rebuild = true;
+    stats.sah_cost = current.stats().sah_cost;
+    stats.seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    return stats;
+}
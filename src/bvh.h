@@ -0,0 +1,404 @@
+/** @file bvh.h */
+
+#pragma once
+
+#include "aabb.h"
+#include "scheduler.h"
+#include "shared_buffer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Node of a flattened BVH. 32 bytes, two per cache line.
+ *
+ * The bounds are stored as raw floats rather than vec3f, whose padding
+ * lane would grow the node to 48 bytes.
+ *
+ * Nodes are laid out depth-first: the left child of an inner node is the
+ * node right after it and offset is the index of the right child. For a
+ * leaf, offset is the first of its count entries in @ref bvh::indices.
+ */
+struct bvh_node {
+    float lo[3];
+    std::uint32_t offset;
+    float hi[3];
+    std::uint16_t count;
+    std::uint16_t axis;
+
+    /** @returns true if the node is a leaf. */
+    inline bool leaf() const {
+        return count > 0;
+    }
+
+    /** @returns The bounding box of the node. */
+    inline aabb bounds() const {
+        return aabb(vec3f(lo[0], lo[1], lo[2]), vec3f(hi[0], hi[1], hi[2]));
+    }
+};
+
+static_assert(sizeof(bvh_node) == 32, "ERROR: bvh_node must be 32 bytes.");
+
+/** @brief Parameters of the binned SAH builder. */
+struct bvh_build_settings {
+    /** @brief Number of centroid bins per axis. At least 2. */
+    std::size_t bins = 16;
+
+    /** @brief Largest number of primitives in a leaf. 1 to 65535. */
+    std::size_t max_leaf_size = 4;
+
+    /** @brief SAH cost of traversing an inner node. */
+    float traversal_cost = 1;
+
+    /** @brief SAH cost of intersecting a primitive. */
+    float intersection_cost = 1;
+
+    /** @brief Smallest subtree (in primitives) built as a separate task. */
+    std::size_t parallel_threshold = 4096;
+};
+
+/** @brief Statistics of a BVH build. */
+struct bvh_build_stats {
+    double build_seconds = 0;
+    std::size_t node_count = 0;
+    std::size_t leaf_count = 0;
+    std::size_t max_depth = 0;
+
+    /**
+     * @brief SAH cost of the tree: the expected cost of a random ray that
+     *        hits the root, with node areas relative to the root area.
+     */
+    double sah_cost = 0;
+};
+
+/**
+ * @brief Work counters of BVH traversals.
+ *
+ * Not thread safe: every thread accumulates into its own instance.
+ */
+struct bvh_traversal_stats {
+    /** @brief Number of traversals (rays). */
+    std::uint64_t rays = 0;
+
+    /** @brief Number of nodes fetched and tested. */
+    std::uint64_t nodes = 0;
+
+    /** @brief Number of primitive intersection tests. */
+    std::uint64_t primitives = 0;
+};
+
+/**
+ * @class bvh
+ * @brief Bounding volume hierarchy built with the binned surface area
+ *        heuristic.
+ *
+ * The builder only sees the primitive bounds, so the same tree type
+ * serves spheres, triangles and any other primitive with an intersect
+ * overload. Leaves refer to primitives through @ref indices.
+ */
+class bvh {
+    private:
+        shared_buffer<bvh_node> node_array;
+        shared_buffer<std::uint32_t> index_array;
+        bvh_build_stats build_stats;
+
+    public:
+        /**
+         * @brief Deepest possible leaf, and the traversal stack size.
+         *
+         * Below depth 32 the builder falls back to median splits, so no
+         * tree of up to 2^32 primitives is deeper.
+         */
+        static constexpr std::size_t max_depth = 64;
+
+        /** @brief Constructs an empty BVH. */
+        bvh() {}
+
+        /**
+         * @brief Builds the BVH.
+         *
+         * @param bounds -> The bounding box of every primitive
+         * @param pool -> If not null, subtrees are built in parallel on it
+         * @param settings -> The builder parameters
+         *
+         * @throws std::invalid_argument if the settings are out of range
+         *         or there are more than 2^32 - 1 primitives.
+         */
+        explicit bvh(const std::vector<aabb>& bounds,
+                     scheduler* pool = nullptr,
+                     const bvh_build_settings& settings =
+                         bvh_build_settings());
+
+        /**
+         * @brief Wraps an already built BVH (e.g. a memory-mapped one)
+         *        without copying it.
+         *
+         * @warning The nodes and indices are trusted to form a valid tree.
+         *
+         * @param nodes -> The nodes, laid out as documented in @ref bvh_node
+         * @param indices -> The primitive indices referenced by the leaves
+         * @param stats -> The statistics of the original build
+         */
+        bvh(shared_buffer<bvh_node> nodes,
+            shared_buffer<std::uint32_t> indices,
+            const bvh_build_stats& stats)
+            : node_array(std::move(nodes)), index_array(std::move(indices)),
+              build_stats(stats) {}
+
+        /** @brief Returns the nodes, root first. Empty for no primitives. */
+        inline const shared_buffer<bvh_node>& nodes() const {
+            return node_array;
+        }
+
+        /** @brief Returns the primitive indices referenced by the leaves. */
+        inline const shared_buffer<std::uint32_t>& indices() const {
+            return index_array;
+        }
+
+        /** @brief Returns the statistics of the build. */
+        inline const bvh_build_stats& stats() const {
+            return build_stats;
+        }
+
+        /** @returns true if the BVH holds no primitive. */
+        inline bool empty() const {
+            return node_array.empty();
+        }
+};
+
+/**
+ * @brief Refits a BVH to moved primitives.
+ *
+ * The tree keeps its topology; the node bounds are recomputed bottom-up
+ * from the new primitive bounds, subtrees of at least
+ * settings.parallel_threshold nodes in parallel. Much cheaper than a
+ * build, but the tree degrades as primitives move away from where it
+ * was built (see @ref dynamic_bvh).
+ *
+ * @param tree -> The BVH, left untouched
+ * @param bounds -> The new bounding box of every primitive
+ * @param pool -> If not null, subtrees are refitted in parallel on it
+ * @param settings -> The parameters tree was built with, for the SAH
+ *                    cost in the statistics
+ *
+ * @returns The refitted BVH, sharing the primitive indices of tree.
+ *
+ * @throws std::invalid_argument if bounds does not have one box per
+ *         primitive of tree.
+ */
+bvh refit(const bvh& tree, const std::vector<aabb>& bounds,
+          scheduler* pool = nullptr,
+          const bvh_build_settings& settings = bvh_build_settings());
+
+/** @brief Parameters of @ref dynamic_bvh updates. */
+struct bvh_update_settings {
+    /**
+     * @brief Largest accepted SAH cost, as a factor of the cost of the
+     *        last full build. Above it, the degraded subtrees (whose cost
+     *        grew by the same factor since they were built) are rebuilt.
+     *        At least 1.
+     */
+    float rebuild_threshold = 1.2f;
+
+    /**
+     * @brief Largest subtree rebuilt on its own, as a fraction of the
+     *        primitives. The degraded descendants of larger degraded
+     *        subtrees are rebuilt instead. In (0, 1].
+     */
+    float max_rebuild_fraction = 0.5f;
+};
+
+/** @brief Statistics of a @ref dynamic_bvh update. */
+struct bvh_update_stats {
+    double seconds = 0;
+
+    /** @brief SAH cost after the refit, before any rebuild. */
+    double refit_sah_cost = 0;
+
+    /** @brief SAH cost of the updated tree. */
+    double sah_cost = 0;
+
+    std::size_t rebuilt_subtrees = 0;
+    std::size_t rebuilt_primitives = 0;
+
+    /** @brief true if partial rebuilds did not suffice. */
+    bool full_rebuild = false;
+};
+
+/**
+ * @class dynamic_bvh
+ * @brief BVH over moving primitives, updated by refitting and rebuilding
+ *        only its degraded subtrees.
+ *
+ * Every update refits the tree. While the SAH cost stays within
+ * bvh_update_settings::rebuild_threshold of the cost of the last full
+ * build, nothing else happens. Past it, the subtrees whose own cost grew
+ * past the threshold since they were built are rebuilt with the binned
+ * SAH builder (in parallel), and spliced into the tree. Only when that
+ * is not enough is the whole tree rebuilt.
+ */
+class dynamic_bvh {
+    private:
+        bvh current;
+        bvh_build_settings build_settings;
+        bvh_update_settings update_settings;
+
+        /**
+         * @brief Per node: the SAH cost of its subtree, relative to its
+         *        area, when the subtree was built.
+         */
+        std::vector<float> reference;
+
+        /** @brief SAH cost of the last full build. */
+        double full_build_cost = 0;
+
+        void build(const std::vector<aabb>& bounds, scheduler* pool);
+
+    public:
+        /** @brief Constructs an empty BVH. */
+        dynamic_bvh() {}
+
+        /**
+         * @brief Builds the BVH.
+         *
+         * @throws std::invalid_argument if the settings are out of range,
+         *         or as bvh::bvh does.
+         */
+        explicit dynamic_bvh(const std::vector<aabb>& bounds,
+                             scheduler* pool = nullptr,
+                             const bvh_build_settings& settings =
+                                 bvh_build_settings(),
+                             const bvh_update_settings& update =
+                                 bvh_update_settings());
+
+        /** @brief Returns the current tree. */
+        inline const bvh& tree() const {
+            return current;
+        }
+
+        /**
+         * @brief Updates the tree to moved primitives.
+         *
+         * The previous tree is not modified, so copies of it stay valid
+         * (e.g. while the previous frame is still being rendered).
+         *
+         * @param bounds -> The new bounding box of every primitive
+         * @param pool -> If not null, the update runs in parallel on it
+         *
+         * @throws std::invalid_argument if the primitive count changed.
+         */
+        bvh_update_stats update(const std::vector<aabb>& bounds,
+                                scheduler* pool = nullptr);
+};
+
+/** @returns The bounding boxes of primitives, in order. */
+template <typename Primitive>
+std::vector<aabb> primitive_bounds(const std::vector<Primitive>& primitives) {
+    std::vector<aabb> boxes;
+    boxes.reserve(primitives.size());
+
+    for (const Primitive& primitive : primitives)
+        boxes.push_back(bounds(primitive));
+
+    return boxes;
+}
+
+/**
+ * @brief Intersects a ray with primitive index of a collection.
+ *
+ * The BVH traversals test primitives through this function, so that
+ * collections which do not store primitive objects (e.g. an indexed
+ * @ref mesh) can provide their own overload.
+ */
+template <typename Primitive>
+inline bool intersect_primitive(const ray& r,
+                                const std::vector<Primitive>& primitives,
+                                std::size_t index, float t_min, float& t) {
+    return intersect(r, primitives[index], t_min, t);
+}
+
+/**
+ * @brief Finds the closest primitive hit by a ray.
+ *
+ * Children are visited near first (by the sign of the ray direction on
+ * the split axis) and subtrees farther than the closest hit are skipped.
+ *
+ * @param r -> The ray
+ * @param tree -> The BVH built over primitives
+ * @param primitives -> The primitives: a std::vector of primitives, or
+ *                      any collection with an intersect_primitive
+ *                      overload
+ * @param t_min -> The smallest accepted hit distance
+ * @param t -> On input, the largest accepted hit distance. On a hit, it
+ *             is set to the distance of the closest intersection.
+ * @param hit -> Set to the index of the closest primitive on a hit.
+ * @param stats -> If not null, the traversal work is added to it.
+ *
+ * @returns true if the ray hits a primitive in (t_min, t).
+ */
+template <typename Primitives>
+bool intersect(const ray& r, const bvh& tree,
+               const Primitives& primitives, float t_min,
+               float& t, std::size_t& hit,
+               bvh_traversal_stats* stats = nullptr) {
+    if (stats)
+        stats->rays++;
+
+    if (tree.empty())
+        return false;
+
+    const bvh_node* nodes = tree.nodes().data();
+    const std::uint32_t* indices = tree.indices().data();
+
+    const vec3f inverse_direction = vec3f(1, 1, 1) / r.direction();
+    const bool negative[3] = { r.direction().x() < 0,
+                               r.direction().y() < 0,
+                               r.direction().z() < 0 };
+
+    std::uint32_t stack[bvh::max_depth];
+    std::size_t stack_size = 0;
+    std::uint32_t index = 0;
+    bool found = false;
+
+    while (true) {
+        const bvh_node& node = nodes[index];
+        float entry;
+
+        if (stats)
+            stats->nodes++;
+
+        if (intersect(r, inverse_direction, node.bounds(), t_min, t, entry)) {
+            if (!node.leaf()) {
+                if (negative[node.axis]) {
+                    stack[stack_size++] = index + 1;
+                    index = node.offset;
+                } else {
+                    stack[stack_size++] = node.offset;
+                    index = index + 1;
+                }
+
+                continue;
+            }
+
+            if (stats)
+                stats->primitives += node.count;
+
+            for (std::uint32_t i = node.offset; i < node.offset + node.count;
+                 i++)
+                if (intersect_primitive(r, primitives, indices[i], t_min,
+                                        t)) {
+                    hit = indices[i];
+                    found = true;
+                }
+        }
+
+        if (stack_size == 0)
+            break;
+
+        index = stack[--stack_size];
+    }
+
+    return found;
+}
@@ -0,0 +1,52 @@
+/** @file camera.h */
+
+#pragma once
+
+#include "ray.h"
+
+#include <cmath>
+
+/**
+ * @class camera
+ * @brief Pinhole camera generating primary rays.
+ */
+class camera {
+    private:
+        vec3f orig;
+        vec3f lower_left;
+        vec3f horizontal;
+        vec3f vertical;
+
+    public:
+        /**
+         * @brief Constructs the camera.
+         *
+         * @param origin -> The eye position
+         * @param target -> The point looked at
+         * @param up -> The up direction
+         * @param vertical_fov -> The vertical field of view, in degrees
+         * @param aspect -> The image width / height ratio
+         */
+        camera(const vec3f& origin, const vec3f& target, const vec3f& up,
+               float vertical_fov, float aspect) : orig(origin) {
+            const float half_height = std::tan(vertical_fov * 0.5f *
+                                               3.14159265f / 180.0f);
+            const float half_width = aspect * half_height;
+
+            const vec3f w = (origin - target).getNormalized();
+            const vec3f u = cross(up, w).getNormalized();
+            const vec3f v = cross(w, u);
+
+            lower_left = origin - u * half_width - v * half_height - w;
+            horizontal = u * (2 * half_width);
+            vertical = v * (2 * half_height);
+        }
+
+        /**
+         * @returns The ray through the image point (s, t), where (0, 0) is
+         *          the bottom left and (1, 1) the top right corner.
+         */
+        inline ray get_ray(float s, float t) const {
+            return ray(orig, lower_left + horizontal * s + vertical * t - orig);
+        }
+};
@@ -0,0 +1,141 @@
+#include "compressed_bvh.h"
+
+#include <cmath>
+#include <stdexcept>
+
+/** @brief Smallest exponent: keeps the scales normal floats. */
+static const int MIN_EXPONENT = -126;
+
+/** @returns The smallest exponent whose 255 steps cover [lo, hi]. */
+static std::int8_t axis_exponent(float lo, float hi) {
+    const float extent = hi - lo;
+    int exponent = MIN_EXPONENT;
+
+    if (extent > 0) {
+        exponent = static_cast<int>(std::ceil(std::log2(extent / 255)));
+        exponent = exponent < MIN_EXPONENT ? MIN_EXPONENT : exponent;
+    }
+
+    // Rounding of log2 and of the addition: check as decoded.
+    while (exponent < 127 &&
+           lo + 255 * exponent_scale(static_cast<std::int8_t>(exponent)) < hi)
+        exponent++;
+
+    return static_cast<std::int8_t>(exponent);
+}
+
+/** @returns The largest grid step decoding to at most value. */
+static std::uint8_t quantize_down(float value, float origin, float scale) {
+    float q = std::floor((value - origin) / scale);
+    q = q < 0 ? 0 : (q > 255 ? 255 : q);
+
+    while (q > 0 && origin + q * scale > value)
+        q--;
+
+    return static_cast<std::uint8_t>(q);
+}
+
+/** @returns The smallest grid step decoding to at least value. */
+static std::uint8_t quantize_up(float value, float origin, float scale) {
+    float q = std::ceil((value - origin) / scale);
+    q = q < 0 ? 0 : (q > 255 ? 255 : q);
+
+    while (q < 255 && origin + q * scale < value)
+        q++;
+
+    return static_cast<std::uint8_t>(q);
+}
+
+template <std::size_t Width>
+compressed_bvh<Width>::compressed_bvh(const wide_bvh<Width>& wide) {
+    if (wide.empty())
+        return;
+
+    for (const wide_bvh_node<Width>& node : wide.nodes())
+        for (std::size_t i = 0; i < node.children; i++)
+            if (node.count[i] > 255)
+                throw std::invalid_argument("compressed_bvh: leaves of "
+                                            "more than 255 primitives are "
+                                            "not supported");
+
+    node_array.reserve(wide.nodes().size());
+    index_array.reserve(wide.indices().size());
+
+    node_array.resize(1);
+    compress(wide, 0, 0);
+}
+
+template <std::size_t Width>
+void compressed_bvh<Width>::compress(const wide_bvh<Width>& wide,
+                                     std::uint32_t wide_index,
+                                     std::uint32_t index) {
+    const wide_bvh_node<Width>& source = wide.nodes()[wide_index];
+    const float* source_lo[3] = { source.lo_x, source.lo_y, source.lo_z };
+    const float* source_hi[3] = { source.hi_x, source.hi_y, source.hi_z };
+
+    compressed_bvh_node<Width> node = {};
+    std::uint8_t* lo[3] = { node.lo_x, node.lo_y, node.lo_z };
+    std::uint8_t* hi[3] = { node.hi_x, node.hi_y, node.hi_z };
+
+    node.children = source.children;
+
+    for (int axis = 0; axis < 3; axis++) {
+        float box_lo = source_lo[axis][0];
+        float box_hi = source_hi[axis][0];
+
+        for (std::size_t i = 1; i < source.children; i++) {
+            box_lo = std::fmin(box_lo, source_lo[axis][i]);
+            box_hi = std::fmax(box_hi, source_hi[axis][i]);
+        }
+
+        const std::int8_t exponent = axis_exponent(box_lo, box_hi);
+        const float scale = exponent_scale(exponent);
+
+        node.origin[axis] = box_lo;
+        node.exponent[axis] = exponent;
+
+        for (std::size_t i = 0; i < Width; i++) {
+            if (i >= source.children) {
+                // Unused lanes: inverted, and masked by wide_slab anyway.
+                lo[axis][i] = 255;
+                hi[axis][i] = 0;
+                continue;
+            }
+
+            lo[axis][i] = quantize_down(source_lo[axis][i], box_lo, scale);
+            hi[axis][i] = quantize_up(source_hi[axis][i], box_lo, scale);
+        }
+    }
+
+    // The leaf children's primitives, then slots for the inner children.
+    node.primitive_base = static_cast<std::uint32_t>(index_array.size());
+    node.child_base = static_cast<std::uint32_t>(node_array.size());
+
+    std::size_t inner = 0;
+
+    for (std::size_t i = 0; i < source.children; i++) {
+        node.count[i] = static_cast<std::uint8_t>(source.count[i]);
+
+        if (source.count[i] == 0) {
+            inner++;
+            continue;
+        }
+
+        index_array.insert(index_array.end(),
+                           wide.indices().begin() + source.child[i],
+                           wide.indices().begin() + source.child[i] +
+                               source.count[i]);
+    }
+
+    node_array.resize(node_array.size() + inner);
+    node_array[index] = node;
+
+    std::uint32_t slot = node.child_base;
+
+    for (std::size_t i = 0; i < source.children; i++)
+        if (source.count[i] == 0)
+            compress(wide, source.child[i], slot++);
+}
+
+template class compressed_bvh<4>;
+template class compressed_bvh<8>;
@@ -0,0 +1,62 @@
+/** @file framebuffer.h */
+
+#pragma once
+
+#include "vec3.h"
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @class framebuffer
+ * @brief Row-major image of colorf samples.
+ *
+ * Rows are contiguous, so whole rows can be handed to the quantization
+ * stage (@ref quantize_row) without copying.
+ */
+class framebuffer {
+    private:
+        std::size_t w;
+        std::size_t h;
+        std::vector<colorf> pixels;
+
+    public:
+        /**
+         * @brief Constructs a black framebuffer.
+         *
+         * @param width -> The width in pixels
+         * @param height -> The height in pixels
+         */
+        framebuffer(std::size_t width, std::size_t height)
+            : w(width), h(height), pixels(width * height) {}
+
+        /** @brief Returns the width in pixels. */
+        inline std::size_t width() const {
+            return w;
+        }
+
+        /** @brief Returns the height in pixels. */
+        inline std::size_t height() const {
+            return h;
+        }
+
+        /** @brief Returns the first pixel of row y. */
+        inline colorf* row(std::size_t y) {
+            return pixels.data() + y * w;
+        }
+
+        /** @brief Returns the first pixel of row y. */
+        inline const colorf* row(std::size_t y) const {
+            return pixels.data() + y * w;
+        }
+
+        /** @brief Returns the pixel (x, y). */
+        inline colorf& at(std::size_t x, std::size_t y) {
+            return pixels[y * w + x];
+        }
+
+        /** @brief Returns the pixel (x, y). */
+        inline const colorf& at(std::size_t x, std::size_t y) const {
+            return pixels[y * w + x];
+        }
+};
@@ -0,0 +1,703 @@
+#include "lbvh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+/** @brief Bits sorted per radix sort pass. */
+static const unsigned RADIX_BITS = 8;
+static const std::size_t RADIX_SIZE = std::size_t(1) << RADIX_BITS;
+
+/**
+ * @brief Depth from which subtrees are emitted balanced: runs of close
+ *        Morton codes can make the emitted tree deeper than traversal
+ *        supports.
+ */
+static const std::size_t BALANCED_DEPTH = bvh::max_depth - 32;
+
+/** @brief Largest supported treelet. */
+static const std::size_t MAX_TREELET_LEAVES = 10;
+
+/** @brief A Morton code and the primitive it was computed for. */
+template <typename Code>
+struct keyed_primitive {
+    Code code;
+    std::uint32_t index;
+};
+
+/**
+ * @brief Node of the tree before flattening. For n primitives, nodes
+ *        [0, n - 1) are inner nodes, 0 the root, and node n - 1 + i is
+ *        the leaf of the i-th primitive in Morton order.
+ */
+struct lbvh_build_node {
+    aabb box;
+    std::uint32_t left;
+    std::uint32_t right;
+    std::uint32_t count;
+
+    /** @brief SAH cost of the subtree, not normalized by the root area. */
+    float cost;
+};
+
+static inline int leading_zeros(std::uint32_t value) {
+    return __builtin_clz(value);
+}
+
+static inline int leading_zeros(std::uint64_t value) {
+    return __builtin_clzll(value);
+}
+
+/**
+ * @brief Calls body(chunk, begin, end) over [0, count) in chunks of
+ *        chunk_size, in parallel on pool if not null.
+ */
+static void for_each_chunk(scheduler* pool, std::size_t count,
+                           std::size_t chunk_size,
+                           const std::function<void(std::size_t, std::size_t,
+                                                    std::size_t)>& body) {
+    const std::size_t chunks = (count + chunk_size - 1) / chunk_size;
+
+    auto run = [&](std::size_t first, std::size_t last) {
+        for (std::size_t chunk = first; chunk < last; chunk++)
+            body(chunk, chunk * chunk_size,
+                 std::min(count, (chunk + 1) * chunk_size));
+    };
+
+    if (pool && chunks > 1)
+        pool->parallel_for(0, chunks, 1, run);
+    else
+        run(0, chunks);
+}
+
+/**
+ * @brief Sorts items by code: a least significant digit radix sort whose
+ *        passes count and scatter chunks of the items in parallel.
+ *        Passes over a digit all the codes share are skipped.
+ */
+template <typename Code>
+static void radix_sort(std::vector<keyed_primitive<Code>>& items,
+                       unsigned code_bits, scheduler* pool,
+                       std::size_t chunk_size) {
+    const std::size_t count = items.size();
+    const std::size_t chunks = (count + chunk_size - 1) / chunk_size;
+
+    std::vector<keyed_primitive<Code>> sorted(count);
+    std::vector<std::size_t> offsets(chunks * RADIX_SIZE);
+
+    for (unsigned shift = 0; shift < code_bits; shift += RADIX_BITS) {
+        std::fill(offsets.begin(), offsets.end(), 0);
+
+        for_each_chunk(pool, count, chunk_size,
+                       [&](std::size_t chunk, std::size_t begin,
+                           std::size_t end) {
+            std::size_t* histogram = &offsets[chunk * RADIX_SIZE];
+
+            for (std::size_t i = begin; i < end; i++)
+                histogram[(items[i].code >> shift) & (RADIX_SIZE - 1)]++;
+        });
+
+        // Where every chunk writes each digit: digit major, so that the
+        // sort is stable.
+        std::size_t total = 0;
+        bool single_digit = false;
+
+        for (std::size_t digit = 0; digit < RADIX_SIZE; digit++) {
+            const std::size_t first = total;
+
+            for (std::size_t chunk = 0; chunk < chunks; chunk++) {
+                const std::size_t digit_count =
+                    offsets[chunk * RADIX_SIZE + digit];
+
+                offsets[chunk * RADIX_SIZE + digit] = total;
+                total += digit_count;
+            }
+
+            single_digit = single_digit || total - first == count;
+        }
+
+        if (single_digit)
+            continue;
+
+        for_each_chunk(pool, count, chunk_size,
+                       [&](std::size_t chunk, std::size_t begin,
+                           std::size_t end) {
+            std::size_t* offset = &offsets[chunk * RADIX_SIZE];
+
+            for (std::size_t i = begin; i < end; i++)
+                sorted[offset[(items[i].code >> shift) &
+                              (RADIX_SIZE - 1)]++] = items[i];
+        });
+
+        items.swap(sorted);
+    }
+}
+
+/**
+ * @brief Builds the LBVH: Morton codes, sort, and hierarchy emission,
+ *        then bounds, treelet reoptimization and flattening.
+ */
+template <typename Code>
+class lbvh_builder {
+    private:
+        const std::vector<aabb>& bounds;
+        const lbvh_build_settings& settings;
+        scheduler* pool;
+
+        std::vector<keyed_primitive<Code>> items;
+        std::vector<lbvh_build_node> nodes;
+
+        /** @brief The primitives of the subtree being flattened. */
+        std::vector<std::uint32_t> gathered;
+
+        /**
+         * @returns The length of the common prefix of the codes of the
+         *          sorted primitives i and j, tied codes extended by their
+         *          positions; -1 if j is out of range.
+         */
+        inline int common_prefix(std::int64_t i, std::int64_t j) const {
+            if (j < 0 || j >= static_cast<std::int64_t>(items.size()))
+                return -1;
+
+            const Code a = items[i].code;
+            const Code b = items[j].code;
+
+            if (a != b)
+                return leading_zeros(static_cast<Code>(a ^ b));
+
+            return 8 * static_cast<int>(sizeof(Code)) +
+                   leading_zeros(static_cast<std::uint32_t>(i ^ j));
+        }
+
+        /**
+         * @brief Finds the range and the split of inner node i (Karras
+         *        2012, algorithm 4) and links its children.
+         */
+        void emit(std::int64_t i) {
+            const std::int64_t leaves =
+                static_cast<std::int64_t>(items.size()) - 1;
+
+            // Direction of the range: towards the longer common prefix.
+            const std::int64_t d =
+                common_prefix(i, i + 1) > common_prefix(i, i - 1) ? 1 : -1;
+            const int min_prefix = common_prefix(i, i - d);
+
+            std::int64_t max_length = 2;
+
+            while (common_prefix(i, i + max_length * d) > min_prefix)
+                max_length *= 2;
+
+            std::int64_t length = 0;
+
+            for (std::int64_t t = max_length / 2; t >= 1; t /= 2)
+                if (common_prefix(i, i + (length + t) * d) > min_prefix)
+                    length += t;
+
+            const std::int64_t j = i + length * d;
+            const int node_prefix = common_prefix(i, j);
+
+            // Binary search of the last position sharing node_prefix.
+            std::int64_t split = 0;
+
+            for (std::int64_t divisor = 2; ; divisor *= 2) {
+                const std::int64_t t = (length + divisor - 1) / divisor;
+
+                if (common_prefix(i, i + (split + t) * d) > node_prefix)
+                    split += t;
+
+                if (t == 1)
+                    break;
+            }
+
+            const std::int64_t gamma = i + split * d + (d < 0 ? -1 : 0);
+            lbvh_build_node& node = nodes[i];
+
+            node.left = static_cast<std::uint32_t>(
+                std::min(i, j) == gamma ? leaves + gamma : gamma);
+            node.right = static_cast<std::uint32_t>(
+                std::max(i, j) == gamma + 1 ? leaves + gamma + 1 : gamma + 1);
+            node.count = static_cast<std::uint32_t>(length + 1);
+        }
+
+        inline bool is_leaf(std::uint32_t index) const {
+            return index + 1 >= items.size();
+        }
+
+        /** @returns The SAH cost of a node of box over count primitives. */
+        inline float node_cost(const aabb& box, std::size_t count,
+                               float children_cost) const {
+            const float area = box.surface_area();
+            const float split = settings.base.traversal_cost * area +
+                                children_cost;
+
+            if (count > settings.base.max_leaf_size)
+                return split;
+
+            return std::fmin(split,
+                             settings.base.intersection_cost * area * count);
+        }
+
+        /** @returns true if the subtree of index is emitted as a leaf. */
+        inline bool collapsed(std::uint32_t index) const {
+            if (is_leaf(index))
+                return true;
+
+            const lbvh_build_node& node = nodes[index];
+
+            return node.count <= settings.base.max_leaf_size &&
+                   settings.base.intersection_cost *
+                   node.box.surface_area() * node.count <=
+                   settings.base.traversal_cost * node.box.surface_area() +
+                   nodes[node.left].cost + nodes[node.right].cost;
+        }
+
+        /** @brief Sets the bounds and costs of the subtree of index. */
+        void refit(std::uint32_t index) {
+            if (is_leaf(index))
+                return;
+
+            lbvh_build_node& node = nodes[index];
+
+            if (pool && node.count >= settings.base.parallel_threshold) {
+                task_group group;
+
+                pool->submit(group, [&] { refit(node.left); });
+                refit(node.right);
+                pool->wait(group);
+            } else {
+                refit(node.left);
+                refit(node.right);
+            }
+
+            const lbvh_build_node& left = nodes[node.left];
+            const lbvh_build_node& right = nodes[node.right];
+
+            node.box = merge(left.box, right.box);
+            node.cost = node_cost(node.box, node.count,
+                                  left.cost + right.cost);
+        }
+
+        /**
+         * @brief Reoptimizes the subtree of index bottom-up: every node
+         *        roots a treelet whose topology is replaced by the optimal
+         *        one.
+         */
+        void optimize(std::uint32_t index) {
+            if (is_leaf(index) ||
+                nodes[index].count < settings.treelet_leaves)
+                return;
+
+            const lbvh_build_node& node = nodes[index];
+
+            if (pool && node.count >= settings.base.parallel_threshold) {
+                task_group group;
+
+                pool->submit(group, [&] { optimize(node.left); });
+                optimize(node.right);
+                pool->wait(group);
+            } else {
+                optimize(node.left);
+                optimize(node.right);
+            }
+
+            restructure(index);
+        }
+
+        /**
+         * @brief Replaces the treelet rooted at index by the one of least
+         *        SAH cost over the same leaves (Karras and Aila 2013),
+         *        found by dynamic programming over the subsets of leaves.
+         */
+        void restructure(std::uint32_t root) {
+            std::uint32_t leaves[MAX_TREELET_LEAVES];
+            std::uint32_t inner[MAX_TREELET_LEAVES];
+            std::size_t leaf_count = 2;
+            std::size_t inner_count = 1;
+
+            leaves[0] = nodes[root].left;
+            leaves[1] = nodes[root].right;
+            inner[0] = root;
+
+            // Grow the treelet by expanding its largest leaf.
+            while (leaf_count < settings.treelet_leaves) {
+                std::size_t largest = leaf_count;
+                float largest_area = -1;
+
+                for (std::size_t i = 0; i < leaf_count; i++) {
+                    const float area = nodes[leaves[i]].box.surface_area();
+
+                    if (!is_leaf(leaves[i]) && area > largest_area) {
+                        largest = i;
+                        largest_area = area;
+                    }
+                }
+
+                if (largest == leaf_count)
+                    break;
+
+                const std::uint32_t expanded = leaves[largest];
+
+                inner[inner_count++] = expanded;
+                leaves[largest] = nodes[expanded].left;
+                leaves[leaf_count++] = nodes[expanded].right;
+            }
+
+            if (leaf_count < 3)
+                return;
+
+            const std::size_t subsets = std::size_t(1) << leaf_count;
+
+            // Per subset of leaves; reused, as every node roots a treelet.
+            thread_local std::vector<aabb> box;
+            thread_local std::vector<float> cost;
+            thread_local std::vector<std::uint32_t> count;
+            thread_local std::vector<std::uint32_t> partition;
+
+            if (box.size() < subsets) {
+                box.resize(subsets);
+                cost.resize(subsets);
+                count.resize(subsets);
+                partition.resize(subsets);
+            }
+
+            for (std::size_t s = 1; s < subsets; s++) {
+                const std::size_t lowest = __builtin_ctzll(s);
+                const std::size_t rest = s & (s - 1);
+                const lbvh_build_node& leaf = nodes[leaves[lowest]];
+
+                if (rest == 0) {
+                    box[s] = leaf.box;
+                    cost[s] = leaf.cost;
+                    count[s] = is_leaf(leaves[lowest]) ? 1 : leaf.count;
+                    continue;
+                }
+
+                box[s] = merge(box[rest], leaf.box);
+                count[s] = count[rest] +
+                           (is_leaf(leaves[lowest]) ? 1 : leaf.count);
+
+                // Every split in two, once: p is the side with the lowest
+                // leaf, and any subset of the others.
+                float best = std::numeric_limits<float>::infinity();
+                const std::size_t low_bit = s & (~s + 1);
+
+                for (std::size_t q = (rest - 1) & rest; ;
+                     q = (q - 1) & rest) {
+                    const std::size_t p = q | low_bit;
+                    const float split = cost[p] + cost[s ^ p];
+
+                    if (split < best) {
+                        best = split;
+                        partition[s] = static_cast<std::uint32_t>(p);
+                    }
+
+                    if (q == 0)
+                        break;
+                }
+
+                cost[s] = node_cost(box[s], count[s], best);
+            }
+
+            const std::size_t all = subsets - 1;
+
+            if (!(cost[all] < nodes[root].cost))
+                return;
+
+            // Rebuild the treelet on its inner nodes, root kept in place.
+            std::size_t next_inner = 1;
+
+            std::function<std::uint32_t(std::size_t, std::uint32_t)> assign =
+                [&](std::size_t s, std::uint32_t index) {
+                const std::size_t p = partition[s];
+                const std::size_t sides[2] = { p, s ^ p };
+                std::uint32_t children[2];
+
+                for (int side = 0; side < 2; side++) {
+                    const std::size_t subset = sides[side];
+
+                    if ((subset & (subset - 1)) == 0)
+                        children[side] = leaves[__builtin_ctzll(subset)];
+                    else
+                        children[side] = assign(subset,
+                                                inner[next_inner++]);
+                }
+
+                lbvh_build_node& node = nodes[index];
+
+                node.left = children[0];
+                node.right = children[1];
+                node.box = box[s];
+                node.count = count[s];
+                node.cost = cost[s];
+
+                return index;
+            };
+
+            assign(all, root);
+        }
+
+        /** @brief Appends the primitives of the subtree of index. */
+        void gather(std::uint32_t index,
+                    std::vector<std::uint32_t>& primitives) const {
+            if (is_leaf(index)) {
+                primitives.push_back(items[index + 1 - items.size()].index);
+                return;
+            }
+
+            gather(nodes[index].left, primitives);
+            gather(nodes[index].right, primitives);
+        }
+
+        /** @brief Appends a median split tree over primitives[begin, end). */
+        void flatten_balanced(const std::vector<std::uint32_t>& primitives,
+                              std::size_t begin, std::size_t end,
+                              std::size_t depth, float root_area,
+                              std::vector<bvh_node>& flat,
+                              std::vector<std::uint32_t>& indices,
+                              bvh_build_stats& stats) const {
+            aabb box;
+
+            for (std::size_t i = begin; i < end; i++)
+                box.extend(bounds[primitives[i]]);
+
+            const std::size_t index = flat.size();
+            flat.push_back(bvh_node());
+            set_flat_bounds(flat[index], box);
+
+            const double relative_area = root_area > 0
+                                       ? box.surface_area() / root_area : 1;
+
+            stats.max_depth = std::max(stats.max_depth, depth);
+
+            if (end - begin <= settings.base.max_leaf_size) {
+                flat[index].offset =
+                    static_cast<std::uint32_t>(indices.size());
+                flat[index].count = static_cast<std::uint16_t>(end - begin);
+                flat[index].axis = 0;
+
+                indices.insert(indices.end(), primitives.begin() + begin,
+                               primitives.begin() + end);
+
+                stats.leaf_count++;
+                stats.sah_cost += settings.base.intersection_cost *
+                                  (end - begin) * relative_area;
+                return;
+            }
+
+            const std::size_t middle = begin + (end - begin) / 2;
+
+            flat[index].count = 0;
+            flat[index].axis = static_cast<std::uint16_t>(box.largest_axis());
+
+            stats.sah_cost += settings.base.traversal_cost * relative_area;
+
+            flatten_balanced(primitives, begin, middle, depth + 1, root_area,
+                             flat, indices, stats);
+            flat[index].offset = static_cast<std::uint32_t>(flat.size());
+            flatten_balanced(primitives, middle, end, depth + 1, root_area,
+                             flat, indices, stats);
+        }
+
+        static void set_flat_bounds(bvh_node& node, const aabb& box) {
+            node.lo[0] = box.min().x();
+            node.lo[1] = box.min().y();
+            node.lo[2] = box.min().z();
+            node.hi[0] = box.max().x();
+            node.hi[1] = box.max().y();
+            node.hi[2] = box.max().z();
+        }
+
+    public:
+        lbvh_builder(const std::vector<aabb>& bounds,
+                     const lbvh_build_settings& settings, scheduler* pool)
+            : bounds(bounds), settings(settings), pool(pool) {}
+
+        /** @brief Computes the codes, sorts them and emits the tree. */
+        void build(Code (*encode)(const vec3f&), unsigned code_bits) {
+            const std::size_t count = bounds.size();
+            const std::size_t chunk_size = settings.base.parallel_threshold;
+
+            // Centroid bounds, merged from the chunks.
+            std::vector<aabb> chunk_bounds((count + chunk_size - 1) /
+                                           chunk_size);
+
+            for_each_chunk(pool, count, chunk_size,
+                           [&](std::size_t chunk, std::size_t begin,
+                               std::size_t end) {
+                for (std::size_t i = begin; i < end; i++)
+                    chunk_bounds[chunk].extend(bounds[i].centroid());
+            });
+
+            aabb centroid_box;
+
+            for (const aabb& box : chunk_bounds)
+                centroid_box.extend(box);
+
+            const vec3f origin = centroid_box.min();
+            const vec3f extent = centroid_box.extent();
+            vec3f scale;
+
+            for (int i = 0; i < 3; i++)
+                scale[i] = extent[i] > 0 ? 1 / extent[i] : 0;
+
+            items.resize(count);
+
+            for_each_chunk(pool, count, chunk_size,
+                           [&](std::size_t, std::size_t begin,
+                               std::size_t end) {
+                for (std::size_t i = begin; i < end; i++)
+                    items[i] = keyed_primitive<Code>{
+                        encode((bounds[i].centroid() - origin) * scale),
+                        static_cast<std::uint32_t>(i)
+                    };
+            });
+
+            radix_sort(items, code_bits, pool, chunk_size);
+
+            // Inner nodes, independently of each other, then the leaves.
+            nodes.resize(2 * count - 1);
+
+            for_each_chunk(pool, count - 1, chunk_size,
+                           [&](std::size_t, std::size_t begin,
+                               std::size_t end) {
+                for (std::size_t i = begin; i < end; i++)
+                    emit(static_cast<std::int64_t>(i));
+            });
+
+            for_each_chunk(pool, count, chunk_size,
+                           [&](std::size_t, std::size_t begin,
+                               std::size_t end) {
+                for (std::size_t i = begin; i < end; i++) {
+                    lbvh_build_node& leaf = nodes[count - 1 + i];
+
+                    leaf.box = bounds[items[i].index];
+                    leaf.count = 1;
+                    leaf.cost = settings.base.intersection_cost *
+                                leaf.box.surface_area();
+                }
+            });
+
+            refit(0);
+
+            for (std::size_t pass = 0; pass < settings.treelet_passes; pass++)
+                optimize(0);
+        }
+
+        /** @brief Appends the subtree of index to flat and indices. */
+        void flatten(std::uint32_t index, std::size_t depth, float root_area,
+                     std::vector<bvh_node>& flat,
+                     std::vector<std::uint32_t>& indices,
+                     bvh_build_stats& stats) {
+            if (depth >= BALANCED_DEPTH || collapsed(index)) {
+                gathered.clear();
+                gather(index, gathered);
+
+                flatten_balanced(gathered, 0, gathered.size(), depth,
+                                 root_area, flat, indices, stats);
+                return;
+            }
+
+            const lbvh_build_node& node = nodes[index];
+            std::uint32_t left = node.left;
+            std::uint32_t right = node.right;
+
+            // The axis separating the children most; left is the lower
+            // one on it, as traversal expects.
+            const vec3f offset = nodes[right].box.centroid() -
+                                 nodes[left].box.centroid();
+            int axis = 0;
+
+            for (int i = 1; i < 3; i++)
+                if (std::fabs(offset[i]) > std::fabs(offset[axis]))
+                    axis = i;
+
+            if (offset[axis] < 0)
+                std::swap(left, right);
+
+            const std::size_t flat_index = flat.size();
+            flat.push_back(bvh_node());
+            set_flat_bounds(flat[flat_index], node.box);
+
+            flat[flat_index].count = 0;
+            flat[flat_index].axis = static_cast<std::uint16_t>(axis);
+
+            stats.max_depth = std::max(stats.max_depth, depth);
+            stats.sah_cost += settings.base.traversal_cost *
+                              (root_area > 0
+                               ? node.box.surface_area() / root_area : 1);
+
+            flatten(left, depth + 1, root_area, flat, indices, stats);
+
+            // flat may have been reallocated.
+            flat[flat_index].offset = static_cast<std::uint32_t>(flat.size());
+
+            flatten(right, depth + 1, root_area, flat, indices, stats);
+        }
+
+        /** @brief Returns the node count of the unflattened tree. */
+        inline std::size_t node_count() const {
+            return nodes.size();
+        }
+
+        inline const aabb& root_bounds() const {
+            return nodes[0].box;
+        }
+};
+
+bvh build_lbvh(const std::vector<aabb>& bounds, scheduler* pool,
+               const lbvh_build_settings& settings) {
+    if (settings.base.max_leaf_size < 1 ||
+        settings.base.max_leaf_size > 65535)
+        throw std::invalid_argument("lbvh: max_leaf_size must be in "
+                                    "[1, 65535]");
+
+    if (settings.base.parallel_threshold < 1)
+        throw std::invalid_argument("lbvh: parallel_threshold must be "
+                                    "positive");
+
+    if (settings.treelet_leaves < 3 ||
+        settings.treelet_leaves > MAX_TREELET_LEAVES)
+        throw std::invalid_argument("lbvh: treelet_leaves must be in "
+                                    "[3, 10]");
+
+    if (bounds.size() >= std::numeric_limits<std::uint32_t>::max())
+        throw std::invalid_argument("lbvh: too many primitives");
+
+    if (bounds.empty())
+        return bvh();
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<bvh_node> nodes;
+    std::vector<std::uint32_t> indices;
+    bvh_build_stats stats;
+
+    auto finish = [&](auto& builder) {
+        nodes.reserve(builder.node_count());
+        indices.reserve(bounds.size());
+
+        builder.flatten(0, 0, builder.root_bounds().surface_area(), nodes,
+                        indices, stats);
+    };
+
+    if (settings.wide_codes) {
+        lbvh_builder<std::uint64_t> builder(bounds, settings, pool);
+        builder.build(morton_code_63, 63);
+        finish(builder);
+    } else {
+        lbvh_builder<std::uint32_t> builder(bounds, settings, pool);
+        builder.build(morton_code_30, 30);
+        finish(builder);
+    }
+
+    stats.node_count = nodes.size();
+    stats.build_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    return bvh(shared_buffer<bvh_node>(std::move(nodes)),
+               shared_buffer<std::uint32_t>(std::move(indices)), stats);
+}
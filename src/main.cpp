@@ -0,0 +1,488 @@
+#include "camera.h"
+#include "compressed_bvh.h"
+#include "obj_loader.h"
+#include "plane.h"
+#include "quantize.h"
+#include "random.h"
+#include "renderer.h"
+#include "sbvh.h"
+#include "scene_cache.h"
+#include "scheduler.h"
+#include "sphere.h"
+#include "tlas.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/** @brief Command line options of the renderer. */
+struct options {
+    std::size_t width = 800;
+    std::size_t height = 450;
+    std::string output = "image.ppm";
+    unsigned threads = 0;
+    std::size_t extra_spheres = 0;
+    std::size_t samples = 1;
+    std::size_t copies = 1;
+    bvh_layout layout = bvh_layout::binary;
+    bvh_quality quality = bvh_quality::fast;
+    std::string model;
+    std::string cache;
+    render_settings settings;
+};
+
+/** @brief The objects of the demo scene. */
+struct scene {
+    std::vector<sphere> spheres;
+    std::vector<plane> planes;
+    bvh_layout layout;
+    bvh sphere_tree;
+    wide_bvh<4> sphere_tree4;
+    wide_bvh<8> sphere_tree8;
+    compressed_bvh<4> sphere_tree_c4;
+    compressed_bvh<8> sphere_tree_c8;
+    tlas models;
+};
+
+/** @brief Error in the command line, reported with the usage. */
+class option_error : public std::invalid_argument {
+    public:
+        using std::invalid_argument::invalid_argument;
+};
+
+static void usage(const char* name) {
+    std::cerr << "usage: " << name << " [-w width] [-h height] "
+              << "[-t tile_size] [-j threads] [-s samples] "
+              << "[-n extra_spheres] "
+              << "[-b binary|bvh4|bvh8|cbvh4|cbvh8] [-q fast|sbvh|lbvh] "
+              << "[-m model.obj [-c cache] [-i copies]] "
+              << "[-o output.ppm]\n";
+}
+
+/** @returns The value of a numeric option, which must be positive. */
+static std::size_t parse_size(const char* value, const char* option) {
+    char* end = nullptr;
+    const unsigned long long parsed = std::strtoull(value, &end, 10);
+
+    if (*value == '\0' || *end != '\0' || parsed == 0)
+        throw option_error(std::string("invalid value for ") + option +
+                           ": " + value);
+
+    return static_cast<std::size_t>(parsed);
+}
+
+static bvh_layout parse_layout(const char* value) {
+    if (std::strcmp(value, "binary") == 0)
+        return bvh_layout::binary;
+
+    if (std::strcmp(value, "bvh4") == 0)
+        return bvh_layout::wide4;
+
+    if (std::strcmp(value, "bvh8") == 0)
+        return bvh_layout::wide8;
+
+    if (std::strcmp(value, "cbvh4") == 0)
+        return bvh_layout::compressed4;
+
+    if (std::strcmp(value, "cbvh8") == 0)
+        return bvh_layout::compressed8;
+
+    throw option_error(std::string("invalid value for -b: ") + value);
+}
+
+static bvh_quality parse_quality(const char* value) {
+    if (std::strcmp(value, "fast") == 0)
+        return bvh_quality::fast;
+
+    if (std::strcmp(value, "sbvh") == 0)
+        return bvh_quality::high;
+
+    if (std::strcmp(value, "lbvh") == 0)
+        return bvh_quality::preview;
+
+    throw option_error(std::string("invalid value for -q: ") + value);
+}
+
+static options parse_options(int argc, char** argv) {
+    options opts;
+
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+
+        if (i + 1 == argc)
+            throw option_error(std::string("missing value for ") + option);
+
+        const char* value = argv[++i];
+
+        if (std::strcmp(option, "-w") == 0)
+            opts.width = parse_size(value, option);
+        else if (std::strcmp(option, "-h") == 0)
+            opts.height = parse_size(value, option);
+        else if (std::strcmp(option, "-t") == 0)
+            opts.settings.tile_size = parse_size(value, option);
+        else if (std::strcmp(option, "-j") == 0)
+            opts.threads = static_cast<unsigned>(parse_size(value, option));
+        else if (std::strcmp(option, "-s") == 0)
+            opts.samples = parse_size(value, option);
+        else if (std::strcmp(option, "-n") == 0)
+            opts.extra_spheres = parse_size(value, option);
+        else if (std::strcmp(option, "-b") == 0)
+            opts.layout = parse_layout(value);
+        else if (std::strcmp(option, "-q") == 0)
+            opts.quality = parse_quality(value);
+        else if (std::strcmp(option, "-m") == 0)
+            opts.model = value;
+        else if (std::strcmp(option, "-c") == 0)
+            opts.cache = value;
+        else if (std::strcmp(option, "-i") == 0)
+            opts.copies = parse_size(value, option);
+        else if (std::strcmp(option, "-o") == 0)
+            opts.output = value;
+        else
+            throw option_error(std::string("unknown option ") + option);
+    }
+
+    if (!opts.cache.empty() && opts.model.empty())
+        throw option_error("-c requires -m");
+
+    if (opts.copies > 1 && opts.model.empty())
+        throw option_error("-i requires -m");
+
+    return opts;
+}
+
+/**
+ * @brief Builds the demo scene: three spheres on a ground plane, plus
+ *        extra_spheres small spheres scattered around them.
+ */
+static scene make_scene(scheduler& pool, std::size_t extra_spheres,
+                        bvh_layout layout) {
+    scene world;
+    world.layout = layout;
+
+    world.spheres.push_back(sphere(vec3f(0, 1, 0), 1));
+    world.spheres.push_back(sphere(vec3f(-2.2f, 0.7f, 0.6f), 0.7f));
+    world.spheres.push_back(sphere(vec3f(2.1f, 0.5f, 0.8f), 0.5f));
+    world.planes.push_back(plane(vec3f(0, 1, 0), 0));
+
+    pcg32 random(1);
+
+    for (std::size_t i = 0; i < extra_spheres; i++) {
+        const float radius = 0.02f + 0.06f * random.next_float();
+        const float x = random.next_float() * 16 - 8;
+        const float z = random.next_float() * 16 - 12;
+
+        world.spheres.push_back(sphere(vec3f(x, radius, z), radius));
+    }
+
+    world.sphere_tree = bvh(primitive_bounds(world.spheres), &pool);
+
+    if (layout == bvh_layout::wide4)
+        world.sphere_tree4 = wide_bvh<4>(world.sphere_tree);
+    else if (layout == bvh_layout::wide8)
+        world.sphere_tree8 = wide_bvh<8>(world.sphere_tree);
+    else if (layout == bvh_layout::compressed4)
+        world.sphere_tree_c4 = compressed_bvh<4>(world.sphere_tree);
+    else if (layout == bvh_layout::compressed8)
+        world.sphere_tree_c8 = compressed_bvh<8>(world.sphere_tree);
+
+    return world;
+}
+
+/**
+ * @brief Places copies of object on a grid, rows going away from the
+ *        camera. The first copy stays in place; the others are turned
+ *        around their vertical axis.
+ */
+static std::vector<instance> place_copies(
+    const std::shared_ptr<const blas>& object, std::size_t copies) {
+    const aabb box = bounds(*object);
+    const vec3f extent = box.extent();
+    const float spacing = 1.25f * std::fmax(extent.x(), extent.z());
+    const std::size_t columns = static_cast<std::size_t>(
+        std::ceil(std::sqrt(double(copies))));
+
+    std::vector<instance> instances;
+    instances.reserve(copies);
+    instances.push_back(instance(object));
+
+    for (std::size_t i = 1; i < copies; i++) {
+        const std::size_t row = i / columns;
+        const std::size_t column = i % columns;
+
+        // Columns alternate right and left of the first one.
+        const float side = column % 2 ? float((column + 1) / 2)
+                                      : -float(column / 2);
+        const vec3f offset(side * spacing, 0, -float(row) * spacing);
+
+        const affine_transform turn =
+            affine_transform::translation(box.centroid() + offset) *
+            affine_transform::rotation(vec3f(0, 1, 0), 0.7f * i) *
+            affine_transform::translation(-box.centroid());
+
+        instances.push_back(instance(object, turn));
+    }
+
+    return instances;
+}
+
+/**
+ * @brief Loads the model of opts into world, as opts.copies instances of
+ *        one shared mesh and BVH. With a cache, the OBJ file is only
+ *        parsed (and its BVH built) when the cache is stale.
+ */
+static void load_model(scheduler& pool, const options& opts, scene& world) {
+    auto load = [&] {
+        const obj_scene obj = load_obj(opts.model, pool);
+        const obj_load_stats& stats = obj.stats;
+
+        std::cerr << "obj: " << opts.model << ", "
+                  << obj.geometry.triangle_count() << " triangles, "
+                  << stats.bytes / 1e6 << " MB in " << stats.seconds * 1000
+                  << " ms (" << stats.megabytes_per_second << " MB/s, "
+                  << stats.chunks << " chunks), peak memory "
+                  << stats.peak_memory_bytes / 1e6 << " MB\n";
+
+        return obj.geometry;
+    };
+
+    auto object = std::make_shared<blas>();
+
+    if (opts.cache.empty()) {
+        object->geometry = load();
+        object->tree = build_bvh(object->geometry, opts.quality, &pool);
+    } else {
+        const auto start = std::chrono::steady_clock::now();
+        bool loaded = false;
+
+        // Caches of different build presets must not be mixed up.
+        const std::uint64_t key = scene_source_key(opts.model) ^
+            hash64(static_cast<std::uint64_t>(opts.quality) + 1);
+
+        cached_scene cached = open_scene_cache(
+            opts.cache, key, load,
+            [&](const mesh& geometry) {
+                return build_bvh(geometry, opts.quality, &pool);
+            },
+            &loaded);
+
+        object->geometry = cached.geometry;
+        object->tree = cached.tree;
+
+        std::cerr << "cache: " << opts.cache
+                  << (loaded ? " loaded" : " written") << " in "
+                  << std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start).count() *
+                         1000
+                  << " ms\n";
+    }
+
+    const bvh_build_stats& blas_build = object->tree.stats();
+
+    std::cerr << "blas: " << object->tree.indices().size()
+              << " references, " << blas_build.node_count << " nodes, depth "
+              << blas_build.max_depth << ", SAH cost " << blas_build.sah_cost
+              << ", built in " << blas_build.build_seconds * 1000 << " ms\n";
+
+    world.models = tlas(place_copies(object, opts.copies), &pool);
+
+    const bvh_build_stats& build = world.models.top_level().stats();
+
+    std::cerr << "tlas: " << opts.copies << " instances of "
+              << object->geometry.triangle_count() << " triangles, top "
+              << "level built in " << build.build_seconds * 1000 << " ms\n";
+}
+
+/** @returns The color seen along r: Lambert shading under a sky. */
+static colorf trace(const scene& world, const ray& r) {
+    const vec3f light = vec3f(1, 2, 1).getNormalized();
+
+    float t = std::numeric_limits<float>::infinity();
+    vec3f normal;
+    bool hit = false;
+
+    std::size_t index;
+    bool sphere_hit;
+
+    switch (world.layout) {
+        case bvh_layout::wide4:
+            sphere_hit = intersect(r, world.sphere_tree4, world.spheres,
+                                   1e-4f, t, index);
+            break;
+        case bvh_layout::wide8:
+            sphere_hit = intersect(r, world.sphere_tree8, world.spheres,
+                                   1e-4f, t, index);
+            break;
+        case bvh_layout::compressed4:
+            sphere_hit = intersect(r, world.sphere_tree_c4, world.spheres,
+                                   1e-4f, t, index);
+            break;
+        case bvh_layout::compressed8:
+            sphere_hit = intersect(r, world.sphere_tree_c8, world.spheres,
+                                   1e-4f, t, index);
+            break;
+        default:
+            sphere_hit = intersect(r, world.sphere_tree, world.spheres,
+                                   1e-4f, t, index);
+    }
+
+    if (sphere_hit) {
+        const sphere& s = world.spheres[index];
+
+        normal = (r.point_at(t) - s.center()) / s.radius();
+        hit = true;
+    }
+
+    instance_hit model_hit;
+
+    if (intersect(r, world.models, 1e-4f, t, model_hit)) {
+        const instance& placed =
+            world.models.instances()[model_hit.instance_index];
+        const triangle tri =
+            placed.object().geometry.get_triangle(model_hit.primitive_index);
+
+        normal = placed.normal_to_world(cross(tri.v1() - tri.v0(),
+                                              tri.v2() - tri.v0()))
+                     .getNormalized();
+
+        if (dot(normal, r.direction()) > 0)
+            normal = -normal;
+
+        hit = true;
+    }
+
+    for (const plane& p : world.planes)
+        if (intersect(r, p, 1e-4f, t)) {
+            normal = p.normal();
+            hit = true;
+        }
+
+    if (!hit) {
+        const float blend = 0.5f * (r.direction().getNormalized().y() + 1);
+
+        return colorf(1, 1, 1) * (1 - blend) + colorf(0.5f, 0.7f, 1) * blend;
+    }
+
+    const float diffuse = dot(normal, light);
+
+    return colorf(0.8f, 0.8f, 0.8f) * (0.1f + (diffuse > 0 ? diffuse : 0));
+}
+
+/**
+ * @brief Writes the framebuffer as a binary, sRGB-encoded PPM.
+ *
+ * The rows are quantized in parallel, in spans of scanlines.
+ */
+static void write_ppm(scheduler& pool, const framebuffer& frame,
+                      const std::string& path) {
+    std::ofstream file(path, std::ios::binary);
+
+    if (!file)
+        throw std::runtime_error("cannot open " + path);
+
+    const std::size_t row_bytes = frame.width() * 3;
+    std::vector<unsigned char> image(row_bytes * frame.height());
+
+    pool.parallel_for(0, frame.height(), 16,
+                      [&](std::size_t first, std::size_t last) {
+        for (std::size_t y = first; y < last; y++)
+            quantize_row(frame.row(y), frame.width(),
+                         image.data() + y * row_bytes, pixel_format::rgb8,
+                         transfer_function::srgb);
+    });
+
+    file << "P6\n" << frame.width() << ' ' << frame.height() << "\n255\n";
+    file.write(reinterpret_cast<const char*>(image.data()), image.size());
+
+    if (!file)
+        throw std::runtime_error("cannot write " + path);
+}
+
+int main(int argc, char** argv) {
+    try {
+        const options opts = parse_options(argc, argv);
+        const camera view(vec3f(0, 1.5f, 6), vec3f(0, 0.8f, 0),
+                          vec3f(0, 1, 0), 40,
+                          float(opts.width) / float(opts.height));
+
+        framebuffer frame(opts.width, opts.height);
+        scheduler pool(opts.threads);
+
+        scene world = make_scene(pool, opts.extra_spheres, opts.layout);
+
+        if (!opts.model.empty())
+            load_model(pool, opts, world);
+
+        const bvh_build_stats& build = world.sphere_tree.stats();
+
+        std::cerr << "bvh: " << world.spheres.size() << " spheres, "
+                  << build.node_count << " nodes, depth " << build.max_depth
+                  << ", SAH cost " << build.sah_cost << ", built in "
+                  << build.build_seconds * 1000 << " ms\n";
+
+        pool.reset_stats();
+
+        const auto start = std::chrono::steady_clock::now();
+
+        render(pool, frame, opts.settings, [&](std::size_t x, std::size_t y) {
+            if (opts.samples == 1) {
+                const float s = (x + 0.5f) / opts.width;
+                const float t = 1 - (y + 0.5f) / opts.height;
+
+                return trace(world, view.get_ray(s, t));
+            }
+
+            // Jittered samples, identical whatever thread renders the
+            // pixel.
+            colorf sum(0, 0, 0);
+
+            for (std::size_t i = 0; i < opts.samples; i++) {
+                pcg32 random = pixel_random(static_cast<std::uint32_t>(x),
+                                            static_cast<std::uint32_t>(y),
+                                            static_cast<std::uint32_t>(i));
+
+                const float s = (x + random.next_float()) / opts.width;
+                const float t = 1 - (y + random.next_float()) / opts.height;
+
+                sum += trace(world, view.get_ray(s, t));
+            }
+
+            return sum / float(opts.samples);
+        });
+
+        const double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+        const scheduler_stats stats = pool.stats();
+
+        std::cerr << opts.width << "x" << opts.height << " rendered in "
+                  << seconds * 1000 << " ms on " << pool.size()
+                  << " threads (" << opts.settings.tile_size
+                  << "px tiles, " << opts.samples << " spp)\n"
+                  << "  tasks " << stats.tasks << ", steals " << stats.steals
+                  << ", idle " << stats.idle_seconds * 1000 << " ms"
+                  << ", mean latency " << stats.mean_latency_seconds * 1e6
+                  << " us, max latency " << stats.max_latency_seconds * 1e6
+                  << " us\n";
+
+        write_ppm(pool, frame, opts.output);
+    } catch (const option_error& error) {
+        std::cerr << error.what() << "\n";
+        usage(argv[0]);
+
+        return 1;
+    } catch (const std::exception& error) {
+        std::cerr << error.what() << "\n";
+
+        return 1;
+    }
+
+    return 0;
+}
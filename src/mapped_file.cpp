@@ -0,0 +1,56 @@
+#include "mapped_file.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** @brief Closes descriptor and throws a std::runtime_error for errno. */
+static void fail(int descriptor, const std::string& path, const char* what) {
+    const int error = errno;
+
+    if (descriptor >= 0)
+        close(descriptor);
+
+    throw std::runtime_error("mapped_file: " + std::string(what) + " " +
+                             path + ": " + std::strerror(error));
+}
+
+mapped_file::mapped_file(const std::string& path) {
+    const int descriptor = open(path.c_str(), O_RDONLY);
+
+    if (descriptor < 0)
+        fail(descriptor, path, "cannot open");
+
+    struct stat status;
+
+    if (fstat(descriptor, &status) != 0)
+        fail(descriptor, path, "cannot stat");
+
+    length = static_cast<std::size_t>(status.st_size);
+
+    if (length == 0) {
+        close(descriptor);
+        return;
+    }
+
+    void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor,
+                         0);
+
+    if (address == MAP_FAILED)
+        fail(descriptor, path, "cannot map");
+
+    // The mapping keeps its own reference to the file.
+    close(descriptor);
+
+    const std::size_t mapped_length = length;
+
+    bytes = std::shared_ptr<const char>(static_cast<const char*>(address),
+                                        [mapped_length](const char* p) {
+        munmap(const_cast<char*>(p), mapped_length);
+    });
+}
@@ -0,0 +1,45 @@
+/** @file mapped_file.h */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+/**
+ * @class mapped_file
+ * @brief Read-only memory mapping of a whole file.
+ *
+ * The mapping is reference counted: it is unmapped when the last copy of
+ * the mapped_file, or of @ref owner, is destroyed.
+ */
+class mapped_file {
+    private:
+        std::shared_ptr<const char> bytes;
+        std::size_t length = 0;
+
+    public:
+        /**
+         * @brief Maps the file.
+         *
+         * @param path -> The path of the file
+         *
+         * @throws std::runtime_error if the file cannot be opened or mapped.
+         */
+        explicit mapped_file(const std::string& path);
+
+        /** @brief Returns the first byte. Null for an empty file. */
+        inline const char* data() const {
+            return bytes.get();
+        }
+
+        /** @brief Returns the size of the file in bytes. */
+        inline std::size_t size() const {
+            return length;
+        }
+
+        /** @brief Returns the owner of the mapping. */
+        inline const std::shared_ptr<const char>& owner() const {
+            return bytes;
+        }
+};
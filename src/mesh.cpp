@@ -0,0 +1,86 @@
+#include "mesh.h"
+
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+mesh::mesh() : buffers(std::make_shared<const mesh_buffers>()) {}
+
+mesh::mesh(std::vector<vec3f> positions,
+           const std::vector<std::uint32_t>& indices,
+           std::vector<vec3f> normals, std::vector<texcoord> uvs,
+           mesh_layout layout) {
+    if (indices.size() % 3 != 0)
+        throw std::invalid_argument("mesh: index count must be a multiple "
+                                    "of 3");
+
+    if (indices.size() / 3 >= std::numeric_limits<std::uint32_t>::max())
+        throw std::invalid_argument("mesh: too many triangles");
+
+    if (!normals.empty() && normals.size() != positions.size())
+        throw std::invalid_argument("mesh: expected one normal per vertex");
+
+    if (!uvs.empty() && uvs.size() != positions.size())
+        throw std::invalid_argument("mesh: expected one uv per vertex");
+
+    for (std::uint32_t index : indices)
+        if (index >= positions.size())
+            throw std::invalid_argument("mesh: vertex index out of range");
+
+    std::shared_ptr<mesh_buffers> data = std::make_shared<mesh_buffers>();
+
+    data->wide_indices = positions.size() > max_16bit_vertices;
+    data->layout = layout;
+
+    if (data->wide_indices)
+        data->indices_32 = shared_buffer<std::uint32_t>(indices);
+    else
+        data->indices_16 = shared_buffer<std::uint16_t>(
+            std::vector<std::uint16_t>(indices.begin(), indices.end()));
+
+    data->positions = shared_buffer<vec3f>(std::move(positions));
+    data->normals = shared_buffer<vec3f>(std::move(normals));
+    data->uvs = shared_buffer<texcoord>(std::move(uvs));
+
+    buffers = data;
+
+    if (layout == mesh_layout::precomputed) {
+        const std::size_t count = triangle_count();
+
+        std::vector<triangle_precomputed> precomputed;
+        precomputed.reserve(count);
+
+        for (std::size_t i = 0; i < count; i++)
+            precomputed.emplace_back(get_triangle(i));
+
+        data->precomputed =
+            shared_buffer<triangle_precomputed>(std::move(precomputed));
+    }
+}
+
+mesh::mesh(std::shared_ptr<const mesh_buffers> buffers)
+    : buffers(std::move(buffers)) {
+    if (!this->buffers)
+        throw std::invalid_argument("mesh: null buffers");
+}
+
+std::size_t mesh::memory_bytes() const {
+    return buffers->positions.size() * sizeof(vec3f) +
+           buffers->normals.size() * sizeof(vec3f) +
+           buffers->uvs.size() * sizeof(texcoord) +
+           buffers->indices_16.size() * sizeof(std::uint16_t) +
+           buffers->indices_32.size() * sizeof(std::uint32_t) +
+           buffers->precomputed.size() * sizeof(triangle_precomputed);
+}
+
+std::vector<aabb> primitive_bounds(const mesh& m) {
+    const std::size_t count = m.triangle_count();
+
+    std::vector<aabb> boxes;
+    boxes.reserve(count);
+
+    for (std::size_t i = 0; i < count; i++)
+        boxes.push_back(bounds(m, i));
+
+    return boxes;
+}
@@ -0,0 +1,221 @@
+/** @file mesh.h */
+
+#pragma once
+
+#include "aabb.h"
+#include "shared_buffer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/** @brief Texture coordinates of a vertex. */
+struct texcoord {
+    float u;
+    float v;
+};
+
+/** @brief How a @ref mesh stores the data read by intersection tests. */
+enum class mesh_layout {
+    /** @brief Only the indexed vertices; triangles are gathered per test. */
+    compact,
+
+    /**
+     * @brief Also one @ref triangle_precomputed per triangle (64 bytes
+     *        with SIMD), for meshes that are traced far more than they
+     *        are stored.
+     */
+    precomputed
+};
+
+/**
+ * @brief Buffers of a @ref mesh, shared by all its copies.
+ *
+ * Exactly one of indices_16 and indices_32 is used, see
+ * @ref mesh::wide_indices. precomputed is empty unless the layout is
+ * mesh_layout::precomputed.
+ */
+struct mesh_buffers {
+    shared_buffer<vec3f> positions;
+    shared_buffer<vec3f> normals;
+    shared_buffer<texcoord> uvs;
+
+    shared_buffer<std::uint16_t> indices_16;
+    shared_buffer<std::uint32_t> indices_32;
+    bool wide_indices = false;
+
+    shared_buffer<triangle_precomputed> precomputed;
+    mesh_layout layout = mesh_layout::compact;
+};
+
+/**
+ * @class mesh
+ * @brief Indexed triangle mesh.
+ *
+ * Positions, normals and texture coordinates live in contiguous per
+ * vertex arrays, referenced by three indices per triangle. Meshes of at
+ * most @ref max_16bit_vertices vertices store 16-bit indices, larger ones
+ * 32-bit indices, so a triangle costs 6 or 12 bytes plus its share of
+ * the vertices instead of the 48 bytes (with SIMD) of a @ref triangle.
+ *
+ * The buffers are immutable and reference counted: copying a mesh (e.g.
+ * to instance it) shares them instead of copying them. They may also
+ * live in memory the mesh does not own, such as a memory-mapped
+ * @ref scene_cache.h "scene cache".
+ */
+class mesh {
+    private:
+        std::shared_ptr<const mesh_buffers> buffers;
+
+    public:
+        /** @brief Largest vertex count for which 16-bit indices are used. */
+        static constexpr std::size_t max_16bit_vertices = 65536;
+
+        /** @brief Constructs an empty mesh. */
+        mesh();
+
+        /**
+         * @brief Constructs the mesh.
+         *
+         * @param positions -> The vertex positions
+         * @param indices -> Three vertex indices per triangle
+         * @param normals -> The vertex normals. Empty or one per vertex.
+         * @param uvs -> The vertex texture coordinates. Empty or one per
+         *               vertex.
+         * @param layout -> The storage layout of the triangles
+         *
+         * @throws std::invalid_argument if indices.size() is not a
+         *         multiple of 3, an index is out of range, normals or uvs
+         *         have the wrong size, or there are 2^32 - 1 triangles or
+         *         more.
+         */
+        mesh(std::vector<vec3f> positions,
+             const std::vector<std::uint32_t>& indices,
+             std::vector<vec3f> normals = std::vector<vec3f>(),
+             std::vector<texcoord> uvs = std::vector<texcoord>(),
+             mesh_layout layout = mesh_layout::compact);
+
+        /**
+         * @brief Wraps existing buffers without copying them.
+         *
+         * @warning The buffers are trusted: indices must be in range and
+         *          the other buffers must have the sizes documented in
+         *          @ref mesh_buffers.
+         *
+         * @throws std::invalid_argument if buffers is null.
+         */
+        explicit mesh(std::shared_ptr<const mesh_buffers> buffers);
+
+        /** @brief Returns the number of triangles. */
+        inline std::size_t triangle_count() const {
+            return buffers->wide_indices ? buffers->indices_32.size() / 3
+                                         : buffers->indices_16.size() / 3;
+        }
+
+        /** @brief Returns the number of vertices. */
+        inline std::size_t vertex_count() const {
+            return buffers->positions.size();
+        }
+
+        /** @returns true if the mesh holds no triangle. */
+        inline bool empty() const {
+            return triangle_count() == 0;
+        }
+
+        /** @returns true if the indices are 32-bit, false if 16-bit. */
+        inline bool wide_indices() const {
+            return buffers->wide_indices;
+        }
+
+        /** @brief Returns the storage layout. */
+        inline mesh_layout layout() const {
+            return buffers->layout;
+        }
+
+        /** @brief Returns the vertex positions. */
+        inline const shared_buffer<vec3f>& positions() const {
+            return buffers->positions;
+        }
+
+        /** @brief Returns the vertex normals, empty if there are none. */
+        inline const shared_buffer<vec3f>& normals() const {
+            return buffers->normals;
+        }
+
+        /** @brief Returns the texture coordinates, empty if there are none. */
+        inline const shared_buffer<texcoord>& uvs() const {
+            return buffers->uvs;
+        }
+
+        /**
+         * @brief Returns a vertex index of a triangle. Unchecked.
+         *
+         * @param index -> The triangle
+         * @param corner -> The corner of the triangle (0, 1, 2)
+         */
+        inline std::uint32_t vertex_index(std::size_t index,
+                                          std::size_t corner) const {
+            return buffers->wide_indices
+                 ? buffers->indices_32[3 * index + corner]
+                 : buffers->indices_16[3 * index + corner];
+        }
+
+        /** @brief Returns triangle index, gathered from the vertices. */
+        inline triangle get_triangle(std::size_t index) const {
+            const shared_buffer<vec3f>& p = buffers->positions;
+
+            return triangle(p[vertex_index(index, 0)],
+                            p[vertex_index(index, 1)],
+                            p[vertex_index(index, 2)]);
+        }
+
+        /**
+         * @brief Returns the precomputed triangles. Empty unless the layout
+         *        is mesh_layout::precomputed.
+         */
+        inline const shared_buffer<triangle_precomputed>& precomputed() const {
+            return buffers->precomputed;
+        }
+
+        /** @brief Returns the buffers. */
+        inline const std::shared_ptr<const mesh_buffers>& data() const {
+            return buffers;
+        }
+
+        /** @returns true if both meshes use the same buffers. */
+        inline bool shares_buffers(const mesh& other) const {
+            return buffers == other.buffers;
+        }
+
+        /** @brief Returns the size of the buffers in bytes. */
+        std::size_t memory_bytes() const;
+};
+
+/** @returns The bounding box of triangle index of m. */
+inline aabb bounds(const mesh& m, std::size_t index) {
+    const shared_buffer<vec3f>& p = m.positions();
+    const vec3f& v0 = p[m.vertex_index(index, 0)];
+    const vec3f& v1 = p[m.vertex_index(index, 1)];
+    const vec3f& v2 = p[m.vertex_index(index, 2)];
+
+    return aabb(vec3_min(vec3_min(v0, v1), v2),
+                vec3_max(vec3_max(v0, v1), v2));
+}
+
+/** @returns The bounding boxes of the triangles of m, in order. */
+std::vector<aabb> primitive_bounds(const mesh& m);
+
+/**
+ * @brief Intersects a ray with triangle index of m, so that a BVH built
+ *        over primitive_bounds(m) can be traversed with the mesh.
+ *
+ * See the @ref triangle overload for the parameter semantics.
+ */
+inline bool intersect_primitive(const ray& r, const mesh& m,
+                                std::size_t index, float t_min, float& t) {
+    if (m.layout() == mesh_layout::precomputed)
+        return intersect(r, m.precomputed()[index], t_min, t);
+
+    return intersect(r, m.get_triangle(index), t_min, t);
+}
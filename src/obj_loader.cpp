@@ -0,0 +1,572 @@
+#include "obj_loader.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include <sys/resource.h>
+
+/** @brief Index of an attribute a face corner does not have. */
+static const std::uint32_t ABSENT = std::numeric_limits<std::uint32_t>::max();
+
+/** @brief Face corner: 0-based position, uv and normal indices. */
+struct obj_corner {
+    std::uint32_t position;
+    std::uint32_t uv;
+    std::uint32_t normal;
+};
+
+/** @brief Numbers of records in a chunk, or before it. */
+struct obj_counts {
+    std::size_t positions = 0;
+    std::size_t uvs = 0;
+    std::size_t normals = 0;
+    std::size_t triangles = 0;
+};
+
+/** @brief A range of lines of the file, parsed by one task. */
+struct obj_chunk {
+    const char* begin;
+    const char* end;
+
+    obj_counts counts;
+    obj_counts base;
+
+    /** @brief Every corner has a uv (normal). */
+    bool all_uvs = true;
+    bool all_normals = true;
+
+    /** @brief Every corner uses its position index for its uv and normal. */
+    bool aligned = true;
+
+    /** @brief usemtl records: first triangle and material name. */
+    std::vector<std::pair<std::size_t, std::string>> materials;
+    std::vector<std::string> libraries;
+};
+
+/** @brief Destination arrays of the second pass. */
+struct obj_arrays {
+    std::vector<vec3f> positions;
+    std::vector<texcoord> uvs;
+    std::vector<vec3f> normals;
+    std::vector<obj_corner> corners;
+};
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* skip_spaces(const char* p, const char* end) {
+    while (p < end && is_space(*p))
+        p++;
+
+    return p;
+}
+
+static const char* skip_token(const char* p, const char* end) {
+    while (p < end && !is_space(*p))
+        p++;
+
+    return p;
+}
+
+/** @returns The end of the line starting at p (its '\n' or end). */
+static const char* line_end(const char* p, const char* end) {
+    const void* newline = std::memchr(p, '\n', end - p);
+
+    return newline ? static_cast<const char*>(newline) : end;
+}
+
+/** @returns The end of the record of the line [p, end): its '#' or end. */
+static const char* record_end(const char* p, const char* end) {
+    const void* comment = std::memchr(p, '#', end - p);
+
+    return comment ? static_cast<const char*>(comment) : end;
+}
+
+/** @returns true if the token [first, last) is keyword. */
+static bool is_keyword(const char* first, const char* last,
+                       const char* keyword) {
+    const std::size_t length = std::strlen(keyword);
+
+    return std::size_t(last - first) == length &&
+           std::memcmp(first, keyword, length) == 0;
+}
+
+/** @brief Throws the std::runtime_error of the line starting at where. */
+static void fail(const std::string& path, const char* file_begin,
+                 const char* where, const char* what) {
+    std::size_t line = 1;
+
+    for (const char* p = file_begin; p < where; p++)
+        line += *p == '\n';
+
+    throw std::runtime_error(path + ":" + std::to_string(line) + ": " + what);
+}
+
+/** @brief Counts the records of a chunk (first pass). */
+static void count_chunk(obj_chunk& chunk) {
+    for (const char* line = chunk.begin; line < chunk.end;) {
+        const char* newline = line_end(line, chunk.end);
+        const char* last = record_end(line, newline);
+        const char* first = skip_spaces(line, last);
+        const char* token_end = skip_token(first, last);
+
+        if (is_keyword(first, token_end, "v")) {
+            chunk.counts.positions++;
+        } else if (is_keyword(first, token_end, "vt")) {
+            chunk.counts.uvs++;
+        } else if (is_keyword(first, token_end, "vn")) {
+            chunk.counts.normals++;
+        } else if (is_keyword(first, token_end, "f")) {
+            std::size_t corners = 0;
+
+            for (const char* p = skip_spaces(token_end, last); p < last;
+                 p = skip_spaces(skip_token(p, last), last))
+                corners++;
+
+            if (corners >= 3)
+                chunk.counts.triangles += corners - 2;
+        }
+
+        line = newline + 1;
+    }
+}
+
+/**
+ * @brief Parses the floats of a record into values.
+ *
+ * @returns The number of floats read, at most count.
+ */
+static std::size_t parse_floats(const char* p, const char* end,
+                                float* values, std::size_t count) {
+    std::size_t parsed = 0;
+
+    for (p = skip_spaces(p, end); p < end && parsed < count;
+         p = skip_spaces(p, end)) {
+        // from_chars rejects the '+' sign that some exporters write.
+        if (*p == '+')
+            p++;
+
+        const std::from_chars_result result =
+            std::from_chars(p, end, values[parsed]);
+
+        if (result.ec != std::errc() ||
+            (result.ptr < end && !is_space(*result.ptr)))
+            return parsed;
+
+        p = result.ptr;
+        parsed++;
+    }
+
+    return parsed;
+}
+
+/**
+ * @brief Resolves an OBJ index into a 0-based index.
+ *
+ * @param reference -> The 1-based, or negative relative, index
+ * @param defined -> The number of elements defined before the record
+ * @param total -> The number of elements in the file
+ *
+ * @returns The index, or ABSENT if it is out of range.
+ */
+static std::uint32_t resolve(long long reference, std::size_t defined,
+                             std::size_t total) {
+    long long index;
+
+    if (reference > 0)
+        index = reference - 1;
+    else
+        index = static_cast<long long>(defined) + reference;
+
+    if (reference == 0 || index < 0 || index >= static_cast<long long>(total))
+        return ABSENT;
+
+    return static_cast<std::uint32_t>(index);
+}
+
+/**
+ * @brief Parses a face corner "v", "v/vt", "v//vn" or "v/vt/vn".
+ *
+ * @returns false if the corner is malformed or out of range.
+ */
+static bool parse_corner(const char* p, const char* end,
+                         const obj_counts& defined, const obj_counts& total,
+                         obj_corner& corner) {
+    long long references[3] = { 0, 0, 0 };
+
+    for (int i = 0; i < 3 && p < end; i++) {
+        if (*p != '/') {
+            const std::from_chars_result result =
+                std::from_chars(p, end, references[i]);
+
+            if (result.ec != std::errc() || references[i] == 0)
+                return false;
+
+            p = result.ptr;
+        } else if (i == 0) {
+            return false;
+        }
+
+        if (p < end && *p != '/')
+            return false;
+
+        if (p < end)
+            p++;
+    }
+
+    corner.position = resolve(references[0], defined.positions,
+                              total.positions);
+    corner.uv = references[1] ? resolve(references[1], defined.uvs,
+                                        total.uvs) : ABSENT;
+    corner.normal = references[2] ? resolve(references[2], defined.normals,
+                                            total.normals) : ABSENT;
+
+    return corner.position != ABSENT &&
+           (references[1] == 0 || corner.uv != ABSENT) &&
+           (references[2] == 0 || corner.normal != ABSENT);
+}
+
+/** @brief Parses the records of a chunk into arrays (second pass). */
+static void parse_chunk(obj_chunk& chunk, const obj_counts& total,
+                        obj_arrays& arrays, const std::string& path,
+                        const char* file_begin) {
+    obj_counts defined = chunk.base;
+    std::vector<obj_corner> face;
+
+    for (const char* line = chunk.begin; line < chunk.end;) {
+        const char* newline = line_end(line, chunk.end);
+        const char* last = record_end(line, newline);
+        const char* first = skip_spaces(line, last);
+        const char* token_end = skip_token(first, last);
+
+        float values[3] = { 0, 0, 0 };
+
+        if (is_keyword(first, token_end, "v")) {
+            if (parse_floats(token_end, last, values, 3) != 3)
+                fail(path, file_begin, line, "malformed v record");
+
+            arrays.positions[defined.positions++] =
+                vec3f(values[0], values[1], values[2]);
+        } else if (is_keyword(first, token_end, "vt")) {
+            if (parse_floats(token_end, last, values, 2) < 1)
+                fail(path, file_begin, line, "malformed vt record");
+
+            arrays.uvs[defined.uvs++] = { values[0], values[1] };
+        } else if (is_keyword(first, token_end, "vn")) {
+            if (parse_floats(token_end, last, values, 3) != 3)
+                fail(path, file_begin, line, "malformed vn record");
+
+            arrays.normals[defined.normals++] =
+                vec3f(values[0], values[1], values[2]);
+        } else if (is_keyword(first, token_end, "f")) {
+            face.clear();
+
+            for (const char* p = skip_spaces(token_end, last); p < last;) {
+                const char* corner_end = skip_token(p, last);
+                obj_corner corner;
+
+                if (!parse_corner(p, corner_end, defined, total, corner))
+                    fail(path, file_begin, line,
+                         "malformed or out of range face index");
+
+                chunk.all_uvs = chunk.all_uvs && corner.uv != ABSENT;
+                chunk.all_normals = chunk.all_normals &&
+                                    corner.normal != ABSENT;
+                chunk.aligned = chunk.aligned &&
+                    (corner.uv == ABSENT || corner.uv == corner.position) &&
+                    (corner.normal == ABSENT ||
+                     corner.normal == corner.position);
+
+                face.push_back(corner);
+                p = skip_spaces(corner_end, last);
+            }
+
+            for (std::size_t i = 1; i + 1 < face.size(); i++) {
+                obj_corner* triangle =
+                    &arrays.corners[3 * defined.triangles++];
+
+                triangle[0] = face[0];
+                triangle[1] = face[i];
+                triangle[2] = face[i + 1];
+            }
+        } else if (is_keyword(first, token_end, "usemtl")) {
+            const char* name = skip_spaces(token_end, last);
+            const char* name_end = last;
+
+            while (name_end > name && is_space(name_end[-1]))
+                name_end--;
+
+            chunk.materials.push_back({ defined.triangles,
+                                        std::string(name, name_end) });
+        } else if (is_keyword(first, token_end, "mtllib")) {
+            for (const char* p = skip_spaces(token_end, last); p < last;
+                 p = skip_spaces(skip_token(p, last), last))
+                chunk.libraries.push_back(std::string(p,
+                                                      skip_token(p, last)));
+        }
+
+        line = newline + 1;
+    }
+}
+
+/** @brief Appends the materials of an MTL library. Ignores missing files. */
+static void load_mtl(const std::string& path,
+                     std::vector<obj_material>& materials) {
+    std::ifstream file(path);
+    std::string line;
+
+    while (std::getline(file, line)) {
+        std::istringstream record(line);
+        std::string keyword;
+
+        if (!(record >> keyword))
+            continue;
+
+        if (keyword == "newmtl") {
+            materials.push_back(obj_material());
+            record >> materials.back().name;
+            continue;
+        }
+
+        if (materials.empty())
+            continue;
+
+        obj_material& material = materials.back();
+        float r = 0, g = 0, b = 0;
+
+        if (keyword == "Kd" && record >> r >> g >> b)
+            material.diffuse = colorf(r, g, b);
+        else if (keyword == "Ks" && record >> r >> g >> b)
+            material.specular = colorf(r, g, b);
+        else if (keyword == "Ke" && record >> r >> g >> b)
+            material.emission = colorf(r, g, b);
+        else if (keyword == "Ns")
+            record >> material.shininess;
+        else if (keyword == "d")
+            record >> material.opacity;
+        else if (keyword == "Tr" && record >> r)
+            material.opacity = 1 - r;
+        else if (keyword == "map_Kd")
+            record >> material.diffuse_map;
+    }
+}
+
+/** @brief Hash of a corner, for merging the distinct corners. */
+struct obj_corner_hash {
+    std::size_t operator()(const std::array<std::uint32_t, 3>& c) const {
+        std::uint64_t h = c[0];
+
+        h = h * 0x9e3779b97f4a7c15ull ^ c[1];
+        h = h * 0x9e3779b97f4a7c15ull ^ c[2];
+
+        return static_cast<std::size_t>(h ^ (h >> 32));
+    }
+};
+
+/** @brief Builds the mesh from the parsed arrays. */
+static mesh make_mesh(obj_arrays& arrays, bool all_uvs, bool all_normals,
+                      bool aligned, mesh_layout layout) {
+    const std::size_t vertex_count = arrays.positions.size();
+
+    // Attributes are kept only if every corner has one.
+    const bool uvs = all_uvs && !arrays.uvs.empty();
+    const bool normals = all_normals && !arrays.normals.empty();
+
+    std::vector<std::uint32_t> indices(arrays.corners.size());
+
+    if (aligned && (!uvs || arrays.uvs.size() == vertex_count) &&
+        (!normals || arrays.normals.size() == vertex_count)) {
+        for (std::size_t i = 0; i < arrays.corners.size(); i++)
+            indices[i] = arrays.corners[i].position;
+
+        return mesh(std::move(arrays.positions), indices,
+                    normals ? std::move(arrays.normals)
+                            : std::vector<vec3f>(),
+                    uvs ? std::move(arrays.uvs) : std::vector<texcoord>(),
+                    layout);
+    }
+
+    std::unordered_map<std::array<std::uint32_t, 3>, std::uint32_t,
+                       obj_corner_hash> vertices;
+    std::vector<vec3f> positions;
+    std::vector<vec3f> merged_normals;
+    std::vector<texcoord> merged_uvs;
+
+    vertices.reserve(vertex_count);
+
+    for (std::size_t i = 0; i < arrays.corners.size(); i++) {
+        const obj_corner& c = arrays.corners[i];
+        const std::array<std::uint32_t, 3> key = {
+            c.position, uvs ? c.uv : ABSENT, normals ? c.normal : ABSENT
+        };
+
+        const auto inserted = vertices.emplace(
+            key, static_cast<std::uint32_t>(positions.size()));
+
+        if (inserted.second) {
+            positions.push_back(arrays.positions[c.position]);
+
+            if (uvs)
+                merged_uvs.push_back(arrays.uvs[c.uv]);
+
+            if (normals)
+                merged_normals.push_back(arrays.normals[c.normal]);
+        }
+
+        indices[i] = inserted.first->second;
+    }
+
+    return mesh(std::move(positions), indices, std::move(merged_normals),
+                std::move(merged_uvs), layout);
+}
+
+obj_scene load_obj(const std::string& path, scheduler& pool,
+                   const obj_load_settings& settings) {
+    if (settings.chunk_size == 0)
+        throw std::invalid_argument("load_obj: chunk_size must be positive");
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const mapped_file file(path);
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+
+    std::vector<obj_chunk> chunks;
+
+    for (const char* p = begin; p < end;) {
+        const char* chunk_end = static_cast<std::size_t>(end - p) >
+                                settings.chunk_size
+                              ? line_end(p + settings.chunk_size, end) : end;
+
+        if (chunk_end < end)
+            chunk_end++;
+
+        obj_chunk chunk;
+        chunk.begin = p;
+        chunk.end = chunk_end;
+        chunks.push_back(std::move(chunk));
+
+        p = chunk_end;
+    }
+
+    pool.parallel_for(0, chunks.size(), 1,
+                      [&](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; i++)
+            count_chunk(chunks[i]);
+    });
+
+    obj_counts total;
+
+    for (obj_chunk& chunk : chunks) {
+        chunk.base = total;
+
+        total.positions += chunk.counts.positions;
+        total.uvs += chunk.counts.uvs;
+        total.normals += chunk.counts.normals;
+        total.triangles += chunk.counts.triangles;
+    }
+
+    obj_arrays arrays;
+    arrays.positions.resize(total.positions);
+    arrays.uvs.resize(total.uvs);
+    arrays.normals.resize(total.normals);
+    arrays.corners.resize(3 * total.triangles);
+
+    pool.parallel_for(0, chunks.size(), 1,
+                      [&](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; i++)
+            parse_chunk(chunks[i], total, arrays, path, begin);
+    });
+
+    bool all_uvs = true;
+    bool all_normals = true;
+    bool aligned = true;
+
+    for (const obj_chunk& chunk : chunks) {
+        all_uvs = all_uvs && chunk.all_uvs;
+        all_normals = all_normals && chunk.all_normals;
+        aligned = aligned && chunk.aligned;
+    }
+
+    obj_scene scene;
+    scene.geometry = make_mesh(arrays, all_uvs, all_normals, aligned,
+                               settings.layout);
+
+    // The materials: a default one, then the libraries in order.
+    scene.materials.push_back(obj_material());
+
+    const std::size_t separator = path.find_last_of('/');
+    const std::string directory = separator == std::string::npos
+                                ? "" : path.substr(0, separator + 1);
+
+    for (const obj_chunk& chunk : chunks)
+        for (const std::string& library : chunk.libraries)
+            load_mtl(library[0] == '/' ? library : directory + library,
+                     scene.materials);
+
+    std::unordered_map<std::string, std::uint32_t> material_index;
+
+    for (std::size_t i = scene.materials.size(); i-- > 1;)
+        material_index[scene.materials[i].name] =
+            static_cast<std::uint32_t>(i);
+
+    scene.triangle_materials.assign(total.triangles, 0);
+
+    std::size_t next = 0;
+    std::uint32_t current = 0;
+
+    for (const obj_chunk& chunk : chunks)
+        for (const auto& change : chunk.materials) {
+            std::fill(scene.triangle_materials.begin() + next,
+                      scene.triangle_materials.begin() + change.first,
+                      current);
+
+            const auto found = material_index.find(change.second);
+
+            if (found == material_index.end()) {
+                current = static_cast<std::uint32_t>(scene.materials.size());
+                material_index[change.second] = current;
+
+                scene.materials.push_back(obj_material());
+                scene.materials.back().name = change.second;
+            } else {
+                current = found->second;
+            }
+
+            next = change.first;
+        }
+
+    std::fill(scene.triangle_materials.begin() + next,
+              scene.triangle_materials.end(), current);
+
+    scene.stats.bytes = file.size();
+    scene.stats.chunks = chunks.size();
+    scene.stats.seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    scene.stats.megabytes_per_second = scene.stats.seconds > 0
+        ? file.size() / 1e6 / scene.stats.seconds : 0;
+    scene.stats.peak_memory_bytes = peak_memory_bytes();
+
+    return scene;
+}
+
+std::size_t peak_memory_bytes() {
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+    // Linux reports kilobytes.
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+}
@@ -0,0 +1,105 @@
+/** @file obj_loader.h */
+
+#pragma once
+
+#include "mesh.h"
+#include "scheduler.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** @brief Material of a Wavefront MTL library. */
+struct obj_material {
+    std::string name;
+    colorf diffuse = colorf(0.8f, 0.8f, 0.8f);
+    colorf specular = colorf(0, 0, 0);
+    colorf emission = colorf(0, 0, 0);
+    float shininess = 0;
+    float opacity = 1;
+    std::string diffuse_map;
+};
+
+/** @brief Parameters of @ref load_obj. */
+struct obj_load_settings {
+    /**
+     * @brief Approximate size of the chunks parsed in parallel. The
+     *        chunks end at line boundaries. At least 1.
+     */
+    std::size_t chunk_size = 1 << 20;
+
+    /** @brief Storage layout of the loaded mesh. */
+    mesh_layout layout = mesh_layout::compact;
+};
+
+/** @brief Statistics of @ref load_obj. */
+struct obj_load_stats {
+    /** @brief Size of the OBJ file. */
+    std::size_t bytes = 0;
+
+    /** @brief Number of chunks parsed in parallel. */
+    std::size_t chunks = 0;
+
+    /** @brief Wall time of the load, MTL libraries included. */
+    double seconds = 0;
+
+    /** @brief Parse throughput: bytes / seconds, in MB/s. */
+    double megabytes_per_second = 0;
+
+    /**
+     * @brief Peak resident memory of the process at the end of the load.
+     *        The mapped file counts only for the pages read.
+     */
+    std::size_t peak_memory_bytes = 0;
+};
+
+/** @brief The contents of an OBJ file. */
+struct obj_scene {
+    mesh geometry;
+
+    /**
+     * @brief The materials. The first one is the default material of
+     *        triangles without usemtl; usemtl of an unknown name adds a
+     *        default material of that name.
+     */
+    std::vector<obj_material> materials;
+
+    /** @brief The material of every triangle of geometry. */
+    std::vector<std::uint32_t> triangle_materials;
+
+    obj_load_stats stats;
+};
+
+/**
+ * @brief Loads a Wavefront OBJ file and its MTL libraries.
+ *
+ * The file is memory-mapped and split into chunks at line boundaries.
+ * A first parallel pass counts the records of every chunk. A second
+ * parallel pass parses the v, vt, vn and f records straight into the
+ * final arrays, at offsets given by the counts. Polygons are
+ * triangulated as fans. Negative (relative) indices are supported.
+ *
+ * Faces whose corners all use the same index for the position, uv and
+ * normal map directly onto the mesh. Otherwise the distinct corners are
+ * merged into new vertices. Normals and uvs are kept only if every
+ * corner has one. Line continuations, lines and points are not
+ * supported; other records (o, g, s, ...) are ignored.
+ *
+ * @param path -> The path of the OBJ file. mtllib paths are relative to
+ *                its directory. Missing libraries are ignored.
+ * @param pool -> The scheduler the chunks are parsed on
+ * @param settings -> The loader parameters
+ *
+ * @throws std::runtime_error if the file cannot be read, or on a
+ *         malformed record or out of range index (with its line).
+ * @throws std::invalid_argument if settings.chunk_size is 0.
+ */
+obj_scene load_obj(const std::string& path, scheduler& pool,
+                   const obj_load_settings& settings = obj_load_settings());
+
+/**
+ * @brief Returns the peak resident memory of the process so far, in
+ *        bytes, or 0 if it is not available.
+ */
+std::size_t peak_memory_bytes();
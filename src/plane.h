@@ -0,0 +1,64 @@
+/** @file plane.h */
+
+#pragma once
+
+#include "ray.h"
+
+/**
+ * @class plane
+ * @brief Infinite plane of the points p with dot(normal, p) == distance.
+ */
+class plane {
+    private:
+        vec3f n;
+        float d;
+
+    public:
+        /**
+         * @brief Constructs the plane.
+         *
+         * @param normal -> The plane normal
+         * @param distance -> The signed distance from the origin, in
+         *                    multiples of the normal length
+         */
+        plane(const vec3f& normal, float distance) : n(normal), d(distance) {}
+
+        /** @brief Returns the plane normal. */
+        inline const vec3f& normal() const {
+            return n;
+        }
+
+        /** @brief Returns the signed distance from the origin. */
+        inline float distance() const {
+            return d;
+        }
+};
+
+/**
+ * @brief Intersects a ray with a plane.
+ *
+ * @param r -> The ray
+ * @param p -> The plane
+ * @param t_min -> The smallest accepted hit distance
+ * @param t -> On input, the largest accepted hit distance. On a hit, it
+ *             is set to the distance of the intersection.
+ *
+ * @returns true if the ray hits the plane in (t_min, t), false otherwise.
+ *          Rays parallel to the plane never hit.
+ */
+inline bool intersect(const ray& r, const plane& p, float t_min, float& t) {
+    const float denominator = dot(p.normal(), r.direction());
+
+    if (denominator == 0)
+        return false;
+
+    const float candidate = (p.distance() - dot(p.normal(), r.origin())) /
+                            denominator;
+
+    if (candidate <= t_min || candidate >= t)
+        return false;
+
+    t = candidate;
+
+    return true;
+}
@@ -0,0 +1,254 @@
+#include "quantize.h"
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+/** @brief Number of buckets of the sRGB encoding table. */
+static const std::size_t SRGB_TABLE_SIZE = 4096;
+
+/** @returns The exactly rounded 8-bit sRGB encoding of linear in [0, 1]. */
+static unsigned srgb_reference(double linear) {
+    const double encoded = linear <= 0.0031308
+                         ? 12.92 * linear
+                         : 1.055 * std::pow(linear, 1 / 2.4) - 0.055;
+
+    return static_cast<unsigned>(std::nearbyint(encoded * 255.0));
+}
+
+/**
+ * @brief Exact 8-bit sRGB encoding by table lookup.
+ *
+ * Linear [0, 1] is cut into SRGB_TABLE_SIZE buckets, index
+ * trunc(v * 4095). The encoding rises by less than one code per bucket
+ * (at most 12.92 * 255 / 4095), so a bucket holds at most one code
+ * boundary: code of v = lowest code of its bucket, plus one if v reaches
+ * the smallest float encoded as the next code.
+ */
+struct srgb_encoder {
+    /** @brief Code of the smallest float of every bucket. */
+    std::array<unsigned char, SRGB_TABLE_SIZE> codes;
+
+    /** @brief thresholds[k]: smallest float encoded as k or more. */
+    std::array<float, 257> thresholds;
+
+    /** @returns The code of v in [0, 1], in bucket. */
+    inline unsigned char encode(float v, std::int32_t bucket) const {
+        const unsigned char code = codes[bucket];
+
+        return static_cast<unsigned char>(code + (v >= thresholds[code + 1]));
+    }
+};
+
+/** @returns The sRGB encoder. Built on first use. */
+static const srgb_encoder& srgb_table() {
+    static const srgb_encoder encoder = [] {
+        srgb_encoder table;
+
+        auto code = [](float v) { return srgb_reference(v); };
+
+        table.thresholds[0] = 0.0f;
+        table.thresholds[256] = std::numeric_limits<float>::infinity();
+
+        for (unsigned k = 1; k < 256; k++) {
+            // The inverse of the encoding at k - 0.5, then the exact float.
+            const double encoded = (k - 0.5) / 255.0;
+            const double linear = encoded <= 12.92 * 0.0031308
+                                ? encoded / 12.92
+                                : std::pow((encoded + 0.055) / 1.055, 2.4);
+
+            float t = static_cast<float>(linear);
+
+            while (code(t) < k)
+                t = std::nextafter(t, 2.0f);
+
+            while (t > 0.0f && code(std::nextafter(t, -1.0f)) >= k)
+                t = std::nextafter(t, -1.0f);
+
+            table.thresholds[k] = t;
+        }
+
+        for (std::size_t b = 0; b < SRGB_TABLE_SIZE; b++) {
+            // The smallest float of the bucket.
+            const float scale = float(SRGB_TABLE_SIZE - 1);
+            float v = static_cast<float>(double(b) / (SRGB_TABLE_SIZE - 1));
+
+            while (static_cast<std::size_t>(v * scale) < b)
+                v = std::nextafter(v, 2.0f);
+
+            while (v > 0.0f &&
+                   static_cast<std::size_t>(std::nextafter(v, -1.0f) *
+                                            scale) >= b)
+                v = std::nextafter(v, -1.0f);
+
+            table.codes[b] = static_cast<unsigned char>(code(v));
+        }
+
+        return table;
+    }();
+
+    return encoder;
+}
+
+/** @returns v clamped to [0, 1], with NaN mapped to 0. */
+static inline float saturate(float v) {
+    return v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f;
+}
+
+/** @returns The 8-bit code of one component. */
+static inline unsigned char quantize_component(float v,
+                                               transfer_function transfer) {
+    if (transfer == transfer_function::srgb) {
+        const float clamped = saturate(v);
+
+        return srgb_table().encode(clamped, static_cast<std::int32_t>(
+            clamped * float(SRGB_TABLE_SIZE - 1)));
+    }
+
+    return static_cast<unsigned char>(std::nearbyint(saturate(v) * 255.0f));
+}
+
+/** @brief Scalar conversion of count pixels. */
+static void quantize_scalar(const colorf* in, std::size_t count,
+                            unsigned char* out, std::size_t stride,
+                            transfer_function transfer) {
+    for (std::size_t i = 0; i < count; i++) {
+        out[0] = quantize_component(in[i].x(), transfer);
+        out[1] = quantize_component(in[i].y(), transfer);
+        out[2] = quantize_component(in[i].z(), transfer);
+
+        if (stride == 4)
+            out[3] = 255;
+
+        out += stride;
+    }
+}
+
+#ifdef RAYSTALKER_SIMD
+
+/**
+ * @returns The four pixels packed as r, g, b, x bytes (x unspecified).
+ *
+ * The components are clamped, scaled by scale and converted with the
+ * current (round to nearest) rounding mode, then narrowed to bytes with
+ * saturating packs.
+ */
+static inline __m128i pack_four(const colorf* in, __m128 scale) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    __m128i q[4];
+
+    for (int i = 0; i < 4; i++) {
+        // _mm_max_ps returns its second operand for NaN input.
+        const __m128 clamped = _mm_min_ps(_mm_max_ps(in[i].sse(), zero), one);
+
+        q[i] = _mm_cvtps_epi32(_mm_mul_ps(clamped, scale));
+    }
+
+    return _mm_packus_epi16(_mm_packs_epi32(q[0], q[1]),
+                            _mm_packs_epi32(q[2], q[3]));
+}
+
+/**
+ * @brief Writes the clamped components of four pixels and their sRGB
+ *        table buckets, 4 per pixel.
+ */
+static inline void srgb_buckets(const colorf* in, float* clamped,
+                                std::int32_t* buckets) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(float(SRGB_TABLE_SIZE - 1));
+
+    for (int i = 0; i < 4; i++) {
+        const __m128 v = _mm_min_ps(_mm_max_ps(in[i].sse(), zero), one);
+
+        _mm_storeu_ps(clamped + 4 * i, v);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(buckets + 4 * i),
+                         _mm_cvttps_epi32(_mm_mul_ps(v, scale)));
+    }
+}
+
+/** @brief Stores 4 packed r, g, b, x pixels in format. */
+static inline void store_four(__m128i pixels, unsigned char* out,
+                              pixel_format format) {
+    if (format == pixel_format::rgba8) {
+        const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                         _mm_or_si128(pixels, alpha));
+        return;
+    }
+
+#ifdef __SSSE3__
+    const __m128i drop_alpha = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10,
+                                             12, 13, 14, -1, -1, -1, -1);
+    alignas(16) unsigned char packed[16];
+
+    _mm_store_si128(reinterpret_cast<__m128i*>(packed),
+                    _mm_shuffle_epi8(pixels, drop_alpha));
+    std::memcpy(out, packed, 12);
+#else
+    alignas(16) unsigned char packed[16];
+
+    _mm_store_si128(reinterpret_cast<__m128i*>(packed), pixels);
+
+    for (int i = 0; i < 4; i++)
+        std::memcpy(out + 3 * i, packed + 4 * i, 3);
+#endif
+}
+
+#endif // RAYSTALKER_SIMD
+
+void quantize_row(const colorf* in, std::size_t count, unsigned char* out,
+                  pixel_format format, transfer_function transfer) {
+    const std::size_t stride = bytes_per_pixel(format);
+    std::size_t i = 0;
+
+#ifdef RAYSTALKER_SIMD
+    if (transfer == transfer_function::linear) {
+        const __m128 scale = _mm_set1_ps(255.0f);
+
+        for (; i + 4 <= count; i += 4)
+            store_four(pack_four(in + i, scale), out + i * stride, format);
+    } else {
+        const srgb_encoder& table = srgb_table();
+        alignas(16) float clamped[16];
+        alignas(16) std::int32_t buckets[16];
+
+        for (; i + 4 <= count; i += 4) {
+            srgb_buckets(in + i, clamped, buckets);
+
+            unsigned char* pixel = out + i * stride;
+
+            for (int p = 0; p < 4; p++) {
+                for (int c = 0; c < 3; c++)
+                    pixel[c] = table.encode(clamped[4 * p + c],
+                                            buckets[4 * p + c]);
+
+                if (stride == 4)
+                    pixel[3] = 255;
+
+                pixel += stride;
+            }
+        }
+    }
+#endif
+
+    quantize_scalar(in + i, count - i, out + i * stride, stride, transfer);
+}
+
+std::vector<unsigned char> quantize(const framebuffer& frame,
+                                    pixel_format format,
+                                    transfer_function transfer) {
+    const std::size_t row_bytes = frame.width() * bytes_per_pixel(format);
+    std::vector<unsigned char> image(row_bytes * frame.height());
+
+    for (std::size_t y = 0; y < frame.height(); y++)
+        quantize_row(frame.row(y), frame.width(), image.data() + y * row_bytes,
+                     format, transfer);
+
+    return image;
+}
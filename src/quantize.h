@@ -0,0 +1,55 @@
+/** @file quantize.h */
+
+#pragma once
+
+#include "framebuffer.h"
+
+#include <cstddef>
+#include <vector>
+
+/** @brief Layout of a quantized pixel. */
+enum class pixel_format {
+    rgb8,   /**< 3 bytes per pixel: r, g, b */
+    rgba8   /**< 4 bytes per pixel: r, g, b, a (a is always 255) */
+};
+
+/** @brief Transfer function applied before quantization. */
+enum class transfer_function {
+    linear, /**< Components are quantized as they are. */
+    srgb    /**< Components are sRGB-encoded first (IEC 61966-2-1). */
+};
+
+/** @returns The number of bytes of a pixel in format. */
+inline std::size_t bytes_per_pixel(pixel_format format) {
+    return format == pixel_format::rgb8 ? 3 : 4;
+}
+
+/**
+ * @brief Quantizes a contiguous row of colorf samples to 8-bit pixels.
+ *
+ * Each component is clamped to [0, 1] (NaN becomes 0), optionally
+ * sRGB-encoded, scaled to [0, 255] and rounded to nearest (ties to even).
+ * The sRGB encoding is exact: a 4096-bucket table gives the code of the
+ * bucket and one threshold comparison the code of the value.
+ * With SSE2 four pixels are converted per iteration with packed
+ * min/max, cvtps2dq and saturating packs.
+ *
+ * @param in -> The samples
+ * @param count -> The number of samples
+ * @param out -> Destination of count * bytes_per_pixel(format) bytes
+ * @param format -> The output pixel layout
+ * @param transfer -> The transfer function
+ */
+void quantize_row(const colorf* in, std::size_t count, unsigned char* out,
+                  pixel_format format, 
+                  transfer_function transfer = transfer_function::linear);
+
+/**
+ * @brief Quantizes a whole framebuffer, row by row.
+ *
+ * @returns The packed image, rows top to bottom without padding.
+ */
+std::vector<unsigned char> quantize(const framebuffer& frame, 
+                                    pixel_format format,
+                                    transfer_function transfer = 
+                                        transfer_function::linear);
@@ -0,0 +1,180 @@
+/** @file random.h */
+
+#pragma once
+
+#include "vec3.h"
+
+#include <cmath>
+#include <cstdint>
+
+/**
+ * @class pcg32
+ * @brief PCG32 (XSH RR 64/32) generator of O'Neill.
+ *
+ * 16 bytes of state and a few instructions per number. Every seed
+ * selects a position in the sequence and every stream a different
+ * sequence, so generators can be created on the fly (see
+ * @ref pixel_random) instead of being shared between threads.
+ */
+class pcg32 {
+    private:
+        static constexpr std::uint64_t multiplier = 6364136223846793005ull;
+
+        std::uint64_t state = 0;
+        std::uint64_t increment;
+
+    public:
+        /**
+         * @brief Seeds the generator, as pcg32_srandom_r does.
+         *
+         * @param seed -> The initial state
+         * @param stream -> The sequence. Only the low 63 bits are used.
+         */
+        explicit pcg32(std::uint64_t seed = 0x853c49e6748fea9bull,
+                       std::uint64_t stream = 0xda3e39cb94b95bdbull)
+            : increment((stream << 1) | 1) {
+            next();
+            state += seed;
+            next();
+        }
+
+        /** @returns The next 32 uniformly distributed bits. */
+        inline std::uint32_t next() {
+            const std::uint64_t old = state;
+            state = old * multiplier + increment;
+
+            const std::uint32_t shifted =
+                static_cast<std::uint32_t>(((old >> 18) ^ old) >> 27);
+            const std::uint32_t rotation =
+                static_cast<std::uint32_t>(old >> 59);
+
+            return (shifted >> rotation) | (shifted << ((32 - rotation) & 31));
+        }
+
+        /** @returns A uniformly distributed float in [0, 1). */
+        inline float next_float() {
+            // 24 bits: every value is exactly representable.
+            return (next() >> 8) * (1.0f / 16777216.0f);
+        }
+};
+
+/**
+ * @brief Mixes the bits of value (the splitmix64 finalizer).
+ *
+ * A bijection in which every input bit affects every output bit, so
+ * that nearby inputs (neighbouring pixels) give unrelated outputs.
+ */
+inline std::uint64_t hash64(std::uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+
+    return value ^ (value >> 31);
+}
+
+/**
+ * @brief Returns the generator of sample of pixel (x, y).
+ *
+ * The generator only depends on its arguments, never on which thread
+ * renders the pixel or in which order, so renders are reproducible bit
+ * for bit whatever the tile scheduling.
+ *
+ * @param x -> The pixel column
+ * @param y -> The pixel row
+ * @param sample -> The sample index of the pixel
+ * @param seed -> The seed of the render (e.g. the frame number)
+ */
+inline pcg32 pixel_random(std::uint32_t x, std::uint32_t y,
+                          std::uint32_t sample, std::uint64_t seed = 0) {
+    const std::uint64_t pixel = (std::uint64_t(y) << 32) | x;
+
+    return pcg32(hash64(pixel ^ hash64(seed)), sample);
+}
+
+/**
+ * @brief Maps two uniform numbers in [0, 1) to a uniformly distributed
+ *        direction on the unit sphere.
+ */
+inline vec3f sample_sphere(float u1, float u2) {
+    const float z = 1 - 2 * u1;
+    const float r = std::sqrt(std::fmax(0.0f, 1 - z * z));
+    const float phi = 6.28318531f * u2;  // 2 pi u2
+
+    return vec3f(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+/**
+ * @brief Maps two uniform numbers in [0, 1) to a uniformly distributed
+ *        direction on the hemisphere around +z.
+ */
+inline vec3f sample_hemisphere(float u1, float u2) {
+    const float z = 1 - u1;
+    const float r = std::sqrt(std::fmax(0.0f, 1 - z * z));
+    const float phi = 6.28318531f * u2;  // 2 pi u2
+
+    return vec3f(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+/**
+ * @brief Maps two uniform numbers in [0, 1) to a cosine distributed
+ *        direction on the hemisphere around +z (density cos(theta) / pi).
+ */
+inline vec3f sample_cosine_hemisphere(float u1, float u2) {
+    const float r = std::sqrt(u1);
+    const float phi = 6.28318531f * u2;  // 2 pi u2
+
+    return vec3f(r * std::cos(phi), r * std::sin(phi),
+                 std::sqrt(std::fmax(0.0f, 1 - u1)));
+}
+
+/**
+ * @brief Builds an orthonormal basis (tangent, bitangent, normal).
+ *
+ * Branchless construction of Duff et al., "Building an Orthonormal
+ * Basis, Revisited" (2017).
+ *
+ * @param normal -> The unit normal
+ * @param tangent -> Set to the first tangent
+ * @param bitangent -> Set to the second tangent
+ */
+inline void orthonormal_basis(const vec3f& normal, vec3f& tangent,
+                              vec3f& bitangent) {
+    const float sign = std::copysign(1.0f, normal.z());
+    const float a = -1 / (sign + normal.z());
+    const float b = normal.x() * normal.y() * a;
+
+    tangent = vec3f(1 + sign * normal.x() * normal.x() * a, sign * b,
+                    -sign * normal.x());
+    bitangent = vec3f(b, sign + normal.y() * normal.y() * a, -normal.y());
+}
+
+/** @returns local, given in the basis around normal (+z), in world space. */
+inline vec3f to_world(const vec3f& normal, const vec3f& local) {
+    vec3f tangent;
+    vec3f bitangent;
+
+    orthonormal_basis(normal, tangent, bitangent);
+
+    return tangent * local.x() + bitangent * local.y() + normal * local.z();
+}
+
+/** @returns A uniformly distributed direction on the unit sphere. */
+inline vec3f sample_sphere(pcg32& random) {
+    const float u1 = random.next_float();
+
+    return sample_sphere(u1, random.next_float());
+}
+
+/** @returns A uniformly distributed direction around the unit normal. */
+inline vec3f sample_hemisphere(pcg32& random, const vec3f& normal) {
+    const float u1 = random.next_float();
+
+    return to_world(normal, sample_hemisphere(u1, random.next_float()));
+}
+
+/** @returns A cosine distributed direction around the unit normal. */
+inline vec3f sample_cosine_hemisphere(pcg32& random, const vec3f& normal) {
+    const float u1 = random.next_float();
+
+    return to_world(normal, sample_cosine_hemisphere(u1,
+                                                     random.next_float()));
+}
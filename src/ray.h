@@ -0,0 +1,46 @@
+/** @file ray.h */
+
+#pragma once
+
+#include "vec3.h"
+
+/**
+ * @class ray
+ * @brief A half-line defined by an origin and a direction.
+ *
+ * The direction is not required to be normalized; hit distances are
+ * expressed in multiples of the direction length.
+ */
+class ray {
+    private:
+        vec3f orig;
+        vec3f dir;
+
+    public:
+        /** @brief Default constructs a degenerate ray at the origin. */
+        ray() {}
+
+        /**
+         * @brief Constructs the ray.
+         *
+         * @param origin -> The ray origin
+         * @param direction -> The ray direction
+         */
+        ray(const vec3f& origin, const vec3f& direction)
+            : orig(origin), dir(direction) {}
+
+        /** @brief Returns the ray origin. */
+        inline const vec3f& origin() const {
+            return orig;
+        }
+
+        /** @brief Returns the ray direction. */
+        inline const vec3f& direction() const {
+            return dir;
+        }
+
+        /** @returns The point origin + t * direction. */
+        inline vec3f point_at(float t) const {
+            return orig + dir * t;
+        }
+};
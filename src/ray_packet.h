@@ -0,0 +1,239 @@
+/** @file ray_packet.h */
+
+#pragma once
+
+#include "plane.h"
+#include "sphere.h"
+#include "triangle.h"
+#include "vec3_soa.h"
+
+#include <array>
+#include <cstdint>
+
+/**
+ * @brief Bit mask of packet lanes. Bit i set means lane i is active / hit.
+ */
+typedef std::uint32_t packet_mask;
+
+/**
+ * @class ray_packet
+ * @brief N coherent rays whose origins and directions are stored SoA.
+ *
+ * The packet intersection kernels below process all N lanes with
+ * branch-free lane-wise loops over the component streams, so a packet of
+ * 8 (AVX2) or 16 (AVX-512) rays is tested against a primitive in one
+ * SIMD pass.
+ *
+ * @tparam N The number of lanes. At most 32 (the width of packet_mask).
+ */
+template <std::size_t N>
+class ray_packet {
+    static_assert(N > 0 && N <= 32, "ERROR: ray_packet supports 1-32 lanes.");
+
+    private:
+        vec3f_soa<N> orig;
+        vec3f_soa<N> dir;
+
+    public:
+        /** @brief Mask with every lane active. */
+        static constexpr packet_mask all_lanes =
+            N == 32 ? ~packet_mask(0) : (packet_mask(1) << N) - 1;
+
+        /** @brief Returns the origins of the rays. */
+        inline const vec3f_soa<N>& origins() const {
+            return orig;
+        }
+
+        /** @brief Returns the directions of the rays. */
+        inline const vec3f_soa<N>& directions() const {
+            return dir;
+        }
+
+        /** @returns The ray stored in the lane index. */
+        inline ray get(std::size_t index) const {
+            return ray(orig.get(index), dir.get(index));
+        }
+
+        /** @brief Stores r in the lane index. */
+        inline void set(std::size_t index, const ray& r) {
+            orig.set(index, r.origin());
+            dir.set(index, r.direction());
+        }
+};
+
+/**
+ * @brief Per-lane closest hit distances of a packet.
+ *
+ * Kernels read it as the per-lane t_max and lower it on every hit, so
+ * a packet can be tested against several primitives in sequence.
+ */
+template <std::size_t N>
+using packet_distances = std::array<float, N>;
+
+/**
+ * @brief Collapses per-lane hit flags into a packet_mask.
+ */
+template <std::size_t N>
+inline packet_mask packet_mask_from(const std::array<std::int32_t, N>& hits) {
+    packet_mask mask = 0;
+
+    for (std::size_t i = 0; i < N; i++)
+        mask |= packet_mask(hits[i] & 1) << i;
+
+    return mask;
+}
+
+/**
+ * @brief Intersects a ray packet with a sphere.
+ *
+ * @param rays -> The packet
+ * @param s -> The sphere
+ * @param active -> The lanes to test. Inactive lanes are never hit and
+ *                  their distances are left untouched.
+ * @param t_min -> The smallest accepted hit distance
+ * @param t -> Per-lane largest accepted hit distances. Updated for every
+ *             lane that hits.
+ *
+ * @returns The mask of the lanes that hit the sphere in (t_min, t).
+ */
+template <std::size_t N>
+packet_mask intersect(const ray_packet<N>& rays, const sphere& s,
+                      packet_mask active, float t_min,
+                      packet_distances<N>& t) {
+    const float* ox = rays.origins().data(0);
+    const float* oy = rays.origins().data(1);
+    const float* oz = rays.origins().data(2);
+    const float* dx = rays.directions().data(0);
+    const float* dy = rays.directions().data(1);
+    const float* dz = rays.directions().data(2);
+
+    const float cx = s.center().x();
+    const float cy = s.center().y();
+    const float cz = s.center().z();
+    const float radius_squared = s.radius() * s.radius();
+
+    std::array<std::int32_t, N> hits;
+
+    for (std::size_t i = 0; i < N; i++) {
+        const float ocx = ox[i] - cx;
+        const float ocy = oy[i] - cy;
+        const float ocz = oz[i] - cz;
+
+        const float a = dx[i] * dx[i] + dy[i] * dy[i] + dz[i] * dz[i];
+        const float b = ocx * dx[i] + ocy * dy[i] + ocz * dz[i];
+        const float c = ocx * ocx + ocy * ocy + ocz * ocz - radius_squared;
+        const float discriminant = b * b - a * c;
+
+        const float root = std::sqrt(discriminant < 0 ? 0.0f : discriminant);
+        const float t_near = (-b - root) / a;
+        const float t_far = (-b + root) / a;
+        const float candidate = t_near > t_min ? t_near : t_far;
+
+        const bool hit = ((active >> i) & 1) & (discriminant >= 0) &
+                         (candidate > t_min) & (candidate < t[i]);
+
+        t[i] = hit ? candidate : t[i];
+        hits[i] = hit;
+    }
+
+    return packet_mask_from<N>(hits);
+}
+
+/**
+ * @brief Intersects a ray packet with a plane.
+ *
+ * See the sphere kernel for the parameter semantics. Lanes parallel to
+ * the plane never hit.
+ */
+template <std::size_t N>
+packet_mask intersect(const ray_packet<N>& rays, const plane& p,
+                      packet_mask active, float t_min,
+                      packet_distances<N>& t) {
+    const float* ox = rays.origins().data(0);
+    const float* oy = rays.origins().data(1);
+    const float* oz = rays.origins().data(2);
+    const float* dx = rays.directions().data(0);
+    const float* dy = rays.directions().data(1);
+    const float* dz = rays.directions().data(2);
+
+    const float nx = p.normal().x();
+    const float ny = p.normal().y();
+    const float nz = p.normal().z();
+
+    std::array<std::int32_t, N> hits;
+
+    for (std::size_t i = 0; i < N; i++) {
+        const float denominator = nx * dx[i] + ny * dy[i] + nz * dz[i];
+        const float numerator = p.distance() -
+                                (nx * ox[i] + ny * oy[i] + nz * oz[i]);
+        const float candidate = numerator / denominator;
+
+        const bool hit = ((active >> i) & 1) & (denominator != 0) &
+                         (candidate > t_min) & (candidate < t[i]);
+
+        t[i] = hit ? candidate : t[i];
+        hits[i] = hit;
+    }
+
+    return packet_mask_from<N>(hits);
+}
+
+/**
+ * @brief Intersects a ray packet with a triangle (Möller–Trumbore).
+ *
+ * See the sphere kernel for the parameter semantics. The edge vectors are
+ * computed once and shared by all lanes.
+ */
+template <std::size_t N>
+packet_mask intersect(const ray_packet<N>& rays, const triangle& tri,
+                      packet_mask active, float t_min,
+                      packet_distances<N>& t) {
+    const float* ox = rays.origins().data(0);
+    const float* oy = rays.origins().data(1);
+    const float* oz = rays.origins().data(2);
+    const float* dx = rays.directions().data(0);
+    const float* dy = rays.directions().data(1);
+    const float* dz = rays.directions().data(2);
+
+    const vec3f edge_1 = tri.v1() - tri.v0();
+    const vec3f edge_2 = tri.v2() - tri.v0();
+
+    const float e1x = edge_1.x(), e1y = edge_1.y(), e1z = edge_1.z();
+    const float e2x = edge_2.x(), e2y = edge_2.y(), e2z = edge_2.z();
+    const float v0x = tri.v0().x(), v0y = tri.v0().y(), v0z = tri.v0().z();
+
+    std::array<std::int32_t, N> hits;
+
+    for (std::size_t i = 0; i < N; i++) {
+        const float px = dy[i] * e2z - dz[i] * e2y;
+        const float py = dz[i] * e2x - dx[i] * e2z;
+        const float pz = dx[i] * e2y - dy[i] * e2x;
+
+        const float determinant = e1x * px + e1y * py + e1z * pz;
+        const float inverse_determinant = 1.0f / determinant;
+
+        const float sx = ox[i] - v0x;
+        const float sy = oy[i] - v0y;
+        const float sz = oz[i] - v0z;
+
+        const float u = (sx * px + sy * py + sz * pz) * inverse_determinant;
+
+        const float qx = sy * e1z - sz * e1y;
+        const float qy = sz * e1x - sx * e1z;
+        const float qz = sx * e1y - sy * e1x;
+
+        const float v = (dx[i] * qx + dy[i] * qy + dz[i] * qz) *
+                        inverse_determinant;
+        const float candidate = (e2x * qx + e2y * qy + e2z * qz) *
+                                inverse_determinant;
+
+        const bool hit = ((active >> i) & 1) & (determinant != 0) &
+                         (u >= 0) & (u <= 1) & (v >= 0) & (u + v <= 1) &
+                         (candidate > t_min) & (candidate < t[i]);
+
+        t[i] = hit ? candidate : t[i];
+        hits[i] = hit;
+    }
+
+    return packet_mask_from<N>(hits);
+}
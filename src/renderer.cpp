@@ -0,0 +1,35 @@
+#include "renderer.h"
+
+#include <stdexcept>
+
+std::vector<tile> make_tiles(std::size_t width, std::size_t height,
+                             std::size_t tile_size) {
+    if (tile_size == 0)
+        throw std::invalid_argument("make_tiles: tile_size must be > 0");
+
+    std::vector<tile> tiles;
+    tiles.reserve(((width + tile_size - 1) / tile_size) *
+                  ((height + tile_size - 1) / tile_size));
+
+    for (std::size_t y = 0; y < height; y += tile_size)
+        for (std::size_t x = 0; x < width; x += tile_size)
+            tiles.push_back(tile{x, y,
+                                 x + tile_size < width ? x + tile_size : width,
+                                 y + tile_size < height ? y + tile_size
+                                                        : height});
+
+    return tiles;
+}
+
+void for_each_tile(scheduler& pool, std::size_t width, std::size_t height,
+                   const render_settings& settings,
+                   const std::function<void(const tile&)>& work) {
+    const std::vector<tile> tiles = make_tiles(width, height,
+                                               settings.tile_size);
+    task_group group;
+
+    for (const tile& region : tiles)
+        pool.submit(group, [&work, region] { work(region); });
+
+    pool.wait(group);
+}
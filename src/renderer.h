@@ -0,0 +1,108 @@
+/** @file renderer.h */
+
+#pragma once
+
+#include "arena.h"
+#include "framebuffer.h"
+#include "scheduler.h"
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+/**
+ * @brief Rectangular region [x0, x1) x [y0, y1) of a framebuffer.
+ */
+struct tile {
+    std::size_t x0;
+    std::size_t y0;
+    std::size_t x1;
+    std::size_t y1;
+};
+
+/** @brief Parameters of the tile dispatch. */
+struct render_settings {
+    /** @brief Edge length of the (square) tiles, in pixels. */
+    std::size_t tile_size = 32;
+};
+
+/**
+ * @brief Splits a width x height image into row-major tiles.
+ *
+ * Tiles on the right and bottom edges are clipped to the image.
+ *
+ * @throws std::invalid_argument if tile_size is 0.
+ */
+std::vector<tile> make_tiles(std::size_t width, std::size_t height,
+                             std::size_t tile_size);
+
+/**
+ * @brief Runs work once for every tile of a width x height image.
+ *
+ * Every tile is submitted as a task to pool, whose workers steal tiles
+ * from each other, so cheap tiles (empty sky) do not leave threads idle
+ * while expensive ones are still being rendered. work is called
+ * concurrently and must only write to the pixels of the tile it is
+ * given.
+ *
+ * @throws std::invalid_argument if settings.tile_size is 0.
+ */
+void for_each_tile(scheduler& pool, std::size_t width, std::size_t height,
+                   const render_settings& settings,
+                   const std::function<void(const tile&)>& work);
+
+/**
+ * @brief Renders frame in parallel, tile by tile.
+ *
+ * @param pool -> The scheduler running the tiles
+ * @param frame -> The destination framebuffer
+ * @param settings -> The tile size
+ * @param shade -> Callable (x, y) -> colorf computing one pixel. Called
+ *                 concurrently from all workers.
+ *
+ * @throws std::invalid_argument if settings.tile_size is 0.
+ */
+template <typename Shader>
+void render(scheduler& pool, framebuffer& frame,
+            const render_settings& settings, const Shader& shade) {
+    for_each_tile(pool, frame.width(), frame.height(), settings,
+                  [&](const tile& region) {
+        for (std::size_t y = region.y0; y < region.y1; y++) {
+            colorf* row = frame.row(y);
+
+            for (std::size_t x = region.x0; x < region.x1; x++)
+                row[x] = shade(x, y);
+        }
+    });
+}
+
+/**
+ * @brief Renders frame in parallel, with per-thread scratch memory.
+ *
+ * Same as the overload above, except that shade is called as
+ * shade(x, y, memory) with the @ref arena of the calling thread, for
+ * temporary objects such as hit records or sample lists. Everything
+ * allocated from it is freed at the end of the tile; scratch.reset()
+ * between frames reports the frame's high-water mark.
+ *
+ * @throws std::invalid_argument if settings.tile_size is 0.
+ */
+template <typename Shader>
+void render(scheduler& pool, framebuffer& frame,
+            const render_settings& settings, thread_arenas& scratch,
+            const Shader& shade) {
+    for_each_tile(pool, frame.width(), frame.height(), settings,
+                  [&](const tile& region) {
+        arena& memory = scratch.local();
+        const arena_mark start = memory.mark();
+
+        for (std::size_t y = region.y0; y < region.y1; y++) {
+            colorf* row = frame.row(y);
+
+            for (std::size_t x = region.x0; x < region.x1; x++)
+                row[x] = shade(x, y, memory);
+        }
+
+        memory.rewind(start);
+    });
+}
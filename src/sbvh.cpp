@@ -0,0 +1,679 @@
+#include "sbvh.h"
+#include "lbvh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+/** @brief Depth from which the builder only makes median object splits. */
+static const std::size_t MEDIAN_SPLIT_DEPTH = bvh::max_depth - 32;
+
+/**
+ * @brief Relative padding of clipped bounds, so that the rounding of the
+ *        clipping points never leaves part of a triangle outside them.
+ */
+static const float CLIP_PADDING = 1e-6f;
+
+/** @brief A triangle, or the part of it inside box. */
+struct reference {
+    aabb box;
+    std::uint32_t index;
+};
+
+/** @brief Node of the temporary pointer tree built before flattening. */
+struct sbvh_build_node {
+    aabb box;
+    std::unique_ptr<sbvh_build_node> left;
+    std::unique_ptr<sbvh_build_node> right;
+    std::vector<std::uint32_t> primitives;
+    int axis = 0;
+};
+
+/** @returns The intersection of two boxes, empty if they are disjoint. */
+static aabb overlap(const aabb& a, const aabb& b) {
+    return aabb(vec3_max(a.min(), b.min()), vec3_min(a.max(), b.max()));
+}
+
+/**
+ * @returns The bounds of the part of tri between the planes lo and hi on
+ *          axis, within box. Empty if there is no such part.
+ */
+static aabb clip(const triangle& tri, const aabb& box, int axis, float lo,
+                 float hi) {
+    const vec3f vertices[3] = { tri.v0(), tri.v1(), tri.v2() };
+    aabb clipped;
+
+    for (int i = 0; i < 3; i++) {
+        const vec3f& a = vertices[i];
+        const vec3f& b = vertices[(i + 1) % 3];
+        const float pa = a.component(axis);
+        const float pb = b.component(axis);
+
+        if (pa >= lo && pa <= hi)
+            clipped.extend(a);
+
+        // Where the edge crosses the planes.
+        for (const float plane : { lo, hi })
+            if ((pa < plane && pb > plane) || (pa > plane && pb < plane))
+                clipped.extend(a + (b - a) * ((plane - pa) / (pb - pa)));
+    }
+
+    if (clipped.empty())
+        return clipped;
+
+    vec3f padding;
+
+    for (int i = 0; i < 3; i++)
+        padding[i] = std::fmax(std::fabs(clipped.min()[i]),
+                               std::fabs(clipped.max()[i])) * CLIP_PADDING;
+
+    vec3f min = vec3_max(clipped.min() - padding, box.min());
+    vec3f max = vec3_min(clipped.max() + padding, box.max());
+
+    min[axis] = std::fmax(min[axis], lo);
+    max[axis] = std::fmin(max[axis], hi);
+
+    return aabb(min, max);
+}
+
+/** @returns The bounds of refs. */
+static aabb bounds_of(const std::vector<reference>& refs) {
+    aabb box;
+
+    for (const reference& ref : refs)
+        box.extend(ref.box);
+
+    return box;
+}
+
+/** @brief SBVH builder over a set of references. */
+class sbvh_builder {
+    private:
+        struct bin {
+            aabb box;
+            std::size_t count = 0;
+            std::size_t entries = 0;
+            std::size_t exits = 0;
+        };
+
+        /** @brief The best split found for a node. */
+        struct split {
+            float cost = std::numeric_limits<float>::infinity();
+            int axis = 0;
+            std::size_t bin = 0;
+            float plane = 0;
+            aabb left;
+            aabb right;
+            std::size_t left_count = 0;
+            std::size_t right_count = 0;
+        };
+
+        const std::vector<triangle>& triangles;
+        const sbvh_build_settings& settings;
+        scheduler* pool;
+        float root_area = 0;
+
+        /** @returns The SAH cost of a split of a node of area parent. */
+        inline float split_cost(float parent, float left_area,
+                                std::size_t left_count, float right_area,
+                                std::size_t right_count) const {
+            return settings.base.traversal_cost +
+                   settings.base.intersection_cost *
+                   (left_area * left_count + right_area * right_count) /
+                   (parent > 0 ? parent : 1);
+        }
+
+        /** @returns The bin of value among bins bins from origin. */
+        static inline std::size_t bin_of(float value, float origin,
+                                         float scale, std::size_t bins) {
+            const float offset = (value - origin) * scale;
+            const std::size_t index = offset > 0
+                                    ? static_cast<std::size_t>(offset) : 0;
+
+            return index < bins ? index : bins - 1;
+        }
+
+        /** @brief Finds the cheapest binned object (centroid) split. */
+        split find_object_split(const std::vector<reference>& refs,
+                                const aabb& box,
+                                const aabb& centroid_box) const {
+            const std::size_t bins = settings.base.bins;
+            const vec3f extent = centroid_box.extent();
+
+            split best;
+            std::vector<bin> binned(bins);
+            std::vector<aabb> right_box(bins);
+            std::vector<std::size_t> right_count(bins);
+
+            for (int axis = 0; axis < 3; axis++) {
+                if (!(extent.component(axis) > 0))
+                    continue;
+
+                const float origin = centroid_box.min().component(axis);
+                const float scale = bins / extent.component(axis);
+
+                std::fill(binned.begin(), binned.end(), bin());
+
+                for (const reference& ref : refs) {
+                    bin& b = binned[bin_of(ref.box.centroid().component(axis),
+                                           origin, scale, bins)];
+
+                    b.box.extend(ref.box);
+                    b.count++;
+                }
+
+                aabb right;
+                std::size_t count = 0;
+
+                for (std::size_t i = bins - 1; i > 0; i--) {
+                    right.extend(binned[i].box);
+                    count += binned[i].count;
+                    right_box[i] = right;
+                    right_count[i] = count;
+                }
+
+                aabb left;
+                count = 0;
+
+                for (std::size_t i = 0; i + 1 < bins; i++) {
+                    left.extend(binned[i].box);
+                    count += binned[i].count;
+
+                    if (count == 0 || right_count[i + 1] == 0)
+                        continue;
+
+                    const float cost = split_cost(
+                        box.surface_area(), left.surface_area(), count,
+                        right_box[i + 1].surface_area(), right_count[i + 1]);
+
+                    if (cost < best.cost) {
+                        best.cost = cost;
+                        best.axis = axis;
+                        best.bin = i;
+                        best.left = left;
+                        best.right = right_box[i + 1];
+                        best.left_count = count;
+                        best.right_count = right_count[i + 1];
+                    }
+                }
+            }
+
+            return best;
+        }
+
+        /**
+         * @brief Finds the cheapest spatial split: references are binned
+         *        by the bins their box spans, and clipped to each.
+         */
+        split find_spatial_split(const std::vector<reference>& refs,
+                                 const aabb& box) const {
+            const std::size_t bins = settings.spatial_bins;
+            const vec3f extent = box.extent();
+
+            split best;
+            std::vector<bin> binned(bins);
+            std::vector<aabb> right_box(bins);
+            std::vector<std::size_t> right_count(bins);
+
+            for (int axis = 0; axis < 3; axis++) {
+                if (!(extent.component(axis) > 0))
+                    continue;
+
+                const float origin = box.min().component(axis);
+                const float width = extent.component(axis) / bins;
+                const float scale = 1 / width;
+
+                auto plane = [&](std::size_t i) {
+                    return i == bins ? box.max().component(axis)
+                                     : origin + width * i;
+                };
+
+                std::fill(binned.begin(), binned.end(), bin());
+
+                for (const reference& ref : refs) {
+                    const std::size_t first =
+                        bin_of(ref.box.min().component(axis), origin, scale,
+                               bins);
+                    const std::size_t last =
+                        bin_of(ref.box.max().component(axis), origin, scale,
+                               bins);
+
+                    if (first == last) {
+                        binned[first].box.extend(ref.box);
+                    } else {
+                        const triangle& tri = triangles[ref.index];
+
+                        for (std::size_t i = first; i <= last; i++)
+                            binned[i].box.extend(clip(tri, ref.box, axis,
+                                                      plane(i),
+                                                      plane(i + 1)));
+                    }
+
+                    binned[first].entries++;
+                    binned[last].exits++;
+                }
+
+                aabb right;
+                std::size_t count = 0;
+
+                for (std::size_t i = bins - 1; i > 0; i--) {
+                    right.extend(binned[i].box);
+                    count += binned[i].exits;
+                    right_box[i] = right;
+                    right_count[i] = count;
+                }
+
+                aabb left;
+                count = 0;
+
+                for (std::size_t i = 0; i + 1 < bins; i++) {
+                    left.extend(binned[i].box);
+                    count += binned[i].entries;
+
+                    if (count == 0 || right_count[i + 1] == 0)
+                        continue;
+
+                    const float cost = split_cost(
+                        box.surface_area(), left.surface_area(), count,
+                        right_box[i + 1].surface_area(), right_count[i + 1]);
+
+                    if (cost < best.cost) {
+                        best.cost = cost;
+                        best.axis = axis;
+                        best.plane = plane(i + 1);
+                        best.left = left;
+                        best.right = right_box[i + 1];
+                        best.left_count = count;
+                        best.right_count = right_count[i + 1];
+                    }
+                }
+            }
+
+            return best;
+        }
+
+        /**
+         * @brief Splits refs by the plane of s, clipping the straddling
+         *        references unless keeping them whole on one side is
+         *        cheaper.
+         *
+         * @returns The number of references duplicated, at most budget.
+         */
+        std::size_t spatial_partition(const std::vector<reference>& refs,
+                                      const split& s, std::size_t budget,
+                                      std::vector<reference>& left,
+                                      std::vector<reference>& right) {
+            const int axis = s.axis;
+            std::vector<reference> straddling;
+
+            aabb left_box;
+            aabb right_box;
+
+            for (const reference& ref : refs) {
+                if (ref.box.max().component(axis) <= s.plane) {
+                    left.push_back(ref);
+                    left_box.extend(ref.box);
+                } else if (ref.box.min().component(axis) >= s.plane) {
+                    right.push_back(ref);
+                    right_box.extend(ref.box);
+                } else {
+                    straddling.push_back(ref);
+                }
+            }
+
+            std::size_t left_count = left.size() + straddling.size();
+            std::size_t right_count = right.size() + straddling.size();
+            std::size_t duplicates = 0;
+
+            left_box.extend(s.left);
+            right_box.extend(s.right);
+
+            for (const reference& ref : straddling) {
+                const triangle& tri = triangles[ref.index];
+                const float inf = std::numeric_limits<float>::infinity();
+                const aabb left_part = clip(tri, ref.box, axis, -inf,
+                                            s.plane);
+                const aabb right_part = clip(tri, ref.box, axis, s.plane,
+                                             inf);
+
+                // Reference unsplitting: compare the SAH numerators.
+                const float cost_split =
+                    left_box.surface_area() * left_count +
+                    right_box.surface_area() * right_count;
+                const float cost_left =
+                    merge(left_box, ref.box).surface_area() * left_count +
+                    right_box.surface_area() * (right_count - 1);
+                const float cost_right =
+                    left_box.surface_area() * (left_count - 1) +
+                    merge(right_box, ref.box).surface_area() * right_count;
+
+                const bool whole = duplicates == budget ||
+                                   std::fmin(cost_left, cost_right) <
+                                   cost_split;
+
+                if (right_part.empty() ||
+                    (!left_part.empty() && whole &&
+                     cost_left <= cost_right)) {
+                    left.push_back(ref);
+                    left_box.extend(ref.box);
+                    right_count--;
+                } else if (left_part.empty() || whole) {
+                    right.push_back(ref);
+                    right_box.extend(ref.box);
+                    left_count--;
+                } else {
+                    left.push_back(reference{left_part, ref.index});
+                    right.push_back(reference{right_part, ref.index});
+                    duplicates++;
+                }
+            }
+
+            return duplicates;
+        }
+
+        /** @brief Splits refs at the median centroid along axis. */
+        static void median_partition(std::vector<reference>& refs, int axis,
+                                     std::vector<reference>& left,
+                                     std::vector<reference>& right) {
+            const std::size_t middle = refs.size() / 2;
+
+            std::nth_element(refs.begin(), refs.begin() + middle, refs.end(),
+                             [axis](const reference& a, const reference& b) {
+                return a.box.centroid().component(axis) <
+                       b.box.centroid().component(axis);
+            });
+
+            left.assign(refs.begin(), refs.begin() + middle);
+            right.assign(refs.begin() + middle, refs.end());
+
+            std::vector<reference>().swap(refs);
+        }
+
+        static std::unique_ptr<sbvh_build_node> make_leaf(
+            const aabb& box, const std::vector<reference>& refs) {
+            std::unique_ptr<sbvh_build_node> node(new sbvh_build_node);
+
+            node->box = box;
+            node->primitives.reserve(refs.size());
+
+            for (const reference& ref : refs)
+                node->primitives.push_back(ref.index);
+
+            return node;
+        }
+
+    public:
+        sbvh_builder(const std::vector<triangle>& triangles,
+                     const sbvh_build_settings& settings, scheduler* pool)
+            : triangles(triangles), settings(settings), pool(pool) {}
+
+        /**
+         * @brief Builds the subtree of refs.
+         *
+         * @param refs -> The references of the subtree
+         * @param depth -> The depth of the subtree root
+         * @param budget -> How many references the subtree may duplicate.
+         *                  What a node leaves unused is shared among its
+         *                  children by size, so that the first subtrees
+         *                  built do not exhaust the whole budget.
+         */
+        std::unique_ptr<sbvh_build_node> build(std::vector<reference> refs,
+                                               std::size_t depth,
+                                               std::size_t budget) {
+            aabb box;
+            aabb centroid_box;
+
+            for (const reference& ref : refs) {
+                box.extend(ref.box);
+                centroid_box.extend(ref.box.centroid());
+            }
+
+            if (depth == 0)
+                root_area = box.surface_area();
+
+            const std::size_t count = refs.size();
+
+            if (count == 1)
+                return make_leaf(box, refs);
+
+            int axis = centroid_box.largest_axis();
+            std::vector<reference> left;
+            std::vector<reference> right;
+
+            if (depth < MEDIAN_SPLIT_DEPTH) {
+                const split object = find_object_split(refs, box,
+                                                       centroid_box);
+                split spatial;
+
+                // Spatial splits only pay off where the object split
+                // children overlap.
+                const float overlap_area =
+                    overlap(object.left, object.right).surface_area();
+
+                if (budget > 0 &&
+                    (object.cost == std::numeric_limits<float>::infinity() ||
+                     overlap_area > settings.overlap_threshold * root_area))
+                    spatial = find_spatial_split(refs, box);
+
+                const float best = std::fmin(object.cost, spatial.cost);
+                const float leaf_cost = settings.base.intersection_cost *
+                                        count;
+
+                if (count <= settings.base.max_leaf_size && leaf_cost <= best)
+                    return make_leaf(box, refs);
+
+                if (spatial.cost < object.cost) {
+                    const std::size_t duplicates =
+                        spatial_partition(refs, spatial, budget, left, right);
+
+                    // Past the budget, straddling references are kept whole,
+                    // which may make the split worse than the object one.
+                    const float cost = split_cost(
+                        box.surface_area(), bounds_of(left).surface_area(),
+                        left.size(), bounds_of(right).surface_area(),
+                        right.size());
+
+                    if (cost <= object.cost) {
+                        axis = spatial.axis;
+                        budget -= duplicates;
+                        std::vector<reference>().swap(refs);
+                    } else {
+                        left.clear();
+                        right.clear();
+                    }
+                }
+
+                if (!refs.empty() && object.cost <
+                    std::numeric_limits<float>::infinity()) {
+                    axis = object.axis;
+
+                    const float origin = centroid_box.min().component(axis);
+                    const float scale = settings.base.bins /
+                        centroid_box.extent().component(axis);
+
+                    for (const reference& ref : refs)
+                        (bin_of(ref.box.centroid().component(axis), origin,
+                                scale, settings.base.bins) <= object.bin
+                             ? left : right).push_back(ref);
+
+                    std::vector<reference>().swap(refs);
+                }
+            } else if (count <= settings.base.max_leaf_size) {
+                return make_leaf(box, refs);
+            }
+
+            if (left.empty() || right.empty()) {
+                // No usable split: back to the median of all references.
+                refs.insert(refs.end(), left.begin(), left.end());
+                refs.insert(refs.end(), right.begin(), right.end());
+                left.clear();
+                right.clear();
+
+                median_partition(refs, axis, left, right);
+            }
+
+            std::unique_ptr<sbvh_build_node> node(new sbvh_build_node);
+            node->box = box;
+            node->axis = axis;
+
+            const std::size_t left_budget = static_cast<std::size_t>(
+                double(budget) * left.size() / (left.size() + right.size()));
+            const std::size_t right_budget = budget - left_budget;
+
+            if (pool && count >= settings.base.parallel_threshold) {
+                task_group group;
+
+                pool->submit(group, [&] {
+                    node->left = build(std::move(left), depth + 1,
+                                       left_budget);
+                });
+
+                node->right = build(std::move(right), depth + 1,
+                                    right_budget);
+                pool->wait(group);
+            } else {
+                node->left = build(std::move(left), depth + 1, left_budget);
+                node->right = build(std::move(right), depth + 1,
+                                    right_budget);
+            }
+
+            return node;
+        }
+};
+
+/** @brief Appends node and its subtree to nodes and indices, depth-first. */
+static void flatten(const sbvh_build_node& node, std::size_t depth,
+                    float root_area, const bvh_build_settings& settings,
+                    std::vector<bvh_node>& nodes,
+                    std::vector<std::uint32_t>& indices,
+                    bvh_build_stats& stats) {
+    const std::size_t index = nodes.size();
+    nodes.push_back(bvh_node());
+
+    bvh_node& flat = nodes[index];
+    const aabb& box = node.box;
+
+    flat.lo[0] = box.min().x();
+    flat.lo[1] = box.min().y();
+    flat.lo[2] = box.min().z();
+    flat.hi[0] = box.max().x();
+    flat.hi[1] = box.max().y();
+    flat.hi[2] = box.max().z();
+
+    const double relative_area = root_area > 0
+                               ? box.surface_area() / root_area : 1;
+
+    stats.max_depth = depth > stats.max_depth ? depth : stats.max_depth;
+
+    if (!node.left) {
+        flat.offset = static_cast<std::uint32_t>(indices.size());
+        flat.count = static_cast<std::uint16_t>(node.primitives.size());
+        flat.axis = 0;
+
+        indices.insert(indices.end(), node.primitives.begin(),
+                       node.primitives.end());
+
+        stats.leaf_count++;
+        stats.sah_cost += settings.intersection_cost *
+                          node.primitives.size() * relative_area;
+        return;
+    }
+
+    flat.count = 0;
+    flat.axis = static_cast<std::uint16_t>(node.axis);
+
+    stats.sah_cost += settings.traversal_cost * relative_area;
+
+    flatten(*node.left, depth + 1, root_area, settings, nodes, indices,
+            stats);
+
+    // nodes may have been reallocated, so flat is no longer valid.
+    nodes[index].offset = static_cast<std::uint32_t>(nodes.size());
+
+    flatten(*node.right, depth + 1, root_area, settings, nodes, indices,
+            stats);
+}
+
+bvh build_sbvh(const std::vector<triangle>& triangles, scheduler* pool,
+               const sbvh_build_settings& settings) {
+    if (settings.base.bins < 2 || settings.spatial_bins < 2)
+        throw std::invalid_argument("sbvh: at least 2 bins are required");
+
+    if (settings.base.max_leaf_size < 1 ||
+        settings.base.max_leaf_size > 65535)
+        throw std::invalid_argument("sbvh: max_leaf_size must be in "
+                                    "[1, 65535]");
+
+    if (!(settings.duplication_budget >= 0))
+        throw std::invalid_argument("sbvh: duplication_budget must not be "
+                                    "negative");
+
+    if (triangles.size() >= std::numeric_limits<std::uint32_t>::max())
+        throw std::invalid_argument("sbvh: too many triangles");
+
+    const auto start = std::chrono::steady_clock::now();
+    bvh_build_stats stats;
+
+    if (triangles.empty())
+        return bvh();
+
+    std::vector<reference> refs;
+    refs.reserve(triangles.size());
+
+    for (std::size_t i = 0; i < triangles.size(); i++)
+        refs.push_back(reference{bounds(triangles[i]),
+                                 static_cast<std::uint32_t>(i)});
+
+    const std::size_t budget = static_cast<std::size_t>(
+        settings.duplication_budget * triangles.size());
+
+    sbvh_builder builder(triangles, settings, pool);
+    const std::unique_ptr<sbvh_build_node> root =
+        builder.build(std::move(refs), 0, budget);
+
+    std::vector<bvh_node> nodes;
+    std::vector<std::uint32_t> indices;
+
+    nodes.reserve(2 * (triangles.size() + budget));
+    indices.reserve(triangles.size() + budget);
+
+    flatten(*root, 0, root->box.surface_area(), settings.base, nodes,
+            indices, stats);
+    nodes.shrink_to_fit();
+
+    stats.node_count = nodes.size();
+    stats.build_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    return bvh(shared_buffer<bvh_node>(std::move(nodes)),
+               shared_buffer<std::uint32_t>(std::move(indices)), stats);
+}
+
+bvh build_sbvh(const mesh& geometry, scheduler* pool,
+               const sbvh_build_settings& settings) {
+    std::vector<triangle> triangles;
+    triangles.reserve(geometry.triangle_count());
+
+    for (std::size_t i = 0; i < geometry.triangle_count(); i++)
+        triangles.push_back(geometry.get_triangle(i));
+
+    return build_sbvh(triangles, pool, settings);
+}
+
+bvh build_bvh(const mesh& geometry, bvh_quality quality, scheduler* pool) {
+    if (quality == bvh_quality::high)
+        return build_sbvh(geometry, pool);
+
+    if (quality == bvh_quality::preview) {
+        lbvh_build_settings settings;
+        settings.treelet_passes = 2;
+
+        return build_lbvh(primitive_bounds(geometry), pool, settings);
+    }
+
+    return bvh(primitive_bounds(geometry), pool);
+}
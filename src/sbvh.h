@@ -0,0 +1,77 @@
+/** @file sbvh.h */
+
+#pragma once
+
+#include "bvh.h"
+#include "mesh.h"
+
+#include <vector>
+
+/** @brief Parameters of the spatial split BVH builder. */
+struct sbvh_build_settings {
+    /**
+     * @brief The object split parameters: bins, leaf size, SAH costs and
+     *        parallel threshold, as for @ref bvh::bvh.
+     */
+    bvh_build_settings base;
+
+    /** @brief Number of spatial bins per axis. At least 2. */
+    std::size_t spatial_bins = 16;
+
+    /**
+     * @brief Spatial splits are only tried where the children of the
+     *        best object split overlap by more than this fraction of the
+     *        root surface area (alpha of Stich et al.).
+     */
+    float overlap_threshold = 1e-5f;
+
+    /**
+     * @brief Memory budget of the duplicated references, as a fraction
+     *        of the triangle count: the tree references at most
+     *        (1 + duplication_budget) * count triangles. Every subtree
+     *        gets a share of it proportional to its size. 0 disables the
+     *        spatial splits.
+     */
+    float duplication_budget = 0.3f;
+};
+
+/**
+ * @brief Builds a BVH with spatial splits (SBVH, Stich et al. 2009).
+ *
+ * Besides the binned object splits of the SAH builder, every node tries
+ * splitting space: the triangles straddling the plane are clipped to
+ * both sides, so both children get tight bounds, and referenced by both.
+ * Long thin triangles, which inflate and overlap the boxes of an object
+ * split hierarchy, cost far fewer intersection tests per ray. Straddling
+ * triangles are kept whole on one side when that is cheaper (reference
+ * unsplitting).
+ *
+ * The tree is an ordinary @ref bvh whose indices may contain a triangle
+ * several times, so every traversal works unchanged; it cannot be
+ * refitted.
+ *
+ * @param triangles -> The triangles
+ * @param pool -> If not null, subtrees are built in parallel on it
+ * @param settings -> The builder parameters
+ *
+ * @throws std::invalid_argument if the settings are out of range or
+ *         there are more than 2^32 - 1 triangles.
+ */
+bvh build_sbvh(const std::vector<triangle>& triangles,
+               scheduler* pool = nullptr,
+               const sbvh_build_settings& settings = sbvh_build_settings());
+
+/** @brief Builds a spatial split BVH over the triangles of a mesh. */
+bvh build_sbvh(const mesh& geometry, scheduler* pool = nullptr,
+               const sbvh_build_settings& settings = sbvh_build_settings());
+
+/** @brief BVH build quality presets. */
+enum class bvh_quality {
+    fast,   /**< Binned SAH object splits, @ref bvh::bvh */
+    high,   /**< Spatial splits, @ref build_sbvh */
+    preview /**< Morton order with treelet reoptimization, @ref build_lbvh */
+};
+
+/** @brief Builds the BVH of a mesh with the builder of a preset. */
+bvh build_bvh(const mesh& geometry, bvh_quality quality,
+              scheduler* pool = nullptr);
@@ -0,0 +1,427 @@
+#include "scene_cache.h"
+#include "mapped_file.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(std::is_trivially_copyable<vec3f>::value &&
+              std::is_trivially_copyable<triangle_precomputed>::value &&
+              std::is_trivially_copyable<bvh_node>::value,
+              "ERROR: cached buffers must be trivially copyable.");
+
+/** @brief Alignment of every buffer in the file. */
+static const std::uint64_t SECTION_ALIGNMENT = 64;
+
+/** @brief Byte order marker, read back reversed on the other order. */
+static const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+static const char MAGIC[8] = { 'R', 'S', 'S', 'C', 'E', 'N', 'E', '\0' };
+
+enum section_id {
+    POSITIONS,
+    NORMALS,
+    UVS,
+    INDICES,
+    PRECOMPUTED,
+    NODES,
+    BVH_INDICES,
+    SECTION_COUNT
+};
+
+struct cache_section {
+    std::uint64_t offset;
+    std::uint64_t count;
+};
+
+/**
+ * @brief Header of the file. The type sizes reject caches written by
+ *        builds whose in-memory layouts differ (e.g. without SIMD).
+ */
+struct cache_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+
+    std::uint32_t vec3_size;
+    std::uint32_t node_size;
+    std::uint32_t precomputed_size;
+    std::uint32_t layout;
+    std::uint32_t wide_indices;
+    std::uint32_t reserved;
+
+    std::uint64_t source_key;
+
+    std::uint64_t node_count;
+    std::uint64_t leaf_count;
+    std::uint64_t max_depth;
+    double sah_cost;
+    double build_seconds;
+
+    cache_section sections[SECTION_COUNT];
+};
+
+/** @returns offset rounded up to SECTION_ALIGNMENT. */
+static std::uint64_t align(std::uint64_t offset) {
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT *
+           SECTION_ALIGNMENT;
+}
+
+void write_scene_cache(const std::string& path, const cached_scene& scene,
+                       std::uint64_t source_key) {
+    const mesh_buffers& buffers = *scene.geometry.data();
+    const bvh_build_stats& stats = scene.tree.stats();
+
+    const void* data[SECTION_COUNT] = {
+        buffers.positions.data(), buffers.normals.data(), buffers.uvs.data(),
+        buffers.wide_indices
+            ? static_cast<const void*>(buffers.indices_32.data())
+            : static_cast<const void*>(buffers.indices_16.data()),
+        buffers.precomputed.data(), scene.tree.nodes().data(),
+        scene.tree.indices().data()
+    };
+
+    const std::uint64_t sizes[SECTION_COUNT] = {
+        sizeof(vec3f), sizeof(vec3f), sizeof(texcoord),
+        buffers.wide_indices ? sizeof(std::uint32_t) : sizeof(std::uint16_t),
+        sizeof(triangle_precomputed), sizeof(bvh_node), sizeof(std::uint32_t)
+    };
+
+    cache_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+
+    header.version = scene_cache_version;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.vec3_size = sizeof(vec3f);
+    header.node_size = sizeof(bvh_node);
+    header.precomputed_size = sizeof(triangle_precomputed);
+    header.layout = static_cast<std::uint32_t>(buffers.layout);
+    header.wide_indices = buffers.wide_indices;
+    header.source_key = source_key;
+    header.node_count = stats.node_count;
+    header.leaf_count = stats.leaf_count;
+    header.max_depth = stats.max_depth;
+    header.sah_cost = stats.sah_cost;
+    header.build_seconds = stats.build_seconds;
+
+    header.sections[POSITIONS].count = buffers.positions.size();
+    header.sections[NORMALS].count = buffers.normals.size();
+    header.sections[UVS].count = buffers.uvs.size();
+    header.sections[INDICES].count = buffers.wide_indices
+                                   ? buffers.indices_32.size()
+                                   : buffers.indices_16.size();
+    header.sections[PRECOMPUTED].count = buffers.precomputed.size();
+    header.sections[NODES].count = scene.tree.nodes().size();
+    header.sections[BVH_INDICES].count = scene.tree.indices().size();
+
+    std::uint64_t offset = sizeof(header);
+
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        offset = align(offset);
+        header.sections[i].offset = offset;
+        offset += header.sections[i].count * sizes[i];
+    }
+
+    // A unique temporary, renamed into place once complete: concurrent
+    // writers of the same cache never mix their files, and readers never
+    // map a partial one.
+    std::string temporary = path + ".XXXXXX";
+    const int descriptor = mkstemp(&temporary[0]);
+
+    if (descriptor < 0)
+        throw std::runtime_error("scene_cache: cannot create " + temporary);
+
+    close(descriptor);
+
+    bool written;
+
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        std::uint64_t position = sizeof(header);
+        const char padding[SECTION_ALIGNMENT] = {};
+
+        for (int i = 0; i < SECTION_COUNT; i++) {
+            const std::uint64_t bytes = header.sections[i].count * sizes[i];
+
+            file.write(padding, header.sections[i].offset - position);
+            file.write(static_cast<const char*>(data[i]), bytes);
+
+            position = header.sections[i].offset + bytes;
+        }
+
+        file.flush();
+        written = static_cast<bool>(file);
+    }
+
+    if (!written) {
+        std::remove(temporary.c_str());
+
+        throw std::runtime_error("scene_cache: cannot write " + temporary);
+    }
+
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+
+        throw std::runtime_error("scene_cache: cannot rename " + temporary +
+                                 " to " + path);
+    }
+}
+
+/** @brief Throws the std::runtime_error of an unusable cache. */
+static void reject(const std::string& path, const char* reason) {
+    throw std::runtime_error("scene_cache: " + path + ": " + reason);
+}
+
+/** @returns The buffer of section id, after checking it fits the file. */
+template <typename T>
+static shared_buffer<T> section(const mapped_file& file,
+                                const cache_header& header, section_id id,
+                                const std::string& path) {
+    const cache_section& s = header.sections[id];
+
+    if (s.offset % SECTION_ALIGNMENT != 0 || s.offset > file.size() ||
+        s.count > (file.size() - s.offset) / sizeof(T))
+        reject(path, "truncated or corrupt section");
+
+    return shared_buffer<T>(file.owner(),
+                            reinterpret_cast<const T*>(file.data() +
+                                                       s.offset),
+                            s.count);
+}
+
+/** @returns true if every vertex index is below vertex_count. */
+template <typename Index>
+static bool valid_indices(const shared_buffer<Index>& indices,
+                          std::size_t vertex_count) {
+    for (const Index index : indices)
+        if (index >= vertex_count)
+            return false;
+
+    return true;
+}
+
+/**
+ * @returns true if nodes and indices form a tree every traversal can walk:
+ *          children in depth-first order and in bounds, split axes valid,
+ *          leaf ranges inside indices, every index below primitive_count,
+ *          and no leaf deeper than @ref bvh::max_depth.
+ */
+static bool valid_tree(const shared_buffer<bvh_node>& nodes,
+                       const shared_buffer<std::uint32_t>& indices,
+                       std::size_t primitive_count) {
+    for (const std::uint32_t index : indices)
+        if (index >= primitive_count)
+            return false;
+
+    if (nodes.empty())
+        return true;
+
+    // Children follow their parent, so there are no cycles. In a tree
+    // every node is visited once: more visits mean shared subtrees.
+    std::vector<std::pair<std::uint32_t, std::size_t>> stack = { { 0, 0 } };
+    std::size_t visited = 0;
+
+    while (!stack.empty()) {
+        const std::uint32_t index = stack.back().first;
+        const std::size_t depth = stack.back().second;
+        const bvh_node& node = nodes[index];
+
+        stack.pop_back();
+
+        if (++visited > nodes.size() || depth > bvh::max_depth)
+            return false;
+
+        if (node.leaf()) {
+            if (std::uint64_t(node.offset) + node.count > indices.size())
+                return false;
+
+            continue;
+        }
+
+        if (node.axis > 2 || index + std::uint64_t(1) >= nodes.size() ||
+            node.offset <= index + 1 || node.offset >= nodes.size())
+            return false;
+
+        stack.push_back({ index + 1, depth + 1 });
+        stack.push_back({ node.offset, depth + 1 });
+    }
+
+    return true;
+}
+
+cached_scene load_scene_cache(const std::string& path,
+                              std::uint64_t source_key) {
+    const mapped_file file(path);
+
+    if (file.size() < sizeof(cache_header))
+        reject(path, "not a scene cache");
+
+    cache_header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+        reject(path, "not a scene cache");
+
+    if (header.version != scene_cache_version)
+        reject(path, "unsupported version");
+
+    if (header.byte_order != BYTE_ORDER_MARK ||
+        header.vec3_size != sizeof(vec3f) ||
+        header.node_size != sizeof(bvh_node) ||
+        header.precomputed_size != sizeof(triangle_precomputed))
+        reject(path, "written by an incompatible build");
+
+    if (header.source_key != source_key)
+        reject(path, "stale");
+
+    if (header.layout > static_cast<std::uint32_t>(mesh_layout::precomputed))
+        reject(path, "unknown mesh layout");
+
+    std::shared_ptr<mesh_buffers> buffers = std::make_shared<mesh_buffers>();
+
+    buffers->positions = section<vec3f>(file, header, POSITIONS, path);
+    buffers->normals = section<vec3f>(file, header, NORMALS, path);
+    buffers->uvs = section<texcoord>(file, header, UVS, path);
+    buffers->wide_indices = header.wide_indices != 0;
+    buffers->layout = static_cast<mesh_layout>(header.layout);
+    buffers->precomputed = section<triangle_precomputed>(file, header,
+                                                         PRECOMPUTED, path);
+
+    std::size_t index_count;
+
+    if (buffers->wide_indices) {
+        buffers->indices_32 = section<std::uint32_t>(file, header, INDICES,
+                                                     path);
+        index_count = buffers->indices_32.size();
+    } else {
+        buffers->indices_16 = section<std::uint16_t>(file, header, INDICES,
+                                                     path);
+        index_count = buffers->indices_16.size();
+    }
+
+    const std::size_t vertex_count = buffers->positions.size();
+    const bool indices_in_range = buffers->wide_indices
+        ? valid_indices(buffers->indices_32, vertex_count)
+        : valid_indices(buffers->indices_16, vertex_count);
+
+    if (index_count % 3 != 0 || !indices_in_range ||
+        (!buffers->normals.empty() &&
+         buffers->normals.size() != vertex_count) ||
+        (!buffers->uvs.empty() && buffers->uvs.size() != vertex_count) ||
+        (buffers->layout == mesh_layout::precomputed &&
+         buffers->precomputed.size() != index_count / 3))
+        reject(path, "inconsistent mesh buffers");
+
+    if (header.max_depth > bvh::max_depth)
+        reject(path, "inconsistent bvh");
+
+    bvh_build_stats stats;
+    stats.node_count = header.node_count;
+    stats.leaf_count = header.leaf_count;
+    stats.max_depth = header.max_depth;
+    stats.sah_cost = header.sah_cost;
+    stats.build_seconds = header.build_seconds;
+
+    const shared_buffer<bvh_node> nodes =
+        section<bvh_node>(file, header, NODES, path);
+    const shared_buffer<std::uint32_t> bvh_indices =
+        section<std::uint32_t>(file, header, BVH_INDICES, path);
+
+    // At least one reference per triangle: spatial split BVHs reference
+    // some several times.
+    if (bvh_indices.size() < index_count / 3 ||
+        !valid_tree(nodes, bvh_indices, index_count / 3))
+        reject(path, "inconsistent bvh");
+
+    cached_scene scene;
+    scene.geometry = mesh(buffers);
+    scene.tree = bvh(nodes, bvh_indices, stats);
+
+    return scene;
+}
+
+cached_scene open_scene_cache(const std::string& path,
+                              std::uint64_t source_key,
+                              const std::function<mesh()>& load,
+                              scheduler* pool,
+                              const bvh_build_settings& settings,
+                              bool* loaded) {
+    return open_scene_cache(path, source_key, load,
+                            [&](const mesh& geometry) {
+                                return bvh(primitive_bounds(geometry), pool,
+                                           settings);
+                            },
+                            loaded);
+}
+
+cached_scene open_scene_cache(const std::string& path,
+                              std::uint64_t source_key,
+                              const std::function<mesh()>& load,
+                              const std::function<bvh(const mesh&)>& build,
+                              bool* loaded) {
+    try {
+        cached_scene scene = load_scene_cache(path, source_key);
+
+        if (loaded)
+            *loaded = true;
+
+        return scene;
+    } catch (const std::runtime_error&) {
+        // Missing, stale or incompatible: rebuild below.
+    }
+
+    cached_scene scene;
+    scene.geometry = load();
+    scene.tree = build(scene.geometry);
+
+    if (loaded)
+        *loaded = false;
+
+    try {
+        write_scene_cache(path, scene, source_key);
+    } catch (const std::runtime_error&) {
+        // A read-only cache location only costs the next startup.
+    }
+
+    return scene;
+}
+
+std::uint64_t scene_source_key(const std::string& path) {
+    struct stat status;
+
+    if (stat(path.c_str(), &status) != 0)
+        throw std::runtime_error("scene_cache: cannot access " + path);
+
+    // FNV-1a over the path, size and modification time.
+    std::uint64_t key = 14695981039346656037ull;
+
+    auto mix = [&key](const void* bytes, std::size_t size) {
+        for (std::size_t i = 0; i < size; i++) {
+            key ^= static_cast<const unsigned char*>(bytes)[i];
+            key *= 1099511628211ull;
+        }
+    };
+
+    const std::int64_t size = status.st_size;
+    const std::int64_t seconds = status.st_mtim.tv_sec;
+    const std::int64_t nanoseconds = status.st_mtim.tv_nsec;
+
+    mix(path.data(), path.size());
+    mix(&size, sizeof(size));
+    mix(&seconds, sizeof(seconds));
+    mix(&nanoseconds, sizeof(nanoseconds));
+
+    return key;
+}
@@ -0,0 +1,112 @@
+/** @file scene_cache.h */
+
+#pragma once
+
+#include "bvh.h"
+#include "mesh.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/**
+ * @brief Version of the scene cache format. Bumped on every change of
+ *        the file layout or of the in-memory layouts it stores.
+ */
+constexpr std::uint32_t scene_cache_version = 1;
+
+/** @brief A mesh and the BVH built over its triangles. */
+struct cached_scene {
+    mesh geometry;
+    bvh tree;
+};
+
+/**
+ * @brief Writes a scene cache.
+ *
+ * The file is a header followed by the vertex, index, precomputed
+ * triangle and BVH buffers, each 64-byte aligned and stored exactly as
+ * in memory. It is written to a uniquely named file next to path and
+ * renamed over it, so that neither an interrupted write nor concurrent
+ * writers leave a truncated cache. The temporary is removed on failure.
+ *
+ * @param path -> The path of the cache
+ * @param scene -> The scene
+ * @param source_key -> Identifies the source the scene was built from,
+ *                      see @ref scene_source_key
+ *
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void write_scene_cache(const std::string& path, const cached_scene& scene,
+                       std::uint64_t source_key = 0);
+
+/**
+ * @brief Maps a scene cache into memory.
+ *
+ * The returned mesh and BVH refer to the mapping directly: nothing is
+ * parsed or copied, and pages are only read when first touched. The
+ * mapping lives as long as a copy of the mesh or BVH.
+ *
+ * The vertex indices and the BVH are scanned once to check that
+ * intersection and traversal stay in bounds: vertex indices, BVH child
+ * and leaf ranges, primitive indices and depth.
+ *
+ * @param path -> The path of the cache
+ * @param source_key -> The expected source key
+ *
+ * @throws std::runtime_error if the file cannot be mapped, is not a
+ *         scene cache of this version and build (type sizes and byte
+ *         order), is truncated, has another source key, or its mesh
+ *         or BVH is corrupt.
+ */
+cached_scene load_scene_cache(const std::string& path,
+                              std::uint64_t source_key = 0);
+
+/**
+ * @brief Loads a scene cache, or builds the scene and writes the cache.
+ *
+ * @param path -> The path of the cache
+ * @param source_key -> Identifies the source of the scene
+ * @param load -> Loads the mesh when the cache is missing or stale
+ * @param pool -> If not null, the BVH is built on it
+ * @param settings -> The BVH builder parameters
+ * @param loaded -> If not null, set to true if the cache was used
+ *
+ * @returns The scene. If writing the cache fails, the built scene is
+ *          still returned.
+ */
+cached_scene open_scene_cache(const std::string& path,
+                              std::uint64_t source_key,
+                              const std::function<mesh()>& load,
+                              scheduler* pool = nullptr,
+                              const bvh_build_settings& settings =
+                                  bvh_build_settings(),
+                              bool* loaded = nullptr);
+
+/**
+ * @brief Loads a scene cache, or builds the scene with a custom BVH
+ *        builder and writes the cache.
+ *
+ * @param path -> The path of the cache
+ * @param source_key -> Identifies the source of the scene, and of how
+ *                      its BVH is built
+ * @param load -> Loads the mesh when the cache is missing or stale
+ * @param build -> Builds the BVH of the loaded mesh
+ * @param loaded -> If not null, set to true if the cache was used
+ *
+ * @returns The scene. If writing the cache fails, the built scene is
+ *          still returned.
+ */
+cached_scene open_scene_cache(const std::string& path,
+                              std::uint64_t source_key,
+                              const std::function<mesh()>& load,
+                              const std::function<bvh(const mesh&)>& build,
+                              bool* loaded = nullptr);
+
+/**
+ * @brief Returns a key of a source file, from its path, size and
+ *        modification time, that changes whenever the file does.
+ *
+ * @throws std::runtime_error if the file cannot be accessed.
+ */
+std::uint64_t scene_source_key(const std::string& path);
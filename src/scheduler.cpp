@@ -0,0 +1,312 @@
+#include "scheduler.h"
+
+#include <stdexcept>
+
+/** @brief Scheduler the calling thread works for, if any. */
+static thread_local const scheduler* current_scheduler = nullptr;
+
+/** @brief Index of the calling thread in current_scheduler. */
+static thread_local int current_index = -1;
+
+/** @returns A per-thread xorshift pseudo-random number. */
+static std::uint32_t next_random() {
+    static thread_local std::uint32_t state =
+        0x9E3779B9u ^ static_cast<std::uint32_t>(
+            std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+
+    return state;
+}
+
+static std::uint64_t nanoseconds(std::chrono::steady_clock::duration d) {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+}
+
+scheduler::scheduler(unsigned threads) {
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+
+    const std::size_t worker_count = threads > 1 ? threads - 1 : 0;
+
+    // Without workers the waiting thread still needs a deque to drain.
+    for (std::size_t i = 0; i < (worker_count > 0 ? worker_count : 1); i++)
+        queues.push_back(std::make_unique<worker_queue>());
+
+    for (std::size_t i = 0; i < worker_count + 1; i++)
+        counters.push_back(std::make_unique<worker_counters>());
+
+    workers.reserve(worker_count);
+
+    for (std::size_t i = 0; i < worker_count; i++)
+        workers.emplace_back(&scheduler::worker_loop, this, i);
+}
+
+scheduler::~scheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+
+    wake.notify_all();
+
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+int scheduler::current_worker() const {
+    return current_scheduler == this ? current_index : -1;
+}
+
+void scheduler::push(std::size_t queue, scheduled_task&& task) {
+    {
+        std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+        queues[queue]->tasks.push_back(std::move(task));
+    }
+
+    {
+        // Under the mutex, so that a thread about to sleep sees it.
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.fetch_add(1, std::memory_order_release);
+    }
+
+    wake.notify_one();
+}
+
+bool scheduler::take(int self, scheduled_task& task) {
+    const std::size_t slot = self >= 0 ? self : workers.size();
+
+    if (self >= 0) {
+        worker_queue& own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued.fetch_sub(1, std::memory_order_relaxed);
+
+            return true;
+        }
+    }
+
+    const std::size_t count = queues.size();
+    const std::size_t start = next_random() % count;
+
+    for (std::size_t i = 0; i < count; i++) {
+        const std::size_t victim = (start + i) % count;
+
+        if (static_cast<int>(victim) == self)
+            continue;
+
+        worker_queue& queue = *queues[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        // Outside threads own no deque, so their takes are not steals.
+        if (queue.tasks.empty()) {
+            if (self >= 0)
+                counters[slot]->failed_steals.fetch_add(
+                    1, std::memory_order_relaxed);
+            continue;
+        }
+
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        queued.fetch_sub(1, std::memory_order_relaxed);
+
+        if (self >= 0)
+            counters[slot]->steals.fetch_add(1, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    return false;
+}
+
+void scheduler::run(scheduled_task& task, std::size_t slot) {
+    worker_counters& counter = *counters[slot];
+
+    const clock::time_point start = clock::now();
+    const std::uint64_t latency = nanoseconds(start - task.submitted);
+
+    counter.latency.fetch_add(latency, std::memory_order_relaxed);
+
+    std::uint64_t max = counter.max_latency.load(std::memory_order_relaxed);
+    while (latency > max &&
+           !counter.max_latency.compare_exchange_weak(
+               max, latency, std::memory_order_relaxed)) {}
+
+    try {
+        task.body();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(task.group->error_mutex);
+
+        if (!task.group->error)
+            task.group->error = std::current_exception();
+    }
+
+    counter.busy.fetch_add(nanoseconds(clock::now() - start),
+                           std::memory_order_relaxed);
+    counter.tasks.fetch_add(1, std::memory_order_relaxed);
+
+    if (task.group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // Wake a thread waiting for the group.
+        { std::lock_guard<std::mutex> lock(mutex); }
+        wake.notify_all();
+    }
+}
+
+void scheduler::worker_loop(std::size_t index) {
+    current_scheduler = this;
+    current_index = static_cast<int>(index);
+
+    scheduled_task task;
+
+    while (true) {
+        if (take(static_cast<int>(index), task)) {
+            run(task, index);
+            task.body = nullptr;
+            continue;
+        }
+
+        const clock::time_point idle_start = clock::now();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this] {
+            return stop || queued.load(std::memory_order_acquire) > 0;
+        });
+
+        const bool done = stop && queued.load(std::memory_order_acquire) == 0;
+        lock.unlock();
+
+        counters[index]->idle.fetch_add(
+            nanoseconds(clock::now() - idle_start), std::memory_order_relaxed);
+
+        if (done)
+            return;
+    }
+}
+
+void scheduler::submit(task_group& group, std::function<void()> body) {
+    group.pending.fetch_add(1, std::memory_order_relaxed);
+
+    const int self = current_worker();
+    const std::size_t queue = self >= 0
+        ? static_cast<std::size_t>(self)
+        : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+    push(queue, scheduled_task{std::move(body), &group, clock::now()});
+}
+
+void scheduler::wait(task_group& group) {
+    const int self = current_worker();
+    const std::size_t slot = self >= 0 ? self : workers.size();
+
+    scheduled_task task;
+
+    while (!group.done()) {
+        if (take(self, task)) {
+            run(task, slot);
+            task.body = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] {
+            return group.done() ||
+                   queued.load(std::memory_order_acquire) > 0;
+        });
+    }
+
+    std::exception_ptr error;
+
+    {
+        std::lock_guard<std::mutex> lock(group.error_mutex);
+        std::swap(error, group.error);
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+/** @brief Runs body over [begin, end), splitting off upper halves. */
+static void split_range(scheduler& pool, task_group& group,
+                        std::size_t begin, std::size_t end, std::size_t grain,
+                        const std::function<void(std::size_t,
+                                                 std::size_t)>& body) {
+    while (end - begin > grain) {
+        const std::size_t middle = begin + (end - begin) / 2;
+
+        pool.submit(group, [&pool, &group, &body, middle, end, grain] {
+            split_range(pool, group, middle, end, grain, body);
+        });
+
+        end = middle;
+    }
+
+    body(begin, end);
+}
+
+void scheduler::parallel_for(std::size_t begin, std::size_t end,
+                             std::size_t grain,
+                             const std::function<void(std::size_t,
+                                                      std::size_t)>& body) {
+    if (grain == 0)
+        throw std::invalid_argument("parallel_for: grain must be > 0");
+
+    if (begin >= end)
+        return;
+
+    task_group group;
+
+    submit(group, [this, &group, &body, begin, end, grain] {
+        split_range(*this, group, begin, end, grain, body);
+    });
+
+    wait(group);
+}
+
+scheduler_stats scheduler::stats() const {
+    scheduler_stats result;
+    std::uint64_t latency = 0;
+    std::uint64_t max_latency = 0;
+    std::uint64_t idle = 0;
+    std::uint64_t busy = 0;
+
+    for (const std::unique_ptr<worker_counters>& counter : counters) {
+        result.tasks += counter->tasks.load(std::memory_order_relaxed);
+        result.steals += counter->steals.load(std::memory_order_relaxed);
+        result.failed_steals +=
+            counter->failed_steals.load(std::memory_order_relaxed);
+
+        idle += counter->idle.load(std::memory_order_relaxed);
+        busy += counter->busy.load(std::memory_order_relaxed);
+        latency += counter->latency.load(std::memory_order_relaxed);
+
+        const std::uint64_t max =
+            counter->max_latency.load(std::memory_order_relaxed);
+        max_latency = max > max_latency ? max : max_latency;
+    }
+
+    result.idle_seconds = idle * 1e-9;
+    result.busy_seconds = busy * 1e-9;
+    result.mean_latency_seconds = result.tasks ? latency * 1e-9 / result.tasks
+                                               : 0;
+    result.max_latency_seconds = max_latency * 1e-9;
+
+    return result;
+}
+
+void scheduler::reset_stats() {
+    for (const std::unique_ptr<worker_counters>& counter : counters) {
+        counter->tasks.store(0, std::memory_order_relaxed);
+        counter->steals.store(0, std::memory_order_relaxed);
+        counter->failed_steals.store(0, std::memory_order_relaxed);
+        counter->idle.store(0, std::memory_order_relaxed);
+        counter->busy.store(0, std::memory_order_relaxed);
+        counter->latency.store(0, std::memory_order_relaxed);
+        counter->max_latency.store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,192 @@
+/** @file scheduler.h */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class task_group
+ * @brief Set of tasks that can be waited for together.
+ *
+ * A group must outlive the tasks submitted to it, i.e. it must be waited
+ * for (@ref scheduler::wait) before it is destroyed.
+ */
+class task_group {
+    friend class scheduler;
+
+    private:
+        std::atomic<std::size_t> pending{0};
+        std::mutex error_mutex;
+        std::exception_ptr error;
+
+    public:
+        task_group() = default;
+        task_group(const task_group&) = delete;
+        task_group& operator=(const task_group&) = delete;
+
+        /** @returns true if every submitted task has finished. */
+        inline bool done() const {
+            return pending.load(std::memory_order_acquire) == 0;
+        }
+};
+
+/** @brief Snapshot of the scheduler counters. */
+struct scheduler_stats {
+    /** @brief Number of tasks executed. */
+    std::uint64_t tasks = 0;
+
+    /** @brief Number of tasks taken from another thread's deque. */
+    std::uint64_t steals = 0;
+
+    /** @brief Number of steal attempts that found an empty deque. */
+    std::uint64_t failed_steals = 0;
+
+    /** @brief Time workers spent blocked waiting for work, summed. */
+    double idle_seconds = 0;
+
+    /** @brief Time spent running tasks, summed over all threads. */
+    double busy_seconds = 0;
+
+    /** @brief Mean time from submission to the start of a task. */
+    double mean_latency_seconds = 0;
+
+    /** @brief Largest time from submission to the start of a task. */
+    double max_latency_seconds = 0;
+};
+
+/**
+ * @class scheduler
+ * @brief Work-stealing task scheduler.
+ *
+ * Every worker thread owns a deque. Tasks submitted from a worker are
+ * pushed to the back of its own deque and the owner pops from the back
+ * (LIFO, cache friendly for recursive splitting). Idle workers steal from
+ * the front of randomly chosen victims, taking the oldest, usually
+ * largest, pieces of work. Tasks submitted from other threads are spread
+ * round-robin over the deques.
+ *
+ * A thread calling @ref wait executes queued tasks until its group is
+ * done, so a scheduler of n threads runs n - 1 workers plus the waiting
+ * thread, and tasks may submit and wait for nested groups.
+ *
+ * The deques are protected by one mutex each. Tasks are expected to be
+ * coarse (tiles, scanline spans, ray batches, BVH subtrees), so lock
+ * traffic is negligible next to the task bodies.
+ */
+class scheduler {
+    private:
+        typedef std::chrono::steady_clock clock;
+
+        struct scheduled_task {
+            std::function<void()> body;
+            task_group* group;
+            clock::time_point submitted;
+        };
+
+        struct alignas(64) worker_queue {
+            std::mutex mutex;
+            std::deque<scheduled_task> tasks;
+        };
+
+        /** @brief Per-thread counters, in nanoseconds where timed. */
+        struct alignas(64) worker_counters {
+            std::atomic<std::uint64_t> tasks{0};
+            std::atomic<std::uint64_t> steals{0};
+            std::atomic<std::uint64_t> failed_steals{0};
+            std::atomic<std::uint64_t> idle{0};
+            std::atomic<std::uint64_t> busy{0};
+            std::atomic<std::uint64_t> latency{0};
+            std::atomic<std::uint64_t> max_latency{0};
+        };
+
+        std::vector<std::unique_ptr<worker_queue>> queues;
+
+        // One slot per worker plus a shared slot for outside threads.
+        std::vector<std::unique_ptr<worker_counters>> counters;
+
+        std::vector<std::thread> workers;
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::atomic<std::size_t> queued{0};
+        std::atomic<std::size_t> next_queue{0};
+        bool stop = false;
+
+        void push(std::size_t queue, scheduled_task&& task);
+        bool take(int self, scheduled_task& task);
+        void run(scheduled_task& task, std::size_t slot);
+        void worker_loop(std::size_t index);
+
+    public:
+        /**
+         * @brief Starts the scheduler.
+         *
+         * @param threads -> The number of threads executing tasks,
+         *                   including the thread calling wait(). 0 uses
+         *                   all hardware threads.
+         */
+        explicit scheduler(unsigned threads = 0);
+
+        /** @brief Runs the remaining queued tasks and joins the workers. */
+        ~scheduler();
+
+        scheduler(const scheduler&) = delete;
+        scheduler& operator=(const scheduler&) = delete;
+
+        /** @returns The number of threads executing tasks. */
+        inline unsigned size() const {
+            return static_cast<unsigned>(workers.size()) + 1;
+        }
+
+        /**
+         * @returns The index of the calling worker thread, in
+         *          [0, size() - 1), or -1 for threads outside the
+         *          scheduler (such as the one calling wait()).
+         */
+        int current_worker() const;
+
+        /**
+         * @brief Queues body as a task of group.
+         *
+         * May be called from any thread, including from a running task.
+         */
+        void submit(task_group& group, std::function<void()> body);
+
+        /**
+         * @brief Executes tasks until every task of group has finished.
+         *
+         * @throws The first exception thrown by a task of group, if any.
+         */
+        void wait(task_group& group);
+
+        /**
+         * @brief Calls body(first, last) over [begin, end) split into
+         *        chunks of at most grain elements, in parallel.
+         *
+         * The range is split recursively in halves, so thieves take large
+         * pieces and the owners keep the small ones.
+         *
+         * @throws std::invalid_argument if grain is 0.
+         */
+        void parallel_for(std::size_t begin, std::size_t end,
+                          std::size_t grain,
+                          const std::function<void(std::size_t,
+                                                   std::size_t)>& body);
+
+        /** @returns The counters accumulated since the last reset. */
+        scheduler_stats stats() const;
+
+        /** @brief Clears the counters. */
+        void reset_stats();
+};
@@ -0,0 +1,77 @@
+/** @file shared_buffer.h */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * @class shared_buffer
+ * @brief Immutable, reference counted array.
+ *
+ * The elements are owned by an arbitrary object (a std::vector, a
+ * memory-mapped file, ...) kept alive as long as a copy of the buffer
+ * exists. Copying a buffer never copies its elements.
+ *
+ * @tparam T -> The element type
+ */
+template <typename T>
+class shared_buffer {
+    private:
+        std::shared_ptr<const T> first;
+        std::size_t count = 0;
+
+    public:
+        /** @brief Constructs an empty buffer. */
+        shared_buffer() {}
+
+        /** @brief Takes ownership of values. */
+        explicit shared_buffer(std::vector<T> values) {
+            const std::shared_ptr<std::vector<T>> owner =
+                std::make_shared<std::vector<T>>(std::move(values));
+
+            count = owner->size();
+            first = std::shared_ptr<const T>(owner, owner->data());
+        }
+
+        /**
+         * @brief Refers to elements owned by another object.
+         *
+         * @param owner -> Kept alive while the buffer is used
+         * @param data -> The first element, inside memory owned by owner
+         * @param size -> The number of elements
+         */
+        shared_buffer(std::shared_ptr<const void> owner, const T* data,
+                      std::size_t size)
+            : first(std::move(owner), data), count(size) {}
+
+        /** @brief Returns the first element. */
+        inline const T* data() const {
+            return first.get();
+        }
+
+        /** @brief Returns the number of elements. */
+        inline std::size_t size() const {
+            return count;
+        }
+
+        /** @returns true if the buffer has no element. */
+        inline bool empty() const {
+            return count == 0;
+        }
+
+        /** @brief Returns element index. Unchecked. */
+        inline const T& operator[](std::size_t index) const {
+            return first.get()[index];
+        }
+
+        inline const T* begin() const {
+            return first.get();
+        }
+
+        inline const T* end() const {
+            return first.get() + count;
+        }
+};
@@ -0,0 +1,70 @@
+/** @file sphere.h */
+
+#pragma once
+
+#include "ray.h"
+
+/**
+ * @class sphere
+ * @brief Sphere primitive given by its center and radius.
+ */
+class sphere {
+    private:
+        vec3f c;
+        float r;
+
+    public:
+        /**
+         * @brief Constructs the sphere.
+         *
+         * @param center -> The sphere center
+         * @param radius -> The sphere radius
+         */
+        sphere(const vec3f& center, float radius) : c(center), r(radius) {}
+
+        /** @brief Returns the sphere center. */
+        inline const vec3f& center() const {
+            return c;
+        }
+
+        /** @brief Returns the sphere radius. */
+        inline float radius() const {
+            return r;
+        }
+};
+
+/**
+ * @brief Intersects a ray with a sphere.
+ *
+ * @param r -> The ray
+ * @param s -> The sphere
+ * @param t_min -> The smallest accepted hit distance
+ * @param t -> On input, the largest accepted hit distance. On a hit, it
+ *             is set to the distance of the closest intersection.
+ *
+ * @returns true if the ray hits the sphere in (t_min, t), false otherwise.
+ */
+inline bool intersect(const ray& r, const sphere& s, float t_min, float& t) {
+    const vec3f oc = r.origin() - s.center();
+
+    const float a = dot(r.direction(), r.direction());
+    const float b = dot(oc, r.direction());
+    const float c = dot(oc, oc) - s.radius() * s.radius();
+    const float discriminant = b * b - a * c;
+
+    if (discriminant < 0)
+        return false;
+
+    const float root = std::sqrt(discriminant);
+
+    float candidate = (-b - root) / a;
+    if (candidate <= t_min)
+        candidate = (-b + root) / a;
+
+    if (candidate <= t_min || candidate >= t)
+        return false;
+
+    t = candidate;
+
+    return true;
+}
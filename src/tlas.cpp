@@ -0,0 +1,82 @@
+#include "tlas.h"
+
+#include <stdexcept>
+#include <utility>
+
+instance::instance(std::shared_ptr<const blas> object,
+                   const affine_transform& object_to_world)
+    : shared_object(std::move(object)) {
+    if (!shared_object)
+        throw std::invalid_argument("instance: null object");
+
+    set_transform(object_to_world);
+}
+
+void instance::set_transform(const affine_transform& object_to_world) {
+    to_object = object_to_world.inverse();
+    to_world = object_to_world;
+}
+
+tlas::tlas(std::vector<instance> instances, scheduler* pool,
+           const bvh_build_settings& settings)
+    : instance_array(std::move(instances)), build_settings(settings) {
+    rebuild(pool);
+}
+
+void tlas::set_transform(std::size_t index,
+                         const affine_transform& object_to_world) {
+    if (index >= instance_array.size())
+        throw std::out_of_range("tlas: instance index out of range");
+
+    instance_array[index].set_transform(object_to_world);
+}
+
+void tlas::rebuild(scheduler* pool) {
+    top = bvh(primitive_bounds(instance_array), pool, build_settings);
+}
+
+/**
+ * @brief The instances seen by the top-level traversal, and where the
+ *        bottom-level traversals report their closest triangle.
+ */
+struct instance_traversal {
+    const std::vector<instance>& instances;
+    std::size_t& primitive;
+    bvh_traversal_stats* stats;
+};
+
+/** @brief Traces r through the BVH of instance index, in object space. */
+static bool intersect_primitive(const ray& r,
+                                const instance_traversal& traversal,
+                                std::size_t index, float t_min, float& t) {
+    const instance& placed = traversal.instances[index];
+    const blas& object = placed.object();
+
+    std::size_t primitive;
+
+    if (!intersect(transform_ray(placed.world_to_object(), r), object.tree,
+                   object.geometry, t_min, t, primitive, traversal.stats))
+        return false;
+
+    // Only hits closer than every previous one get here, so the last
+    // primitive reported is the closest.
+    traversal.primitive = primitive;
+
+    return true;
+}
+
+bool intersect(const ray& r, const tlas& scene, float t_min, float& t,
+               instance_hit& hit, bvh_traversal_stats* stats) {
+    std::size_t primitive = 0;
+    std::size_t index = 0;
+
+    const instance_traversal traversal{scene.instances(), primitive, stats};
+
+    if (!intersect(r, scene.top_level(), traversal, t_min, t, index, stats))
+        return false;
+
+    hit.instance_index = index;
+    hit.primitive_index = primitive;
+
+    return true;
+}
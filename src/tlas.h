@@ -0,0 +1,193 @@
+/** @file tlas.h */
+
+#pragma once
+
+#include "bvh.h"
+#include "mesh.h"
+#include "transform.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ * @brief A bottom-level acceleration structure: a mesh and the BVH built
+ *        over its triangles, in object space.
+ *
+ * Shared by every @ref instance placing it in the scene, so that copies
+ * of an object only cost their transforms.
+ */
+struct blas {
+    mesh geometry;
+    bvh tree;
+};
+
+/** @returns The object space bounding box of object. */
+inline aabb bounds(const blas& object) {
+    if (object.tree.empty())
+        return aabb();
+
+    return object.tree.nodes()[0].bounds();
+}
+
+/**
+ * @class instance
+ * @brief A placement of a shared @ref blas in the world.
+ *
+ * Both directions of the transform are kept: object to world for the
+ * bounds and world to object for the rays.
+ */
+class instance {
+    private:
+        std::shared_ptr<const blas> shared_object;
+        affine_transform to_world;
+        affine_transform to_object;
+
+    public:
+        /**
+         * @brief Constructs the instance.
+         *
+         * @param object -> The placed object
+         * @param object_to_world -> The placement
+         *
+         * @throws std::invalid_argument if object is null or the
+         *         transform is singular.
+         */
+        explicit instance(std::shared_ptr<const blas> object,
+                          const affine_transform& object_to_world =
+                              affine_transform());
+
+        /** @brief Returns the placed object. */
+        inline const blas& object() const {
+            return *shared_object;
+        }
+
+        /** @brief Returns the shared pointer to the placed object. */
+        inline const std::shared_ptr<const blas>& shared() const {
+            return shared_object;
+        }
+
+        /** @brief Returns the object to world transform. */
+        inline const affine_transform& object_to_world() const {
+            return to_world;
+        }
+
+        /** @brief Returns the world to object transform. */
+        inline const affine_transform& world_to_object() const {
+            return to_object;
+        }
+
+        /**
+         * @brief Moves the instance.
+         *
+         * @throws std::invalid_argument if the transform is singular.
+         */
+        void set_transform(const affine_transform& object_to_world);
+
+        /** @returns The object space normal n in world space, unnormalized. */
+        inline vec3f normal_to_world(const vec3f& n) const {
+            return to_object.transform_transposed(n);
+        }
+};
+
+/** @returns The world space bounding box of object. */
+inline aabb bounds(const instance& object) {
+    return transform_bounds(object.object_to_world(), bounds(object.object()));
+}
+
+/** @brief The closest hit of a ray in a @ref tlas. */
+struct instance_hit {
+    /** @brief Index of the instance in @ref tlas::instances. */
+    std::size_t instance_index = 0;
+
+    /** @brief Index of the triangle in the mesh of the instance. */
+    std::size_t primitive_index = 0;
+};
+
+/**
+ * @class tlas
+ * @brief Top-level acceleration structure: a BVH over the world bounds of
+ *        instances, whose leaves enter the BVHs of the placed objects.
+ *
+ * When objects move, only the top level is rebuilt (see @ref rebuild):
+ * its cost depends on the number of instances, not of triangles.
+ */
+class tlas {
+    private:
+        std::vector<instance> instance_array;
+        bvh top;
+        bvh_build_settings build_settings;
+
+    public:
+        /** @brief Constructs an empty TLAS. */
+        tlas() {}
+
+        /**
+         * @brief Builds the top level over instances.
+         *
+         * @param instances -> The instances
+         * @param pool -> If not null, the top level is built in parallel
+         * @param settings -> The builder parameters, also used by rebuild
+         *
+         * @throws std::invalid_argument as bvh::bvh does.
+         */
+        explicit tlas(std::vector<instance> instances,
+                      scheduler* pool = nullptr,
+                      const bvh_build_settings& settings =
+                          bvh_build_settings());
+
+        /** @brief Returns the instances. */
+        inline const std::vector<instance>& instances() const {
+            return instance_array;
+        }
+
+        /** @brief Returns the BVH over the instances. */
+        inline const bvh& top_level() const {
+            return top;
+        }
+
+        /** @returns true if the TLAS holds no instance. */
+        inline bool empty() const {
+            return instance_array.empty();
+        }
+
+        /**
+         * @brief Moves instance index.
+         *
+         * @warning The top level is stale until @ref rebuild is called.
+         *
+         * @throws std::out_of_range if index is out of range.
+         * @throws std::invalid_argument if the transform is singular.
+         */
+        void set_transform(std::size_t index,
+                           const affine_transform& object_to_world);
+
+        /**
+         * @brief Rebuilds the top level from the current transforms. The
+         *        bottom levels are left untouched.
+         *
+         * @param pool -> If not null, the top level is built in parallel
+         */
+        void rebuild(scheduler* pool = nullptr);
+};
+
+/**
+ * @brief Finds the closest triangle hit by a ray among the instances.
+ *
+ * At every top-level leaf, the ray is transformed into the object space
+ * of the instance and traced through its BVH. The direction is not
+ * renormalized, so distances along the object space ray are the world
+ * space distances.
+ *
+ * @param r -> The ray
+ * @param scene -> The TLAS
+ * @param t_min -> The smallest accepted hit distance
+ * @param t -> On input, the largest accepted hit distance. On a hit, it
+ *             is set to the distance of the closest intersection.
+ * @param hit -> Set to the closest instance and triangle on a hit.
+ * @param stats -> If not null, the work of the top and of every bottom
+ *                 level traversal is added to it.
+ *
+ * @returns true if the ray hits a triangle in (t_min, t).
+ */
+bool intersect(const ray& r, const tlas& scene, float t_min, float& t,
+               instance_hit& hit, bvh_traversal_stats* stats = nullptr);
@@ -0,0 +1,172 @@
+/** @file transform.h */
+
+#pragma once
+
+#include "aabb.h"
+#include "ray.h"
+
+#include <cmath>
+#include <stdexcept>
+
+/**
+ * @class affine_transform
+ * @brief 3x4 affine transform: a linear 3x3 part and a translation.
+ *
+ * Stored as its four columns, so that transforming a point is three
+ * vec3f multiply-adds: col[0] * x + col[1] * y + col[2] * z + col[3].
+ */
+class affine_transform {
+    private:
+        vec3f col[4];
+
+    public:
+        /** @brief Constructs the identity. */
+        affine_transform()
+            : col{vec3f(1, 0, 0), vec3f(0, 1, 0), vec3f(0, 0, 1),
+                  vec3f(0, 0, 0)} {}
+
+        /**
+         * @brief Constructs the transform from its columns.
+         *
+         * @param x -> The image of the x axis
+         * @param y -> The image of the y axis
+         * @param z -> The image of the z axis
+         * @param translation -> The image of the origin
+         */
+        affine_transform(const vec3f& x, const vec3f& y, const vec3f& z,
+                         const vec3f& translation)
+            : col{x, y, z, translation} {}
+
+        /** @returns The translation by offset. */
+        static affine_transform translation(const vec3f& offset) {
+            return affine_transform(vec3f(1, 0, 0), vec3f(0, 1, 0),
+                                    vec3f(0, 0, 1), offset);
+        }
+
+        /** @returns The scaling by factors along the axes. */
+        static affine_transform scaling(const vec3f& factors) {
+            return affine_transform(vec3f(factors.x(), 0, 0),
+                                    vec3f(0, factors.y(), 0),
+                                    vec3f(0, 0, factors.z()),
+                                    vec3f(0, 0, 0));
+        }
+
+        /**
+         * @returns The rotation by radians around axis (right-handed).
+         *
+         * @param axis -> The rotation axis. Need not be normalized.
+         * @param radians -> The angle
+         */
+        static affine_transform rotation(const vec3f& axis, float radians) {
+            const vec3f a = axis.getNormalized();
+            const float c = std::cos(radians);
+            const float s = std::sin(radians);
+            const float t = 1 - c;
+
+            return affine_transform(
+                vec3f(t * a.x() * a.x() + c, t * a.x() * a.y() + s * a.z(),
+                      t * a.x() * a.z() - s * a.y()),
+                vec3f(t * a.x() * a.y() - s * a.z(), t * a.y() * a.y() + c,
+                      t * a.y() * a.z() + s * a.x()),
+                vec3f(t * a.x() * a.z() + s * a.y(),
+                      t * a.y() * a.z() - s * a.x(), t * a.z() * a.z() + c),
+                vec3f(0, 0, 0));
+        }
+
+        /** @brief Returns column index (3 is the translation). Unchecked. */
+        inline const vec3f& column(int index) const {
+            return col[index];
+        }
+
+        /** @returns The transformed point. */
+        inline vec3f transform_point(const vec3f& p) const {
+            return col[0] * p.x() + col[1] * p.y() + col[2] * p.z() + col[3];
+        }
+
+        /** @returns The transformed vector (the translation is ignored). */
+        inline vec3f transform_vector(const vec3f& v) const {
+            return col[0] * v.x() + col[1] * v.y() + col[2] * v.z();
+        }
+
+        /**
+         * @returns v multiplied by the transposed linear part. Applied to
+         *          the inverse transform, this maps normals.
+         */
+        inline vec3f transform_transposed(const vec3f& v) const {
+            return vec3f(dot(col[0], v), dot(col[1], v), dot(col[2], v));
+        }
+
+        /** @returns The determinant of the linear part. */
+        inline float determinant() const {
+            return dot(col[0], cross(col[1], col[2]));
+        }
+
+        /**
+         * @returns The inverse transform.
+         *
+         * @throws std::invalid_argument if the transform is singular.
+         */
+        affine_transform inverse() const {
+            const float det = determinant();
+
+            if (!(std::fabs(det) > 0) || !std::isfinite(det))
+                throw std::invalid_argument("affine_transform: singular "
+                                            "transform");
+
+            // The rows of the inverse of [a b c] are the cross products
+            // of its columns, over the determinant.
+            const vec3f r0 = cross(col[1], col[2]) / det;
+            const vec3f r1 = cross(col[2], col[0]) / det;
+            const vec3f r2 = cross(col[0], col[1]) / det;
+
+            const affine_transform linear(vec3f(r0.x(), r1.x(), r2.x()),
+                                          vec3f(r0.y(), r1.y(), r2.y()),
+                                          vec3f(r0.z(), r1.z(), r2.z()),
+                                          vec3f(0, 0, 0));
+
+            return affine_transform(linear.col[0], linear.col[1],
+                                    linear.col[2],
+                                    -linear.transform_vector(col[3]));
+        }
+};
+
+/** @returns The transform applying b, then a. */
+inline affine_transform operator*(const affine_transform& a,
+                                  const affine_transform& b) {
+    return affine_transform(a.transform_vector(b.column(0)),
+                            a.transform_vector(b.column(1)),
+                            a.transform_vector(b.column(2)),
+                            a.transform_point(b.column(3)));
+}
+
+/**
+ * @returns The ray with transformed origin and direction. The direction
+ *          is not renormalized, so hit distances are preserved.
+ */
+inline ray transform_ray(const affine_transform& transform, const ray& r) {
+    return ray(transform.transform_point(r.origin()),
+               transform.transform_vector(r.direction()));
+}
+
+/**
+ * @returns The bounding box of the transformed box (Arvo's method: the
+ *          extremes of every output axis, one input axis at a time).
+ */
+inline aabb transform_bounds(const affine_transform& transform,
+                             const aabb& box) {
+    if (box.empty())
+        return box;
+
+    vec3f lo = transform.column(3);
+    vec3f hi = lo;
+
+    for (int axis = 0; axis < 3; axis++) {
+        const vec3f a = transform.column(axis) * box.min().component(axis);
+        const vec3f b = transform.column(axis) * box.max().component(axis);
+
+        lo += vec3_min(a, b);
+        hi += vec3_max(a, b);
+    }
+
+    return aabb(lo, hi);
+}
@@ -0,0 +1,316 @@
+/** @file triangle.h */
+
+#pragma once
+
+#include "ray.h"
+
+#include <cmath>
+
+/**
+ * @class triangle
+ * @brief Triangle primitive given by its three vertices.
+ */
+class triangle {
+    private:
+        vec3f vertex[3];
+
+    public:
+        /**
+         * @brief Constructs the triangle.
+         *
+         * @param v0 -> The first vertex
+         * @param v1 -> The second vertex
+         * @param v2 -> The third vertex
+         */
+        triangle(const vec3f& v0, const vec3f& v1, const vec3f& v2)
+            : vertex{v0, v1, v2} {}
+
+        /** @brief Returns the first vertex. */
+        inline const vec3f& v0() const {
+            return vertex[0];
+        }
+
+        /** @brief Returns the second vertex. */
+        inline const vec3f& v1() const {
+            return vertex[1];
+        }
+
+        /** @brief Returns the third vertex. */
+        inline const vec3f& v2() const {
+            return vertex[2];
+        }
+};
+
+/**
+ * @brief Intersects a ray with a triangle (Möller–Trumbore).
+ *
+ * @param r -> The ray
+ * @param tri -> The triangle
+ * @param t_min -> The smallest accepted hit distance
+ * @param t -> On input, the largest accepted hit distance. On a hit, it
+ *             is set to the distance of the intersection.
+ *
+ * @returns true if the ray hits the triangle in (t_min, t), 
+ *          false otherwise.
+ */
+inline bool intersect(const ray& r, const triangle& tri, 
+                      float t_min, float& t) {
+    const vec3f edge_1 = tri.v1() - tri.v0();
+    const vec3f edge_2 = tri.v2() - tri.v0();
+
+    const vec3f p = cross(r.direction(), edge_2);
+    const float determinant = dot(edge_1, p);
+
+    if (determinant == 0)
+        return false;
+
+    const float inverse_determinant = 1.0f / determinant;
+
+    const vec3f s = r.origin() - tri.v0();
+    const float u = dot(s, p) * inverse_determinant;
+
+    if (u < 0 || u > 1)
+        return false;
+
+    const vec3f q = cross(s, edge_1);
+    const float v = dot(r.direction(), q) * inverse_determinant;
+
+    if (v < 0 || u + v > 1)
+        return false;
+
+    const float candidate = dot(edge_2, q) * inverse_determinant;
+
+    if (candidate <= t_min || candidate >= t)
+        return false;
+
+    t = candidate;
+
+    return true;
+}
+
+/**
+ * @class watertight_ray
+ * @brief Per-ray data of the watertight triangle test.
+ *
+ * The ray is transformed so that it starts at the origin and points
+ * along +z: kz is the dominant direction axis, kx and ky the other two
+ * (swapped if needed to keep the winding), and shear maps the direction
+ * onto (0, 0, 1). Computing it once per ray amortizes the divisions over
+ * all the triangles the ray is tested against.
+ */
+class watertight_ray {
+    private:
+        vec3f orig;
+        int axis[3];
+        float shear[3];
+
+    public:
+        /** @brief Precomputes the transform of r. */
+        explicit watertight_ray(const ray& r) : orig(r.origin()) {
+            const vec3f& d = r.direction();
+            const float ax = std::fabs(d.x());
+            const float ay = std::fabs(d.y());
+            const float az = std::fabs(d.z());
+
+            const int kz = ax > ay ? (ax > az ? 0 : 2) : (ay > az ? 1 : 2);
+            int kx = kz == 2 ? 0 : kz + 1;
+            int ky = kx == 2 ? 0 : kx + 1;
+
+            if (d.component(kz) < 0) {
+                const int swap = kx;
+                kx = ky;
+                ky = swap;
+            }
+
+            axis[0] = kx;
+            axis[1] = ky;
+            axis[2] = kz;
+
+            shear[0] = d.component(kx) / d.component(kz);
+            shear[1] = d.component(ky) / d.component(kz);
+            shear[2] = 1.0f / d.component(kz);
+        }
+
+        /** @brief Returns the ray origin. */
+        inline const vec3f& origin() const {
+            return orig;
+        }
+
+        /** @returns The permuted axis index (0 -> kx, 1 -> ky, 2 -> kz). */
+        inline int permuted(int index) const {
+            return axis[index];
+        }
+
+        /** @returns The shear constant (0 -> Sx, 1 -> Sy, 2 -> Sz). */
+        inline float shear_constant(int index) const {
+            return shear[index];
+        }
+};
+
+/**
+ * @brief Intersects a ray with a triangle, watertight (Woop, Benthin and
+ *        Wald, JCGT 2013).
+ *
+ * Unlike Möller–Trumbore, rays through a shared edge or vertex of two
+ * triangles never slip between them: the edge functions are evaluated
+ * in the ray's sheared space, where the same edge yields exactly
+ * opposite values for both triangles, and recomputed in double precision
+ * when one of them is exactly 0.
+ *
+ * @param r -> The precomputed ray
+ * @param tri -> The triangle
+ * @param t_min -> The smallest accepted hit distance
+ * @param t -> On input, the largest accepted hit distance. On a hit, it
+ *             is set to the distance of the intersection.
+ *
+ * @returns true if the ray hits the triangle in (t_min, t),
+ *          false otherwise. Both faces are hit.
+ */
+inline bool intersect_watertight(const watertight_ray& r,
+                                 const triangle& tri, float t_min,
+                                 float& t) {
+    const int kx = r.permuted(0);
+    const int ky = r.permuted(1);
+    const int kz = r.permuted(2);
+
+    const float sx = r.shear_constant(0);
+    const float sy = r.shear_constant(1);
+    const float sz = r.shear_constant(2);
+
+    const vec3f a = tri.v0() - r.origin();
+    const vec3f b = tri.v1() - r.origin();
+    const vec3f c = tri.v2() - r.origin();
+
+    const float a_x = a.component(kx) - sx * a.component(kz);
+    const float a_y = a.component(ky) - sy * a.component(kz);
+    const float b_x = b.component(kx) - sx * b.component(kz);
+    const float b_y = b.component(ky) - sy * b.component(kz);
+    const float c_x = c.component(kx) - sx * c.component(kz);
+    const float c_y = c.component(ky) - sy * c.component(kz);
+
+    float u = c_x * b_y - c_y * b_x;
+    float v = a_x * c_y - a_y * c_x;
+    float w = b_x * a_y - b_y * a_x;
+
+    if (u == 0 || v == 0 || w == 0) {
+        u = static_cast<float>(double(c_x) * b_y - double(c_y) * b_x);
+        v = static_cast<float>(double(a_x) * c_y - double(a_y) * c_x);
+        w = static_cast<float>(double(b_x) * a_y - double(b_y) * a_x);
+    }
+
+    if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0))
+        return false;
+
+    const float determinant = u + v + w;
+
+    if (determinant == 0)
+        return false;
+
+    const float scaled_t = u * sz * a.component(kz) +
+                           v * sz * b.component(kz) +
+                           w * sz * c.component(kz);
+    const float candidate = scaled_t / determinant;
+
+    if (!(candidate > t_min && candidate < t))
+        return false;
+
+    t = candidate;
+
+    return true;
+}
+
+/** @brief Watertight test of an unprepared ray. See the overload above. */
+inline bool intersect_watertight(const ray& r, const triangle& tri,
+                                 float t_min, float& t) {
+    return intersect_watertight(watertight_ray(r), tri, t_min, t);
+}
+
+/**
+ * @class triangle_precomputed
+ * @brief Triangle stored with its edges and (unnormalized) normal.
+ *
+ * Four vec3f instead of the three of @ref triangle: 64 bytes instead of
+ * 48 with the padded SIMD vec3f (48 instead of 36 without). In exchange
+ * the intersection test needs one subtraction, one cross product and
+ * four dot products instead of three subtractions, two cross products
+ * and four dot products. Meant for meshes whose triangles are tested far
+ * more often than they are stored or updated.
+ */
+class triangle_precomputed {
+    private:
+        vec3f vertex;
+        vec3f edge[2];
+        vec3f n;
+
+    public:
+        /** @brief Precomputes the data of tri. */
+        explicit triangle_precomputed(const triangle& tri)
+            : vertex(tri.v0()) {
+            edge[0] = tri.v1() - tri.v0();
+            edge[1] = tri.v2() - tri.v0();
+            n = cross(edge[0], edge[1]);
+        }
+
+        /** @brief Returns the first vertex. */
+        inline const vec3f& v0() const {
+            return vertex;
+        }
+
+        /** @brief Returns v1 - v0. */
+        inline const vec3f& edge_1() const {
+            return edge[0];
+        }
+
+        /** @brief Returns v2 - v0. */
+        inline const vec3f& edge_2() const {
+            return edge[1];
+        }
+
+        /** @brief Returns cross(edge_1, edge_2). */
+        inline const vec3f& normal() const {
+            return n;
+        }
+};
+
+/**
+ * @brief Intersects a ray with a precomputed triangle.
+ *
+ * Möller–Trumbore rewritten with the scalar triple product identities,
+ * for r = cross(s, d) and s = o - v0:
+ * det = -dot(d, n), u = dot(e2, r) / det, v = -dot(e1, r) / det and
+ * t = dot(s, n) / det. Accepts the same hits as the compact kernel up to
+ * rounding.
+ *
+ * See the Möller–Trumbore overload for the parameter semantics.
+ */
+inline bool intersect(const ray& r, const triangle_precomputed& tri,
+                      float t_min, float& t) {
+    const float determinant = -dot(r.direction(), tri.normal());
+
+    if (determinant == 0)
+        return false;
+
+    const float inverse_determinant = 1.0f / determinant;
+
+    const vec3f s = r.origin() - tri.v0();
+    const vec3f q = cross(s, r.direction());
+
+    const float u = dot(tri.edge_2(), q) * inverse_determinant;
+
+    if (u < 0 || u > 1)
+        return false;
+
+    const float v = -dot(tri.edge_1(), q) * inverse_determinant;
+
+    if (v < 0 || u + v > 1)
+        return false;
+
+    const float candidate = dot(s, tri.normal()) * inverse_determinant;
+
+    if (candidate <= t_min || candidate >= t)
+        return false;
+
+    t = candidate;
+
+    return true;
+}
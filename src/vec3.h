@@ -6,6 +6,57 @@
 #include <cmath>
 #include <type_traits>
 #include <exception>
+#include <stdexcept>
+#include <limits>
+
+#if defined(__SSE2__) && !defined(RAYSTALKER_NO_SIMD)
+#define RAYSTALKER_SIMD 1
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Whether vec3_::operator[] checks its index.
+ *
+ * Defining RAYSTALKER_CHECKED (done by the debug and test builds) keeps
+ * the std::out_of_range check. Release builds index the components
+ * directly and the operator is noexcept.
+ *
+ * @warning Every translation unit of a program must agree on the macro.
+ */
+#ifdef RAYSTALKER_CHECKED
+constexpr bool vec3_checked_access = true;
+#else
+constexpr bool vec3_checked_access = false;
+#endif
+
+/**
+ * @brief The type returned by dot, length and squared_length for vec3_s
+ *        with Type components.
+ *
+ * Floating point vectors keep their own precision (float for vec3f,
+ * double for vec3d). Integer vectors use double.
+ */
+template <typename Type>
+using vec3_scalar_t = typename std::conditional<
+    std::is_floating_point<Type>::value, Type, double>::type;
+
+/**
+ * @brief Type, in a context that takes no part in template argument
+ *        deduction (std::type_identity_t of C++20).
+ *
+ * The scalars of the vec3_ operators are declared with it, so that any
+ * arithmetic scalar converts to the component type (v * 2, v / 2) for
+ * every Type, as it does for the non-template vec3f SIMD overloads.
+ */
+template <typename Type>
+struct vec3_identity {
+    typedef Type type;
+};
+
+template <typename Type>
+using vec3_identity_t = typename vec3_identity<Type>::type;
+
+struct normalize_exact;
 
 /**
  * @class vec3_
@@ -33,11 +84,7 @@ class vec3_ {
          * @warning If Type is not arithmetic, a static assertion 
          *          halts the program.
          */
-        vec3_() {
-            dimension[0] = Type();
-            dimension[1] = Type();
-            dimension[2] = Type();
-
+        constexpr vec3_() noexcept : dimension{} {
             static_assert(std::is_arithmetic<Type>::value,
                           "ERROR: vec3_ uses only arithmetic types.");
         }
@@ -52,13 +99,10 @@ class vec3_ {
          * @warning If Type is not arithmetic, a static assertion 
          *          halts the program.
          */
-        vec3_(const Type& x, const Type& y, const Type& z) {
+        constexpr vec3_(const Type& x, const Type& y, const Type& z) noexcept
+            : dimension{x, y, z} {
             static_assert(std::is_arithmetic<Type>::value,
                           "ERROR: vec3_ uses only arithmetic types.");
-
-            dimension[0] = x;
-            dimension[1] = y;
-            dimension[2] = z;
         }
 
         /**
@@ -67,32 +111,23 @@ class vec3_ {
          * @param vec -> The vector to copy
          *
          * The internal component values of vec are assigned to the vec3
-         * on which this is called.
-         *
-         * @warning If Type is not arithmetic, a static assertion 
-         *          halts the program.
+         * on which this is called. Defaulted, so vec3_ stays trivially
+         * copyable.
          */
-        vec3_(const vec3_& vec) {
-            static_assert(std::is_arithmetic<Type>::value,
-                          "ERROR: vec3_ uses only arithmetic types.");
-
-            dimension[0] = vec.x();
-            dimension[1] = vec.y();
-            dimension[2] = vec.z();
-        }
+        constexpr vec3_(const vec3_& vec) noexcept = default;
 
         /** @brief Returns the x-component value. */
-        inline Type x() const {
+        constexpr Type x() const noexcept {
             return dimension[0];
         }
 
         /** @brief Returns the y-component value. */
-        inline Type y() const {
+        constexpr Type y() const noexcept {
             return dimension[1];
         }
 
         /** @brief Returns the z-component value. */
-        inline Type z() const {
+        constexpr Type z() const noexcept {
             return dimension[2];
         }
 
@@ -104,13 +139,7 @@ class vec3_ {
          * The internal component values of vec are assigned to the vec3
          * on which this is called.
          */
-        inline vec3_& operator=(const vec3_& vec) {
-            dimension[0] = vec.x();
-            dimension[1] = vec.y();
-            dimension[2] = vec.z();
-
-            return *this;
-        }
+        constexpr vec3_& operator=(const vec3_& vec) noexcept = default;
 
         /**
          * @brief Equality operator.
@@ -120,7 +149,7 @@ class vec3_ {
          * @returns true if all the component values of the vectors are equal,
          *          false otherwise
          */
-        inline const bool operator==(const vec3_& vec) const {
+        constexpr bool operator==(const vec3_& vec) const noexcept {
             if (this->x() != vec.x() ||
                 this->y() != vec.y() || 
                 this->z() != vec.z())
@@ -137,7 +166,7 @@ class vec3_ {
          * @returns true if all the component values of the vectors are 
          *          not equal, false otherwise
          */
-        inline const bool operator!=(const vec3_& vec) const {
+        constexpr bool operator!=(const vec3_& vec) const noexcept {
             return !(*this == vec);
         }
 
@@ -147,7 +176,7 @@ class vec3_ {
          * @warning Overflow / underflow of component values
          *          results in undefined behaviour.
          */
-        inline const vec3_& operator+() const {
+        constexpr const vec3_& operator+() const noexcept {
             return *this;
         }
 
@@ -157,10 +186,38 @@ class vec3_ {
          * @warning Overflow / underflow of component values 
          *          result in undefined behaviour.
          */
-        inline const vec3_& operator-() const {
+        constexpr vec3_ operator-() const noexcept {
             return vec3_(-dimension[0], -dimension[1], -dimension[2]);
         }
 
+        /**
+         * @brief Unchecked component access (const).
+         *
+         * @param index -> The index of the component
+         *
+         * @returns x, y, z component values for the 0, 1, 2 index values.
+         *
+         * @warning The index is not checked. Out of bounds access results
+         *          in undefined behaviour. Used by the library internally.
+         */
+        constexpr Type component(size_t index) const noexcept {
+            return dimension[index];
+        }
+
+        /**
+         * @brief Unchecked component access.
+         *
+         * @param index -> The index of the component
+         *
+         * @returns x, y, z component values for the 0, 1, 2 index values.
+         *
+         * @warning The index is not checked. Out of bounds access results
+         *          in undefined behaviour. Used by the library internally.
+         */
+        constexpr Type& component(size_t index) noexcept {
+            return dimension[index];
+        }
+
         /**
          * @brief Direct access operator (const).
          *
@@ -168,12 +225,17 @@ class vec3_ {
          *
          * @returns x, y, z component values for the 0, 1, 2 index values.
          *
-         * @warning If index is out of bounds (negative or bigger than 2),
-         *          std::out_of_range is thrown.
+         * @warning If RAYSTALKER_CHECKED is defined and index is out of 
+         *          bounds (negative or bigger than 2), std::out_of_range
+         *          is thrown. Otherwise out of bounds access results in
+         *          undefined behaviour.
          */
-        inline Type operator[](size_t index) const {
-            if (index > 2)
-                throw std::out_of_range("vec3_[] out of range");
+        constexpr Type operator[](size_t index) const 
+            noexcept(!vec3_checked_access) {
+            if constexpr (vec3_checked_access) {
+                if (index > 2)
+                    throw std::out_of_range("vec3_[] out of range");
+            }
 
             return dimension[index];
         }
@@ -185,12 +247,17 @@ class vec3_ {
          *
          * @returns x, y, z component values for the 0, 1, 2 index values.
          *
-         * @warning If index is out of bounds (bigger than 2),
-         *          std::out_of_range is thrown.
+         * @warning If RAYSTALKER_CHECKED is defined and index is out of 
+         *          bounds (bigger than 2), std::out_of_range is thrown.
+         *          Otherwise out of bounds access results in undefined
+         *          behaviour.
          */
-        inline Type& operator[](size_t index) {
-            if (index > 2)
-                throw std::out_of_range("vec3_[] out of range");
+        constexpr Type& operator[](size_t index) 
+            noexcept(!vec3_checked_access) {
+            if constexpr (vec3_checked_access) {
+                if (index > 2)
+                    throw std::out_of_range("vec3_[] out of range");
+            }
 
             return dimension[index];
         }
@@ -205,7 +272,7 @@ class vec3_ {
          * @warning Overflow / underflow of component values
          *          result in undefined behaviour.
          */
-        inline vec3_& operator+=(const vec3_& vec) {
+        constexpr vec3_& operator+=(const vec3_& vec) noexcept {
             dimension[0] += vec.x();
             dimension[1] += vec.y();
             dimension[2] += vec.z();
@@ -223,7 +290,7 @@ class vec3_ {
          * @warning Overflow / underflow of component values
          *          result in undefined behaviour.
          */
-        inline vec3_& operator-=(const vec3_& vec) {
+        constexpr vec3_& operator-=(const vec3_& vec) noexcept {
             dimension[0] -= vec.x();
             dimension[1] -= vec.y();
             dimension[2] -= vec.z();
@@ -241,7 +308,7 @@ class vec3_ {
          * @warning Overflow / underflow of component values
          *          result in undefined behaviour.
          */
-        inline vec3_& operator*=(const vec3_& vec) {
+        constexpr vec3_& operator*=(const vec3_& vec) noexcept {
             dimension[0] *= vec.x();
             dimension[1] *= vec.y();
             dimension[2] *= vec.z();
@@ -259,7 +326,7 @@ class vec3_ {
          * @warning Overflow / underflow of component values
          *          result in undefined behaviour.
          */
-        inline vec3_& operator/=(const vec3_& vec) {
+        constexpr vec3_& operator/=(const vec3_& vec) noexcept {
             dimension[0] /= vec.x();
             dimension[1] /= vec.y();
             dimension[2] /= vec.z();
@@ -278,7 +345,7 @@ class vec3_ {
          * @warning Overflow / underflow of component values
          *          result in undefined behaviour.
          */
-        inline vec3_& operator*=(const Type& value) {
+        constexpr vec3_& operator*=(const Type& value) noexcept {
             dimension[0] *= value;
             dimension[1] *= value;
             dimension[2] *= value;
@@ -297,7 +364,7 @@ class vec3_ {
          * @warning Overflow / underflow of component values
          *          result in undefined behaviour.
          */
-        inline vec3_& operator/=(const Type& value) {
+        constexpr vec3_& operator/=(const Type& value) noexcept {
             dimension[0] /= value;
             dimension[1] /= value;
             dimension[2] /= value;
@@ -308,16 +375,14 @@ class vec3_ {
         /**
          * @returns The length of the vector.
          */
-        inline double length() const {
-            return sqrt(dimension[0] * dimension[0] + 
-                        dimension[1] * dimension[1] +
-                        dimension[2] * dimension[2]);
+        inline vec3_scalar_t<Type> length() const noexcept {
+            return std::sqrt(squared_length());
         }
 
         /**
          * @returns The squared length of the vector.
          */
-        inline double squared_length() const {
+        constexpr vec3_scalar_t<Type> squared_length() const noexcept {
             return dimension[0] * dimension[0] +
                    dimension[1] * dimension[1] +
                    dimension[2] * dimension[2];
@@ -326,35 +391,30 @@ class vec3_ {
         /**
          * @brief Normalizes the vector.
          *
-         * @warning Currently, the multiplication operators
-         *          are defined for scalars/vectors of the same type as the
-         *          vector components. That means that normalizing
-         *          a non-floating point type vector doesn't work very
-         *          well, so using @ref vec3_convert is recommended.
+         * @tparam Policy -> The accuracy tier: @ref normalize_exact
+         *                   (default), @ref normalize_rsqrt_newton or
+         *                   @ref normalize_rsqrt.
+         *
+         * @warning Normalizing a non-floating point type vector doesn't 
+         *          work very well (the components are truncated), so 
+         *          using @ref vec3_convert is recommended.
+         *
+         * @warning A zero-length vector results in NaN components. Use
+         *          @ref normalize_safe if the input can be degenerate.
          */
-        inline void normalize() {
-            int len = this->length();
-
-            dimension[0] /= len;
-            dimension[1] /= len;
-            dimension[2] /= len;
+        template <typename Policy = normalize_exact>
+        inline void normalize() noexcept {
+            *this = Policy::normalized(*this);
         }
 
         /** 
          * @brief Returns the normalized version of the vector.
          *
-         * @warning Currently, the multiplication operators
-         *          are defined for scalars/vectors of the same type as the
-         *          vector components. That means that normalizing
-         *          a non-floating point type vector doesn't work very
-         *          well, so using @ref vec3_convert is recommended.
+         * See @ref normalize for the template parameter and warnings.
          */
-        inline vec3_ getNormalized() {
-            int len = this->length();
-
-            return vec3_(dimension[0] / len,
-                         dimension[1] / len,
-                         dimension[2] / len);
+        template <typename Policy = normalize_exact>
+        inline vec3_ getNormalized() const noexcept {
+            return Policy::normalized(*this);
         }
 };
 
@@ -365,7 +425,8 @@ class vec3_ {
  *          results in undefined behaviour.
  */
 template <typename Type>
-inline vec3_<Type> operator+(const vec3_<Type>& v1, const vec3_<Type>& v2) {
+constexpr vec3_<Type> operator+(const vec3_<Type>& v1,
+                                const vec3_<Type>& v2) noexcept {
     return vec3_<Type>(v1.x() + v2.x(), v1.y() + v2.y(), v1.z() + v2.z());
 }
 
@@ -376,7 +437,8 @@ inline vec3_<Type> operator+(const vec3_<Type>& v1, const vec3_<Type>& v2) {
  *          results in undefined behaviour.
  */
 template <typename Type>
-inline vec3_<Type> operator-(const vec3_<Type>& v1, const vec3_<Type>& v2) {
+constexpr vec3_<Type> operator-(const vec3_<Type>& v1,
+                                const vec3_<Type>& v2) noexcept {
     return vec3_<Type>(v1.x() - v2.x(), v1.y() - v2.y(), v1.z() - v2.z());
 }
 
@@ -387,7 +449,8 @@ inline vec3_<Type> operator-(const vec3_<Type>& v1, const vec3_<Type>& v2) {
  *          results in undefined behaviour.
  */
 template <typename Type>
-inline vec3_<Type> operator*(const vec3_<Type>& v1, const vec3_<Type>& v2) {
+constexpr vec3_<Type> operator*(const vec3_<Type>& v1,
+                                const vec3_<Type>& v2) noexcept {
     return vec3_<Type>(v1.x() * v2.x(), v1.y() * v2.y(), v1.z() * v2.z());
 }
 
@@ -398,7 +461,8 @@ inline vec3_<Type> operator*(const vec3_<Type>& v1, const vec3_<Type>& v2) {
  *          results in undefined behaviour.
  */
 template <typename Type>
-inline vec3_<Type> operator/(const vec3_<Type>& v1, const vec3_<Type>& v2) {
+constexpr vec3_<Type> operator/(const vec3_<Type>& v1,
+                                const vec3_<Type>& v2) noexcept {
     return vec3_<Type>(v1.x() / v2.x(), v1.y() / v2.y(), v1.z() / v2.z());
 }
 
@@ -409,7 +473,8 @@ inline vec3_<Type> operator/(const vec3_<Type>& v1, const vec3_<Type>& v2) {
  *          results in undefined behaviour.
  */
 template <typename Type>
-inline vec3_<Type> operator/(const vec3_<Type>& v, const Type& value) {
+constexpr vec3_<Type> operator/(const vec3_<Type>& v,
+                                const vec3_identity_t<Type>& value) noexcept {
     return vec3_<Type>(v.x() / value, v.y() / value, v.z() / value);
 }
 
@@ -420,7 +485,8 @@ inline vec3_<Type> operator/(const vec3_<Type>& v, const Type& value) {
  *          results in undefined behaviour.
  */
 template <typename Type>
-inline vec3_<Type> operator*(const vec3_<Type>& v, const Type& value) {
+constexpr vec3_<Type> operator*(const vec3_<Type>& v,
+                                const vec3_identity_t<Type>& value) noexcept {
     return vec3_<Type>(v.x() * value, v.y() * value, v.z() * value);
 }
 
@@ -431,7 +497,8 @@ inline vec3_<Type> operator*(const vec3_<Type>& v, const Type& value) {
  *          results in undefined behaviour.
  */
 template <typename Type>
-inline vec3_<Type> operator*(const Type& value, const vec3_<Type>& v) {
+constexpr vec3_<Type> operator*(const vec3_identity_t<Type>& value,
+                                const vec3_<Type>& v) noexcept {
     return vec3_<Type>(v.x() * value, v.y() * value, v.z() * value);
 }
 
@@ -439,7 +506,8 @@ inline vec3_<Type> operator*(const Type& value, const vec3_<Type>& v) {
  * @returns the dot product of the two vectors
  */
 template <typename Type>
-inline double dot(const vec3_<Type>& v1, const vec3_<Type>& v2) {
+constexpr vec3_scalar_t<Type> dot(const vec3_<Type>& v1,
+                                  const vec3_<Type>& v2) noexcept {
     return v1.x() * v2.x() + v1.y() * v2.y() + v1.z() * v2.z();
 }
 
@@ -450,12 +518,39 @@ inline double dot(const vec3_<Type>& v1, const vec3_<Type>& v2) {
  *          results in undefined behaviour.
  */
 template <typename Type>
-inline vec3_<Type> cross(const vec3_<Type>& v1, const vec3_<Type>& v2) {
+constexpr vec3_<Type> cross(const vec3_<Type>& v1,
+                            const vec3_<Type>& v2) noexcept {
     return vec3_<Type>(v1.y() * v2.z() - v1.z() * v2.y(),
                        v1.z() * v2.x() - v1.x() * v2.z(),
                        v1.x() * v2.y() - v1.y() * v2.x());
 }
 
+/**
+ * @returns The component-wise minimum of the two vectors.
+ *
+ * Each component is v1 < v2 ? v1 : v2, so a NaN component yields v2's.
+ */
+template <typename Type>
+constexpr vec3_<Type> vec3_min(const vec3_<Type>& v1,
+                               const vec3_<Type>& v2) noexcept {
+    return vec3_<Type>(v1.x() < v2.x() ? v1.x() : v2.x(),
+                       v1.y() < v2.y() ? v1.y() : v2.y(),
+                       v1.z() < v2.z() ? v1.z() : v2.z());
+}
+
+/**
+ * @returns The component-wise maximum of the two vectors.
+ *
+ * Each component is v1 > v2 ? v1 : v2, so a NaN component yields v2's.
+ */
+template <typename Type>
+constexpr vec3_<Type> vec3_max(const vec3_<Type>& v1,
+                               const vec3_<Type>& v2) noexcept {
+    return vec3_<Type>(v1.x() > v2.x() ? v1.x() : v2.x(),
+                       v1.y() > v2.y() ? v1.y() : v2.y(),
+                       v1.z() > v2.z() ? v1.z() : v2.z());
+}
+
 /**
  * @brief Converts a vec3 to another type.
  *
@@ -467,13 +562,599 @@ inline vec3_<Type> cross(const vec3_<Type>& v1, const vec3_<Type>& v2) {
  * @param vec -> The vector to convert
  */
 template <typename inType, typename outType>
-inline vec3_<outType> vec3_convert(const vec3_<inType>& vec) {
+constexpr vec3_<outType> vec3_convert(const vec3_<inType>& vec) noexcept {
     return vec3_<outType>(static_cast<outType>(vec.x()),
                           static_cast<outType>(vec.y()),
                           static_cast<outType>(vec.z()));
 }
 
+/**
+ * @brief The result type of mixing vec3_<A> and vec3_<B>.
+ *
+ * Defined only for two different floating point component types, in
+ * which case it is the wider one (std::common_type). Mixed operators are
+ * evaluated by promoting both operands with @ref vec3_convert.
+ */
+template <typename A, typename B>
+using vec3_promote_t = typename std::enable_if<
+    std::is_floating_point<A>::value && std::is_floating_point<B>::value &&
+    !std::is_same<A, B>::value,
+    typename std::common_type<A, B>::type>::type;
+
+/** @returns the addition result of the two vectors, promoted. */
+template <typename A, typename B>
+constexpr vec3_<vec3_promote_t<A, B>> operator+(const vec3_<A>& v1,
+                                                const vec3_<B>& v2) noexcept {
+    typedef vec3_promote_t<A, B> Type;
+
+    return vec3_convert<A, Type>(v1) + vec3_convert<B, Type>(v2);
+}
+
+/** @returns the subtraction result of the two vectors, promoted. */
+template <typename A, typename B>
+constexpr vec3_<vec3_promote_t<A, B>> operator-(const vec3_<A>& v1,
+                                                const vec3_<B>& v2) noexcept {
+    typedef vec3_promote_t<A, B> Type;
+
+    return vec3_convert<A, Type>(v1) - vec3_convert<B, Type>(v2);
+}
+
+/** @returns the multiplication result of the two vectors, promoted. */
+template <typename A, typename B>
+constexpr vec3_<vec3_promote_t<A, B>> operator*(const vec3_<A>& v1,
+                                                const vec3_<B>& v2) noexcept {
+    typedef vec3_promote_t<A, B> Type;
+
+    return vec3_convert<A, Type>(v1) * vec3_convert<B, Type>(v2);
+}
+
+/** @returns the division result of the two vectors, promoted. */
+template <typename A, typename B>
+constexpr vec3_<vec3_promote_t<A, B>> operator/(const vec3_<A>& v1,
+                                                const vec3_<B>& v2) noexcept {
+    typedef vec3_promote_t<A, B> Type;
+
+    return vec3_convert<A, Type>(v1) / vec3_convert<B, Type>(v2);
+}
+
+/** @returns the dot product of the two vectors, promoted. */
+template <typename A, typename B>
+constexpr vec3_promote_t<A, B> dot(const vec3_<A>& v1,
+                                   const vec3_<B>& v2) noexcept {
+    typedef vec3_promote_t<A, B> Type;
+
+    return dot(vec3_convert<A, Type>(v1), vec3_convert<B, Type>(v2));
+}
+
+/** @returns the cross product of the two vectors, promoted. */
+template <typename A, typename B>
+constexpr vec3_<vec3_promote_t<A, B>> cross(const vec3_<A>& v1,
+                                            const vec3_<B>& v2) noexcept {
+    typedef vec3_promote_t<A, B> Type;
+
+    return cross(vec3_convert<A, Type>(v1), vec3_convert<B, Type>(v2));
+}
+
+#ifdef RAYSTALKER_SIMD
+
+/**
+ * @brief True while the enclosing constexpr function is being evaluated
+ *        at compile time.
+ *
+ * The SSE intrinsics are not constexpr, so the vec3_<float> specialization
+ * takes an equivalent scalar path in constant expressions.
+ */
+#define RAYSTALKER_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+
+/**
+ * @class vec3_<float>
+ * @brief SSE-backed specialization of vec3_ used by vec3f / colorf.
+ *
+ * The components live in a 16-byte aligned four-lane array so that every
+ * operation is a single load, a couple of packed instructions and a store.
+ * The fourth lane is padding: its value is unspecified and is ignored by
+ * every operation (equality, dot, length, ...).
+ *
+ * Only SSE2 is required. dot() uses the SSE4.1 dpps instruction when
+ * __SSE4_1__ is defined. Compiling with RAYSTALKER_NO_SIMD (or for a
+ * target without SSE2) selects the generic scalar template instead.
+ */
+template <>
+class alignas(16) vec3_<float> {
+    private:
+        float dimension[4];
+
+        /** @returns x*x' + y*y' + z*z' of the two packed vectors. */
+        static inline float dot3(__m128 v1, __m128 v2) noexcept {
+#ifdef __SSE4_1__
+            return _mm_cvtss_f32(_mm_dp_ps(v1, v2, 0x71));
+#else
+            __m128 product = _mm_mul_ps(v1, v2);
+            __m128 y = _mm_shuffle_ps(product, product, 
+                                      _MM_SHUFFLE(1, 1, 1, 1));
+            __m128 z = _mm_shuffle_ps(product, product,
+                                      _MM_SHUFFLE(2, 2, 2, 2));
+
+            return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(product, y), z));
+#endif
+        }
+
+    public:
+        /** @brief Default constructs the vector with zero components. */
+        constexpr vec3_() noexcept : dimension{0.0f, 0.0f, 0.0f, 0.0f} {}
+
+        /**
+         * @brief Constructs the vector with specified component values.
+         *
+         * @param x -> The x-component value
+         * @param y -> The y-component value
+         * @param z -> The z-component value
+         */
+        constexpr vec3_(const float& x, const float& y, const float& z) noexcept
+            : dimension{x, y, z, 0.0f} {}
+
+        /**
+         * @brief Constructs the vector from a packed register.
+         *
+         * @param value -> The x, y, z components in lanes 0, 1, 2.
+         *                 Lane 3 is stored as padding.
+         */
+        explicit vec3_(__m128 value) noexcept {
+            _mm_store_ps(dimension, value);
+        }
+
+        /** @brief Copy-constructs the vector (trivial, 16-byte copy). */
+        constexpr vec3_(const vec3_& vec) noexcept = default;
+
+        /** @brief Copy-assignment operator (trivial, 16-byte copy). */
+        constexpr vec3_& operator=(const vec3_& vec) noexcept = default;
+
+        /** @brief Returns the x-component value. */
+        constexpr float x() const noexcept {
+            return dimension[0];
+        }
+
+        /** @brief Returns the y-component value. */
+        constexpr float y() const noexcept {
+            return dimension[1];
+        }
+
+        /** @brief Returns the z-component value. */
+        constexpr float z() const noexcept {
+            return dimension[2];
+        }
+
+        /** @brief Returns the components as a packed register. */
+        inline __m128 sse() const noexcept {
+            return _mm_load_ps(dimension);
+        }
+
+        /**
+         * @brief Equality operator.
+         *
+         * @param vec -> The vec3 to check equality with.
+         *
+         * @returns true if all the component values of the vectors are equal,
+         *          false otherwise
+         */
+        constexpr bool operator==(const vec3_& vec) const noexcept {
+            if (RAYSTALKER_CONSTANT_EVALUATED())
+                return x() == vec.x() && y() == vec.y() && z() == vec.z();
+
+            return (_mm_movemask_ps(_mm_cmpeq_ps(sse(), vec.sse())) & 0x7) 
+                   == 0x7;
+        }
+
+        /**
+         * @brief Inequality operator.
+         *
+         * @param vec -> The vec3 to check inequality with.
+         *
+         * @returns true if any of the component values of the vectors
+         *          differ, false otherwise
+         */
+        constexpr bool operator!=(const vec3_& vec) const noexcept {
+            return !(*this == vec);
+        }
+
+        /** @brief Unary plus operator. */
+        constexpr const vec3_& operator+() const noexcept {
+            return *this;
+        }
+
+        /** @brief Negation operator. */
+        constexpr vec3_ operator-() const noexcept {
+            if (RAYSTALKER_CONSTANT_EVALUATED())
+                return vec3_(-x(), -y(), -z());
+
+            return vec3_(_mm_xor_ps(sse(), _mm_set1_ps(-0.0f)));
+        }
+
+        /**
+         * @brief Unchecked component access (const).
+         *
+         * @param index -> The index of the component
+         *
+         * @returns x, y, z component values for the 0, 1, 2 index values.
+         *
+         * @warning The index is not checked. Out of bounds access results
+         *          in undefined behaviour. Used by the library internally.
+         */
+        constexpr float component(size_t index) const noexcept {
+            return dimension[index];
+        }
+
+        /**
+         * @brief Unchecked component access.
+         *
+         * @param index -> The index of the component
+         *
+         * @returns x, y, z component values for the 0, 1, 2 index values.
+         *
+         * @warning The index is not checked. Out of bounds access results
+         *          in undefined behaviour. Used by the library internally.
+         */
+        constexpr float& component(size_t index) noexcept {
+            return dimension[index];
+        }
+
+        /**
+         * @brief Direct access operator (const).
+         *
+         * @param index -> The index of the component
+         *
+         * @returns x, y, z component values for the 0, 1, 2 index values.
+         *
+         * @warning If RAYSTALKER_CHECKED is defined and index is out of 
+         *          bounds (negative or bigger than 2), std::out_of_range
+         *          is thrown. Otherwise out of bounds access results in
+         *          undefined behaviour.
+         */
+        constexpr float operator[](size_t index) const 
+            noexcept(!vec3_checked_access) {
+            if constexpr (vec3_checked_access) {
+                if (index > 2)
+                    throw std::out_of_range("vec3_[] out of range");
+            }
+
+            return dimension[index];
+        }
+
+        /**
+         * @brief Direct access operator.
+         *
+         * @param index -> The index of the component
+         *
+         * @returns x, y, z component values for the 0, 1, 2 index values.
+         *
+         * @warning If RAYSTALKER_CHECKED is defined and index is out of 
+         *          bounds (bigger than 2), std::out_of_range is thrown.
+         *          Otherwise out of bounds access results in undefined
+         *          behaviour.
+         */
+        constexpr float& operator[](size_t index) 
+            noexcept(!vec3_checked_access) {
+            if constexpr (vec3_checked_access) {
+                if (index > 2)
+                    throw std::out_of_range("vec3_[] out of range");
+            }
+
+            return dimension[index];
+        }
+
+        /** @brief Addition-assignment operator. */
+        constexpr vec3_& operator+=(const vec3_& vec) noexcept {
+            if (RAYSTALKER_CONSTANT_EVALUATED())
+                return *this = vec3_(x() + vec.x(), y() + vec.y(),
+                                     z() + vec.z());
+
+            _mm_store_ps(dimension, _mm_add_ps(sse(), vec.sse()));
+
+            return *this;
+        }
+
+        /** @brief Subtraction-assignment operator. */
+        constexpr vec3_& operator-=(const vec3_& vec) noexcept {
+            if (RAYSTALKER_CONSTANT_EVALUATED())
+                return *this = vec3_(x() - vec.x(), y() - vec.y(),
+                                     z() - vec.z());
+
+            _mm_store_ps(dimension, _mm_sub_ps(sse(), vec.sse()));
+
+            return *this;
+        }
+
+        /** @brief Multiplication-assignment operator by vec3. */
+        constexpr vec3_& operator*=(const vec3_& vec) noexcept {
+            if (RAYSTALKER_CONSTANT_EVALUATED())
+                return *this = vec3_(x() * vec.x(), y() * vec.y(),
+                                     z() * vec.z());
+
+            _mm_store_ps(dimension, _mm_mul_ps(sse(), vec.sse()));
+
+            return *this;
+        }
+
+        /** @brief Division-assignment operator by vec3. */
+        constexpr vec3_& operator/=(const vec3_& vec) noexcept {
+            if (RAYSTALKER_CONSTANT_EVALUATED())
+                return *this = vec3_(x() / vec.x(), y() / vec.y(),
+                                     z() / vec.z());
+
+            _mm_store_ps(dimension, _mm_div_ps(sse(), vec.sse()));
+
+            return *this;
+        }
+
+        /** @brief Multiplication-assignment operator by scalar. */
+        constexpr vec3_& operator*=(const float& value) noexcept {
+            if (RAYSTALKER_CONSTANT_EVALUATED())
+                return *this = vec3_(x() * value, y() * value, z() * value);
+
+            _mm_store_ps(dimension, _mm_mul_ps(sse(), _mm_set1_ps(value)));
+
+            return *this;
+        }
+
+        /** @brief Division-assignment operator by scalar. */
+        constexpr vec3_& operator/=(const float& value) noexcept {
+            if (RAYSTALKER_CONSTANT_EVALUATED())
+                return *this = vec3_(x() / value, y() / value, z() / value);
+
+            _mm_store_ps(dimension, _mm_div_ps(sse(), _mm_set1_ps(value)));
+
+            return *this;
+        }
+
+        /**
+         * @returns The length of the vector.
+         */
+        inline float length() const noexcept {
+            return _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(dot3(sse(), sse()))));
+        }
+
+        /**
+         * @returns The squared length of the vector.
+         */
+        constexpr float squared_length() const noexcept {
+            if (RAYSTALKER_CONSTANT_EVALUATED())
+                return x() * x() + y() * y() + z() * z();
+
+            return dot3(sse(), sse());
+        }
+
+        /**
+         * @brief Normalizes the vector.
+         *
+         * @tparam Policy -> The accuracy tier: @ref normalize_exact
+         *                   (default), @ref normalize_rsqrt_newton or
+         *                   @ref normalize_rsqrt.
+         */
+        template <typename Policy = normalize_exact>
+        inline void normalize() noexcept {
+            *this = Policy::normalized(*this);
+        }
+
+        /** 
+         * @brief Returns the normalized version of the vector.
+         */
+        template <typename Policy = normalize_exact>
+        inline vec3_ getNormalized() const noexcept {
+            return Policy::normalized(*this);
+        }
+
+        /** @returns the dot product of the two vectors */
+        friend constexpr float dot(const vec3_& v1, const vec3_& v2) noexcept {
+            if (RAYSTALKER_CONSTANT_EVALUATED())
+                return v1.x() * v2.x() + v1.y() * v2.y() + v1.z() * v2.z();
+
+            return dot3(v1.sse(), v2.sse());
+        }
+};
+
+/** @returns the addition result of the two vectors. */
+constexpr vec3_<float> operator+(const vec3_<float>& v1,
+                                 const vec3_<float>& v2) noexcept {
+    if (RAYSTALKER_CONSTANT_EVALUATED())
+        return vec3_<float>(v1.x() + v2.x(), v1.y() + v2.y(), v1.z() + v2.z());
+
+    return vec3_<float>(_mm_add_ps(v1.sse(), v2.sse()));
+}
+
+/** @returns the subtraction result of the two vectors. (v1 - v2) */
+constexpr vec3_<float> operator-(const vec3_<float>& v1,
+                                 const vec3_<float>& v2) noexcept {
+    if (RAYSTALKER_CONSTANT_EVALUATED())
+        return vec3_<float>(v1.x() - v2.x(), v1.y() - v2.y(), v1.z() - v2.z());
+
+    return vec3_<float>(_mm_sub_ps(v1.sse(), v2.sse()));
+}
+
+/** @returns the multiplication result of the two vectors. */
+constexpr vec3_<float> operator*(const vec3_<float>& v1,
+                                 const vec3_<float>& v2) noexcept {
+    if (RAYSTALKER_CONSTANT_EVALUATED())
+        return vec3_<float>(v1.x() * v2.x(), v1.y() * v2.y(), v1.z() * v2.z());
+
+    return vec3_<float>(_mm_mul_ps(v1.sse(), v2.sse()));
+}
+
+/** @returns the division result of the two vectors. (v1 / v2) */
+constexpr vec3_<float> operator/(const vec3_<float>& v1,
+                                 const vec3_<float>& v2) noexcept {
+    if (RAYSTALKER_CONSTANT_EVALUATED())
+        return vec3_<float>(v1.x() / v2.x(), v1.y() / v2.y(), v1.z() / v2.z());
+
+    return vec3_<float>(_mm_div_ps(v1.sse(), v2.sse()));
+}
+
+/** @returns the division of the vector by the scalar */
+constexpr vec3_<float> operator/(const vec3_<float>& v,
+                                 const float& value) noexcept {
+    if (RAYSTALKER_CONSTANT_EVALUATED())
+        return vec3_<float>(v.x() / value, v.y() / value, v.z() / value);
+
+    return vec3_<float>(_mm_div_ps(v.sse(), _mm_set1_ps(value)));
+}
+
+/** @returns the multiplication of the vector by the scalar (vec3 * scalar) */
+constexpr vec3_<float> operator*(const vec3_<float>& v,
+                                 const float& value) noexcept {
+    if (RAYSTALKER_CONSTANT_EVALUATED())
+        return vec3_<float>(v.x() * value, v.y() * value, v.z() * value);
+
+    return vec3_<float>(_mm_mul_ps(v.sse(), _mm_set1_ps(value)));
+}
+
+/** @returns the multiplication of the vector by the scalar (scalar * vec) */
+constexpr vec3_<float> operator*(const float& value,
+                                 const vec3_<float>& v) noexcept {
+    return v * value;
+}
+
+/** @returns the cross product of the two vectors */
+constexpr vec3_<float> cross(const vec3_<float>& v1,
+                             const vec3_<float>& v2) noexcept {
+    if (RAYSTALKER_CONSTANT_EVALUATED())
+        return vec3_<float>(v1.y() * v2.z() - v1.z() * v2.y(),
+                            v1.z() * v2.x() - v1.x() * v2.z(),
+                            v1.x() * v2.y() - v1.y() * v2.x());
+
+    const __m128 a = v1.sse();
+    const __m128 b = v2.sse();
+
+    const __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    const __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    const __m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+
+    return vec3_<float>(_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+}
+
+/** @returns The component-wise minimum of the two vectors. */
+constexpr vec3_<float> vec3_min(const vec3_<float>& v1,
+                                const vec3_<float>& v2) noexcept {
+    if (RAYSTALKER_CONSTANT_EVALUATED())
+        return vec3_<float>(v1.x() < v2.x() ? v1.x() : v2.x(),
+                            v1.y() < v2.y() ? v1.y() : v2.y(),
+                            v1.z() < v2.z() ? v1.z() : v2.z());
+
+    return vec3_<float>(_mm_min_ps(v1.sse(), v2.sse()));
+}
+
+/** @returns The component-wise maximum of the two vectors. */
+constexpr vec3_<float> vec3_max(const vec3_<float>& v1,
+                                const vec3_<float>& v2) noexcept {
+    if (RAYSTALKER_CONSTANT_EVALUATED())
+        return vec3_<float>(v1.x() > v2.x() ? v1.x() : v2.x(),
+                            v1.y() > v2.y() ? v1.y() : v2.y(),
+                            v1.z() > v2.z() ? v1.z() : v2.z());
+
+    return vec3_<float>(_mm_max_ps(v1.sse(), v2.sse()));
+}
+
+#endif // RAYSTALKER_SIMD
+
+/**
+ * @brief Normalization policy: divides by the exact length.
+ *
+ * Correctly rounded up to the division (≤ 1 ulp per component).
+ */
+struct normalize_exact {
+    template <typename Type>
+    static inline vec3_<Type> normalized(const vec3_<Type>& vec) noexcept {
+        const vec3_scalar_t<Type> len = vec.length();
+
+        return vec3_<Type>(static_cast<Type>(vec.x() / len),
+                           static_cast<Type>(vec.y() / len),
+                           static_cast<Type>(vec.z() / len));
+    }
+
+    static inline vec3_<float> normalized(const vec3_<float>& vec) noexcept {
+        return vec / vec.length();
+    }
+};
+
+/**
+ * @brief Normalization policy: hardware reciprocal square root refined
+ *        by one Newton-Raphson step.
+ *
+ * For vec3f the relative error of the result is below 2^-21 (about
+ * 5e-7), close to the exact tier at the cost of a few multiplies instead
+ * of a square root and a division. Other component types use the exact
+ * tier.
+ */
+struct normalize_rsqrt_newton {
+    template <typename Type>
+    static inline vec3_<Type> normalized(const vec3_<Type>& vec) noexcept {
+        return normalize_exact::normalized(vec);
+    }
+
+    static inline vec3_<float> normalized(const vec3_<float>& vec) noexcept {
+#ifdef RAYSTALKER_SIMD
+        const __m128 squared = _mm_set1_ps(vec.squared_length());
+        const __m128 estimate = _mm_rsqrt_ps(squared);
+        const __m128 refined = _mm_mul_ps(
+            _mm_mul_ps(_mm_set1_ps(0.5f), estimate),
+            _mm_sub_ps(_mm_set1_ps(3.0f),
+                       _mm_mul_ps(_mm_mul_ps(squared, estimate), estimate)));
+
+        return vec3_<float>(_mm_mul_ps(vec.sse(), refined));
+#else
+        return vec * (1.0f / std::sqrt(vec.squared_length()));
+#endif
+    }
+};
+
+/**
+ * @brief Normalization policy: raw hardware reciprocal square root
+ *        (rsqrtps).
+ *
+ * For vec3f the relative error of the result is at most 1.5 * 2^-12
+ * (about 3.7e-4). Good enough for shading directions, not for geometry.
+ * Other component types use the exact tier.
+ */
+struct normalize_rsqrt {
+    template <typename Type>
+    static inline vec3_<Type> normalized(const vec3_<Type>& vec) noexcept {
+        return normalize_exact::normalized(vec);
+    }
+
+    static inline vec3_<float> normalized(const vec3_<float>& vec) noexcept {
+#ifdef RAYSTALKER_SIMD
+        const __m128 squared = _mm_set1_ps(vec.squared_length());
+
+        return vec3_<float>(_mm_mul_ps(vec.sse(), _mm_rsqrt_ps(squared)));
+#else
+        return vec * (1.0f / std::sqrt(vec.squared_length()));
+#endif
+    }
+};
+
+/**
+ * @brief Normalizes a vector that may have zero length.
+ *
+ * @tparam Policy -> The accuracy tier used for non-degenerate input.
+ *
+ * @param vec -> The vector to normalize
+ * @param fallback -> Returned when the squared length of vec is zero, 
+ *                    subnormal or NaN. Defaults to the zero vector.
+ *
+ * @returns The normalized vector, never containing NaNs for finite input.
+ */
+template <typename Policy = normalize_exact, typename Type>
+inline vec3_<Type> normalize_safe(const vec3_<Type>& vec,
+                                  const vec3_<Type>& fallback = vec3_<Type>())
+                                  noexcept {
+    typedef vec3_scalar_t<Type> scalar;
+
+    if (!(vec.squared_length() >= std::numeric_limits<scalar>::min()))
+        return fallback;
+
+    return Policy::normalized(vec);
+}
+
 typedef vec3_<float> vec3f;
+typedef vec3_<double> vec3d;
 
 typedef vec3_<unsigned char> color;
 typedef vec3_<float> colorf;
@@ -0,0 +1,278 @@
+/** @file vec3_expr.h */
+
+#pragma once
+
+#include "vec3.h"
+
+#include <cmath>
+#include <type_traits>
+
+/**
+ * @brief Whether the target has fused multiply-add instructions.
+ *
+ * When it does, a * b + c chains built with @ref lazy are evaluated with
+ * std::fma (a single rounding). Otherwise they are evaluated as written.
+ */
+#if defined(__FMA__) || defined(FP_FAST_FMAF)
+constexpr bool vec3_expr_fma = true;
+#else
+constexpr bool vec3_expr_fma = false;
+#endif
+
+/**
+ * @class vec3_expr
+ * @brief Base of the vec3 expression templates.
+ *
+ * Arithmetic on expressions builds a tree of small value types instead of
+ * materializing a vec3_ per operator. The tree is evaluated in a single
+ * pass over the three components when it is converted to a vec3_.
+ *
+ * Expression templates are opt-in: wrap the operands with @ref lazy.
+ *
+ * @code
+ * vec3f result = lazy(a) * s + lazy(b) * t - lazy(c);
+ * @endcode
+ *
+ * @warning Leaves reference the wrapped vectors, so an expression must not
+ *          outlive its operands. Convert it to a vec3_ before the end of
+ *          the statement unless the operands are known to live long
+ *          enough.
+ *
+ * @tparam Derived The expression node type (CRTP). It provides
+ *                 value_type and component(index).
+ */
+template <typename Derived>
+class vec3_expr {
+    public:
+        /** @brief Returns the expression node. */
+        inline const Derived& self() const noexcept {
+            return static_cast<const Derived&>(*this);
+        }
+
+        /** @brief Evaluates the expression. */
+        template <typename Type>
+        inline operator vec3_<Type>() const noexcept {
+            static_assert(std::is_same<Type,
+                                       typename Derived::value_type>::value,
+                          "ERROR: vec3 expression type mismatch.");
+
+            return vec3_<Type>(self().component(0),
+                               self().component(1),
+                               self().component(2));
+        }
+};
+
+/**
+ * @class vec3_leaf
+ * @brief Expression leaf referencing a vec3_.
+ */
+template <typename Type>
+class vec3_leaf : public vec3_expr<vec3_leaf<Type>> {
+    private:
+        const vec3_<Type>& vec;
+
+    public:
+        typedef Type value_type;
+        typedef void operation;
+
+        explicit vec3_leaf(const vec3_<Type>& value) noexcept : vec(value) {}
+
+        inline Type component(size_t index) const noexcept {
+            return vec.component(index);
+        }
+};
+
+/**
+ * @class vec3_broadcast
+ * @brief Expression leaf holding a scalar used for all three components.
+ */
+template <typename Type>
+class vec3_broadcast : public vec3_expr<vec3_broadcast<Type>> {
+    private:
+        Type value;
+
+    public:
+        typedef Type value_type;
+        typedef void operation;
+
+        explicit vec3_broadcast(const Type& value) noexcept : value(value) {}
+
+        inline Type component(size_t) const noexcept {
+            return value;
+        }
+};
+
+/** @brief Component-wise addition. */
+struct vec3_add_op {
+    template <typename Type>
+    static inline Type apply(Type a, Type b) noexcept {
+        return static_cast<Type>(a + b);
+    }
+};
+
+/** @brief Component-wise subtraction. */
+struct vec3_sub_op {
+    template <typename Type>
+    static inline Type apply(Type a, Type b) noexcept {
+        return static_cast<Type>(a - b);
+    }
+};
+
+/** @brief Component-wise multiplication. */
+struct vec3_mul_op {
+    template <typename Type>
+    static inline Type apply(Type a, Type b) noexcept {
+        return static_cast<Type>(a * b);
+    }
+};
+
+/** @brief Component-wise division. */
+struct vec3_div_op {
+    template <typename Type>
+    static inline Type apply(Type a, Type b) noexcept {
+        return static_cast<Type>(a / b);
+    }
+};
+
+/**
+ * @returns a * b + c, fused into one instruction when the target has FMA
+ *          and Type is a floating point type.
+ */
+template <typename Type>
+inline Type vec3_fma(Type a, Type b, Type c) noexcept {
+    if constexpr (vec3_expr_fma && std::is_floating_point<Type>::value)
+        return std::fma(a, b, c);
+    else
+        return static_cast<Type>(a * b + c);
+}
+
+/**
+ * @class vec3_binary
+ * @brief Expression node applying Operation to two sub-expressions.
+ *
+ * Additions and subtractions with a multiplication operand are
+ * contracted into @ref vec3_fma.
+ */
+template <typename Left, typename Right, typename Operation>
+class vec3_binary : public vec3_expr<vec3_binary<Left, Right, Operation>> {
+    static_assert(std::is_same<typename Left::value_type,
+                               typename Right::value_type>::value,
+                  "ERROR: vec3 expression type mismatch.");
+
+    private:
+        Left left;
+        Right right;
+
+        template <typename Node>
+        static constexpr bool is_product =
+            std::is_same<typename Node::operation, vec3_mul_op>::value;
+
+    public:
+        typedef typename Left::value_type value_type;
+        typedef Operation operation;
+
+        vec3_binary(const Left& left, const Right& right) noexcept
+            : left(left), right(right) {}
+
+        /** @returns The left operand. */
+        inline const Left& lhs() const noexcept {
+            return left;
+        }
+
+        /** @returns The right operand. */
+        inline const Right& rhs() const noexcept {
+            return right;
+        }
+
+        inline value_type component(size_t index) const noexcept {
+            constexpr bool add = std::is_same<Operation, vec3_add_op>::value;
+            constexpr bool sub = std::is_same<Operation, vec3_sub_op>::value;
+
+            if constexpr ((add || sub) && is_product<Left>) {
+                const value_type c = right.component(index);
+
+                return vec3_fma(left.lhs().component(index),
+                                left.rhs().component(index),
+                                add ? c : static_cast<value_type>(-c));
+            } else if constexpr ((add || sub) && is_product<Right>) {
+                const value_type a = right.lhs().component(index);
+
+                return vec3_fma(add ? a : static_cast<value_type>(-a),
+                                right.rhs().component(index),
+                                left.component(index));
+            } else {
+                return Operation::apply(left.component(index),
+                                        right.component(index));
+            }
+        }
+};
+
+/**
+ * @brief Wraps a vector so that arithmetic on it builds an expression.
+ */
+template <typename Type>
+inline vec3_leaf<Type> lazy(const vec3_<Type>& vec) noexcept {
+    return vec3_leaf<Type>(vec);
+}
+
+/** @brief Evaluates an expression into a vec3_. */
+template <typename Derived>
+inline vec3_<typename Derived::value_type>
+eval(const vec3_expr<Derived>& expr) noexcept {
+    return expr;
+}
+
+/** @returns The addition expression of the two expressions. */
+template <typename Left, typename Right>
+inline auto operator+(const vec3_expr<Left>& left,
+                      const vec3_expr<Right>& right) noexcept {
+    return vec3_binary<Left, Right, vec3_add_op>(left.self(), right.self());
+}
+
+/** @returns The subtraction expression of the two expressions. */
+template <typename Left, typename Right>
+inline auto operator-(const vec3_expr<Left>& left,
+                      const vec3_expr<Right>& right) noexcept {
+    return vec3_binary<Left, Right, vec3_sub_op>(left.self(), right.self());
+}
+
+/** @returns The component-wise multiplication expression. */
+template <typename Left, typename Right>
+inline auto operator*(const vec3_expr<Left>& left,
+                      const vec3_expr<Right>& right) noexcept {
+    return vec3_binary<Left, Right, vec3_mul_op>(left.self(), right.self());
+}
+
+/** @returns The component-wise division expression. */
+template <typename Left, typename Right>
+inline auto operator/(const vec3_expr<Left>& left,
+                      const vec3_expr<Right>& right) noexcept {
+    return vec3_binary<Left, Right, vec3_div_op>(left.self(), right.self());
+}
+
+/** @returns The expression multiplied by a scalar. (expr * scalar) */
+template <typename Left>
+inline auto operator*(const vec3_expr<Left>& left,
+                      const typename Left::value_type& value) noexcept {
+    typedef vec3_broadcast<typename Left::value_type> scalar;
+
+    return vec3_binary<Left, scalar, vec3_mul_op>(left.self(), scalar(value));
+}
+
+/** @returns The expression multiplied by a scalar. (scalar * expr) */
+template <typename Right>
+inline auto operator*(const typename Right::value_type& value,
+                      const vec3_expr<Right>& right) noexcept {
+    typedef vec3_broadcast<typename Right::value_type> scalar;
+
+    return vec3_binary<scalar, Right, vec3_mul_op>(scalar(value), right.self());
+}
+
+/** @returns The expression divided by a scalar. */
+template <typename Left>
+inline auto operator/(const vec3_expr<Left>& left,
+                      const typename Left::value_type& value) noexcept {
+    typedef vec3_broadcast<typename Left::value_type> scalar;
+
+    return vec3_binary<Left, scalar, vec3_div_op>(left.self(), scalar(value));
+}
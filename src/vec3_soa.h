@@ -0,0 +1,515 @@
+/** @file vec3_soa.h */
+
+#pragma once
+
+#include "vec3.h"
+
+#include <array>
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * @class aligned_allocator
+ * @brief Standard allocator returning Alignment-aligned storage.
+ *
+ * Used by the SoA containers so that every component stream starts on a
+ * cache line and can be loaded with aligned AVX / AVX-512 instructions.
+ *
+ * @tparam Type The allocated type.
+ * @tparam Alignment The alignment (in bytes) of every allocation.
+ */
+template <typename Type, std::size_t Alignment = 64>
+class aligned_allocator {
+    public:
+        typedef Type value_type;
+
+        template <typename Other>
+        struct rebind {
+            typedef aligned_allocator<Other, Alignment> other;
+        };
+
+        aligned_allocator() = default;
+
+        template <typename Other>
+        aligned_allocator(const aligned_allocator<Other, Alignment>&) {}
+
+        Type* allocate(std::size_t count) {
+            return static_cast<Type*>(
+                ::operator new(count * sizeof(Type),
+                               std::align_val_t(Alignment)));
+        }
+
+        void deallocate(Type* pointer, std::size_t) {
+            ::operator delete(pointer, std::align_val_t(Alignment));
+        }
+
+        template <typename Other>
+        bool operator==(const aligned_allocator<Other, Alignment>&) const {
+            return true;
+        }
+
+        template <typename Other>
+        bool operator!=(const aligned_allocator<Other, Alignment>&) const {
+            return false;
+        }
+};
+
+/** @brief std::vector whose buffer is 64-byte aligned. */
+template <typename Type>
+using aligned_vector = std::vector<Type, aligned_allocator<Type>>;
+
+/**
+ * @class vec3_soa_ops
+ * @brief Lane-wise vec3 operations shared by @ref vec3_soa and
+ *        @ref vec3_array.
+ *
+ * Every operation is a plain loop over the three contiguous component
+ * streams, which the compiler turns into packed SIMD code (8 floats per
+ * AVX2 instruction, 16 per AVX-512 instruction).
+ *
+ * @tparam Derived The container type (CRTP). It provides size(),
+ *                 data(axis) and make_scalar_array().
+ * @tparam Type The component type. Must be arithmetic.
+ */
+template <typename Derived, typename Type>
+class vec3_soa_ops {
+    private:
+        Derived& derived() {
+            return static_cast<Derived&>(*this);
+        }
+
+        const Derived& derived() const {
+            return static_cast<const Derived&>(*this);
+        }
+
+        template <typename Operation>
+        Derived& apply(const Derived& other, Operation operation) {
+            Derived& self = derived();
+            const std::size_t count = self.size();
+
+            if (other.size() != count)
+                throw std::invalid_argument("vec3 SoA size mismatch");
+
+            for (std::size_t axis = 0; axis < 3; axis++) {
+                Type* out = self.data(axis);
+                const Type* in = other.data(axis);
+
+                for (std::size_t i = 0; i < count; i++)
+                    out[i] = operation(out[i], in[i]);
+            }
+
+            return self;
+        }
+
+        template <typename Operation>
+        Derived& apply(const Type& value, Operation operation) {
+            Derived& self = derived();
+            const std::size_t count = self.size();
+
+            for (std::size_t axis = 0; axis < 3; axis++) {
+                Type* out = self.data(axis);
+
+                for (std::size_t i = 0; i < count; i++)
+                    out[i] = operation(out[i], value);
+            }
+
+            return self;
+        }
+
+    public:
+        /** @returns The vector stored in the lane index. */
+        inline vec3_<Type> get(std::size_t index) const {
+            const Derived& self = derived();
+
+            return vec3_<Type>(self.data(0)[index],
+                               self.data(1)[index],
+                               self.data(2)[index]);
+        }
+
+        /** @brief Stores vec in the lane index. */
+        inline void set(std::size_t index, const vec3_<Type>& vec) {
+            Derived& self = derived();
+
+            self.data(0)[index] = vec.x();
+            self.data(1)[index] = vec.y();
+            self.data(2)[index] = vec.z();
+        }
+
+        /**
+         * @brief Loads size() vectors from an AoS buffer.
+         *
+         * @param vecs -> Pointer to at least size() vectors.
+         */
+        void gather(const vec3_<Type>* vecs) {
+            for (std::size_t i = 0; i < derived().size(); i++)
+                set(i, vecs[i]);
+        }
+
+        /**
+         * @brief Stores the size() vectors to an AoS buffer.
+         *
+         * @param vecs -> Pointer to at least size() vectors.
+         */
+        void scatter(vec3_<Type>* vecs) const {
+            for (std::size_t i = 0; i < derived().size(); i++)
+                vecs[i] = get(i);
+        }
+
+        /**
+         * @brief Lane-wise addition-assignment operator.
+         *
+         * @throws std::invalid_argument if the sizes differ.
+         */
+        inline Derived& operator+=(const Derived& other) {
+            return apply(other, [](Type a, Type b) { return a + b; });
+        }
+
+        /**
+         * @brief Lane-wise subtraction-assignment operator.
+         *
+         * @throws std::invalid_argument if the sizes differ.
+         */
+        inline Derived& operator-=(const Derived& other) {
+            return apply(other, [](Type a, Type b) { return a - b; });
+        }
+
+        /**
+         * @brief Lane-wise multiplication-assignment operator.
+         *
+         * @throws std::invalid_argument if the sizes differ.
+         */
+        inline Derived& operator*=(const Derived& other) {
+            return apply(other, [](Type a, Type b) { return a * b; });
+        }
+
+        /**
+         * @brief Lane-wise division-assignment operator.
+         *
+         * @throws std::invalid_argument if the sizes differ.
+         */
+        inline Derived& operator/=(const Derived& other) {
+            return apply(other, [](Type a, Type b) { return a / b; });
+        }
+
+        /** @brief Multiplies every lane by a scalar. */
+        inline Derived& operator*=(const Type& value) {
+            return apply(value, [](Type a, Type b) { return a * b; });
+        }
+
+        /** @brief Divides every lane by a scalar. */
+        inline Derived& operator/=(const Type& value) {
+            return apply(value, [](Type a, Type b) { return a / b; });
+        }
+
+        /** @returns The squared length of every lane. */
+        auto squared_length() const {
+            const Derived& self = derived();
+            typename Derived::scalar_array result = self.make_scalar_array();
+
+            const Type* x = self.data(0);
+            const Type* y = self.data(1);
+            const Type* z = self.data(2);
+
+            for (std::size_t i = 0; i < self.size(); i++)
+                result[i] = x[i] * x[i] + y[i] * y[i] + z[i] * z[i];
+
+            return result;
+        }
+
+        /** @returns The length of every lane. */
+        auto length() const {
+            auto result = squared_length();
+
+            for (std::size_t i = 0; i < derived().size(); i++)
+                result[i] = std::sqrt(result[i]);
+
+            return result;
+        }
+
+        /**
+         * @brief Normalizes every lane.
+         *
+         * @warning Zero-length lanes result in NaN components, as with
+         *          @ref vec3_::normalize.
+         */
+        void normalize() {
+            Derived& self = derived();
+
+            Type* x = self.data(0);
+            Type* y = self.data(1);
+            Type* z = self.data(2);
+
+            for (std::size_t i = 0; i < self.size(); i++) {
+                const Type len = std::sqrt(x[i] * x[i] +
+                                           y[i] * y[i] +
+                                           z[i] * z[i]);
+
+                x[i] /= len;
+                y[i] /= len;
+                z[i] /= len;
+            }
+        }
+};
+
+/**
+ * @class vec3_soa
+ * @brief Fixed-size batch of N vec3s stored as three aligned arrays.
+ *
+ * @tparam Type The component type. Must be arithmetic.
+ * @tparam N The number of lanes.
+ */
+template <typename Type, std::size_t N>
+class vec3_soa : public vec3_soa_ops<vec3_soa<Type, N>, Type> {
+    private:
+        alignas(64) Type xs[N];
+        alignas(64) Type ys[N];
+        alignas(64) Type zs[N];
+
+    public:
+        typedef Type value_type;
+        typedef std::array<Type, N> scalar_array;
+
+        /** @brief Default constructs every lane with zero components. */
+        vec3_soa() : xs(), ys(), zs() {
+            static_assert(std::is_arithmetic<Type>::value,
+                          "ERROR: vec3_soa uses only arithmetic types.");
+        }
+
+        /** @brief Broadcasts vec to every lane. */
+        explicit vec3_soa(const vec3_<Type>& vec) : vec3_soa() {
+            for (std::size_t i = 0; i < N; i++)
+                this->set(i, vec);
+        }
+
+        /** @returns The number of lanes. */
+        static constexpr std::size_t size() {
+            return N;
+        }
+
+        /** @returns The component stream of axis (0, 1, 2 -> x, y, z). */
+        inline Type* data(std::size_t axis) {
+            return axis == 0 ? xs : (axis == 1 ? ys : zs);
+        }
+
+        /** @returns The component stream of axis (0, 1, 2 -> x, y, z). */
+        inline const Type* data(std::size_t axis) const {
+            return axis == 0 ? xs : (axis == 1 ? ys : zs);
+        }
+
+        /** @returns A zeroed per-lane scalar array. */
+        scalar_array make_scalar_array() const {
+            return scalar_array();
+        }
+
+        /** @returns A batch of the same size. */
+        vec3_soa make_like() const {
+            return vec3_soa();
+        }
+};
+
+/**
+ * @class vec3_array
+ * @brief Dynamically sized batch of vec3s stored as three aligned arrays.
+ *
+ * @tparam Type The component type. Must be arithmetic.
+ */
+template <typename Type>
+class vec3_array : public vec3_soa_ops<vec3_array<Type>, Type> {
+    private:
+        aligned_vector<Type> dimension[3];
+
+    public:
+        typedef Type value_type;
+        typedef aligned_vector<Type> scalar_array;
+
+        /**
+         * @brief Constructs a batch of count zero vectors.
+         *
+         * @param count -> The number of lanes
+         */
+        explicit vec3_array(std::size_t count = 0)
+            : dimension{aligned_vector<Type>(count),
+                        aligned_vector<Type>(count),
+                        aligned_vector<Type>(count)} {
+            static_assert(std::is_arithmetic<Type>::value,
+                          "ERROR: vec3_array uses only arithmetic types.");
+        }
+
+        /** @brief Gathers an AoS vector of vec3s. */
+        explicit vec3_array(const std::vector<vec3_<Type>>& vecs)
+            : vec3_array(vecs.size()) {
+            this->gather(vecs.data());
+        }
+
+        /** @returns The number of lanes. */
+        inline std::size_t size() const {
+            return dimension[0].size();
+        }
+
+        /** @brief Resizes every component stream to count lanes. */
+        void resize(std::size_t count) {
+            dimension[0].resize(count);
+            dimension[1].resize(count);
+            dimension[2].resize(count);
+        }
+
+        /** @brief Appends vec as the last lane. */
+        void push_back(const vec3_<Type>& vec) {
+            dimension[0].push_back(vec.x());
+            dimension[1].push_back(vec.y());
+            dimension[2].push_back(vec.z());
+        }
+
+        /** @returns The component stream of axis (0, 1, 2 -> x, y, z). */
+        inline Type* data(std::size_t axis) {
+            return dimension[axis].data();
+        }
+
+        /** @returns The component stream of axis (0, 1, 2 -> x, y, z). */
+        inline const Type* data(std::size_t axis) const {
+            return dimension[axis].data();
+        }
+
+        /** @returns A zeroed per-lane scalar array. */
+        scalar_array make_scalar_array() const {
+            return scalar_array(size());
+        }
+
+        /** @returns A batch of the same size. */
+        vec3_array make_like() const {
+            return vec3_array(size());
+        }
+};
+
+/** @returns The lane-wise addition of the two batches. */
+template <typename Derived, typename Type>
+inline Derived operator+(const vec3_soa_ops<Derived, Type>& v1,
+                         const vec3_soa_ops<Derived, Type>& v2) {
+    Derived result(static_cast<const Derived&>(v1));
+
+    return result += static_cast<const Derived&>(v2);
+}
+
+/** @returns The lane-wise subtraction of the two batches. (v1 - v2) */
+template <typename Derived, typename Type>
+inline Derived operator-(const vec3_soa_ops<Derived, Type>& v1,
+                         const vec3_soa_ops<Derived, Type>& v2) {
+    Derived result(static_cast<const Derived&>(v1));
+
+    return result -= static_cast<const Derived&>(v2);
+}
+
+/** @returns The lane-wise multiplication of the two batches. */
+template <typename Derived, typename Type>
+inline Derived operator*(const vec3_soa_ops<Derived, Type>& v1,
+                         const vec3_soa_ops<Derived, Type>& v2) {
+    Derived result(static_cast<const Derived&>(v1));
+
+    return result *= static_cast<const Derived&>(v2);
+}
+
+/** @returns The lane-wise division of the two batches. (v1 / v2) */
+template <typename Derived, typename Type>
+inline Derived operator/(const vec3_soa_ops<Derived, Type>& v1,
+                         const vec3_soa_ops<Derived, Type>& v2) {
+    Derived result(static_cast<const Derived&>(v1));
+
+    return result /= static_cast<const Derived&>(v2);
+}
+
+/** @returns Every lane multiplied by the scalar. (batch * scalar) */
+template <typename Derived, typename Type>
+inline Derived operator*(const vec3_soa_ops<Derived, Type>& v,
+                         const Type& value) {
+    Derived result(static_cast<const Derived&>(v));
+
+    return result *= value;
+}
+
+/** @returns Every lane multiplied by the scalar. (scalar * batch) */
+template <typename Derived, typename Type>
+inline Derived operator*(const Type& value,
+                         const vec3_soa_ops<Derived, Type>& v) {
+    return v * value;
+}
+
+/** @returns Every lane divided by the scalar. */
+template <typename Derived, typename Type>
+inline Derived operator/(const vec3_soa_ops<Derived, Type>& v,
+                         const Type& value) {
+    Derived result(static_cast<const Derived&>(v));
+
+    return result /= value;
+}
+
+/**
+ * @returns The lane-wise dot product of the two batches.
+ *
+ * @throws std::invalid_argument if the sizes differ.
+ */
+template <typename Derived, typename Type>
+typename Derived::scalar_array dot(const vec3_soa_ops<Derived, Type>& v1,
+                                   const vec3_soa_ops<Derived, Type>& v2) {
+    const Derived& a = static_cast<const Derived&>(v1);
+    const Derived& b = static_cast<const Derived&>(v2);
+
+    if (a.size() != b.size())
+        throw std::invalid_argument("vec3 SoA size mismatch");
+
+    typename Derived::scalar_array result = a.make_scalar_array();
+
+    const Type* ax = a.data(0);
+    const Type* ay = a.data(1);
+    const Type* az = a.data(2);
+    const Type* bx = b.data(0);
+    const Type* by = b.data(1);
+    const Type* bz = b.data(2);
+
+    for (std::size_t i = 0; i < a.size(); i++)
+        result[i] = ax[i] * bx[i] + ay[i] * by[i] + az[i] * bz[i];
+
+    return result;
+}
+
+/**
+ * @returns The lane-wise cross product of the two batches.
+ *
+ * @throws std::invalid_argument if the sizes differ.
+ */
+template <typename Derived, typename Type>
+Derived cross(const vec3_soa_ops<Derived, Type>& v1,
+              const vec3_soa_ops<Derived, Type>& v2) {
+    const Derived& a = static_cast<const Derived&>(v1);
+    const Derived& b = static_cast<const Derived&>(v2);
+
+    if (a.size() != b.size())
+        throw std::invalid_argument("vec3 SoA size mismatch");
+
+    Derived result = a.make_like();
+
+    const Type* ax = a.data(0);
+    const Type* ay = a.data(1);
+    const Type* az = a.data(2);
+    const Type* bx = b.data(0);
+    const Type* by = b.data(1);
+    const Type* bz = b.data(2);
+
+    Type* rx = result.data(0);
+    Type* ry = result.data(1);
+    Type* rz = result.data(2);
+
+    for (std::size_t i = 0; i < a.size(); i++) {
+        rx[i] = ay[i] * bz[i] - az[i] * by[i];
+        ry[i] = az[i] * bx[i] - ax[i] * bz[i];
+        rz[i] = ax[i] * by[i] - ay[i] * bx[i];
+    }
+
+    return result;
+}
+
+template <std::size_t N>
+using vec3f_soa = vec3_soa<float, N>;
+
+typedef vec3_array<float> vec3f_array;
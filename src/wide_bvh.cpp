@@ -0,0 +1,107 @@
+#include "wide_bvh.h"
+
+#include <limits>
+
+template <std::size_t Width>
+wide_bvh<Width>::wide_bvh(const bvh& binary)
+    : index_array(binary.indices()) {
+    if (binary.empty())
+        return;
+
+    node_array.reserve(binary.nodes().size() / 2 + 1);
+
+    const bvh_node& root = binary.nodes()[0];
+
+    if (!root.leaf()) {
+        collapse(binary, 0);
+        return;
+    }
+
+    // A single leaf becomes a root with one leaf child.
+    wide_bvh_node<Width> node = {};
+
+    node.lo_x[0] = root.lo[0];
+    node.lo_y[0] = root.lo[1];
+    node.lo_z[0] = root.lo[2];
+    node.hi_x[0] = root.hi[0];
+    node.hi_y[0] = root.hi[1];
+    node.hi_z[0] = root.hi[2];
+    node.child[0] = root.offset;
+    node.count[0] = root.count;
+    node.children = 1;
+
+    node_array.push_back(node);
+}
+
+template <std::size_t Width>
+std::uint32_t wide_bvh<Width>::collapse(const bvh& binary,
+                                        std::uint32_t index) {
+    const shared_buffer<bvh_node>& binary_nodes = binary.nodes();
+
+    std::uint32_t children[Width] = { index + 1, binary_nodes[index].offset };
+    std::size_t count = 2;
+
+    while (count < Width) {
+        std::size_t largest = count;
+        float largest_area = -1;
+
+        for (std::size_t i = 0; i < count; i++) {
+            const bvh_node& child = binary_nodes[children[i]];
+            const float area = child.bounds().surface_area();
+
+            if (!child.leaf() && area > largest_area) {
+                largest = i;
+                largest_area = area;
+            }
+        }
+
+        if (largest == count)
+            break;
+
+        const std::uint32_t opened = children[largest];
+
+        children[largest] = opened + 1;
+        children[count++] = binary_nodes[opened].offset;
+    }
+
+    const std::uint32_t wide_index =
+        static_cast<std::uint32_t>(node_array.size());
+
+    wide_bvh_node<Width> node = {};
+    node.children = static_cast<std::uint8_t>(count);
+
+    for (std::size_t i = 0; i < Width; i++) {
+        // Unused slots get inverted bounds; wide_slab masks them anyway.
+        const float inf = std::numeric_limits<float>::infinity();
+
+        node.lo_x[i] = node.lo_y[i] = node.lo_z[i] = inf;
+        node.hi_x[i] = node.hi_y[i] = node.hi_z[i] = -inf;
+    }
+
+    for (std::size_t i = 0; i < count; i++) {
+        const bvh_node& child = binary_nodes[children[i]];
+
+        node.lo_x[i] = child.lo[0];
+        node.lo_y[i] = child.lo[1];
+        node.lo_z[i] = child.lo[2];
+        node.hi_x[i] = child.hi[0];
+        node.hi_y[i] = child.hi[1];
+        node.hi_z[i] = child.hi[2];
+
+        if (child.leaf()) {
+            node.child[i] = child.offset;
+            node.count[i] = child.count;
+        }
+    }
+
+    node_array.push_back(node);
+
+    for (std::size_t i = 0; i < count; i++)
+        if (!binary_nodes[children[i]].leaf())
+            node_array[wide_index].child[i] = collapse(binary, children[i]);
+
+    return wide_index;
+}
+
+template class wide_bvh<4>;
+template class wide_bvh<8>;
@@ -0,0 +1,344 @@
+/** @file wide_bvh.h */
+
+#pragma once
+
+#include "bvh.h"
+#include "vec3_soa.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Node of a Width-wide BVH.
+ *
+ * The child bounds are stored SoA (one array per axis and side), so the
+ * slab test of a ray against all Width children is a handful of packed
+ * SSE (Width 4) or AVX (Width 8) instructions.
+ *
+ * Child i is a leaf if count[i] > 0, in which case child[i] is the first
+ * of its primitives in @ref wide_bvh::indices. Otherwise child[i] is the
+ * index of an inner node. Only the first children slots are used.
+ */
+template <std::size_t Width>
+struct alignas(64) wide_bvh_node {
+    float lo_x[Width];
+    float lo_y[Width];
+    float lo_z[Width];
+    float hi_x[Width];
+    float hi_y[Width];
+    float hi_z[Width];
+    std::uint32_t child[Width];
+    std::uint16_t count[Width];
+    std::uint8_t children;
+};
+
+/** @brief Layout of the BVH traversed for primary rays. */
+enum class bvh_layout {
+    binary, /**< @ref bvh */
+    wide4,       /**< @ref wide_bvh<4> */
+    wide8,       /**< @ref wide_bvh<8> */
+    compressed4, /**< @ref compressed_bvh<4> */
+    compressed8  /**< @ref compressed_bvh<8> */
+};
+
+/**
+ * @class wide_bvh
+ * @brief BVH with up to Width children per node.
+ *
+ * Built by collapsing a binary @ref bvh: every wide node takes the place
+ * of a binary inner node and repeatedly replaces its largest (by surface
+ * area) inner child with that child's two children until it holds Width
+ * children or only leaves remain. The leaves and the primitive indices
+ * are those of the binary tree.
+ *
+ * @tparam Width The branching factor, 4 or 8.
+ */
+template <std::size_t Width>
+class wide_bvh {
+    static_assert(Width == 4 || Width == 8,
+                  "ERROR: wide_bvh supports 4 and 8 children.");
+
+    private:
+        aligned_vector<wide_bvh_node<Width>> node_array;
+        shared_buffer<std::uint32_t> index_array;
+
+        std::uint32_t collapse(const bvh& binary, std::uint32_t index);
+
+    public:
+        /**
+         * @brief Largest number of pending children during a traversal.
+         *
+         * Every level of the (at most bvh::max_depth deep) tree pushes at
+         * most Width - 1 children besides the one visited next.
+         */
+        static constexpr std::size_t stack_size =
+            bvh::max_depth * (Width - 1) + 1;
+
+        /** @brief Constructs an empty BVH. */
+        wide_bvh() {}
+
+        /** @brief Collapses binary into a Width-wide BVH. */
+        explicit wide_bvh(const bvh& binary);
+
+        /** @brief Returns the nodes, root first. Empty for no primitives. */
+        inline const aligned_vector<wide_bvh_node<Width>>& nodes() const {
+            return node_array;
+        }
+
+        /**
+         * @brief Returns the primitive indices referenced by the leaves,
+         *        shared with the binary BVH.
+         */
+        inline const shared_buffer<std::uint32_t>& indices() const {
+            return index_array;
+        }
+
+        /** @returns true if the BVH holds no primitive. */
+        inline bool empty() const {
+            return node_array.empty();
+        }
+};
+
+/**
+ * @brief Ray data shared by the slab tests of one traversal.
+ */
+struct wide_ray {
+    float origin[3];
+    float inverse_direction[3];
+};
+
+/**
+ * @brief Slab test of a ray against 4 children starting at lane first.
+ *
+ * @returns The mask of the children overlapping [t_min, t_max]. Their
+ *          entry distances are written to distances[first...].
+ */
+template <std::size_t Width>
+inline unsigned wide_slab4(const wide_bvh_node<Width>& node,
+                           std::size_t first, const wide_ray& r,
+                           float t_min, float t_max, float* distances) {
+#ifdef RAYSTALKER_SIMD
+    const __m128 ox = _mm_set1_ps(r.origin[0]);
+    const __m128 oy = _mm_set1_ps(r.origin[1]);
+    const __m128 oz = _mm_set1_ps(r.origin[2]);
+    const __m128 ix = _mm_set1_ps(r.inverse_direction[0]);
+    const __m128 iy = _mm_set1_ps(r.inverse_direction[1]);
+    const __m128 iz = _mm_set1_ps(r.inverse_direction[2]);
+
+    const __m128 lx = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.lo_x + first),
+                                            ox), ix);
+    const __m128 ly = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.lo_y + first),
+                                            oy), iy);
+    const __m128 lz = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.lo_z + first),
+                                            oz), iz);
+    const __m128 hx = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.hi_x + first),
+                                            ox), ix);
+    const __m128 hy = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.hi_y + first),
+                                            oy), iy);
+    const __m128 hz = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.hi_z + first),
+                                            oz), iz);
+
+    // minps / maxps return their second operand if either is NaN. The
+    // running interval goes second, so a NaN slab distance (0 * inf)
+    // leaves it unchanged, as in the scalar slab test.
+    __m128 enter = _mm_max_ps(_mm_min_ps(lx, hx), _mm_set1_ps(t_min));
+    enter = _mm_max_ps(_mm_min_ps(ly, hy), enter);
+    enter = _mm_max_ps(_mm_min_ps(lz, hz), enter);
+
+    __m128 exit = _mm_min_ps(_mm_max_ps(lx, hx), _mm_set1_ps(t_max));
+    exit = _mm_min_ps(_mm_max_ps(ly, hy), exit);
+    exit = _mm_min_ps(_mm_max_ps(lz, hz), exit);
+
+    _mm_storeu_ps(distances + first, enter);
+
+    return static_cast<unsigned>(_mm_movemask_ps(_mm_cmple_ps(enter, exit)));
+#else
+    unsigned mask = 0;
+
+    for (std::size_t i = 0; i < 4; i++) {
+        const std::size_t lane = first + i;
+
+        const float lx = (node.lo_x[lane] - r.origin[0]) *
+                         r.inverse_direction[0];
+        const float ly = (node.lo_y[lane] - r.origin[1]) *
+                         r.inverse_direction[1];
+        const float lz = (node.lo_z[lane] - r.origin[2]) *
+                         r.inverse_direction[2];
+        const float hx = (node.hi_x[lane] - r.origin[0]) *
+                         r.inverse_direction[0];
+        const float hy = (node.hi_y[lane] - r.origin[1]) *
+                         r.inverse_direction[1];
+        const float hz = (node.hi_z[lane] - r.origin[2]) *
+                         r.inverse_direction[2];
+
+        float enter = t_min;
+        float exit = t_max;
+
+        enter = (lx < hx ? lx : hx) > enter ? (lx < hx ? lx : hx) : enter;
+        enter = (ly < hy ? ly : hy) > enter ? (ly < hy ? ly : hy) : enter;
+        enter = (lz < hz ? lz : hz) > enter ? (lz < hz ? lz : hz) : enter;
+        exit = (lx > hx ? lx : hx) < exit ? (lx > hx ? lx : hx) : exit;
+        exit = (ly > hy ? ly : hy) < exit ? (ly > hy ? ly : hy) : exit;
+        exit = (lz > hz ? lz : hz) < exit ? (lz > hz ? lz : hz) : exit;
+
+        distances[lane] = enter;
+        mask |= unsigned(enter <= exit) << i;
+    }
+
+    return mask;
+#endif
+}
+
+/**
+ * @brief Slab test of a ray against all children of a node.
+ *
+ * @returns The mask of the used children overlapping [t_min, t_max].
+ *          Their entry distances are written to distances.
+ */
+template <std::size_t Width>
+inline unsigned wide_slab(const wide_bvh_node<Width>& node,
+                          const wide_ray& r, float t_min, float t_max,
+                          float* distances) {
+    unsigned mask;
+
+#if defined(RAYSTALKER_SIMD) && defined(__AVX__)
+    if constexpr (Width == 8) {
+        const __m256 ox = _mm256_set1_ps(r.origin[0]);
+        const __m256 oy = _mm256_set1_ps(r.origin[1]);
+        const __m256 oz = _mm256_set1_ps(r.origin[2]);
+        const __m256 ix = _mm256_set1_ps(r.inverse_direction[0]);
+        const __m256 iy = _mm256_set1_ps(r.inverse_direction[1]);
+        const __m256 iz = _mm256_set1_ps(r.inverse_direction[2]);
+
+        const __m256 lx = _mm256_mul_ps(
+            _mm256_sub_ps(_mm256_load_ps(node.lo_x), ox), ix);
+        const __m256 ly = _mm256_mul_ps(
+            _mm256_sub_ps(_mm256_load_ps(node.lo_y), oy), iy);
+        const __m256 lz = _mm256_mul_ps(
+            _mm256_sub_ps(_mm256_load_ps(node.lo_z), oz), iz);
+        const __m256 hx = _mm256_mul_ps(
+            _mm256_sub_ps(_mm256_load_ps(node.hi_x), ox), ix);
+        const __m256 hy = _mm256_mul_ps(
+            _mm256_sub_ps(_mm256_load_ps(node.hi_y), oy), iy);
+        const __m256 hz = _mm256_mul_ps(
+            _mm256_sub_ps(_mm256_load_ps(node.hi_z), oz), iz);
+
+        __m256 enter = _mm256_max_ps(_mm256_min_ps(lx, hx),
+                                     _mm256_set1_ps(t_min));
+        enter = _mm256_max_ps(_mm256_min_ps(ly, hy), enter);
+        enter = _mm256_max_ps(_mm256_min_ps(lz, hz), enter);
+
+        __m256 exit = _mm256_min_ps(_mm256_max_ps(lx, hx),
+                                    _mm256_set1_ps(t_max));
+        exit = _mm256_min_ps(_mm256_max_ps(ly, hy), exit);
+        exit = _mm256_min_ps(_mm256_max_ps(lz, hz), exit);
+
+        _mm256_storeu_ps(distances, enter);
+
+        mask = static_cast<unsigned>(_mm256_movemask_ps(
+            _mm256_cmp_ps(enter, exit, _CMP_LE_OQ)));
+    } else
+#endif
+    {
+        mask = wide_slab4(node, 0, r, t_min, t_max, distances);
+
+        if constexpr (Width == 8)
+            mask |= wide_slab4(node, 4, r, t_min, t_max, distances) << 4;
+    }
+
+    return mask & ((1u << node.children) - 1);
+}
+
+/**
+ * @brief Finds the closest primitive hit by a ray in a wide BVH.
+ *
+ * The children hit by the ray are visited nearest first. Pending
+ * children are kept on a fixed-size stack together with their entry
+ * distance and are skipped when popped if a closer hit was found since.
+ *
+ * See the binary @ref intersect(const ray&, const bvh&, ...) for the
+ * parameter semantics.
+ */
+template <std::size_t Width, typename Primitives>
+bool intersect(const ray& r, const wide_bvh<Width>& tree,
+               const Primitives& primitives, float t_min,
+               float& t, std::size_t& hit,
+               bvh_traversal_stats* stats = nullptr) {
+    struct entry {
+        std::uint32_t child;
+        std::uint32_t count;
+        float distance;
+    };
+
+    if (stats)
+        stats->rays++;
+
+    if (tree.empty())
+        return false;
+
+    const auto& nodes = tree.nodes();
+    const shared_buffer<std::uint32_t>& indices = tree.indices();
+
+    const vec3f inverse_direction = vec3f(1, 1, 1) / r.direction();
+    const wide_ray slab_ray = {
+        { r.origin().x(), r.origin().y(), r.origin().z() },
+        { inverse_direction.x(), inverse_direction.y(),
+          inverse_direction.z() }
+    };
+
+    entry stack[wide_bvh<Width>::stack_size];
+    std::size_t stack_size = 0;
+    bool found = false;
+
+    stack[stack_size++] = entry{0, 0, t_min};
+
+    while (stack_size > 0) {
+        const entry current = stack[--stack_size];
+
+        if (current.distance > t)
+            continue;
+
+        if (current.count > 0) {
+            if (stats)
+                stats->primitives += current.count;
+
+            for (std::uint32_t i = current.child;
+                 i < current.child + current.count; i++)
+                if (intersect_primitive(r, primitives, indices[i], t_min,
+                                        t)) {
+                    hit = indices[i];
+                    found = true;
+                }
+
+            continue;
+        }
+
+        const wide_bvh_node<Width>& node = nodes[current.child];
+
+        if (stats)
+            stats->nodes++;
+
+        alignas(32) float distances[Width];
+        unsigned mask = wide_slab(node, slab_ray, t_min, t, distances);
+
+        // Push the hit children farthest first, so the nearest is on top.
+        const std::size_t base = stack_size;
+
+        while (mask) {
+            const unsigned lane = __builtin_ctz(mask);
+            mask &= mask - 1;
+
+            const entry child = { node.child[lane], node.count[lane],
+                                  distances[lane] };
+            std::size_t i = stack_size++;
+
+            for (; i > base && stack[i - 1].distance < child.distance; i--)
+                stack[i] = stack[i - 1];
+
+            stack[i] = child;
+        }
+    }
+
+    return found;
+}
@@ -0,0 +1,111 @@
+#include "doctest.h"
+#include "arena.h"
+#include "renderer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+
+TEST_CASE( "arena" ) {
+    arena memory(256);
+
+    SUBCASE( "alignment and blocks" ) {
+        char* c = static_cast<char*>(memory.allocate(1, 1));
+        double* d = memory.create<double>(2.5);
+        vec3f* v = memory.allocate_array<vec3f>(4);
+
+        CHECK( c != nullptr );
+        CHECK( *d == 2.5 );
+        CHECK( reinterpret_cast<std::uintptr_t>(d) % alignof(double) == 0 );
+        CHECK( reinterpret_cast<std::uintptr_t>(v) % alignof(vec3f) == 0 );
+
+        // Larger than a block: gets a block of its own.
+        char* large = static_cast<char*>(memory.allocate(1000, 64));
+
+        CHECK( reinterpret_cast<std::uintptr_t>(large) % 64 == 0 );
+        CHECK( memory.stats().allocations == 4 );
+        CHECK( memory.stats().capacity >= 1000 + 256 );
+        CHECK( memory.size() >=
+               1000 + 1 + sizeof(double) + 4 * sizeof(vec3f) );
+
+        CHECK_THROWS_AS( arena(0), std::invalid_argument );
+    }
+
+    SUBCASE( "mark, rewind and reset" ) {
+        memory.allocate(100);
+
+        const arena_mark start = memory.mark();
+        void* first = memory.allocate(300);
+
+        memory.rewind(start);
+
+        CHECK( memory.size() == 100 );
+        CHECK( memory.allocate(300) == first );
+
+        const std::size_t capacity = memory.stats().capacity;
+        const arena_stats frame = memory.reset();
+
+        CHECK( frame.high_water >= 400 );
+        CHECK( frame.allocations == 3 );
+        CHECK( memory.size() == 0 );
+        CHECK( memory.stats().high_water == 0 );
+
+        // The blocks are reused: no new capacity.
+        memory.allocate(100);
+        memory.allocate(300);
+
+        CHECK( memory.stats().capacity == capacity );
+    }
+
+    SUBCASE( "allocator" ) {
+        arena_vector<int> values{arena_allocator<int>(memory)};
+
+        for (int i = 0; i < 100; i++)
+            values.push_back(i);
+
+        CHECK( values[99] == 99 );
+        CHECK( memory.stats().allocations > 1 );
+        CHECK( values.get_allocator() ==
+               arena_allocator<double>(memory) );
+
+        arena other;
+
+        CHECK( values.get_allocator() != arena_allocator<int>(other) );
+    }
+}
+
+TEST_CASE( "thread arenas" ) {
+    scheduler pool(3);
+    thread_arenas scratch(pool, 1024);
+    framebuffer frame(64, 64);
+
+    render_settings settings;
+    settings.tile_size = 16;
+
+    std::atomic<std::size_t> wrong{0};
+
+    render(pool, frame, settings, scratch,
+           [&](std::size_t x, std::size_t y, arena& memory) {
+        arena_vector<float> samples{arena_allocator<float>(memory)};
+
+        for (std::size_t i = 0; i < 8; i++)
+            samples.push_back(float(x + y));
+
+        if (&memory != &scratch.local())
+            wrong++;
+
+        return colorf(samples.back(), 0, 0);
+    });
+
+    CHECK( scratch.size() == pool.size() );
+    CHECK( wrong == 0 );
+    CHECK( frame.row(10)[20].x() == 30 );
+
+    const arena_stats stats = scratch.reset();
+
+    // Every pixel allocated; each tile freed its allocations at the end.
+    CHECK( stats.allocations >= 64 * 64 );
+    CHECK( stats.high_water > 0 );
+    CHECK( stats.high_water <= stats.capacity );
+    CHECK( scratch.reset().allocations == 0 );
+}
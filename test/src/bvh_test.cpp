@@ -0,0 +1,306 @@
+#include "doctest.h"
+#include "bvh.h"
+#include "test_scenes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+/** @returns true if the brute force and BVH closest hits agree. */
+bool same_hit(const ray& r, const bvh& tree,
+              const std::vector<sphere>& spheres) {
+    float t_brute = std::numeric_limits<float>::infinity();
+    std::size_t hit_brute = spheres.size();
+
+    for (std::size_t i = 0; i < spheres.size(); i++)
+        if (intersect(r, spheres[i], 0.0f, t_brute))
+            hit_brute = i;
+
+    float t_tree = std::numeric_limits<float>::infinity();
+    std::size_t hit_tree = spheres.size();
+
+    const bool found = intersect(r, tree, spheres, 0.0f, t_tree, hit_tree);
+
+    return found == (hit_brute < spheres.size()) && hit_tree == hit_brute &&
+           t_tree == t_brute;
+}
+
+/** @returns The number of rays through the cloud on which tree is wrong. */
+int count_mismatches(const bvh& tree, const std::vector<sphere>& spheres) {
+    int mismatches = 0;
+
+    for (int i = 0; i < 500; i++) {
+        const float angle = i * 0.1f;
+        const ray r(vec3f(0, 0, -30), vec3f(std::cos(angle) * 0.3f,
+                                            std::sin(angle * 1.3f) * 0.3f,
+                                            1));
+
+        mismatches += !same_hit(r, tree, spheres);
+    }
+
+    return mismatches;
+}
+
+/** @returns true if every primitive is referenced by exactly one leaf. */
+bool complete(const bvh& tree, std::size_t count) {
+    std::vector<int> referenced(count, 0);
+
+    for (const bvh_node& node : tree.nodes())
+        if (node.leaf())
+            for (std::uint32_t i = 0; i < node.count; i++)
+                referenced[tree.indices()[node.offset + i]]++;
+
+    return std::count(referenced.begin(), referenced.end(), 1) ==
+           static_cast<std::ptrdiff_t>(count);
+}
+
+}
+
+TEST_CASE( "aabb" ) {
+    SUBCASE( "empty and extend" ) {
+        aabb box;
+
+        CHECK( box.empty() );
+        CHECK( box.surface_area() == 0 );
+
+        box.extend(vec3f(1, 2, 3));
+        box.extend(vec3f(-1, 0, 4));
+
+        CHECK_FALSE( box.empty() );
+        CHECK( box.min() == vec3f(-1, 0, 3) );
+        CHECK( box.max() == vec3f(1, 2, 4) );
+        CHECK( box.centroid() == vec3f(0, 1, 3.5) );
+        CHECK( box.surface_area() == 2 * (2 * 2 + 2 * 1 + 1 * 2) );
+        CHECK( box.largest_axis() == 0 );
+    }
+
+    SUBCASE( "primitive bounds" ) {
+        const aabb s = bounds(sphere(vec3f(1, 1, 1), 2));
+
+        CHECK( s.min() == vec3f(-1, -1, -1) );
+        CHECK( s.max() == vec3f(3, 3, 3) );
+
+        const aabb t = bounds(triangle(vec3f(0, 0, 0), vec3f(1, -1, 0),
+                                       vec3f(0, 2, 5)));
+
+        CHECK( t.min() == vec3f(0, -1, 0) );
+        CHECK( t.max() == vec3f(1, 2, 5) );
+    }
+
+    SUBCASE( "slab test" ) {
+        const aabb box(vec3f(-1, -1, -1), vec3f(1, 1, 1));
+        const float inf = std::numeric_limits<float>::infinity();
+        float entry;
+
+        const ray hit(vec3f(0, 0, -5), vec3f(0, 0, 1));
+        const vec3f inverse = vec3f(1, 1, 1) / hit.direction();
+
+        CHECK( intersect(hit, inverse, box, 0, inf, entry) );
+        CHECK( entry == 4 );
+        CHECK_FALSE( intersect(hit, inverse, box, 0, 3.5f, entry) );
+
+        const ray miss(vec3f(2, 0, -5), vec3f(0, 0, 1));
+
+        CHECK_FALSE( intersect(miss, vec3f(1, 1, 1) / miss.direction(), box,
+                               0, inf, entry) );
+    }
+}
+
+TEST_CASE( "bvh" ) {
+    SUBCASE( "empty" ) {
+        const bvh tree(std::vector<aabb>{});
+        const std::vector<sphere> spheres;
+        float t = 1;
+        std::size_t hit;
+
+        CHECK( tree.empty() );
+        CHECK( tree.stats().node_count == 0 );
+        CHECK_FALSE( intersect(ray(vec3f(), vec3f(0, 0, 1)), tree, spheres,
+                               0.0f, t, hit) );
+    }
+
+    SUBCASE( "invalid settings" ) {
+        bvh_build_settings settings;
+        settings.bins = 1;
+
+        CHECK_THROWS_AS( bvh(std::vector<aabb>(1), nullptr, settings),
+                         std::invalid_argument );
+
+        settings = bvh_build_settings();
+        settings.max_leaf_size = 0;
+
+        CHECK_THROWS_AS( bvh(std::vector<aabb>(1), nullptr, settings),
+                         std::invalid_argument );
+    }
+
+    SUBCASE( "structure and traversal" ) {
+        const std::vector<sphere> spheres = sphere_cloud(3000, 12345);
+        scheduler pool(4);
+
+        bvh_build_settings settings;
+        settings.parallel_threshold = 256;
+
+        for (scheduler* builder : {static_cast<scheduler*>(nullptr), &pool}) {
+            const bvh tree(primitive_bounds(spheres), builder, settings);
+            const bvh_build_stats& stats = tree.stats();
+
+            CHECK( stats.node_count == tree.nodes().size() );
+            CHECK( stats.node_count == 2 * stats.leaf_count - 1 );
+            CHECK( stats.max_depth < bvh::max_depth );
+            CHECK( stats.sah_cost > 1 );
+
+            // Every primitive is referenced by exactly one leaf.
+            std::vector<int> referenced(spheres.size(), 0);
+
+            for (const bvh_node& node : tree.nodes())
+                if (node.leaf())
+                    for (std::uint32_t i = 0; i < node.count; i++)
+                        referenced[tree.indices()[node.offset + i]]++;
+
+            CHECK( std::count(referenced.begin(), referenced.end(), 1) ==
+                   static_cast<std::ptrdiff_t>(spheres.size()) );
+
+            int mismatches = 0;
+
+            for (int i = 0; i < 500; i++) {
+                const float angle = i * 0.1f;
+                const ray r(vec3f(0, 0, -30),
+                            vec3f(std::cos(angle) * 0.3f,
+                                  std::sin(angle * 1.3f) * 0.3f, 1));
+
+                mismatches += !same_hit(r, tree, spheres);
+            }
+
+            CHECK( mismatches == 0 );
+        }
+    }
+
+    SUBCASE( "coincident primitives" ) {
+        const std::vector<sphere> spheres(100, sphere(vec3f(1, 2, 3), 1));
+        const bvh tree(primitive_bounds(spheres));
+
+        float t = std::numeric_limits<float>::infinity();
+        std::size_t hit = spheres.size();
+
+        CHECK( tree.stats().max_depth < bvh::max_depth );
+        CHECK( intersect(ray(vec3f(1, 2, -3), vec3f(0, 0, 1)), tree, spheres,
+                         0.0f, t, hit) );
+        CHECK( t == 5 );
+        CHECK( hit < spheres.size() );
+    }
+}
+
+TEST_CASE( "bvh refit" ) {
+    std::vector<sphere> spheres = sphere_cloud(2000, 12345);
+    scheduler pool(4);
+
+    bvh_build_settings settings;
+    settings.parallel_threshold = 64;
+
+    const bvh tree(primitive_bounds(spheres), &pool, settings);
+
+    for (std::size_t i = 0; i < spheres.size(); i++)
+        spheres[i] = sphere(spheres[i].center() +
+                            vec3f(std::sin(i * 0.7f), 0.5f, 0) * 0.3f,
+                            spheres[i].radius());
+
+    for (scheduler* refitter : {static_cast<scheduler*>(nullptr), &pool}) {
+        const bvh moved = refit(tree, primitive_bounds(spheres), refitter,
+                                settings);
+
+        CHECK( moved.indices().data() == tree.indices().data() );
+        CHECK( moved.stats().node_count == tree.stats().node_count );
+        CHECK( moved.stats().max_depth == tree.stats().max_depth );
+        CHECK( moved.stats().sah_cost > 1 );
+        CHECK( count_mismatches(moved, spheres) == 0 );
+    }
+
+    CHECK_THROWS_AS( refit(tree, std::vector<aabb>(3)),
+                     std::invalid_argument );
+}
+
+TEST_CASE( "dynamic bvh" ) {
+    std::vector<sphere> spheres = sphere_cloud(4000, 12345);
+    scheduler pool(4);
+
+    bvh_build_settings settings;
+    settings.parallel_threshold = 64;
+
+    bvh_update_settings update;
+    update.rebuild_threshold = 1.05f;
+    update.max_rebuild_fraction = 0.25f;
+
+    dynamic_bvh tree(primitive_bounds(spheres), &pool, settings, update);
+    const double built_cost = tree.tree().stats().sah_cost;
+
+    SUBCASE( "small motion is refitted" ) {
+        for (sphere& s : spheres)
+            s = sphere(s.center() + vec3f(0.01f, 0, 0), s.radius());
+
+        const bvh_update_stats stats = tree.update(primitive_bounds(spheres),
+                                                   &pool);
+
+        CHECK( stats.rebuilt_subtrees == 0 );
+        CHECK_FALSE( stats.full_rebuild );
+        CHECK( stats.sah_cost == stats.refit_sah_cost );
+        CHECK( count_mismatches(tree.tree(), spheres) == 0 );
+    }
+
+    SUBCASE( "degraded subtrees are rebuilt" ) {
+        const std::vector<sphere> before = spheres;
+        const bvh previous = tree.tree();
+
+        // Shuffle the spheres of one corner of the cloud within it.
+        pcg32 random(99);
+
+        for (sphere& s : spheres)
+            if (s.center().x() < -5 && s.center().y() < -5) {
+                const float u = random.next_float();
+                const float v = random.next_float();
+
+                s = sphere(vec3f(-10 + 5 * u, -10 + 5 * v, s.center().z()),
+                           s.radius());
+            }
+
+        for (scheduler* updater : {static_cast<scheduler*>(nullptr), &pool}) {
+            dynamic_bvh copy = tree;
+            const bvh_update_stats stats =
+                copy.update(primitive_bounds(spheres), updater);
+
+            CHECK( stats.refit_sah_cost > 1.05 * built_cost );
+            CHECK( stats.rebuilt_subtrees > 0 );
+            CHECK( stats.rebuilt_primitives < spheres.size() / 2 );
+            CHECK_FALSE( stats.full_rebuild );
+            CHECK( stats.sah_cost <= 1.05 * built_cost );
+            CHECK( stats.sah_cost == copy.tree().stats().sah_cost );
+            CHECK( copy.tree().stats().node_count ==
+                   copy.tree().nodes().size() );
+            CHECK( complete(copy.tree(), spheres.size()) );
+            CHECK( count_mismatches(copy.tree(), spheres) == 0 );
+        }
+
+        // The previous tree is untouched.
+        CHECK( count_mismatches(previous, before) == 0 );
+    }
+
+    SUBCASE( "full rebuild" ) {
+        std::reverse(spheres.begin(), spheres.end());
+
+        const bvh_update_stats stats = tree.update(primitive_bounds(spheres));
+
+        CHECK( stats.full_rebuild );
+        CHECK( stats.sah_cost == doctest::Approx(built_cost).epsilon(0.1) );
+        CHECK( count_mismatches(tree.tree(), spheres) == 0 );
+    }
+
+    update.rebuild_threshold = 0.5f;
+
+    CHECK_THROWS_AS( dynamic_bvh(primitive_bounds(spheres), nullptr,
+                                 settings, update),
+                     std::invalid_argument );
+    CHECK_THROWS_AS( tree.update(std::vector<aabb>(1)),
+                     std::invalid_argument );
+}
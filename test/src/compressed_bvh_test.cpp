@@ -0,0 +1,153 @@
+#include "doctest.h"
+#include "compressed_bvh.h"
+#include "test_scenes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+template <typename Tree>
+std::vector<float> trace_all(const Tree& tree,
+                             const std::vector<triangle>& triangles) {
+    std::vector<float> distances;
+
+    for (int i = 0; i < 2000; i++) {
+        const float angle = i * 0.01f;
+        const ray r(vec3f(0, 0, -1030), vec3f(std::cos(angle) * 0.01f,
+                                              std::sin(angle * 1.7f) * 0.01f,
+                                              1));
+
+        float t = std::numeric_limits<float>::infinity();
+        std::size_t hit;
+
+        intersect(r, tree, triangles, 0.0f, t, hit);
+        distances.push_back(t);
+    }
+
+    return distances;
+}
+
+/** @returns true if every decoded child box contains the exact one. */
+template <std::size_t Width>
+bool conservative(const compressed_bvh<Width>& compressed,
+                  const wide_bvh<Width>& wide) {
+    // The compressed tree stores siblings together, not depth-first:
+    // walk both trees in parallel.
+    struct pair {
+        std::uint32_t wide;
+        std::uint32_t compressed;
+    };
+
+    std::vector<pair> pending = { { 0, 0 } };
+
+    while (!pending.empty()) {
+        const pair current = pending.back();
+        pending.pop_back();
+
+        const wide_bvh_node<Width>& exact = wide.nodes()[current.wide];
+        const compressed_bvh_node<Width>& node =
+            compressed.nodes()[current.compressed];
+
+        wide_bvh_node<Width> decoded;
+        dequantize(node, decoded);
+
+        std::uint32_t child = node.child_base;
+
+        for (std::size_t i = 0; i < exact.children; i++) {
+            if (decoded.lo_x[i] > exact.lo_x[i] ||
+                decoded.lo_y[i] > exact.lo_y[i] ||
+                decoded.lo_z[i] > exact.lo_z[i] ||
+                decoded.hi_x[i] < exact.hi_x[i] ||
+                decoded.hi_y[i] < exact.hi_y[i] ||
+                decoded.hi_z[i] < exact.hi_z[i] ||
+                node.count[i] != exact.count[i])
+                return false;
+
+            if (exact.count[i] == 0)
+                pending.push_back({ exact.child[i], child++ });
+        }
+    }
+
+    return true;
+}
+
+}
+
+TEST_CASE( "compressed_bvh" ) {
+    SUBCASE( "empty" ) {
+        const compressed_bvh<8> tree{bvh(std::vector<aabb>{})};
+        const std::vector<triangle> triangles;
+        float t = 1;
+        std::size_t hit;
+
+        CHECK( tree.empty() );
+        CHECK( tree.memory_bytes() == 0 );
+        CHECK_FALSE( intersect(ray(vec3f(), vec3f(0, 0, 1)), tree, triangles,
+                               0.0f, t, hit) );
+    }
+
+    SUBCASE( "single leaf" ) {
+        const std::vector<triangle> triangles = {
+            triangle(vec3f(-1, -1, 2), vec3f(1, -1, 2), vec3f(0, 1, 2))
+        };
+        const compressed_bvh<4> tree{bvh(primitive_bounds(triangles))};
+
+        float t = std::numeric_limits<float>::infinity();
+        std::size_t hit = 1;
+
+        REQUIRE( tree.nodes().size() == 1 );
+        CHECK( tree.nodes()[0].count[0] == 1 );
+        CHECK( intersect(ray(vec3f(), vec3f(0, 0, 1)), tree, triangles,
+                         0.0f, t, hit) );
+        CHECK( t == doctest::Approx(2) );
+        CHECK( hit == 0 );
+    }
+
+    SUBCASE( "same hits as the binary tree" ) {
+        const std::vector<triangle> triangles = triangle_soup(5000, 4242, vec3f(10, 10, 1000));
+        const bvh binary(primitive_bounds(triangles));
+        const wide_bvh<4> wide4(binary);
+        const wide_bvh<8> wide8(binary);
+        const compressed_bvh<4> tree4(wide4);
+        const compressed_bvh<8> tree8(wide8);
+
+        CHECK( tree4.nodes().size() == wide4.nodes().size() );
+        CHECK( tree8.nodes().size() == wide8.nodes().size() );
+        CHECK( 3 * sizeof(compressed_bvh_node<8>) <
+               sizeof(wide_bvh_node<8>) );
+
+        CHECK( conservative(tree4, wide4) );
+        CHECK( conservative(tree8, wide8) );
+
+        // The indices are a permutation of the primitives.
+        std::vector<std::uint32_t> sorted = tree8.indices();
+        std::vector<std::uint32_t> all(triangles.size());
+
+        std::sort(sorted.begin(), sorted.end());
+        std::iota(all.begin(), all.end(), 0);
+
+        CHECK( sorted == all );
+
+        const std::vector<float> expected = trace_all(binary, triangles);
+
+        CHECK( trace_all(tree4, triangles) == expected );
+        CHECK( trace_all(tree8, triangles) == expected );
+        CHECK( std::count_if(expected.begin(), expected.end(), [](float t) {
+                   return std::isfinite(t);
+               }) > 100 );
+    }
+
+    SUBCASE( "large leaves" ) {
+        const std::vector<aabb> bounds(300, aabb(vec3f(0, 0, 0),
+                                                 vec3f(1, 1, 1)));
+        bvh_build_settings settings;
+        settings.max_leaf_size = 300;
+
+        CHECK_THROWS_AS( compressed_bvh<8>(bvh(bounds, nullptr, settings)),
+                         std::invalid_argument );
+    }
+}
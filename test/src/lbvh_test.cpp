@@ -0,0 +1,162 @@
+#include "doctest.h"
+#include "lbvh.h"
+#include "test_scenes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+/** @returns The closest hit distances of rays through the cloud. */
+std::vector<float> trace_all(const bvh& tree,
+                             const std::vector<sphere>& spheres) {
+    std::vector<float> distances;
+
+    for (int i = 0; i < 500; i++) {
+        const float angle = i * 0.1f;
+        const ray r(vec3f(0, 0, -30), vec3f(std::cos(angle) * 0.3f,
+                                            std::sin(angle * 1.3f) * 0.3f,
+                                            1));
+
+        float t = std::numeric_limits<float>::infinity();
+        std::size_t hit;
+
+        intersect(r, tree, spheres, 0.0f, t, hit);
+        distances.push_back(t);
+    }
+
+    return distances;
+}
+
+/** @returns true if the indices of tree are a permutation. */
+bool permutation(const bvh& tree, std::size_t count) {
+    std::vector<std::uint32_t> sorted(tree.indices().begin(),
+                                      tree.indices().end());
+    std::vector<std::uint32_t> all(count);
+
+    std::sort(sorted.begin(), sorted.end());
+    std::iota(all.begin(), all.end(), 0);
+
+    return sorted == all;
+}
+
+}
+
+TEST_CASE( "morton codes" ) {
+    CHECK( morton_code_30(vec3f(0, 0, 0)) == 0 );
+    CHECK( morton_code_30(vec3f(1, 1, 1)) == 0x3fffffffu );
+    CHECK( morton_code_30(vec3f(1, 0, 0)) == 0x24924924u );
+    CHECK( morton_code_30(vec3f(0, 0, 1)) == 0x09249249u );
+
+    // Cell (1, 2, 3): x = 01, y = 10, z = 11 interleaved to 011 101.
+    CHECK( morton_code_30(vec3f(1.5f, 2.5f, 3.5f) / 1024.0f) == 0x1du );
+
+    // Outside [0, 1] is clamped.
+    CHECK( morton_code_30(vec3f(-1, 2, 0.5f)) ==
+           morton_code_30(vec3f(0, 1, 0.5f)) );
+
+    CHECK( morton_code_63(vec3f(0, 0, 0)) == 0 );
+    CHECK( morton_code_63(vec3f(1, 1, 1)) == 0x7fffffffffffffffull );
+    CHECK( morton_code_63(vec3f(1.5f, 2.5f, 3.5f) / 2097152.0f) == 0x1du );
+
+    CHECK( expand_bits_10(0x3ff) == 0x09249249u );
+    CHECK( expand_bits_21(0x1fffff) == 0x1249249249249249ull );
+}
+
+TEST_CASE( "lbvh" ) {
+    SUBCASE( "empty and single" ) {
+        CHECK( build_lbvh(std::vector<aabb>{}).empty() );
+
+        const std::vector<sphere> spheres = { sphere(vec3f(0, 0, 5), 1) };
+        const bvh tree = build_lbvh(primitive_bounds(spheres));
+
+        float t = std::numeric_limits<float>::infinity();
+        std::size_t hit = 1;
+
+        REQUIRE( tree.nodes().size() == 1 );
+        CHECK( intersect(ray(vec3f(), vec3f(0, 0, 1)), tree, spheres, 0.0f,
+                         t, hit) );
+        CHECK( hit == 0 );
+        CHECK( t == doctest::Approx(4) );
+    }
+
+    SUBCASE( "same hits as the SAH builder" ) {
+        const std::vector<sphere> spheres = sphere_cloud(3000, 9876);
+        const std::vector<aabb> bounds = primitive_bounds(spheres);
+        const bvh sah(bounds);
+        const std::vector<float> expected = trace_all(sah, spheres);
+
+        CHECK( std::count_if(expected.begin(), expected.end(), [](float t) {
+                   return std::isfinite(t);
+               }) > 100 );
+
+        scheduler pool(4);
+        lbvh_build_settings settings;
+        settings.base.parallel_threshold = 64;
+
+        const bvh serial = build_lbvh(bounds);
+        const bvh parallel = build_lbvh(bounds, &pool, settings);
+
+        settings.wide_codes = true;
+        const bvh wide = build_lbvh(bounds, &pool, settings);
+
+        settings.treelet_passes = 2;
+        const bvh optimized = build_lbvh(bounds, &pool, settings);
+
+        for (const bvh* tree : { &serial, &parallel, &wide, &optimized }) {
+            CHECK( permutation(*tree, spheres.size()) );
+            CHECK( tree->stats().node_count == tree->nodes().size() );
+            CHECK( tree->stats().max_depth < bvh::max_depth );
+            CHECK( trace_all(*tree, spheres) == expected );
+        }
+
+        // The chunking does not change the tree.
+        CHECK( parallel.nodes().size() == serial.nodes().size() );
+        CHECK( std::equal(parallel.indices().begin(),
+                          parallel.indices().end(),
+                          serial.indices().begin()) );
+
+        CHECK( optimized.stats().sah_cost < wide.stats().sah_cost );
+    }
+
+    SUBCASE( "coincident primitives" ) {
+        // Every Morton code is the same: the tree splits by position.
+        const std::vector<sphere> spheres(5000, sphere(vec3f(0, 0, 3), 1));
+        lbvh_build_settings settings;
+        settings.treelet_passes = 1;
+
+        const bvh tree = build_lbvh(primitive_bounds(spheres), nullptr,
+                                    settings);
+
+        float t = std::numeric_limits<float>::infinity();
+        std::size_t hit;
+
+        CHECK( permutation(tree, spheres.size()) );
+        CHECK( tree.stats().max_depth < bvh::max_depth );
+        CHECK( intersect(ray(vec3f(), vec3f(0, 0, 1)), tree, spheres, 0.0f,
+                         t, hit) );
+        CHECK( t == doctest::Approx(2) );
+    }
+
+    SUBCASE( "invalid settings" ) {
+        const std::vector<aabb> bounds(4, aabb(vec3f(), vec3f(1, 1, 1)));
+        lbvh_build_settings settings;
+
+        settings.treelet_leaves = 2;
+        CHECK_THROWS_AS( build_lbvh(bounds, nullptr, settings),
+                         std::invalid_argument );
+
+        settings = lbvh_build_settings();
+        settings.base.max_leaf_size = 0;
+        CHECK_THROWS_AS( build_lbvh(bounds, nullptr, settings),
+                         std::invalid_argument );
+
+        settings = lbvh_build_settings();
+        settings.base.parallel_threshold = 0;
+        CHECK_THROWS_AS( build_lbvh(bounds, nullptr, settings),
+                         std::invalid_argument );
+    }
+}
@@ -0,0 +1,132 @@
+#include "doctest.h"
+#include "bvh.h"
+#include "mesh.h"
+#include "wide_bvh.h"
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+/** @returns A grid of (size + 1)^2 vertices and 2 * size^2 triangles. */
+mesh grid_mesh(std::size_t size, mesh_layout layout = mesh_layout::compact) {
+    std::vector<vec3f> positions;
+    std::vector<std::uint32_t> indices;
+
+    for (std::size_t y = 0; y <= size; y++)
+        for (std::size_t x = 0; x <= size; x++)
+            positions.push_back(vec3f(float(x), float(y),
+                                      5 + 0.01f * float(x)));
+
+    for (std::size_t y = 0; y < size; y++)
+        for (std::size_t x = 0; x < size; x++) {
+            const std::uint32_t i =
+                static_cast<std::uint32_t>(y * (size + 1) + x);
+            const std::uint32_t row = static_cast<std::uint32_t>(size + 1);
+
+            indices.insert(indices.end(), { i, i + 1, i + row });
+            indices.insert(indices.end(), { i + 1, i + row + 1, i + row });
+        }
+
+    return mesh(positions, indices, std::vector<vec3f>(),
+                std::vector<texcoord>(), layout);
+}
+
+}
+
+TEST_CASE( "mesh" ) {
+    SUBCASE( "construction" ) {
+        const mesh m(
+            { vec3f(0, 0, 0), vec3f(1, 0, 0), vec3f(0, 1, 0) }, { 0, 1, 2 },
+            { vec3f(0, 0, 1), vec3f(0, 0, 1), vec3f(0, 0, 1) },
+            { { 0, 0 }, { 1, 0 }, { 0, 1 } });
+
+        CHECK( m.triangle_count() == 1 );
+        CHECK( m.vertex_count() == 3 );
+        CHECK( m.normals().size() == 3 );
+        CHECK( m.uvs()[1].u == 1 );
+        CHECK( m.get_triangle(0).v1() == vec3f(1, 0, 0) );
+
+        CHECK( mesh().empty() );
+    }
+
+    SUBCASE( "invalid input" ) {
+        const std::vector<vec3f> p = { vec3f(0, 0, 0), vec3f(1, 0, 0),
+                                       vec3f(0, 1, 0) };
+
+        CHECK_THROWS_AS( mesh(p, { 0, 1 }), std::invalid_argument );
+        CHECK_THROWS_AS( mesh(p, { 0, 1, 3 }), std::invalid_argument );
+        CHECK_THROWS_AS( mesh(p, { 0, 1, 2 }, { vec3f(0, 0, 1) }),
+                         std::invalid_argument );
+        CHECK_THROWS_AS( mesh(p, { 0, 1, 2 }, {}, { { 0, 0 } }),
+                         std::invalid_argument );
+    }
+
+    SUBCASE( "index width" ) {
+        // 256^2 vertices still fit 16-bit indices, 257^2 do not.
+        const mesh narrow = grid_mesh(255);
+        const mesh wide = grid_mesh(256);
+
+        CHECK( narrow.vertex_count() == mesh::max_16bit_vertices );
+        CHECK_FALSE( narrow.wide_indices() );
+        CHECK( wide.wide_indices() );
+
+        CHECK( narrow.vertex_index(narrow.triangle_count() - 1, 1) ==
+               narrow.vertex_count() - 1 );
+        CHECK( wide.vertex_index(wide.triangle_count() - 1, 1) ==
+               wide.vertex_count() - 1 );
+
+        // Indexed storage is much smaller than independent triangles.
+        CHECK( narrow.memory_bytes() <
+               narrow.triangle_count() * sizeof(triangle) / 2 );
+    }
+
+    SUBCASE( "instances share buffers" ) {
+        const mesh m = grid_mesh(4);
+        const mesh instance = m;
+
+        CHECK( instance.shares_buffers(m) );
+        CHECK( &instance.positions() == &m.positions() );
+        CHECK_FALSE( grid_mesh(4).shares_buffers(m) );
+    }
+
+    SUBCASE( "bvh traversal" ) {
+        const mesh compact = grid_mesh(16);
+        const mesh pre = grid_mesh(16, mesh_layout::precomputed);
+        const bvh tree(primitive_bounds(compact));
+        const wide_bvh<4> wide(tree);
+
+        CHECK( pre.precomputed().size() == pre.triangle_count() );
+        CHECK( compact.precomputed().empty() );
+
+        std::size_t mismatches = 0;
+
+        for (int i = 0; i < 64; i++) {
+            const float x = 0.25f + i % 8 * 2;
+            const float y = 0.6f + i / 8 * 2;
+            const ray r(vec3f(x, y, 0), vec3f(0, 0, 1));
+
+            float t_brute = std::numeric_limits<float>::infinity();
+            std::size_t hit_brute = 0;
+
+            for (std::size_t j = 0; j < compact.triangle_count(); j++)
+                if (intersect(r, compact.get_triangle(j), 0, t_brute))
+                    hit_brute = j;
+
+            float t_compact = std::numeric_limits<float>::infinity();
+            float t_pre = t_compact, t_wide = t_compact;
+            std::size_t hit_compact = 0, hit_pre = 0, hit_wide = 0;
+
+            if (!intersect(r, tree, compact, 0, t_compact, hit_compact) ||
+                !intersect(r, tree, pre, 0, t_pre, hit_pre) ||
+                !intersect(r, wide, compact, 0, t_wide, hit_wide) ||
+                hit_compact != hit_brute || hit_pre != hit_brute ||
+                hit_wide != hit_brute || t_compact != t_brute ||
+                std::abs(t_pre - t_brute) > 1e-4f)
+                mismatches++;
+        }
+
+        CHECK( mismatches == 0 );
+    }
+}
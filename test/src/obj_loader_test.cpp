@@ -0,0 +1,119 @@
+#include "doctest.h"
+#include "obj_loader.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+/** @brief Writes text to a file in the temporary directory. */
+std::string write_file(const char* name, const std::string& text) {
+    const std::string path =
+        (std::filesystem::temp_directory_path() / name).string();
+
+    std::ofstream file(path, std::ios::binary);
+    file << text;
+
+    return path;
+}
+
+}
+
+TEST_CASE( "obj loader" ) {
+    scheduler pool(2);
+
+    obj_load_settings settings;
+    settings.chunk_size = 16;
+
+    SUBCASE( "positions only, polygons and relative indices" ) {
+        const std::string path = write_file("raystalker_quad.obj",
+            "# quad and triangle\n"
+            "v 0 0 0\nv 1 0 0\r\nv 1 1 0\n  v 0 1 0\n"
+            "o quad\n"
+            "f 1 2 3 4 # quad\n"
+            "v 2 0 0# extra\n"
+            "f -4 -1 -3 #\n");
+
+        const obj_scene scene = load_obj(path, pool, settings);
+        const mesh& m = scene.geometry;
+
+        CHECK( scene.stats.bytes > 0 );
+        CHECK( scene.stats.chunks > 1 );
+        REQUIRE( m.triangle_count() == 3 );
+        CHECK( m.vertex_count() == 5 );
+        CHECK( m.normals().empty() );
+        CHECK( m.vertex_index(1, 2) == 3 );
+        CHECK( m.vertex_index(2, 0) == 1 );
+        CHECK( m.vertex_index(2, 1) == 4 );
+        CHECK( m.get_triangle(2).v1() == vec3f(2, 0, 0) );
+
+        std::remove(path.c_str());
+    }
+
+    SUBCASE( "attributes and materials" ) {
+        const std::string mtl = write_file("raystalker_materials.mtl",
+            "newmtl red\nKd 1 0 0\nNs 10\n"
+            "newmtl glass\nKd 0.5 0.5 0.5\nd 0.25\n");
+        const std::string path = write_file("raystalker_attributes.obj",
+            "mtllib raystalker_materials.mtl\n"
+            "v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+            "vt 0 0\nvt 1 0\nvt 0 1\nvt 0.5 0.5\n"
+            "vn 0 0 1\n"
+            "f 1/1/1 2/2/1 3/3/1\n"
+            "usemtl red\n"
+            "f 1/4/1 3/3/1 2/2/1\n"
+            "usemtl unknown\n"
+            "f 1//1 2//1 3//1\n");
+
+        const obj_scene scene = load_obj(path, pool, settings);
+        const mesh& m = scene.geometry;
+
+        REQUIRE( m.triangle_count() == 3 );
+
+        // The uv indices differ from the position indices, and the last
+        // face has none: corners are merged and the uvs are dropped.
+        CHECK( m.uvs().empty() );
+        CHECK( m.normals().size() == m.vertex_count() );
+        CHECK( m.vertex_count() == 3 );
+        CHECK( m.normals()[0] == vec3f(0, 0, 1) );
+
+        REQUIRE( scene.materials.size() == 4 );
+        CHECK( scene.materials[1].diffuse == colorf(1, 0, 0) );
+        CHECK( scene.materials[1].shininess == 10 );
+        CHECK( scene.materials[2].opacity == 0.25f );
+        CHECK( scene.materials[3].name == "unknown" );
+
+        CHECK( scene.triangle_materials ==
+               std::vector<std::uint32_t>({ 0, 1, 3 }) );
+
+        std::remove(path.c_str());
+        std::remove(mtl.c_str());
+    }
+
+    SUBCASE( "errors" ) {
+        const std::string path = write_file("raystalker_bad.obj",
+            "v 0 0 0\nv 1 0 0\nv 0 1 0\n\nf 1 2 4\n");
+
+        CHECK_THROWS_WITH_AS( load_obj(path, pool, settings),
+                              (path + ":5: malformed or out of range face "
+                               "index").c_str(),
+                              std::runtime_error );
+
+        write_file("raystalker_bad.obj", "v 0 zero 0\n");
+
+        CHECK_THROWS_AS( load_obj(path, pool, settings), std::runtime_error );
+
+        settings.chunk_size = 0;
+
+        CHECK_THROWS_AS( load_obj(path, pool, settings),
+                         std::invalid_argument );
+
+        std::remove(path.c_str());
+
+        settings.chunk_size = 16;
+
+        CHECK_THROWS_AS( load_obj(path, pool, settings), std::runtime_error );
+    }
+}
@@ -0,0 +1,131 @@
+#include "doctest.h"
+#include "quantize.h"
+
+#include <cmath>
+#include <limits>
+
+TEST_CASE( "quantize_row" ) {
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+
+    const std::vector<colorf> row = {
+        colorf(0, 0.5, 1), colorf(-1, 2, nan), colorf(0.2, 0.4, 0.6),
+        colorf(1, 1, 1), colorf(0.1, 0.9, 0.002)
+    };
+
+    SUBCASE( "rgb8" ) {
+        std::vector<unsigned char> out(row.size() * 3);
+
+        quantize_row(row.data(), row.size(), out.data(), pixel_format::rgb8);
+
+        CHECK( out[0] == 0 );
+        CHECK( out[1] == 128 );
+        CHECK( out[2] == 255 );
+
+        CHECK( out[3] == 0 );
+        CHECK( out[4] == 255 );
+        CHECK( out[5] == 0 );
+
+        CHECK( out[6] == 51 );
+        CHECK( out[7] == 102 );
+        CHECK( out[8] == 153 );
+
+        CHECK( out[12] == 26 );
+        CHECK( out[13] == 230 );
+        CHECK( out[14] == 1 );
+    }
+
+    SUBCASE( "rgba8" ) {
+        std::vector<unsigned char> out(row.size() * 4);
+
+        quantize_row(row.data(), row.size(), out.data(), pixel_format::rgba8);
+
+        for (size_t i = 0; i < row.size(); i++)
+            CHECK( out[4 * i + 3] == 255 );
+
+        CHECK( out[1] == 128 );
+        CHECK( out[9] == 102 );
+        CHECK( out[18] == 1 );
+    }
+
+    SUBCASE( "srgb" ) {
+        std::vector<unsigned char> out(row.size() * 3);
+
+        quantize_row(row.data(), row.size(), out.data(), pixel_format::rgb8,
+                     transfer_function::srgb);
+
+        CHECK( out[0] == 0 );
+        CHECK( out[1] == 188 );
+        CHECK( out[2] == 255 );
+        CHECK( out[5] == 0 );
+        CHECK( out[12] == 89 );
+    }
+
+    SUBCASE( "srgb is exactly rounded" ) {
+        // Evenly spaced values, then a finer sweep near black, where the
+        // encoding is steepest.
+        std::vector<float> values;
+
+        for (int i = 0; i <= 300000; i++)
+            values.push_back(i / 300000.0f);
+
+        for (int i = 0; i < 300000; i++)
+            values.push_back(i * 1e-7f);
+
+        std::vector<colorf> pixels;
+
+        for (std::size_t i = 0; i + 2 < values.size(); i += 3)
+            pixels.push_back(colorf(values[i], values[i + 1], values[i + 2]));
+
+        std::vector<unsigned char> out(pixels.size() * 3);
+
+        quantize_row(pixels.data(), pixels.size(), out.data(),
+                     pixel_format::rgb8, transfer_function::srgb);
+
+        std::size_t mismatches = 0;
+
+        for (std::size_t i = 0; i < out.size(); i++) {
+            const double linear = values[i];
+            const double encoded = linear <= 0.0031308
+                                 ? 12.92 * linear
+                                 : 1.055 * std::pow(linear, 1 / 2.4) - 0.055;
+
+            if (out[i] != std::nearbyint(encoded * 255.0))
+                mismatches++;
+        }
+
+        CHECK( mismatches == 0 );
+    }
+
+    SUBCASE( "simd and scalar tails agree" ) {
+        std::vector<colorf> pixels;
+
+        for (int i = 0; i < 11; i++)
+            pixels.push_back(colorf(i / 10.f, 1 - i / 10.f, i / 20.f));
+
+        std::vector<unsigned char> all(pixels.size() * 3);
+        std::vector<unsigned char> one_by_one(pixels.size() * 3);
+
+        quantize_row(pixels.data(), pixels.size(), all.data(), 
+                     pixel_format::rgb8, transfer_function::srgb);
+
+        for (size_t i = 0; i < pixels.size(); i++)
+            quantize_row(&pixels[i], 1, one_by_one.data() + 3 * i,
+                         pixel_format::rgb8, transfer_function::srgb);
+
+        CHECK( all == one_by_one );
+    }
+}
+
+TEST_CASE( "quantize framebuffer" ) {
+    framebuffer frame(5, 2);
+
+    frame.at(4, 1) = colorf(1, 0.5, 0);
+
+    const std::vector<unsigned char> image = quantize(frame, 
+                                                      pixel_format::rgba8);
+
+    CHECK( image.size() == 5 * 2 * 4 );
+    CHECK( image[(1 * 5 + 4) * 4 + 0] == 255 );
+    CHECK( image[(1 * 5 + 4) * 4 + 1] == 128 );
+    CHECK( image[0] == 0 );
+}
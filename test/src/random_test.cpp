@@ -0,0 +1,124 @@
+#include "doctest.h"
+#include "random.h"
+#include "renderer.h"
+
+#include <cmath>
+
+TEST_CASE( "pcg32" ) {
+    SUBCASE( "reference sequence" ) {
+        // pcg32-global-demo of the PCG reference implementation.
+        pcg32 random(42, 54);
+
+        CHECK( random.next() == 0xa15c02b7u );
+        CHECK( random.next() == 0x7b47f409u );
+        CHECK( random.next() == 0xba1d3330u );
+        CHECK( random.next() == 0x83d2f293u );
+        CHECK( random.next() == 0xbfa4784bu );
+        CHECK( random.next() == 0xcbed606eu );
+    }
+
+    SUBCASE( "floats" ) {
+        pcg32 random;
+        float sum = 0;
+        bool in_range = true;
+
+        for (int i = 0; i < 10000; i++) {
+            const float u = random.next_float();
+
+            in_range = in_range && u >= 0 && u < 1;
+            sum += u;
+        }
+
+        CHECK( in_range );
+        CHECK( sum / 10000 == doctest::Approx(0.5).epsilon(0.02) );
+    }
+
+    SUBCASE( "pixel generators" ) {
+        pcg32 a = pixel_random(3, 4, 0);
+        pcg32 b = pixel_random(3, 4, 0);
+        pcg32 next_sample = pixel_random(3, 4, 1);
+        pcg32 next_pixel = pixel_random(4, 4, 0);
+        pcg32 next_frame = pixel_random(3, 4, 0, 1);
+
+        const std::uint32_t first = a.next();
+
+        CHECK( first == b.next() );
+        CHECK( first != next_sample.next() );
+        CHECK( first != next_pixel.next() );
+        CHECK( first != next_frame.next() );
+    }
+}
+
+TEST_CASE( "sampling" ) {
+    pcg32 random(7);
+    const vec3f normal = vec3f(1, -2, 0.5f).getNormalized();
+
+    vec3f sphere_mean(0, 0, 0);
+    float cosine_mean = 0;
+    std::size_t bad = 0;
+
+    const int count = 20000;
+
+    for (int i = 0; i < count; i++) {
+        const vec3f s = sample_sphere(random);
+        const vec3f h = sample_hemisphere(random, normal);
+        const vec3f c = sample_cosine_hemisphere(random, normal);
+
+        if (std::fabs(s.length() - 1) > 1e-4f ||
+            std::fabs(h.length() - 1) > 1e-4f ||
+            std::fabs(c.length() - 1) > 1e-4f ||
+            dot(h, normal) < -1e-5f || dot(c, normal) < -1e-5f)
+            bad++;
+
+        sphere_mean += s;
+        cosine_mean += dot(c, normal);
+    }
+
+    CHECK( bad == 0 );
+    CHECK( (sphere_mean / float(count)).length() < 0.02f );
+
+    // E[cos] is 2/3 under the cosine density.
+    CHECK( cosine_mean / count == doctest::Approx(2.0 / 3).epsilon(0.01) );
+
+    SUBCASE( "orthonormal basis" ) {
+        for (const vec3f& n : { vec3f(0, 0, 1), vec3f(0, 0, -1), normal }) {
+            vec3f t, b;
+            orthonormal_basis(n, t, b);
+
+            CHECK( dot(t, n) == doctest::Approx(0).epsilon(1e-6) );
+            CHECK( dot(b, n) == doctest::Approx(0).epsilon(1e-6) );
+            CHECK( dot(t, b) == doctest::Approx(0).epsilon(1e-6) );
+            CHECK( t.length() == doctest::Approx(1) );
+            CHECK( cross(t, b).x() == doctest::Approx(n.x()) );
+        }
+    }
+}
+
+TEST_CASE( "random renders are reproducible across thread counts" ) {
+    auto shade = [](std::size_t x, std::size_t y) {
+        pcg32 random = pixel_random(static_cast<std::uint32_t>(x),
+                                    static_cast<std::uint32_t>(y), 0, 9);
+
+        return sample_sphere(random);
+    };
+
+    framebuffer serial(48, 40);
+    framebuffer parallel(48, 40);
+
+    render_settings settings;
+    settings.tile_size = 8;
+
+    scheduler one(1);
+    scheduler many(4);
+
+    render(one, serial, settings, shade);
+    render(many, parallel, settings, shade);
+
+    std::size_t mismatches = 0;
+
+    for (std::size_t y = 0; y < 40; y++)
+        for (std::size_t x = 0; x < 48; x++)
+            mismatches += !(serial.row(y)[x] == parallel.row(y)[x]);
+
+    CHECK( mismatches == 0 );
+}
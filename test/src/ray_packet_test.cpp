@@ -0,0 +1,100 @@
+#include "doctest.h"
+#include "ray_packet.h"
+
+#include <limits>
+
+namespace {
+
+const float infinity = std::numeric_limits<float>::infinity();
+
+ray_packet<8> make_fan() {
+    ray_packet<8> rays;
+
+    for (std::size_t i = 0; i < 8; i++)
+        rays.set(i, ray(vec3f(0, 0, 0), 
+                        vec3f(-0.7f + 0.2f * i, 0.1f * i, -1)));
+
+    return rays;
+}
+
+template <typename Primitive>
+void check_against_scalar(const Primitive& primitive) {
+    const ray_packet<8> rays = make_fan();
+
+    packet_distances<8> t;
+    t.fill(infinity);
+
+    const packet_mask active = 0xF7;
+    const packet_mask hits = intersect(rays, primitive, active, 0.001f, t);
+
+    for (std::size_t i = 0; i < 8; i++) {
+        float expected = infinity;
+        const bool hit = ((active >> i) & 1) &&
+                         intersect(rays.get(i), primitive, 0.001f, expected);
+
+        CHECK( bool((hits >> i) & 1) == hit );
+
+        if (hit)
+            CHECK( t[i] == doctest::Approx(expected) );
+        else
+            CHECK( t[i] == infinity );
+    }
+}
+
+}
+
+TEST_CASE( "scalar ray intersection" ) {
+    const ray r(vec3f(0, 0, 0), vec3f(0, 0, -1));
+    float t = infinity;
+
+    SUBCASE( "sphere" ) {
+        CHECK( intersect(r, sphere(vec3f(0, 0, -5), 1), 0.001f, t) );
+        CHECK( t == doctest::Approx(4) );
+        CHECK( !intersect(r, sphere(vec3f(0, 3, -5), 1), 0.001f, t) );
+    }
+
+    SUBCASE( "plane" ) {
+        CHECK( intersect(r, plane(vec3f(0, 0, 1), -2), 0.001f, t) );
+        CHECK( t == doctest::Approx(2) );
+        CHECK( !intersect(r, plane(vec3f(0, 1, 0), -2), 0.001f, t) );
+    }
+
+    SUBCASE( "triangle" ) {
+        const triangle tri(vec3f(-1, -1, -3), vec3f(1, -1, -3), 
+                           vec3f(0, 1, -3));
+
+        CHECK( intersect(r, tri, 0.001f, t) );
+        CHECK( t == doctest::Approx(3) );
+        CHECK( r.point_at(t) == vec3f(0, 0, -3) );
+    }
+}
+
+TEST_CASE( "ray packet intersection" ) {
+    SUBCASE( "sphere" ) {
+        check_against_scalar(sphere(vec3f(0, 0.3f, -3), 1));
+    }
+
+    SUBCASE( "plane" ) {
+        check_against_scalar(plane(vec3f(0, 1, 0), 0.2f));
+    }
+
+    SUBCASE( "triangle" ) {
+        check_against_scalar(triangle(vec3f(-1, -1, -2), vec3f(1, -1, -2),
+                                      vec3f(0, 1, -2)));
+    }
+
+    SUBCASE( "closest hit across primitives" ) {
+        const ray_packet<8> rays = make_fan();
+        packet_distances<8> t;
+        t.fill(infinity);
+
+        intersect(rays, sphere(vec3f(0, 0, -10), 20), 
+                  ray_packet<8>::all_lanes, 0.001f, t);
+        const packet_mask hits = intersect(rays, plane(vec3f(0, 0, 1), -1),
+                                           ray_packet<8>::all_lanes, 
+                                           0.001f, t);
+
+        CHECK( hits == ray_packet<8>::all_lanes );
+        CHECK( t[0] == doctest::Approx(1) );
+    }
+}
@@ -0,0 +1,62 @@
+#include "doctest.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+TEST_CASE( "make_tiles" ) {
+    SUBCASE( "clipped edges" ) {
+        const std::vector<tile> tiles = make_tiles(40, 20, 16);
+
+        REQUIRE( tiles.size() == 6 );
+
+        CHECK( tiles[0].x0 == 0 );
+        CHECK( tiles[0].x1 == 16 );
+        CHECK( tiles[2].x0 == 32 );
+        CHECK( tiles[2].x1 == 40 );
+        CHECK( tiles[5].y0 == 16 );
+        CHECK( tiles[5].y1 == 20 );
+    }
+
+    SUBCASE( "covers every pixel once" ) {
+        std::vector<int> covered(37 * 23, 0);
+
+        for (const tile& region : make_tiles(37, 23, 8))
+            for (std::size_t y = region.y0; y < region.y1; y++)
+                for (std::size_t x = region.x0; x < region.x1; x++)
+                    covered[y * 37 + x]++;
+
+        CHECK( std::count(covered.begin(), covered.end(), 1) ==
+               static_cast<std::ptrdiff_t>(covered.size()) );
+    }
+
+    SUBCASE( "empty image" ) {
+        CHECK( make_tiles(0, 10, 16).empty() );
+    }
+
+    SUBCASE( "invalid tile size" ) {
+        CHECK_THROWS_AS( make_tiles(10, 10, 0), std::invalid_argument );
+    }
+}
+
+TEST_CASE( "render" ) {
+    for (unsigned threads : {1u, 4u, 64u}) {
+        framebuffer frame(70, 45);
+        scheduler pool(threads);
+
+        render_settings settings;
+        settings.tile_size = 16;
+
+        render(pool, frame, settings, [](std::size_t x, std::size_t y) {
+            return colorf(float(x), float(y), 1);
+        });
+
+        std::size_t wrong = 0;
+
+        for (std::size_t y = 0; y < frame.height(); y++)
+            for (std::size_t x = 0; x < frame.width(); x++)
+                wrong += frame.at(x, y) != colorf(float(x), float(y), 1);
+
+        CHECK( wrong == 0 );
+    }
+}
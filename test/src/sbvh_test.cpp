@@ -0,0 +1,156 @@
+#include "doctest.h"
+#include "sbvh.h"
+#include "test_scenes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+/** @returns Long thin triangles in random directions. */
+std::vector<triangle> slivers(std::size_t count) {
+    std::vector<triangle> triangles;
+    pcg32 random(777);
+
+    for (std::size_t i = 0; i < count; i++) {
+        const float x = next_centered(random, 8);
+        const float y = random.next_float() * 4;
+        const float z = next_centered(random, 8) - 4;
+        const vec3f center(x, y, z);
+
+        const float dx = next_centered(random, 1);
+        const float dy = next_centered(random, 1);
+        const float dz = next_centered(random, 1);
+        const vec3f along(dx, dy, dz);
+        const vec3f across(0.05f, 0.05f, 0);
+
+        triangles.push_back(triangle(center - along, center + along,
+                                     center + across));
+    }
+
+    return triangles;
+}
+
+ray grid_ray(int i) {
+    const float x = (i % 40) * 0.4f - 8;
+    const float y = (i / 40) * 0.1f;
+
+    return ray(vec3f(x, y, -20), vec3f(0.01f, 0.02f, 1));
+}
+
+float brute_force(const std::vector<triangle>& triangles, const ray& r) {
+    float t = std::numeric_limits<float>::infinity();
+
+    for (const triangle& tri : triangles)
+        intersect(r, tri, 0.0f, t);
+
+    return t;
+}
+
+}
+
+TEST_CASE( "sbvh" ) {
+    SUBCASE( "empty" ) {
+        const bvh tree = build_sbvh(std::vector<triangle>{});
+
+        CHECK( tree.empty() );
+    }
+
+    SUBCASE( "same hits as brute force, cheaper than binned" ) {
+        const std::vector<triangle> triangles = slivers(2000);
+        scheduler pool(2);
+        sbvh_build_settings settings;
+        settings.base.parallel_threshold = 256;
+
+        const bvh binned(primitive_bounds(triangles));
+        const bvh tree = build_sbvh(triangles, &pool, settings);
+
+        // Every triangle is referenced, within the duplication budget.
+        std::vector<std::uint32_t> sorted(tree.indices().begin(),
+                                          tree.indices().end());
+        std::sort(sorted.begin(), sorted.end());
+
+        CHECK( std::unique(sorted.begin(), sorted.end()) - sorted.begin() ==
+               static_cast<std::ptrdiff_t>(triangles.size()) );
+        CHECK( tree.indices().size() > triangles.size() );
+        CHECK( tree.indices().size() <= triangles.size() * 1.3 );
+        CHECK( tree.stats().node_count == tree.nodes().size() );
+        CHECK( tree.stats().sah_cost < binned.stats().sah_cost );
+
+        bvh_traversal_stats sbvh_stats;
+        bvh_traversal_stats binned_stats;
+        int hits = 0;
+
+        for (int i = 0; i < 1600; i++) {
+            const ray r = grid_ray(i);
+            const float expected = brute_force(triangles, r);
+
+            float t = std::numeric_limits<float>::infinity();
+            float binned_t = t;
+            std::size_t hit;
+
+            intersect(r, tree, triangles, 0.0f, t, hit, &sbvh_stats);
+            intersect(r, binned, triangles, 0.0f, binned_t, hit,
+                      &binned_stats);
+
+            CHECK( t == expected );
+            hits += std::isfinite(t);
+        }
+
+        CHECK( hits > 800 );
+        CHECK( sbvh_stats.primitives < binned_stats.primitives );
+    }
+
+    SUBCASE( "no budget, no duplicates" ) {
+        const std::vector<triangle> triangles = slivers(500);
+        sbvh_build_settings settings;
+        settings.duplication_budget = 0;
+
+        const bvh tree = build_sbvh(triangles, nullptr, settings);
+
+        CHECK( tree.indices().size() == triangles.size() );
+    }
+
+    SUBCASE( "mesh and presets" ) {
+        const std::vector<vec3f> positions = {
+            vec3f(-10, -10, 2), vec3f(10, 10, 2), vec3f(10, 9.9f, 2),
+            vec3f(-10, 10, 3), vec3f(10, -10, 3), vec3f(9.9f, -10, 3)
+        };
+        const mesh geometry(positions, { 0, 1, 2, 3, 4, 5 });
+
+        const bvh fast = build_bvh(geometry, bvh_quality::fast);
+        const bvh high = build_bvh(geometry, bvh_quality::high);
+
+        CHECK( fast.indices().size() == 2 );
+        CHECK( high.indices().size() >= 2 );
+
+        float t = std::numeric_limits<float>::infinity();
+        std::size_t hit = 2;
+
+        CHECK( intersect(ray(vec3f(0, 0, 0), vec3f(0, 0, 1)), high, geometry,
+                         0.0f, t, hit) );
+        CHECK( hit == 0 );
+        CHECK( t == doctest::Approx(2) );
+    }
+
+    SUBCASE( "invalid settings" ) {
+        const std::vector<triangle> triangles = slivers(10);
+        sbvh_build_settings settings;
+
+        settings.spatial_bins = 1;
+        CHECK_THROWS_AS( build_sbvh(triangles, nullptr, settings),
+                         std::invalid_argument );
+
+        settings = sbvh_build_settings();
+        settings.duplication_budget = -1;
+        CHECK_THROWS_AS( build_sbvh(triangles, nullptr, settings),
+                         std::invalid_argument );
+
+        settings = sbvh_build_settings();
+        settings.base.max_leaf_size = 0;
+        CHECK_THROWS_AS( build_sbvh(triangles, nullptr, settings),
+                         std::invalid_argument );
+    }
+}
@@ -0,0 +1,241 @@
+#include "doctest.h"
+#include "mapped_file.h"
+#include "scene_cache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+/** @returns A strip of count triangles. */
+mesh strip_mesh(std::size_t count, mesh_layout layout) {
+    std::vector<vec3f> positions;
+    std::vector<vec3f> normals;
+    std::vector<texcoord> uvs;
+    std::vector<std::uint32_t> indices;
+
+    for (std::size_t i = 0; i < count + 2; i++) {
+        positions.push_back(vec3f(float(i / 2), float(i % 2), 4));
+        normals.push_back(vec3f(0, 0, -1));
+        uvs.push_back({ float(i), 0 });
+    }
+
+    for (std::uint32_t i = 0; i < count; i++)
+        indices.insert(indices.end(), { i, i + 1, i + 2 });
+
+    return mesh(positions, indices, normals, uvs, layout);
+}
+
+/** @returns A path in the temporary directory. */
+std::string temporary_path(const char* name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+}
+
+TEST_CASE( "mapped_file" ) {
+    const std::string path = temporary_path("raystalker_mapped_file");
+
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "abc";
+    }
+
+    const mapped_file file(path);
+
+    CHECK( file.size() == 3 );
+    CHECK( std::string(file.data(), file.size()) == "abc" );
+
+    std::remove(path.c_str());
+
+    CHECK_THROWS_AS( mapped_file{ path }, std::runtime_error );
+}
+
+TEST_CASE( "scene cache" ) {
+    const std::string path = temporary_path("raystalker_scene_cache");
+
+    cached_scene scene;
+    scene.geometry = strip_mesh(100, mesh_layout::precomputed);
+    scene.tree = bvh(primitive_bounds(scene.geometry));
+
+    write_scene_cache(path, scene, 42);
+
+    SUBCASE( "no temporary left" ) {
+        std::size_t files = 0;
+
+        for (const auto& entry : std::filesystem::directory_iterator(
+                 std::filesystem::temp_directory_path()))
+            if (entry.path().filename().string().rfind(
+                    "raystalker_scene_cache.", 0) == 0)
+                files++;
+
+        CHECK( files == 0 );
+        CHECK_THROWS_AS( write_scene_cache(path + ".missing/cache", scene,
+                                           42),
+                         std::runtime_error );
+    }
+
+    SUBCASE( "round trip" ) {
+        const cached_scene loaded = load_scene_cache(path, 42);
+        const mesh& m = loaded.geometry;
+
+        REQUIRE( m.triangle_count() == 100 );
+        CHECK( m.vertex_count() == 102 );
+        CHECK( m.layout() == mesh_layout::precomputed );
+        CHECK( m.precomputed().size() == 100 );
+        CHECK( m.normals()[7] == vec3f(0, 0, -1) );
+        CHECK( m.uvs()[7].u == 7 );
+        CHECK( m.vertex_index(99, 2) == 101 );
+
+        CHECK( loaded.tree.nodes().size() == scene.tree.nodes().size() );
+        CHECK( loaded.tree.stats().sah_cost == scene.tree.stats().sah_cost );
+
+        // The buffers live in the mapping, 64-byte aligned.
+        CHECK( reinterpret_cast<std::uintptr_t>(m.positions().data()) % 64 ==
+               0 );
+
+        std::size_t mismatches = 0;
+
+        for (int i = 0; i < 50; i++) {
+            const ray r(vec3f(0.3f + i, 0.5f, 0), vec3f(0, 0, 1));
+
+            float t_original = std::numeric_limits<float>::infinity();
+            float t_loaded = t_original;
+            std::size_t hit_original = 0, hit_loaded = 0;
+
+            const bool found_original = intersect(r, scene.tree,
+                                                  scene.geometry, 0,
+                                                  t_original, hit_original);
+            const bool found_loaded = intersect(r, loaded.tree, m, 0,
+                                                t_loaded, hit_loaded);
+
+            if (!found_original || found_loaded != found_original ||
+                hit_loaded != hit_original || t_loaded != t_original)
+                mismatches++;
+        }
+
+        CHECK( mismatches == 0 );
+    }
+
+    SUBCASE( "rejected caches" ) {
+        CHECK_THROWS_AS( load_scene_cache(path, 43), std::runtime_error );
+
+        {
+            std::fstream file(path, std::ios::binary | std::ios::in |
+                                    std::ios::out);
+            file.seekp(8);
+            file.put(char(0x7f));
+        }
+
+        CHECK_THROWS_AS( load_scene_cache(path, 42), std::runtime_error );
+        CHECK_THROWS_AS( load_scene_cache(path + ".missing"),
+                         std::runtime_error );
+    }
+
+    SUBCASE( "corrupt mesh" ) {
+        std::shared_ptr<mesh_buffers> buffers =
+            std::make_shared<mesh_buffers>(*scene.geometry.data());
+        std::vector<std::uint16_t> indices(buffers->indices_16.begin(),
+                                           buffers->indices_16.end());
+
+        REQUIRE_FALSE( buffers->wide_indices );
+        indices[7] = static_cast<std::uint16_t>(
+            scene.geometry.vertex_count());
+        buffers->indices_16 = shared_buffer<std::uint16_t>(indices);
+
+        cached_scene corrupt;
+        corrupt.geometry = mesh(buffers);
+        corrupt.tree = scene.tree;
+
+        write_scene_cache(path, corrupt, 42);
+
+        CHECK_THROWS_AS( load_scene_cache(path, 42), std::runtime_error );
+    }
+
+    SUBCASE( "corrupt bvh" ) {
+        auto rejected = [&](const std::vector<bvh_node>& nodes,
+                            const std::vector<std::uint32_t>& indices,
+                            const bvh_build_stats& stats) {
+            cached_scene corrupt;
+            corrupt.geometry = scene.geometry;
+            corrupt.tree = bvh(shared_buffer<bvh_node>(nodes),
+                               shared_buffer<std::uint32_t>(indices), stats);
+
+            write_scene_cache(path, corrupt, 42);
+
+            try {
+                load_scene_cache(path, 42);
+            } catch (const std::runtime_error&) {
+                return true;
+            }
+
+            return false;
+        };
+
+        const std::vector<bvh_node> nodes(scene.tree.nodes().begin(),
+                                          scene.tree.nodes().end());
+        const std::vector<std::uint32_t> indices(
+            scene.tree.indices().begin(), scene.tree.indices().end());
+        const bvh_build_stats& stats = scene.tree.stats();
+
+        REQUIRE( !nodes[0].leaf() );
+        CHECK_FALSE( rejected(nodes, indices, stats) );
+
+        std::vector<bvh_node> bad_nodes = nodes;
+        bad_nodes[0].offset = static_cast<std::uint32_t>(nodes.size());
+        CHECK( rejected(bad_nodes, indices, stats) );
+
+        // A cycle back to the root.
+        bad_nodes = nodes;
+        bad_nodes[0].offset = 0;
+        CHECK( rejected(bad_nodes, indices, stats) );
+
+        bad_nodes = nodes;
+        bad_nodes[0].axis = 3;
+        CHECK( rejected(bad_nodes, indices, stats) );
+
+        bad_nodes = nodes;
+        bad_nodes[nodes.size() - 1].count = 0xffff;
+        CHECK( rejected(bad_nodes, indices, stats) );
+
+        std::vector<std::uint32_t> bad_indices = indices;
+        bad_indices[3] = 100;
+        CHECK( rejected(nodes, bad_indices, stats) );
+
+        bvh_build_stats bad_stats = stats;
+        bad_stats.max_depth = bvh::max_depth + 1;
+        CHECK( rejected(nodes, indices, bad_stats) );
+    }
+
+    SUBCASE( "open builds once" ) {
+        std::remove(path.c_str());
+
+        int loads = 0;
+        bool loaded = true;
+
+        auto load = [&loads] {
+            loads++;
+            return strip_mesh(10, mesh_layout::compact);
+        };
+
+        const cached_scene built = open_scene_cache(path, 7, load, nullptr,
+                                                    bvh_build_settings(),
+                                                    &loaded);
+
+        CHECK_FALSE( loaded );
+
+        const cached_scene cached = open_scene_cache(path, 7, load, nullptr,
+                                                     bvh_build_settings(),
+                                                     &loaded);
+
+        CHECK( loaded );
+        CHECK( loads == 1 );
+        CHECK( cached.geometry.triangle_count() == 10 );
+        CHECK_FALSE( cached.geometry.wide_indices() );
+    }
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,100 @@
+#include "doctest.h"
+#include "scheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+TEST_CASE( "scheduler" ) {
+    for (unsigned threads : {1u, 4u}) {
+        scheduler pool(threads);
+
+        REQUIRE( pool.size() == threads );
+
+        SUBCASE( "submit and wait" ) {
+            std::atomic<int> sum(0);
+            task_group group;
+
+            for (int i = 1; i <= 1000; i++)
+                pool.submit(group, [&sum, i] { sum += i; });
+
+            pool.wait(group);
+
+            CHECK( group.done() );
+            CHECK( sum == 500500 );
+            CHECK( pool.stats().tasks == 1000 );
+        }
+
+        SUBCASE( "nested groups" ) {
+            std::atomic<int> count(0);
+            task_group outer;
+
+            for (int i = 0; i < 8; i++)
+                pool.submit(outer, [&] {
+                    task_group inner;
+
+                    for (int j = 0; j < 8; j++)
+                        pool.submit(inner, [&count] { count++; });
+
+                    pool.wait(inner);
+                });
+
+            pool.wait(outer);
+
+            CHECK( count == 64 );
+        }
+
+        SUBCASE( "parallel_for" ) {
+            std::vector<int> visited(1037, 0);
+            std::atomic<std::size_t> largest(0);
+
+            pool.parallel_for(0, visited.size(), 10,
+                              [&](std::size_t first, std::size_t last) {
+                std::size_t seen = largest;
+                while (last - first > seen &&
+                       !largest.compare_exchange_weak(seen, last - first)) {}
+
+                for (std::size_t i = first; i < last; i++)
+                    visited[i]++;
+            });
+
+            CHECK( std::count(visited.begin(), visited.end(), 1) ==
+                   static_cast<std::ptrdiff_t>(visited.size()) );
+            CHECK( largest <= 10 );
+
+            CHECK_THROWS_AS( pool.parallel_for(0, 1, 0,
+                                               [](std::size_t, std::size_t) {}),
+                             std::invalid_argument );
+        }
+
+        SUBCASE( "exceptions" ) {
+            task_group group;
+
+            pool.submit(group, [] { throw std::runtime_error("task"); });
+            pool.submit(group, [] {});
+
+            CHECK_THROWS_AS( pool.wait(group), std::runtime_error );
+            CHECK( group.done() );
+        }
+
+        SUBCASE( "stats" ) {
+            task_group group;
+
+            for (int i = 0; i < 10; i++)
+                pool.submit(group, [] {});
+
+            pool.wait(group);
+
+            const scheduler_stats stats = pool.stats();
+
+            CHECK( stats.tasks == 10 );
+            CHECK( stats.mean_latency_seconds <= stats.max_latency_seconds );
+
+            pool.reset_stats();
+
+            CHECK( pool.stats().tasks == 0 );
+            CHECK( pool.stats().steals == 0 );
+        }
+    }
+}
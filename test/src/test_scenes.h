@@ -0,0 +1,70 @@
+/** @file test_scenes.h */
+
+#pragma once
+
+#include "random.h"
+#include "sphere.h"
+#include "triangle.h"
+
+#include <cstddef>
+#include <vector>
+
+/** @returns A float in [-extent, extent) drawn from random. */
+inline float next_centered(pcg32& random, float extent) {
+    return random.next_float() * (2 * extent) - extent;
+}
+
+/**
+ * @returns A deterministic cloud of count small spheres (radii in
+ *          [0.05, 0.35)) centered in [-extent, extent)^3.
+ */
+inline std::vector<sphere> sphere_cloud(std::size_t count,
+                                        std::uint64_t seed,
+                                        float extent = 10) {
+    std::vector<sphere> spheres;
+    pcg32 random(seed);
+
+    for (std::size_t i = 0; i < count; i++) {
+        const float x = next_centered(random, extent);
+        const float y = next_centered(random, extent);
+        const float z = next_centered(random, extent);
+
+        spheres.push_back(sphere(vec3f(x, y, z),
+                                 0.05f + random.next_float() * 0.3f));
+    }
+
+    return spheres;
+}
+
+/**
+ * @returns A deterministic soup of count unit-sized triangles, with a
+ *          vertex in [-extent, extent) per axis.
+ */
+inline std::vector<triangle> triangle_soup(std::size_t count,
+                                           std::uint64_t seed,
+                                           const vec3f& extent =
+                                               vec3f(10, 10, 10)) {
+    std::vector<triangle> triangles;
+    pcg32 random(seed);
+
+    for (std::size_t i = 0; i < count; i++) {
+        const float x = next_centered(random, extent.x());
+        const float y = next_centered(random, extent.y());
+        const float z = next_centered(random, extent.z());
+        const vec3f center(x, y, z);
+
+        vec3f corners[2];
+
+        for (vec3f& corner : corners) {
+            const float dx = next_centered(random, 0.5f);
+            const float dy = next_centered(random, 0.5f);
+            const float dz = next_centered(random, 0.5f);
+
+            corner = center + vec3f(dx, dy, dz);
+        }
+
+        triangles.push_back(triangle(center, corners[0], corners[1]));
+    }
+
+    return triangles;
+}
@@ -0,0 +1,214 @@
+#include "doctest.h"
+#include "random.h"
+#include "tlas.h"
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+/** @returns A closed unit cube at the origin as a bottom level. */
+std::shared_ptr<const blas> cube_object() {
+    std::vector<vec3f> positions;
+
+    for (int i = 0; i < 8; i++)
+        positions.push_back(vec3f(float(i & 1), float((i >> 1) & 1),
+                                  float((i >> 2) & 1)));
+
+    const std::vector<std::uint32_t> indices = {
+        0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,
+        0, 1, 4, 1, 5, 4,  2, 6, 3, 3, 6, 7,
+        0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5
+    };
+
+    auto object = std::make_shared<blas>();
+
+    object->geometry = mesh(positions, indices);
+    object->tree = bvh(primitive_bounds(object->geometry));
+
+    return object;
+}
+
+/** @returns The closest hit of r, testing every world space triangle. */
+bool brute_force(const ray& r, const tlas& scene, float& t,
+                 std::size_t& hit) {
+    bool found = false;
+
+    for (std::size_t i = 0; i < scene.instances().size(); i++) {
+        const instance& placed = scene.instances()[i];
+        const mesh& geometry = placed.object().geometry;
+        const affine_transform& to_world = placed.object_to_world();
+
+        for (std::size_t j = 0; j < geometry.triangle_count(); j++) {
+            const triangle tri = geometry.get_triangle(j);
+            const triangle world(to_world.transform_point(tri.v0()),
+                                 to_world.transform_point(tri.v1()),
+                                 to_world.transform_point(tri.v2()));
+
+            if (intersect(r, world, 1e-4f, t)) {
+                hit = i;
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+}
+
+TEST_CASE( "affine transform" ) {
+    const affine_transform turn =
+        affine_transform::rotation(vec3f(0, 0, 2), 1.57079633f);
+    const affine_transform transform =
+        affine_transform::translation(vec3f(1, 2, 3)) * turn *
+        affine_transform::scaling(vec3f(2, 1, 0.5f));
+
+    const vec3f x = turn.transform_vector(vec3f(1, 0, 0));
+
+    CHECK( x.x() == doctest::Approx(0).epsilon(1e-6) );
+    CHECK( x.y() == doctest::Approx(1) );
+
+    const vec3f p = transform.transform_point(vec3f(1, 1, 1));
+
+    CHECK( p.x() == doctest::Approx(0) );
+    CHECK( p.y() == doctest::Approx(4) );
+    CHECK( p.z() == doctest::Approx(3.5) );
+
+    SUBCASE( "inverse" ) {
+        const vec3f back = transform.inverse().transform_point(p);
+
+        CHECK( back.x() == doctest::Approx(1) );
+        CHECK( back.y() == doctest::Approx(1) );
+        CHECK( back.z() == doctest::Approx(1) );
+
+        CHECK_THROWS_AS( affine_transform::scaling(vec3f(1, 0, 1)).inverse(),
+                         std::invalid_argument );
+    }
+
+    SUBCASE( "normals" ) {
+        // A tangent and the normal of a plane stay perpendicular.
+        const vec3f tangent = transform.transform_vector(vec3f(1, -1, 0));
+        const vec3f normal =
+            transform.inverse().transform_transposed(vec3f(1, 1, 0));
+
+        CHECK( dot(tangent, normal) == doctest::Approx(0).epsilon(1e-6) );
+    }
+
+    SUBCASE( "bounds" ) {
+        const aabb box(vec3f(-1, 0, 2), vec3f(3, 1, 4));
+        const aabb moved = transform_bounds(transform, box);
+        bool inside = true;
+
+        for (int i = 0; i < 8; i++) {
+            const vec3f corner(i & 1 ? 3 : -1, i & 2 ? 1 : 0, i & 4 ? 4 : 2);
+            const vec3f q = transform.transform_point(corner);
+
+            for (int axis = 0; axis < 3; axis++)
+                inside = inside &&
+                         q.component(axis) >=
+                             moved.min().component(axis) - 1e-5f &&
+                         q.component(axis) <=
+                             moved.max().component(axis) + 1e-5f;
+        }
+
+        CHECK( inside );
+        CHECK( transform_bounds(transform, aabb()).empty() );
+    }
+}
+
+TEST_CASE( "tlas" ) {
+    const std::shared_ptr<const blas> cube = cube_object();
+    std::vector<instance> instances;
+
+    for (int i = 0; i < 20; i++) {
+        const float angle = 0.4f * i;
+
+        instances.push_back(instance(cube,
+            affine_transform::translation(vec3f(float(i % 5) * 3 - 6,
+                                                float(i / 5) * 3 - 4, 0)) *
+            affine_transform::rotation(vec3f(1, 1, 0), angle) *
+            affine_transform::scaling(vec3f(1, 1 + 0.1f * i, 1))));
+    }
+
+    tlas scene(std::move(instances));
+
+    CHECK( scene.instances().size() == 20 );
+    CHECK( scene.instances()[3].shared() == cube );
+
+    SUBCASE( "matches brute force" ) {
+        pcg32 random(5);
+        std::size_t hits = 0;
+        std::size_t mismatches = 0;
+
+        for (int i = 0; i < 2000; i++) {
+            const vec3f origin(random.next_float() * 20 - 10,
+                               random.next_float() * 16 - 8, 10);
+            // Unnormalized directions: t must not depend on the length.
+            const vec3f direction = vec3f(random.next_float() - 0.5f,
+                                          random.next_float() - 0.5f, -2) *
+                                    (0.5f + random.next_float());
+            const ray r(origin, direction);
+
+            float expected_t = std::numeric_limits<float>::infinity();
+            float t = expected_t;
+            std::size_t expected = 0;
+            instance_hit hit;
+            bvh_traversal_stats stats;
+
+            const bool expected_found = brute_force(r, scene, expected_t,
+                                                    expected);
+            const bool found = intersect(r, scene, 1e-4f, t, hit, &stats);
+
+            hits += found;
+
+            if (found != expected_found ||
+                (found && (hit.instance_index != expected ||
+                           std::fabs(t - expected_t) > 1e-3f * t)))
+                mismatches++;
+        }
+
+        CHECK( hits > 100 );
+        CHECK( mismatches == 0 );
+    }
+
+    SUBCASE( "moving instances" ) {
+        const ray r(vec3f(40.5f, 0.5f, 10), vec3f(0, 0, -1));
+        const bvh_node root = scene.top_level().nodes()[0];
+
+        float t = std::numeric_limits<float>::infinity();
+        instance_hit hit;
+
+        CHECK_FALSE( intersect(r, scene, 1e-4f, t, hit) );
+
+        scene.set_transform(7, affine_transform::translation(
+                                   vec3f(40, 0, 0)));
+
+        // Stale until the top level is rebuilt.
+        CHECK_FALSE( intersect(r, scene, 1e-4f, t, hit) );
+
+        scene.rebuild();
+
+        CHECK( intersect(r, scene, 1e-4f, t, hit) );
+        CHECK( hit.instance_index == 7 );
+        CHECK( t == doctest::Approx(9) );
+        CHECK( scene.top_level().nodes()[0].hi[0] > root.hi[0] );
+
+        CHECK_THROWS_AS( scene.set_transform(20, affine_transform()),
+                         std::out_of_range );
+        CHECK_THROWS_AS( scene.set_transform(0, affine_transform::scaling(
+                             vec3f(0, 1, 1))),
+                         std::invalid_argument );
+    }
+
+    SUBCASE( "empty" ) {
+        float t = std::numeric_limits<float>::infinity();
+        instance_hit hit;
+
+        CHECK( tlas().empty() );
+        CHECK_FALSE( intersect(ray(vec3f(0, 0, 0), vec3f(0, 0, 1)), tlas(),
+                               0, t, hit) );
+        CHECK_THROWS_AS( instance(nullptr), std::invalid_argument );
+    }
+}
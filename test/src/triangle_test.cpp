@@ -0,0 +1,97 @@
+#include "doctest.h"
+#include "triangle.h"
+
+#include <cmath>
+#include <limits>
+
+TEST_CASE( "triangle kernels" ) {
+    const float inf = std::numeric_limits<float>::infinity();
+    const triangle tri(vec3f(-1, -1, 3), vec3f(1, -1, 3), vec3f(0, 1, 3));
+    const triangle_precomputed pre(tri);
+
+    SUBCASE( "hit" ) {
+        const ray r(vec3f(0, 0, 0), vec3f(0, 0, 1));
+        float t_mt = inf, t_wt = inf, t_pre = inf;
+
+        CHECK( intersect(r, tri, 0, t_mt) );
+        CHECK( intersect_watertight(r, tri, 0, t_wt) );
+        CHECK( intersect(r, pre, 0, t_pre) );
+
+        CHECK( t_mt == doctest::Approx(3) );
+        CHECK( t_wt == doctest::Approx(3) );
+        CHECK( t_pre == doctest::Approx(3) );
+    }
+
+    SUBCASE( "back face and negative direction" ) {
+        const ray r(vec3f(0, 0, 5), vec3f(0, 0, -2));
+        float t_mt = inf, t_wt = inf, t_pre = inf;
+
+        CHECK( intersect(r, tri, 0, t_mt) );
+        CHECK( intersect_watertight(r, tri, 0, t_wt) );
+        CHECK( intersect(r, pre, 0, t_pre) );
+
+        CHECK( t_wt == doctest::Approx(1) );
+        CHECK( t_pre == doctest::Approx(1) );
+    }
+
+    SUBCASE( "miss and range" ) {
+        const ray outside(vec3f(2, 0, 0), vec3f(0, 0, 1));
+        const ray parallel(vec3f(0, 0, 0), vec3f(1, 0, 0));
+        const ray ahead(vec3f(0, 0, 0), vec3f(0, 0, 1));
+        float t = inf;
+
+        CHECK_FALSE( intersect_watertight(outside, tri, 0, t) );
+        CHECK_FALSE( intersect(outside, pre, 0, t) );
+        CHECK_FALSE( intersect_watertight(parallel, tri, 0, t) );
+        CHECK_FALSE( intersect(parallel, pre, 0, t) );
+
+        t = 2;
+        CHECK_FALSE( intersect_watertight(ahead, tri, 0, t) );
+        CHECK_FALSE( intersect(ahead, pre, 0, t) );
+        CHECK( t == 2 );
+    }
+
+    SUBCASE( "kernels agree" ) {
+        int disagreements = 0;
+
+        for (int i = 0; i < 2000; i++) {
+            const float a = i * 0.37f;
+            const ray r(vec3f(std::sin(a) * 0.5f, std::cos(a * 1.3f) * 0.5f,
+                              -1),
+                        vec3f(std::sin(a * 2.1f), std::cos(a * 0.7f), 4));
+
+            float t_mt = inf, t_wt = inf, t_pre = inf;
+            const bool mt = intersect(r, tri, 0, t_mt);
+            const bool wt = intersect_watertight(r, tri, 0, t_wt);
+            const bool pr = intersect(r, pre, 0, t_pre);
+
+            disagreements += mt != wt || mt != pr ||
+                             (mt && (std::fabs(t_wt - t_mt) > 1e-4f ||
+                                     std::fabs(t_pre - t_mt) > 1e-4f));
+        }
+
+        CHECK( disagreements == 0 );
+    }
+
+    SUBCASE( "watertight along a shared edge" ) {
+        // Two triangles sharing the edge (0, -1, 2) - (0, 1, 2).
+        const triangle left(vec3f(0, -1, 2), vec3f(0, 1, 2),
+                            vec3f(-1.3f, 0.1f, 2.7f));
+        const triangle right(vec3f(0, 1, 2), vec3f(0, -1, 2),
+                             vec3f(1.1f, -0.2f, 1.6f));
+        int gaps = 0;
+
+        for (int i = 0; i < 1000; i++) {
+            const float y = -0.999f + i * 0.001998f;
+            const ray r(vec3f(0.3f, 0.2f, -1), vec3f(-0.3f, y - 0.2f, 3));
+
+            float t = inf;
+            const bool hit_left = intersect_watertight(r, left, 0, t);
+            const bool hit_right = intersect_watertight(r, right, 0, t);
+
+            gaps += !hit_left && !hit_right;
+        }
+
+        CHECK( gaps == 0 );
+    }
+}
@@ -0,0 +1,47 @@
+#include "doctest.h"
+#include "vec3_expr.h"
+
+TEST_CASE( "vec3 expression templates" ) {
+    const vec3f a(1, 2, 3);
+    const vec3f b(4, 5, 6);
+    const vec3f c(0.5, 0.25, 0.125);
+
+    SUBCASE( "matches the eager operators" ) {
+        const float s = 0.75f;
+        const float t = 2.5f;
+
+        const vec3f eager = a * s + b * t - c;
+        const vec3f fused = lazy(a) * s + lazy(b) * t - lazy(c);
+
+        CHECK( fused.x() == doctest::Approx(eager.x()) );
+        CHECK( fused.y() == doctest::Approx(eager.y()) );
+        CHECK( fused.z() == doctest::Approx(eager.z()) );
+    }
+
+    SUBCASE( "every operator" ) {
+        CHECK( eval(lazy(a) + lazy(b)) == a + b );
+        CHECK( eval(lazy(a) - lazy(b)) == a - b );
+        CHECK( eval(lazy(a) * lazy(b)) == a * b );
+        CHECK( eval(lazy(a) / lazy(b)) == a / b );
+        CHECK( eval(2.0f * lazy(a)) == a * 2.0f );
+        CHECK( eval(lazy(b) / 2.0f) == b / 2.0f );
+    }
+
+    SUBCASE( "contraction" ) {
+        CHECK( eval(lazy(c) - lazy(a) * lazy(b)) == vec3f(-3.5, -9.75, 
+                                                           -17.875) );
+        CHECK( eval(lazy(c) + lazy(a) * lazy(b)) == vec3f(4.5, 10.25, 
+                                                           18.125) );
+        CHECK( eval(lazy(a) * lazy(b) - lazy(c)) == vec3f(3.5, 9.75, 
+                                                           17.875) );
+    }
+
+    SUBCASE( "integer components" ) {
+        const color col_1(10, 20, 30);
+        const color col_2(1, 2, 3);
+
+        const color result = lazy(col_1) * lazy(col_2) + lazy(col_2);
+
+        CHECK( result == color(11, 42, 93) );
+    }
+}
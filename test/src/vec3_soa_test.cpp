@@ -0,0 +1,84 @@
+#include "doctest.h"
+#include "vec3_soa.h"
+
+#include <cstdint>
+
+TEST_CASE( "vec3_soa storage" ) {
+    SUBCASE( "alignment" ) {
+        vec3f_soa<8> batch;
+        vec3f_array array(13);
+
+        CHECK( reinterpret_cast<std::uintptr_t>(batch.data(0)) % 64 == 0 );
+        CHECK( reinterpret_cast<std::uintptr_t>(batch.data(1)) % 64 == 0 );
+        CHECK( reinterpret_cast<std::uintptr_t>(array.data(2)) % 64 == 0 );
+    }
+
+    SUBCASE( "gather & scatter" ) {
+        std::vector<vec3f> vecs = { vec3f(1, 2, 3), vec3f(4, 5, 6),
+                                    vec3f(7, 8, 9), vec3f(10, 11, 12) };
+
+        vec3f_soa<4> batch;
+        batch.gather(vecs.data());
+
+        CHECK( batch.data(0)[2] == 7 );
+        CHECK( batch.data(1)[2] == 8 );
+        CHECK( batch.get(3) == vec3f(10, 11, 12) );
+
+        vec3f_array array(vecs);
+        std::vector<vec3f> out(vecs.size());
+        array.scatter(out.data());
+
+        CHECK( out == vecs );
+    }
+
+    SUBCASE( "broadcast & push_back" ) {
+        vec3f_soa<16> batch(vec3f(1, 2, 3));
+        vec3f_array array;
+
+        array.push_back(vec3f(1, 2, 3));
+
+        CHECK( batch.get(15) == vec3f(1, 2, 3) );
+        CHECK( array.size() == 1 );
+        CHECK( array.get(0) == vec3f(1, 2, 3) );
+    }
+}
+
+TEST_CASE( "vec3_soa operators" ) {
+    vec3f_array v1(std::vector<vec3f>{ vec3f(100, 200, 300), vec3f(2, 3, 4) });
+    vec3f_array v2(std::vector<vec3f>{ vec3f(50, 40, 10), vec3f(0.5, 2, 3) });
+
+    SUBCASE( "arithmetic" ) {
+        CHECK( (v1 + v2).get(0) == vec3f(150, 240, 310) );
+        CHECK( (v1 - v2).get(0) == vec3f(50, 160, 290) );
+        CHECK( (v1 * v2).get(0) == vec3f(5000, 8000, 3000) );
+        CHECK( (v1 / v2).get(0) == vec3f(2, 5, 30) );
+        CHECK( (v1 * 2.0f).get(1) == vec3f(4, 6, 8) );
+        CHECK( (2.0f * v1).get(1) == vec3f(4, 6, 8) );
+        CHECK( (v1 / 2.0f).get(1) == vec3f(1, 1.5, 2) );
+    }
+
+    SUBCASE( "size mismatch" ) {
+        vec3f_array v3(3);
+
+        CHECK_THROWS_AS( v1 += v3, std::invalid_argument );
+        CHECK_THROWS_AS( dot(v1, v3), std::invalid_argument );
+    }
+
+    SUBCASE( "dot & cross" ) {
+        CHECK( dot(v1, v2)[1] == 19 );
+        CHECK( cross(v1, v2).get(1) == cross(v1.get(1), v2.get(1)) );
+    }
+
+    SUBCASE( "length & normalize" ) {
+        vec3f_soa<2> batch;
+        batch.set(0, vec3f(2, 3, 6));
+        batch.set(1, vec3f(4, 5, 6));
+
+        CHECK( batch.squared_length()[1] == 77 );
+        CHECK( batch.length()[0] == 7 );
+
+        batch.normalize();
+
+        CHECK( batch.get(0) == vec3f(2 / 7.f, 3 / 7.f, 6 / 7.f) );
+    }
+}
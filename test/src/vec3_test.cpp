@@ -70,6 +70,7 @@ TEST_CASE( "vec3 constructors and component access" ) {
         }
     }
 
+#ifdef RAYSTALKER_CHECKED
     SUBCASE( "[] out of bounds access" ) {
         SUBCASE( "negative index" ) {
             const vec3f vec(12321, 12321, 1941);
@@ -97,6 +98,19 @@ TEST_CASE( "vec3 constructors and component access" ) {
             CHECK( thrown == true );
         }
     }
+#endif
+
+    SUBCASE( "unchecked component access" ) {
+        vec3f vec(1, 2, 3);
+
+        vec.component(1) = 5;
+
+        CHECK( vec.component(0) == 1 );
+        CHECK( vec.component(1) == 5 );
+        CHECK( vec[2] == vec.component(2) );
+        CHECK( noexcept(vec.component(0)) );
+        CHECK( noexcept(vec[0]) == !vec3_checked_access );
+    }
 }
 
 TEST_CASE( "vec3 operators" ) {
@@ -407,6 +421,31 @@ TEST_CASE( "vec3 operators" ) {
             }
         }
     }
+
+    SUBCASE( "scalars convert to the component type" ) {
+        // The same with and without RAYSTALKER_NO_SIMD.
+        const vec3f vec(2, 4, 6);
+        const vec3_<double> vec_d(2, 4, 6);
+        const color col(2, 4, 6);
+
+        CHECK( vec * 2 == vec3f(4, 8, 12) );
+        CHECK( 2 * vec == vec3f(4, 8, 12) );
+        CHECK( vec / 2 == vec3f(1, 2, 3) );
+        CHECK( vec * 0.5 == vec3f(1, 2, 3) );
+
+        CHECK( vec_d * 2 == vec3_<double>(4, 8, 12) );
+        CHECK( 2.0f * vec_d == vec3_<double>(4, 8, 12) );
+        CHECK( vec_d / 2 == vec3_<double>(1, 2, 3) );
+
+        CHECK( col * 2 == color(4, 8, 12) );
+        CHECK( 2 * col == color(4, 8, 12) );
+        CHECK( col / 2 == color(1, 2, 3) );
+
+        static_assert( vec3f(1, 2, 3) * 2 == vec3f(2, 4, 6),
+                       "constexpr * int" );
+        static_assert( 2 * vec3_<double>(1, 2, 3) == vec3_<double>(2, 4, 6),
+                       "constexpr int *" );
+    }
 }
 
 TEST_CASE( "vec3 dot & cross") {
@@ -454,7 +493,7 @@ TEST_CASE( "vec3 length" ) {
     SUBCASE( "normal" ) {
         vec3f vec(3, 4, 5);
 
-        CHECK( vec.length() == sqrt(50) );
+        CHECK( vec.length() == std::sqrt(50.0f) );
     }
 
     SUBCASE( "squared" ) {
@@ -484,6 +523,43 @@ TEST_CASE( "vec3 normalize & getNormalized" ) {
         CHECK ( vec_2.y() == 3 / 7.f);
         CHECK ( vec_2.z() == 6 / 7.f );
     }
+
+    SUBCASE( "no length truncation" ) {
+        vec3d vec(1, 1, 0);
+
+        vec.normalize();
+
+        CHECK ( vec.length() == doctest::Approx(1) );
+    }
+
+    SUBCASE( "accuracy tiers" ) {
+        const vec3f vec(0.3f, -12.5f, 4.0f);
+        const vec3f exact = vec.getNormalized();
+
+        const vec3f newton = vec.getNormalized<normalize_rsqrt_newton>();
+        const vec3f raw = vec.getNormalized<normalize_rsqrt>();
+
+        for (size_t i = 0; i < 3; i++) {
+            CHECK ( newton[i] == doctest::Approx(exact[i]).epsilon(5e-7) );
+            CHECK ( raw[i] == doctest::Approx(exact[i]).epsilon(3.7e-4) );
+        }
+
+        vec3f in_place = vec;
+        in_place.normalize<normalize_rsqrt_newton>();
+
+        CHECK ( in_place == newton );
+    }
+
+    SUBCASE( "normalize_safe" ) {
+        const vec3f zero;
+        const vec3f tiny(1e-30f, 0, 0);
+        const vec3f up(0, 1, 0);
+
+        CHECK ( normalize_safe(zero) == zero );
+        CHECK ( normalize_safe(tiny, up) == up );
+        CHECK ( normalize_safe<normalize_rsqrt>(zero, up) == up );
+        CHECK ( normalize_safe(vec3f(0, 0, 5)) == vec3f(0, 0, 1) );
+    }
 }
 
 TEST_CASE( "vec3 convert" ) {
@@ -495,3 +571,131 @@ TEST_CASE( "vec3 convert" ) {
         CHECK ( vec_2 == vec3_<int>(123, 12321, 123213) );
     }
 }
+
+TEST_CASE( "vec3 min & max" ) {
+    SUBCASE( "vec3f (float)" ) {
+        const vec3f vec_1(1, -2, 3);
+        const vec3f vec_2(0, 5, 3.5);
+
+        CHECK( vec3_min(vec_1, vec_2) == vec3f(0, -2, 3) );
+        CHECK( vec3_max(vec_1, vec_2) == vec3f(1, 5, 3.5) );
+    }
+
+    SUBCASE( "vec3_<int>" ) {
+        const vec3_<int> vec_1(1, -2, 3);
+        const vec3_<int> vec_2(0, 5, 3);
+
+        CHECK( vec3_min(vec_1, vec_2) == vec3_<int>(0, -2, 3) );
+        CHECK( vec3_max(vec_1, vec_2) == vec3_<int>(1, 5, 3) );
+    }
+}
+
+TEST_CASE( "vec3f simd layout" ) {
+    SUBCASE( "alignment" ) {
+#ifdef RAYSTALKER_SIMD
+        CHECK( alignof(vec3f) == 16 );
+        CHECK( sizeof(vec3f) == 16 );
+        CHECK( std::is_trivially_copyable<vec3f>::value );
+#endif
+    }
+
+    SUBCASE( "negation" ) {
+        vec3f vec(1, -2, 3);
+
+        CHECK( -vec == vec3f(-1, 2, -3) );
+    }
+
+    SUBCASE( "padding is ignored" ) {
+        vec3f vec_1(1, 2, 3);
+        vec3f vec_2(2, 4, 6);
+
+        CHECK( (vec_1 * vec_2) / vec_2 == vec_1 );
+        CHECK( dot(vec_1 / vec3f(1, 1, 1), vec3f(1, 1, 1)) == 6 );
+        CHECK( (vec_2 / 0.5f).squared_length() == 4 * 56 );
+    }
+
+    SUBCASE( "scalar fallback agrees" ) {
+        vec3_<double> ref_1(2, 3, 4);
+        vec3_<double> ref_2(0.5, 2, 3);
+        vec3f vec_1(2, 3, 4);
+        vec3f vec_2(0.5, 2, 3);
+
+        vec3f result = cross(vec_1, vec_2);
+        vec3_<double> expected = cross(ref_1, ref_2);
+
+        CHECK( result.x() == expected.x() );
+        CHECK( result.y() == expected.y() );
+        CHECK( result.z() == expected.z() );
+    }
+}
+
+TEST_CASE( "vec3 constexpr" ) {
+    SUBCASE( "vec3f (float)" ) {
+        constexpr vec3f vec_1(2, 3, 4);
+        constexpr vec3f vec_2(0.5, 2, 3);
+
+        static_assert( vec_1 + vec_2 == vec3f(2.5, 5, 7), "constexpr +" );
+        static_assert( vec_1 * 2.0f == vec3f(4, 6, 8), "constexpr *" );
+        static_assert( dot(vec_1, vec_2) == 19, "constexpr dot" );
+        static_assert( cross(vec_1, vec_2) == vec3f(1, -4, 2.5), 
+                       "constexpr cross" );
+        static_assert( vec_1[2] == 4, "constexpr []" );
+
+        constexpr vec3f sum = [] {
+            vec3f vec(1, 1, 1);
+            vec += vec3f(1, 2, 3);
+            vec *= 2.0f;
+            return vec;
+        }();
+
+        CHECK( sum == vec3f(4, 6, 8) );
+    }
+
+    SUBCASE( "color (unsigned char)" ) {
+        constexpr color col = vec3_convert<float, unsigned char>(
+                                  vec3f(1.5, 200.7, 3));
+
+        static_assert( col == color(1, 200, 3), "constexpr vec3_convert" );
+        static_assert( col.squared_length() == 40010, 
+                       "constexpr squared_length" );
+    }
+
+    SUBCASE( "noexcept" ) {
+        vec3f vec;
+
+        CHECK( noexcept(vec + vec) );
+        CHECK( noexcept(dot(vec, vec)) );
+        CHECK( noexcept(vec.normalize()) );
+        CHECK( noexcept(vec3_convert<float, int>(vec)) );
+    }
+}
+
+TEST_CASE( "vec3 mixed precision" ) {
+    SUBCASE( "scalar types follow the components" ) {
+        const vec3f vec_f(1, 2, 3);
+        const vec3d vec_d(1, 2, 3);
+        const color col(1, 2, 3);
+
+        CHECK( std::is_same<decltype(dot(vec_f, vec_f)), float>::value );
+        CHECK( std::is_same<decltype(vec_f.length()), float>::value );
+        CHECK( std::is_same<decltype(vec_d.length()), double>::value );
+        CHECK( std::is_same<decltype(col.length()), double>::value );
+        CHECK( dot(col, col) == 14 );
+    }
+
+    SUBCASE( "float and double promote to double" ) {
+        const vec3f vec_f(0.1f, 2, 3);
+        const vec3d vec_d(0.1, 0.5, 0.25);
+
+        CHECK( std::is_same<decltype(vec_f + vec_d), vec3d>::value );
+        CHECK( std::is_same<decltype(dot(vec_d, vec_f)), double>::value );
+
+        CHECK( (vec_f + vec_d).x() == double(0.1f) + 0.1 );
+        CHECK( (vec_d - vec_f) == vec3d(0.1 - double(0.1f), -1.5, -2.75) );
+        CHECK( (vec_f * vec_d).z() == 0.75 );
+        CHECK( (vec_f / vec_d).y() == 4 );
+        CHECK( dot(vec_f, vec_d) == doctest::Approx(0.01 + 1 + 0.75) );
+        CHECK( cross(vec_d, vec_f) == cross(vec_d, 
+                                            vec3_convert<float, double>(vec_f)) );
+    }
+}
@@ -0,0 +1,86 @@
+#include "doctest.h"
+#include "test_scenes.h"
+#include "wide_bvh.h"
+
+#include <cmath>
+#include <limits>
+
+namespace {
+
+template <typename Tree>
+void trace_all(const Tree& tree, const std::vector<triangle>& triangles,
+               std::vector<float>& distances, bvh_traversal_stats& stats) {
+    for (int i = 0; i < 400; i++) {
+        const float angle = i * 0.05f;
+        const ray r(vec3f(0, 0, -30), vec3f(std::cos(angle) * 0.3f,
+                                            std::sin(angle * 1.7f) * 0.3f,
+                                            1));
+
+        float t = std::numeric_limits<float>::infinity();
+        std::size_t hit;
+
+        intersect(r, tree, triangles, 0.0f, t, hit, &stats);
+        distances.push_back(t);
+    }
+}
+
+}
+
+TEST_CASE( "wide_bvh" ) {
+    SUBCASE( "empty" ) {
+        const bvh binary(std::vector<aabb>{});
+        const wide_bvh<4> tree(binary);
+        const std::vector<triangle> triangles;
+        float t = 1;
+        std::size_t hit;
+
+        CHECK( tree.empty() );
+        CHECK_FALSE( intersect(ray(vec3f(), vec3f(0, 0, 1)), tree, triangles,
+                               0.0f, t, hit) );
+    }
+
+    SUBCASE( "single leaf" ) {
+        const std::vector<triangle> triangles = {
+            triangle(vec3f(-1, -1, 2), vec3f(1, -1, 2), vec3f(0, 1, 2))
+        };
+        const bvh binary(primitive_bounds(triangles));
+        const wide_bvh<8> tree(binary);
+
+        float t = std::numeric_limits<float>::infinity();
+        std::size_t hit = 1;
+
+        REQUIRE( tree.nodes().size() == 1 );
+        CHECK( tree.nodes()[0].children == 1 );
+        CHECK( intersect(ray(vec3f(), vec3f(0, 0, 1)), tree, triangles,
+                         0.0f, t, hit) );
+        CHECK( t == doctest::Approx(2) );
+        CHECK( hit == 0 );
+    }
+
+    SUBCASE( "same hits as the binary tree" ) {
+        const std::vector<triangle> triangles = triangle_soup(5000, 777);
+        const bvh binary(primitive_bounds(triangles));
+        const wide_bvh<4> tree4(binary);
+        const wide_bvh<8> tree8(binary);
+
+        CHECK( tree4.nodes().size() < binary.nodes().size() / 2 );
+        CHECK( tree8.nodes().size() < tree4.nodes().size() );
+
+        // The indices are shared, not copied.
+        CHECK( tree4.indices().data() == binary.indices().data() );
+
+        std::vector<float> binary_t, wide4_t, wide8_t;
+        bvh_traversal_stats binary_stats, wide4_stats, wide8_stats;
+
+        trace_all(binary, triangles, binary_t, binary_stats);
+        trace_all(tree4, triangles, wide4_t, wide4_stats);
+        trace_all(tree8, triangles, wide8_t, wide8_stats);
+
+        CHECK( wide4_t == binary_t );
+        CHECK( wide8_t == binary_t );
+
+        CHECK( wide4_stats.rays == binary_stats.rays );
+        CHECK( wide4_stats.nodes < binary_stats.nodes );
+        CHECK( wide8_stats.nodes < wide4_stats.nodes );
+    }
+}